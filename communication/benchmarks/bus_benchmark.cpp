@@ -0,0 +1,314 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../include/bus_manager.h"
+#include "../include/communication.h"
+#include "../include/latency_tracer.h"
+#include "../sockets/socket_factory.h"
+
+// Messages every client sends in one scenario
+#define BENCHMARK_MESSAGES 2000
+
+// A scenario that does not receive everything gives up after this long
+#define BENCHMARK_TIMEOUT_MS 20000
+
+// Registration at the bus is asynchronous, the clients wait this long before sending
+#define BENCHMARK_REGISTRATION_MS 200
+
+// Every scenario connects its clients under fresh IDs, starting here
+#define BENCHMARK_FIRST_ID 1000
+#define BENCHMARK_ID_BLOCK 100
+
+// One point of the sweep
+struct Scenario
+{
+    size_t clients;
+    size_t size;
+    bool broadcast;
+};
+
+// Options from the command line
+struct Options
+{
+    bool processes = false;
+    bool async = false;
+    uint32_t bitrate = 0;
+    size_t messages = BENCHMARK_MESSAGES;
+};
+
+// What the clients of one process saw
+struct ClientResult
+{
+    uint64_t delivered;
+    uint64_t failed;
+    double cpuSeconds;
+    uint64_t samples;
+    double seconds; // From the first send until everything arrived
+};
+
+// Filled by the receive callback, which gets no context of its own
+static std::atomic<uint64_t> delivered(0);
+static LatencyHistogram latency;
+
+// The IDs of the running scenario, a message from another one arrived late and is not counted
+static std::atomic<uint32_t> scenarioFirstID(0);
+static std::atomic<uint32_t> scenarioClients(0);
+
+// A forked client sends its raw latencies to the parent, which merges them
+static bool keepSamples = false;
+static std::vector<int64_t> samples;
+
+// The send time is written at the start of every message
+static void receive(const MessageView &message)
+{
+    if (message.srcID - scenarioFirstID.load() >= scenarioClients.load())
+        return;
+
+    int64_t sentAt;
+    std::memcpy(&sentAt, message.data, sizeof(sentAt));
+    int64_t elapsed = monotonicNanoseconds() - sentAt;
+    latency.record(elapsed);
+    if (keepSamples)
+        samples.push_back(elapsed);
+    delivered.fetch_add(1);
+}
+
+// User and system time of the process in seconds
+static double cpuSeconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// Messages all the clients of a scenario receive together, a broadcast also reaches its sender
+static uint64_t expectedDeliveries(const Scenario &scenario, const Options &options)
+{
+    uint64_t sent = scenario.clients * options.messages;
+    return scenario.broadcast ? sent * scenario.clients : sent;
+}
+
+// Waits until the count is reached or the timeout passes
+static void waitForDeliveries(uint64_t expected)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(BENCHMARK_TIMEOUT_MS);
+    while (delivered.load() < expected && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+// Sends the messages of one client, unicast goes to the next client in the ring
+static void sendAll(Communication &client, uint32_t id, uint32_t destID, const Scenario &scenario,
+                    const Options &options, std::atomic<uint64_t> &failed)
+{
+    std::vector<uint8_t> payload(scenario.size, 0x5A);
+    for (size_t i = 0; i < options.messages; ++i) {
+        int64_t now = monotonicNanoseconds();
+        std::memcpy(payload.data(), &now, sizeof(now));
+        if (options.async)
+            client.sendMessageAsync(payload.data(), payload.size(), destID, id, [&failed](ErrorCode res) {
+                if (res != ErrorCode::SUCCESS)
+                    failed++;
+            }, scenario.broadcast);
+        else if (client.sendMessage(payload.data(), payload.size(), destID, id, scenario.broadcast) != ErrorCode::SUCCESS)
+            failed++;
+    }
+}
+
+// All the clients run as threads of this process, they leave the bus when the scenario ends
+static ClientResult runThreads(const Scenario &scenario, const Options &options, uint32_t firstID)
+{
+    std::vector<std::unique_ptr<Communication>> clients;
+    for (size_t i = 0; i < scenario.clients; ++i) {
+        clients.emplace_back(new Communication(firstID + i, receive));
+        clients.back()->startConnection();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(BENCHMARK_REGISTRATION_MS));
+
+    delivered = 0;
+    latency.reset();
+    std::atomic<uint64_t> failed(0);
+    double cpuBefore = cpuSeconds();
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> senders;
+    for (size_t i = 0; i < scenario.clients; ++i)
+        senders.emplace_back(sendAll, std::ref(*clients[i]), firstID + i, firstID + (i + 1) % scenario.clients,
+                             std::cref(scenario), std::cref(options), std::ref(failed));
+    for (std::thread &sender : senders)
+        sender.join();
+    waitForDeliveries(expectedDeliveries(scenario, options));
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return {delivered.load(), failed.load(), cpuSeconds() - cpuBefore, 0, elapsed.count()};
+}
+
+// Runs in a forked process: connects, waits for the start and reports through the pipe
+static void runForkedClient(const Scenario &scenario, const Options &options, uint32_t id, uint32_t destID,
+                            int readyFd, int startFd, int resultFd)
+{
+    keepSamples = true;
+    delivered = 0;
+    Communication client(id, receive);
+    client.startConnection();
+    samples.reserve(expectedDeliveries(scenario, options) / scenario.clients);
+
+    char byte = 0;
+    if (write(readyFd, &byte, 1) != 1 || read(startFd, &byte, 1) != 0)
+        _exit(1);
+
+    std::atomic<uint64_t> failed(0);
+    double cpuBefore = cpuSeconds();
+    sendAll(client, id, destID, scenario, options, failed);
+    waitForDeliveries(expectedDeliveries(scenario, options) / scenario.clients);
+
+    // Every counted delivery has pushed its sample, later ones are left out
+    uint64_t count = delivered.load();
+    ClientResult result = {count, failed.load(), cpuSeconds() - cpuBefore, count, 0};
+    bool written = write(resultFd, &result, sizeof(result)) == sizeof(result) &&
+                   write(resultFd, samples.data(), count * sizeof(int64_t)) == (ssize_t)(count * sizeof(int64_t));
+    logger::flush();
+    _exit(written ? 0 : 1);
+}
+
+// Reads exactly length bytes, returns false at the end of the pipe
+static bool readAll(int fd, void *buffer, size_t length)
+{
+    size_t done = 0;
+    while (done < length) {
+        ssize_t result = read(fd, (char *)buffer + done, length - done);
+        if (result <= 0)
+            return false;
+        done += result;
+    }
+    return true;
+}
+
+// Every client is a process of its own, as in a simulation
+static ClientResult runProcesses(const Scenario &scenario, const Options &options, uint32_t firstID)
+{
+    int ready[2], start[2];
+    if (pipe(ready) < 0 || pipe(start) < 0)
+        return {0, 0, 0, 0, 0};
+
+    std::vector<pid_t> children;
+    std::vector<int> results;
+    for (size_t i = 0; i < scenario.clients; ++i) {
+        int result[2];
+        if (pipe(result) < 0)
+            break;
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(start[1]);
+            runForkedClient(scenario, options, firstID + i, firstID + (i + 1) % scenario.clients, ready[1], start[0], result[1]);
+        }
+        close(result[1]);
+        children.push_back(pid);
+        results.push_back(result[0]);
+    }
+
+    char byte;
+    for (size_t i = 0; i < children.size(); ++i)
+        readAll(ready[0], &byte, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(BENCHMARK_REGISTRATION_MS));
+
+    // Closing the pipe starts all the clients at once
+    latency.reset();
+    double cpuBefore = cpuSeconds();
+    auto begin = std::chrono::steady_clock::now();
+    close(start[1]);
+
+    ClientResult total = {0, 0, 0, 0, 0};
+    for (int fd : results) {
+        ClientResult result;
+        if (readAll(fd, &result, sizeof(result))) {
+            std::vector<int64_t> clientSamples(result.samples);
+            readAll(fd, clientSamples.data(), clientSamples.size() * sizeof(int64_t));
+            for (int64_t sample : clientSamples)
+                latency.record(sample);
+            total.delivered += result.delivered;
+            total.failed += result.failed;
+            total.cpuSeconds += result.cpuSeconds;
+        }
+        close(fd);
+    }
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    for (pid_t pid : children)
+        waitpid(pid, nullptr, 0);
+
+    // The bus runs in this process
+    total.cpuSeconds += cpuSeconds() - cpuBefore;
+    close(ready[0]);
+    close(ready[1]);
+    close(start[0]);
+    return total;
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--processes")
+            options.processes = true;
+        else if (arg == "--async")
+            options.async = true;
+        else if (arg == "--bitrate" && i + 1 < argc)
+            options.bitrate = std::atoi(argv[++i]);
+        else if (arg == "--messages" && i + 1 < argc)
+            options.messages = std::atoi(argv[++i]);
+        else {
+            printf("usage: %s [--processes] [--async] [--bitrate bits/s] [--messages per client]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    BusManager *bus = BusManager::getInstance({}, 0);
+    bus->setBitrate(options.bitrate);
+    if (bus->startConnection() != ErrorCode::SUCCESS) {
+        printf("the bus could not start\n");
+        return 1;
+    }
+
+    const char *transport = std::getenv(TRANSPORT_ENV);
+    printf("transport %s, clients as %s, %s sends, bitrate %u, %zu messages per client\n",
+           transport ? transport : "tcp", options.processes ? "processes" : "threads",
+           options.async ? "async" : "sync", options.bitrate, options.messages);
+    // Nothing sets TCP_NODELAY, so over TCP a small message may wait for Nagle's algorithm
+    // and the delayed ACK of the receiver, which shows as latencies of about 40 ms
+    if (!transport || std::string(transport) != "shm")
+        printf("note: TCP without TCP_NODELAY, small messages may wait ~40 ms for Nagle's algorithm and delayed ACKs\n");
+    printf("%7s %6s %9s %12s %9s %9s %9s %11s %8s\n", "clients", "bytes", "fanout", "msgs/s", "p50 us", "p99 us",
+           "p999 us", "cpu us/msg", "lost");
+
+    uint32_t firstID = BENCHMARK_FIRST_ID;
+    for (bool broadcast : {false, true})
+        for (size_t clients : {2, 4, 8})
+            for (size_t size : {8, 64, 1024}) {
+                Scenario scenario = {clients, size, broadcast};
+                scenarioFirstID = firstID;
+                scenarioClients = clients;
+                ClientResult result = options.processes ? runProcesses(scenario, options, firstID)
+                                                        : runThreads(scenario, options, firstID);
+                firstID += BENCHMARK_ID_BLOCK;
+
+                uint64_t expected = expectedDeliveries(scenario, options);
+                printf("%7zu %6zu %9s %12.0f %9.1f %9.1f %9.1f %11.2f %8llu\n", clients, size,
+                       broadcast ? "broadcast" : "unicast", result.delivered / result.seconds, latency.percentile(50) / 1000.0,
+                       latency.percentile(99) / 1000.0, latency.percentile(99.9) / 1000.0,
+                       result.delivered ? result.cpuSeconds * 1e6 / result.delivered : 0,
+                       (unsigned long long)(expected - std::min(expected, result.delivered)));
+                fflush(stdout);
+            }
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "../include/crc.h"
+
+// A full CAN frame at 500 kbit/s, the time budget the checksum has to fit in
+#define FRAME_BUDGET_NS 270000.0
+
+// Keeps the compiler from dropping the computed checksums
+static volatile uint32_t sink;
+
+// Runs the checksum over the buffer until enough time passed, returns nanoseconds per call
+template <typename Checksum>
+static double measure(Checksum checksum, const std::vector<uint8_t> &buffer)
+{
+    size_t iterations = 1024;
+    while (true) {
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            sink = checksum(buffer.data(), buffer.size());
+        std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - begin;
+        if (elapsed > std::chrono::milliseconds(200))
+            return (double)elapsed.count() / iterations;
+        iterations *= 4;
+    }
+}
+
+// Prints one line of the results table
+static void report(const char *name, size_t size, double ns)
+{
+    printf("%-16s %8zu %12.1f %12.4f%% %10.2f GB/s\n", name, size, ns, 100 * ns / FRAME_BUDGET_NS, size / ns);
+}
+
+int main()
+{
+    printf("crc32c hardware path: %s\n", crc32cHardwareAvailable() ? "sse4.2" : "not available");
+    printf("%-16s %8s %12s %13s %15s\n", "checksum", "bytes", "ns/call", "of frame", "throughput");
+
+    for (size_t size : {8, 64, 1024, 65536}) {
+        std::vector<uint8_t> buffer(size);
+        for (size_t i = 0; i < size; ++i)
+            buffer[i] = i * 31 + 7;
+
+        report("crc15Can", size, measure([](const uint8_t *data, size_t length) { return (uint32_t)crc15Can(data, length); }, buffer));
+        report("crc32cSoftware", size, measure([](const uint8_t *data, size_t length) { return crc32cSoftware(data, length); }, buffer));
+        report("crc32c", size, measure([](const uint8_t *data, size_t length) { return crc32c(data, length); }, buffer));
+    }
+
+    return 0;
+}
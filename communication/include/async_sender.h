@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+#include "packet.h"
+#include "error_code.h"
+
+// Messages that may wait for the I/O thread before new ones are rejected
+#define ASYNC_SEND_QUEUE_LIMIT 4096
+
+// Sends messages in the background for many producer threads.
+// Producers only append to the submission queue, a single I/O thread takes everything
+// that was queued since its last write and sends it as one batch, then runs the completions.
+// Completions run on the I/O thread, so they should be short and must not wait for other sends.
+class AsyncSender
+{
+private:
+    // A message waiting to be sent
+    struct Submission
+    {
+        std::vector<Packet> packets;
+        std::function<void(ErrorCode)> completion;
+        ErrorCode result; // Anything but SUCCESS completes the message without sending it
+    };
+
+    std::function<ErrorCode(std::vector<Packet> &)> writeBatch;
+    std::vector<Submission> submitted; // Filled by the producers
+    std::vector<Submission> inFlight;  // Owned by the I/O thread
+    std::vector<Packet> batch;
+    std::mutex submitMutex;
+    std::condition_variable submittedChanged;
+    bool running;
+    std::thread ioThread;
+
+    // Writes the queued messages until the sender is stopped and the queue is empty
+    void run();
+
+    // Appends a submission, completing it at once if the queue is full
+    void enqueue(Submission &&submission);
+
+public:
+    // Constructor - writeBatch sends all the packets it gets with as few writes as possible
+    AsyncSender(std::function<ErrorCode(std::vector<Packet> &)> writeBatch);
+
+    // Starts the I/O thread
+    void start();
+
+    // Sends what is still queued and joins the I/O thread
+    void stop();
+
+    // Queues the packets of a message, the completion may be null.
+    // A message rejected because the queue is full or the sender is stopped completes on the caller's thread
+    void submit(std::vector<Packet> &&packets, std::function<void(ErrorCode)> completion);
+
+    // Completes a message that cannot be sent, through the queue like every other completion
+    void fail(ErrorCode result, std::function<void(ErrorCode)> completion);
+
+    // Number of messages waiting for the I/O thread
+    size_t pending();
+
+    // Destructor
+    ~AsyncSender();
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "packet.h"
+
+// A capture starts with the magic and the version, then one record per routed packet:
+//   time(8) frame
+// time is the little-endian monotonic nanoseconds of the routing, frame the packet as it is sent on the socket,
+// so payloads are kept whole and a capture is as compact as the traffic itself
+#define CAPTURE_MAGIC "VCSCAP"
+#define CAPTURE_MAGIC_SIZE 6
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER_SIZE (CAPTURE_MAGIC_SIZE + 2)
+#define CAPTURE_TIME_SIZE 8
+
+// Records are collected into blocks of about this size before they are written
+#define CAPTURE_WRITE_BLOCK_SIZE (64 * 1024)
+
+// A packet read back from a capture
+struct CapturedPacket
+{
+    int64_t time; // Monotonic nanoseconds when the bus routed the packet
+    Packet packet;
+};
+
+// Writes a capture file. Not thread safe, the bus writes from the one thread that routes the packets
+class CaptureWriter
+{
+private:
+    int fd;
+    std::vector<uint8_t> block;
+    uint64_t packets;
+    bool failed;
+
+    // Writes the collected records to the file
+    bool flush();
+
+public:
+    // Constructor - creates the file, throws std::runtime_error if it cannot be created
+    CaptureWriter(const std::string &fileName);
+
+    // Adds a record, returns false if the file could not be written
+    bool write(int64_t time, const Packet &packet);
+
+    // Writes what is left and closes the file, returns false if any record was lost
+    bool close();
+
+    // Number of records written
+    uint64_t getPackets();
+
+    // Destructor
+    ~CaptureWriter();
+};
+
+// Reads a capture file record by record
+class CaptureReader
+{
+private:
+    std::ifstream file;
+    bool corrupted;
+
+public:
+    // Constructor - opens the file, throws std::runtime_error if it is missing or not a capture
+    CaptureReader(const std::string &fileName);
+
+    // Reads the next record, returns false at the end of the capture or at a damaged record
+    bool next(CapturedPacket &record);
+
+    // Checks if reading stopped at a damaged record rather than at the end
+    bool isCorrupted();
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "client_connection.h"
+#include "metrics.h"
+
+// A route of a gateway: the broadcast frames whose ID matches the route's ID in every bit the mask selects
+// are forwarded, with those bits replaced by the ones of translatedID. A mask of all ones maps one ID to another,
+// a narrower mask moves a whole range. Routes should not merge the IDs of different senders,
+// the receivers tell the messages apart by ID since the gateway sends all of them
+struct GatewayRoute
+{
+    uint32_t id;
+    uint32_t mask;
+    uint32_t translatedID;
+
+    // Checks if the route forwards the ID
+    bool matches(uint32_t frameID) const { return ((frameID ^ id) & mask) == 0; }
+
+    // The ID the frame gets on the target bus
+    uint32_t translate(uint32_t frameID) const { return (frameID & ~mask) | (translatedID & mask); }
+};
+
+// Forwards frames from one bus to another, as the gateway ECU between the CAN buses of a vehicle.
+// It joins both buses as a process with its own ID, the source bus sends it only the frames of its routes
+// through acceptance filters, and it sends them on the target bus as their transmitter.
+// Either bus may be served by another process, they are known only by their ports.
+// Forwarding in both directions takes two gateways, the routes must not send a frame back where it came from
+class BusGateway
+{
+private:
+    uint32_t id;
+    ClientConnection source;
+    ClientConnection target;
+    std::vector<GatewayRoute> routes; // Fixed once the gateway starts
+    std::atomic<bool> started;
+
+    Counter framesForwarded;
+    Counter framesDropped; // Could not be sent on the target bus
+
+    // Translates a frame of the source bus and sends it on the target bus
+    void forward(Packet &packet);
+
+public:
+    // Constructor - the gateway joins both buses under the ID
+    BusGateway(uint32_t id, int sourcePort, int targetPort);
+
+    // Adds a route, must be called before start
+    void addRoute(const GatewayRoute &route);
+
+    // Joins the target bus and then the source bus, after which frames are forwarded
+    ErrorCode start();
+
+    // Leaves both buses
+    void stop();
+
+    // Frames sent on the target bus
+    uint64_t getForwarded();
+
+    // Frames that matched a route but could not be sent on the target bus
+    uint64_t getDropped();
+
+    // Destructor
+    ~BusGateway();
+};
@@ -2,12 +2,60 @@
 #include <mutex>
 #include <utility>
 #include "server_connection.h"
+#include "client_connection.h"
+#include "can_arbiter.h"
+#include "latency_tracer.h"
+#include "metrics.h"
+#include "bus_capture.h"
 #include <iostream>
 
+// Number of epoll event loops serving the connected processes
+#define BUS_EVENT_LOOPS 4
+
+// A process that does not read its packets loses them, the rest of the bus is not slowed down
+#define BUS_SLOW_CONSUMER_POLICY SlowConsumerPolicy::DROP
+
+// Simulated bus speed in bits per second, 0 forwards packets as fast as they arrive.
+// The arbitration is opt-in, through setBitrate, the bitrate option of a topology or BUS_BITRATE_ENV
+#define BUS_BITRATE 0
+
+// Environment variable setting the simulated bus speed of main_bus, CAN_DEFAULT_BITRATE is a typical CAN bus
+#define BUS_BITRATE_ENV "VCS_BUS_BITRATE"
+
+// Stamps every packet with the times it was read and routed, so receivers can split their latency per hop
+#define BUS_TRACE_PACKETS false
+
+// File the bus metrics are written to in the Prometheus text format while the bus runs, empty to disable
+#define BUS_METRICS_FILE "bus_metrics.prom"
+
+// Environment variable naming the file main_bus records the routed packets to, see startCapture
+#define BUS_CAPTURE_ENV "VCS_BUS_CAPTURE"
+
+// The port of the bus the processes join unless they are told otherwise
+#define BUS_DEFAULT_PORT PORT
+
 class BusManager
 {
 private:
     ServerConnection server;
+    CanArbiter arbiter;
+    std::atomic<bool> tracing;
+    std::string metricsFile;
+
+    // The capture of the routed packets, written by whichever thread routes them
+    std::unique_ptr<CaptureWriter> capture;
+    std::atomic<bool> capturing;
+    std::mutex captureMutex;
+    Counter packetsCaptured;
+
+    Counter packetsRouted;
+    Counter bytesRouted;
+    LabeledCounter packetsByID;
+    LabeledCounter routeErrors;
+    LatencyHistogram routingLatency;
+
+    // Declared after the metrics it reads, so its export stops first
+    MetricsRegistry metrics;
 
     // Singleton instance
     static BusManager* instance;
@@ -17,12 +65,19 @@ private:
     // Sending according to broadcast variable
     ErrorCode sendToClients(const Packet &packet);
 
-    // Private constructor
-    BusManager(std::vector<uint32_t> idShouldConnect, uint32_t limit);
+    // Adds the metrics of the bus and of its server to the registry
+    void registerMetrics();
+
+    // Adds a routed packet to the capture
+    void capturePacket(int64_t time, const Packet &packet);
 
 public:
+    // Constructor - a bus of its own on the port, for processes that run several buses.
+    // Only the processes in idShouldConnect may join it, any process if it is empty, and at most limit at once, 0 for no limit
+    BusManager(std::vector<uint32_t> idShouldConnect, uint32_t limit, int port = BUS_DEFAULT_PORT);
+
     //Static function to return a singleton instance
-    static BusManager* getInstance(std::vector<uint32_t> idShouldConnect, uint32_t limit);
+    static BusManager* getInstance(std::vector<uint32_t> idShouldConnect, uint32_t limit, int port = BUS_DEFAULT_PORT);
 
     // Sends to the server to listen for requests
     ErrorCode startConnection();
@@ -36,8 +91,30 @@ public:
     // Implement a priority check according to the CAN bus
     Packet packetPriority(Packet &a, Packet &b);
 
-    // Static method to handle SIGINT signal
-    static void signalHandler(int signum);
+    // Sets the simulated bus speed in bits per second, 0 disables the arbitration
+    void setBitrate(uint32_t bitrate);
+
+    // Per message ID latency since the start
+    std::unordered_map<uint32_t, CanIdStatistics> getStatistics();
+
+    // Fraction of the time the simulated bus was busy
+    double getBusLoad();
+
+    // Turns the per hop timestamps of the packets on or off
+    void setTracing(bool enabled);
+
+    // Sets the file the metrics are exported to once the bus starts, empty to disable
+    void setMetricsFile(const std::string &fileName);
+
+    // The metrics of the bus in the Prometheus text format
+    std::string getMetrics();
+
+    // Records every packet routed from now on to the file with the time it was routed, replacing a running capture.
+    // Returns false if the file cannot be created
+    bool startCapture(const std::string &fileName);
+
+    // Ends the capture and writes what is left, returns false if any packet could not be written
+    bool stopCapture();
 
     ~BusManager();
 };
\ No newline at end of file
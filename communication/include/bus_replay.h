@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include "bus_capture.h"
+#include "client_connection.h"
+#include "metrics.h"
+
+// Replay speed that sends every packet as soon as the bus takes it
+#define REPLAY_AS_FAST_AS_POSSIBLE 0.0
+
+// Feeds a capture back into a bus, so that a run of the simulation can be repeated while debugging.
+// The replayer joins the bus as every source of the capture, so the packets keep their transmitters,
+// their credits and their reassembly, and it sends them in the order of the capture from a single thread.
+// The packets of a source therefore arrive in the recorded order, packets of different sources sent at once
+// may still be arbitrated differently, as on the real bus. A source that is running live must be skipped,
+// the bus accepts every ID once
+class BusReplayer
+{
+private:
+    std::string fileName;
+    int port;
+    double speed;
+    std::set<uint32_t> skippedSources;
+    std::map<uint32_t, std::unique_ptr<ClientConnection>> sources;
+    std::mutex replayMutex;
+    std::condition_variable stopRequested;
+    bool stopping;
+
+    Counter packetsReplayed;
+    Counter packetsFailed; // Could not be sent to the bus
+
+    // Joins the bus as every source of the capture that is not skipped
+    ErrorCode joinSources();
+
+    // Sleeps until the time, returns false if the replay was stopped meanwhile
+    bool waitUntil(std::chrono::steady_clock::time_point time);
+
+    // Leaves the bus as every source
+    void leaveSources();
+
+public:
+    // Constructor - replays the capture into the bus on the port.
+    // Throws std::invalid_argument for an invalid port and std::runtime_error if the file is not a capture
+    BusReplayer(const std::string &fileName, int port = PORT);
+
+    // Sets the pace: 1 replays at the recorded pace, N at N times that, REPLAY_AS_FAST_AS_POSSIBLE without waiting.
+    // Throws if the speed is negative or the replay is running
+    void setSpeed(double speed);
+
+    // Leaves out the packets of a source, for a process that runs live next to the replay
+    void skipSource(uint32_t id);
+
+    // Replays the capture and leaves the bus, blocks until the end of the capture or stop.
+    // Returns INVALID_DATA if the capture ends in a damaged record, whatever preceded it is replayed
+    ErrorCode run();
+
+    // Ends the replay, may be called from any thread. A stopped replayer does not run again
+    void stop();
+
+    // Packets sent to the bus
+    uint64_t getReplayed();
+
+    // Packets that could not be sent to the bus
+    uint64_t getFailed();
+
+    // Destructor
+    ~BusReplayer();
+};
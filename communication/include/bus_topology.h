@@ -0,0 +1,70 @@
+#pragma once
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "bus_manager.h"
+#include "bus_gateway.h"
+
+// A bus served by this process
+struct BusConfig
+{
+    std::string name;
+    int port;
+    uint32_t bitrate;
+    std::vector<uint32_t> ids; // The processes that may join, empty for any process
+    uint32_t limit;            // Processes connected at once, 0 for no limit
+    std::string capture;       // File the routed packets are recorded to, empty for none
+};
+
+// A gateway run by this process, its buses are given by their ports
+struct GatewayConfig
+{
+    uint32_t id;
+    int sourcePort;
+    int targetPort;
+    std::vector<GatewayRoute> routes;
+};
+
+// The buses and gateways of a process, such as the powertrain, body and ADAS buses of a vehicle.
+// Every bus has its own port, and so its own shared memory segments, event loops and arbiter,
+// so the load is partitioned the way a real vehicle partitions it. Read from a text file, one entry per line:
+//
+//   # bus <name> <port> [bitrate=<bits per second>] [ids=<id>,<id>,...] [limit=<processes>] [capture=<file>]
+//   bus powertrain 8080 bitrate=500000 capture=powertrain.vcscap
+//   bus body 8081 ids=3,4,5
+//   # gateway <id> <source bus> <target bus>, a bus of another process is given by its port
+//   gateway 90 powertrain body
+//   # route <id> <mask> <translated id>, belongs to the gateway above it
+//   route 0x100 0x7F0 0x300
+class BusTopology
+{
+private:
+    std::vector<BusConfig> buses;
+    std::vector<GatewayConfig> gateways;
+    std::vector<std::unique_ptr<BusManager>> managers;
+    std::vector<std::unique_ptr<BusGateway>> links; // Declared after the buses, so the gateways are destroyed first
+
+    // The port of a bus named in this topology, or the number itself for a bus of another process
+    int resolvePort(const std::string &bus) const;
+
+public:
+    // Reads a topology, throws std::invalid_argument naming the line of an invalid entry
+    static BusTopology parse(std::istream &input);
+
+    // Reads a topology from a file, throws std::invalid_argument if it cannot be read or is invalid
+    static BusTopology load(const std::string &fileName);
+
+    // Starts the buses and then the gateways between them, stops whatever started if one fails
+    ErrorCode start();
+
+    // Stops the gateways and then the buses
+    void stop();
+
+    const std::vector<BusConfig> &getBuses() const;
+
+    const std::vector<GatewayConfig> &getGateways() const;
+
+    // The running bus with the name, or null
+    BusManager *getBus(const std::string &name);
+};
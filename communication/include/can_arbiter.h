@@ -0,0 +1,103 @@
+#pragma once
+#include <queue>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <unordered_map>
+#include "packet.h"
+
+// Bitrate of a classic high-speed CAN bus
+#define CAN_DEFAULT_BITRATE 500000
+
+// Bits of a standard data frame without payload, including the interframe space
+#define CAN_FRAME_OVERHEAD_BITS 47
+
+// Latency and volume observed for one message ID
+struct CanIdStatistics
+{
+    uint64_t frames = 0;
+    std::chrono::nanoseconds totalLatency{0}; // From submission until the end of the frame on the bus
+    std::chrono::nanoseconds maxLatency{0};
+};
+
+// Simulated CAN bus arbitration.
+// Frames that are pending when the bus becomes idle compete in the same slot, the lowest ID wins
+// as the dominant bits do on a real bus, and the winner holds the bus for the duration of its bits.
+// A bitrate of 0 disables the simulation and forwards every frame at once.
+class CanArbiter
+{
+private:
+    // A frame waiting for the bus
+    struct PendingFrame
+    {
+        Packet packet;
+        uint64_t sequence;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    // Orders the queue so that its top is the winner of the next arbitration
+    struct LosesArbitration
+    {
+        bool operator()(const PendingFrame &a, const PendingFrame &b) const;
+    };
+
+    std::function<void(const Packet &)> dispatch;
+    std::atomic<uint32_t> bitrate;
+    std::priority_queue<PendingFrame, std::vector<PendingFrame>, LosesArbitration> pending;
+    uint64_t nextSequence;
+    std::mutex pendingMutex;
+    std::condition_variable frameSubmitted;
+    std::atomic<bool> running;
+    std::thread busThread;
+
+    std::unordered_map<uint32_t, CanIdStatistics> statistics;
+    std::chrono::nanoseconds busyTime;
+    std::chrono::steady_clock::time_point startTime;
+    std::mutex statisticsMutex;
+
+    // Arbitrates and transmits frames until the arbiter is stopped
+    void run();
+
+    // Records the delivery of a frame
+    void record(const PendingFrame &frame, std::chrono::nanoseconds duration);
+
+public:
+    // Constructor
+    CanArbiter(std::function<void(const Packet &)> dispatch, uint32_t bitrate = CAN_DEFAULT_BITRATE);
+
+    // Starts the bus thread
+    void start();
+
+    // Stops the bus thread, frames still pending are discarded
+    void stop();
+
+    // Queues a frame for the next arbitration, or forwards it at once if the simulation is disabled
+    void submit(const Packet &packet);
+
+    // Sets the bitrate in bits per second, 0 disables the simulation
+    void setBitrate(uint32_t bitrate);
+
+    uint32_t getBitrate();
+
+    // True if a wins the arbitration against b
+    static bool hasPriority(const Packet &a, const Packet &b);
+
+    // Time the frame holds the bus, with worst-case bit stuffing
+    static std::chrono::nanoseconds frameDuration(const Packet &packet, uint32_t bitrate);
+
+    // Number of frames waiting for the bus
+    size_t pendingFrames();
+
+    // Per message ID statistics since the start
+    std::unordered_map<uint32_t, CanIdStatistics> getStatistics();
+
+    // Fraction of the time since the start during which the bus was busy
+    double getBusLoad();
+
+    // Destructor
+    ~CanArbiter();
+};
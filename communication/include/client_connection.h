@@ -1,44 +1,123 @@
 #pragma once
 #include <thread>
+#include <chrono>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <functional>
 #include <iostream>
 #include "message.h"
+#include "wire_format.h"
+#include "receive_buffer.h"
 #include "../sockets/Isocket.h"
 #include "../sockets/real_socket.h"
+#include "../sockets/socket_factory.h"
 #include <string>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 #include "error_code.h"
+#include "filter_table.h"
 
 #define PORT 8080
 #define IP "127.0.0.1"
 
+// Environment variable selecting the port of the bus a process joins, PORT when unset
+#define BUS_PORT_ENV "VCS_BUS_PORT"
+
+// An idle process sends a heartbeat this often, the bus echoes it
+#define HEARTBEAT_INTERVAL_MS 1000
+
+// A connection on which nothing arrived for this long is considered dead
+#define HEARTBEAT_TIMEOUT_MS (3 * HEARTBEAT_INTERVAL_MS)
+
+// A lost connection is retried after a delay that doubles up to the maximum, with random jitter
+// so that the processes of a restarted bus do not reconnect all at once
+#define RECONNECT_INITIAL_DELAY_MS 100
+#define RECONNECT_MAX_DELAY_MS 5000
+
 class ClientConnection
 {
 private:
     int clientSocket;
+    int epollFd;
+    int wakeFd; // Wakes the receive thread when the connection is closed
+    int clientID;
+    int port; // The bus to join, each bus listens on its own port
     sockaddr_in servAddress;
     std::atomic<bool> connected;
+    std::atomic<bool> stopping;
+    std::atomic<bool> supervising;
     std::function<void(Packet &)> passPacketCom;
     ISocket* socketInterface;
     std::thread receiveThread;
+    ReceiveBuffer receiveBuffer;
+    std::vector<uint8_t> sendBuffer;
+    std::mutex sendMutex;
+    // Held across the credit batches of one send, the packets of a message do not interleave with another's
+    std::mutex messageMutex;
+    std::atomic<uint64_t> reconnects;
+    // Used by the receive thread only
+    bool heardFromBus; // Something arrived on the current connection
+    std::chrono::steady_clock::time_point lastReceived;
+
+    // Packets the bus lets the connection send, nothing goes out before its first grant
+    std::mutex stateMutex;
+    std::condition_variable stateChanged;
+    int64_t credits;
+    std::vector<AcceptanceFilter> filters; // Sent again on every new connection
+
+    // Opens the socket and registers the ID at the bus
+    ErrorCode openConnection();
+
+    // Closes a lost connection, the supervisor opens a new one
+    void dropConnection();
+
+    // Keeps the connection alive until closeConnection, reconnecting with backoff when it is lost
+    void superviseConnection();
+
+    // Waits for the backoff delay, returns false if the connection was closed meanwhile
+    bool waitBeforeReconnect(int delayMs);
+
+    // Reads everything the socket has, returns false if the connection is lost
+    bool readAvailable();
+
+    // Handles a frame of the connection itself
+    void handleControl(const Packet &packet);
+
+    // Tells the bus that the idle connection is alive, skipped if the socket is busy anyway
+    ErrorCode sendHeartbeat();
+
+    // Waits until the bus lets the connection send, returns the number of packets that may go now or 0 if it was lost
+    size_t acquireCredits(size_t wanted);
+
+    // Sends the packets in as many writes as the credits allow
+    ErrorCode sendFrames(const Packet *packets, size_t count);
+
+    // Sends a frame of the connection itself, must be called with sendMutex held
+    ErrorCode sendControl(const Packet &packet);
+
+    // Writes the whole buffer, continuing after partial writes, must be called with sendMutex held
+    ErrorCode writeAll(const uint8_t *buffer, size_t length);
 
 public:
     // Constructor
-    ClientConnection(std::function<void(Packet &)> callback, ISocket* socketInterface = new RealSocket());
+    ClientConnection(std::function<void(Packet &)> callback, ISocket* socketInterface = createSocketInterface());
 
-    // Requesting a connection to the server
+    // Requesting a connection to the server, a connection lost afterwards is restored in the background
     ErrorCode connectToServer(int id);
 
     // Sends the packet to the manager-sync
     ErrorCode sendPacket(Packet &packet);
 
-    // Waits for a message and forwards it to Communication
+    // Sends all the packets of a message with a single write, or several when the bus limits the packets in flight
+    ErrorCode sendPackets(std::vector<Packet> &packets);
+
+    // Waits for messages and forwards them to Communication, returns when the connection is lost
     void receivePacket();
 
-    // Closes the connection
+    // Closes the connection and stops reconnecting
     ErrorCode closeConnection();
 
     // Setter for passPacketCom
@@ -47,6 +126,21 @@ public:
     // Setter for socketInterface
     void setSocketInterface(ISocket* socketInterface);
 
+    // Selects the bus to join by its port, throws if the port is invalid or the connection is open
+    void setPort(int port);
+
+    // The port of the bus to join, PORT unless BUS_PORT_ENV names another
+    static int portFromEnvironment();
+
+    // Number of times a lost connection was restored
+    uint64_t getReconnects();
+
+    // Asks the bus to send only the broadcast frames one of the filters accepts, kept across reconnects
+    ErrorCode addFilter(const AcceptanceFilter &filter);
+
+    // Removes the filters, the bus sends every broadcast frame again
+    ErrorCode clearFilters();
+
     // For testing
     int getClientSocket();
     
@@ -57,4 +151,3 @@ public:
     //Destructor
     ~ClientConnection();
 };
-
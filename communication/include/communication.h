@@ -2,20 +2,35 @@
 #include <unordered_map>
 #include <csignal>
 #include "client_connection.h"
+#include "reassembler.h"
+#include "async_sender.h"
+#include "latency_tracer.h"
 #include "../sockets/Isocket.h"
 #include "error_code.h"
+
+// A received message as a read-only view of the reassembly buffer it was rebuilt in.
+// The bytes are valid only until the receive callback returns, a receiver that keeps them makes its own copy.
+struct MessageView
+{
+    uint32_t srcID;
+    const uint8_t *data;
+    size_t size;
+};
+
+// Receives the complete messages, any callable object fits
+typedef std::function<void(const MessageView &)> ReceiveCallback;
+
 class Communication
 {
 private:
     ClientConnection client;
-    std::unordered_map<std::string, Message> receivedMessages;
-    void (*passData)(uint32_t, void *); 
+    Reassembler reassembler;
+    AsyncSender sender;
+    LatencyTracer tracer;
+    ReceiveCallback passData;
     uint32_t id;
     //SyncCommunication syncCommunication;
 
-    // A static variable that holds an instance of the class
-    static Communication* instance;
-
     // Accepts the packet from the client and checks..
     void receivePacket(Packet &p);
     
@@ -29,7 +44,7 @@ private:
     void handlePacket(Packet &p);
     
     // Implement error handling according to CAN bus
-    void handleError();
+    void handleError(Packet &p);
     
     // Implement arrival confirmation according to the CAN bus
     Packet hadArrived();
@@ -37,26 +52,49 @@ private:
     // Adding the packet to the complete message
     void addPacketToMessage(Packet &p);
 
-    // Static method to handle SIGINT signal
-    static void signalHandler(int signum);
+    // Checks the arguments of a message to send
+    ErrorCode validateMessage(void *data, size_t dataSize);
+
+    // Passes a complete message to the process
+    void deliverMessage(uint32_t srcID, const uint8_t *data, size_t size);
 
     void setId(uint32_t newId);
 
-    void setPassDataCallback(void (*callback)(uint32_t, void *));
+    void setPassDataCallback(ReceiveCallback callback);
+
+    // Adapts a callback that owns and frees its data, it gets a malloced copy of every message
+    static ReceiveCallback copyingCallback(void (*passDataCallback)(uint32_t, void *));
 
 public:
-    // Constructor
+    // Constructor - the callback gets a view of every message without a copy
+    Communication(uint32_t id, ReceiveCallback receiveCallback);
+
+    // Constructor - the callback gets a malloced copy of every message and frees it
     Communication(uint32_t id, void (*passDataCallback)(uint32_t, void *));
     
+    // Selects the bus to join by its port, must be called before startConnection
+    void setPort(int port);
+
     // Sends the client to connect to server
     ErrorCode startConnection();
     
     // Sends a message to manager
     ErrorCode sendMessage(void *data, size_t dataSize, uint32_t destID, uint32_t srcID, bool isBroadcast);
     
-    // Sends a message to manager - Async
+    // Sends a message to manager - Async, returns at once and calls passSend from the sending thread when done.
+    // The data is copied before returning, passSend may be null
     void sendMessageAsync(void *data, size_t dataSize, uint32_t destID, uint32_t srcID, std::function<void(ErrorCode)> passSend, bool isBroadcast);
 
+    // Per hop latency of the packets received so far
+    LatencyTracer &getLatencyTracer();
+
+    // Registers an acceptance filter at the bus, as on a CAN controller: a broadcast is delivered only if
+    // its message ID matches the ID in every bit the mask selects. Without filters every broadcast is delivered
+    ErrorCode addAcceptanceFilter(uint32_t id, uint32_t mask);
+
+    // Removes the acceptance filters, every broadcast is delivered again
+    ErrorCode clearAcceptanceFilters();
+
     //Destructor
     ~Communication();
 };
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// CRC-15/CAN generator polynomial x^15 + x^14 + x^10 + x^8 + x^7 + x^4 + x^3 + 1
+#define CRC15_CAN_POLYNOMIAL 0x4599
+
+// CRC-32C (Castagnoli) polynomial in reflected form
+#define CRC32C_POLYNOMIAL 0x82F63B78
+
+// CRC-15 of a CAN frame, table driven one byte at a time
+uint16_t crc15Can(const void *data, size_t length);
+
+// CRC-32C for whole messages, uses the SSE4.2 crc32 instruction when the CPU has it.
+// Pass the previous result as crc to continue a checksum over several buffers
+uint32_t crc32c(const void *data, size_t length, uint32_t crc = 0);
+
+// CRC-32C with slice-by-8 tables, the fallback of crc32c
+uint32_t crc32cSoftware(const void *data, size_t length, uint32_t crc = 0);
+
+// True if crc32c runs on the SSE4.2 instruction
+bool crc32cHardwareAvailable();
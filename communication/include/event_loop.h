@@ -0,0 +1,51 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <sys/epoll.h>
+#include "../sockets/Isocket.h"
+#include "error_code.h"
+
+#define EPOLL_MAX_EVENTS 64
+
+// A single epoll reactor thread that multiplexes many client sockets.
+// Every socket is owned by exactly one loop, so its events are handled in order.
+class EventLoop
+{
+private:
+    ISocket* socketInterface;
+    int epollFd;
+    int wakeFd;
+    std::atomic<bool> running;
+    std::thread loopThread;
+    std::function<bool(int)> readHandler;
+    std::function<void(int)> closeHandler;
+    std::function<bool(int)> writeHandler;
+
+    // Waits for events and dispatches them until the loop is stopped
+    void run();
+
+public:
+    // Constructor - readHandler and writeHandler return false when the socket should be dropped
+    EventLoop(ISocket* socketInterface, std::function<bool(int)> readHandler, std::function<void(int)> closeHandler, std::function<bool(int)> writeHandler = nullptr);
+
+    // Creates the epoll instance and starts the loop thread
+    ErrorCode start();
+
+    // Registers a socket for read events
+    ErrorCode addSocket(int fd);
+
+    // Unregisters a socket, the caller is responsible for closing it
+    void removeSocket(int fd);
+
+    // Enables or disables writable events of a registered socket, may be called from any thread
+    ErrorCode setWriteInterest(int fd, bool enabled);
+
+    // Wakes the loop thread and joins it
+    void stop();
+
+    bool isRunning();
+
+    // Destructor
+    ~EventLoop();
+};
@@ -0,0 +1,76 @@
+#pragma once
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "packet.h"
+
+// IDs whose acceptance is precomputed into a bitset, the 11-bit standard CAN IDs
+#define FILTER_BITSET_IDS 2048
+
+// Acceptance filter of a CAN controller: a frame passes if its ID matches in every bit the mask selects
+struct AcceptanceFilter
+{
+    uint32_t id;
+    uint32_t mask;
+
+    // Checks if the filter lets the ID pass
+    bool accepts(uint32_t frameID) const { return ((frameID ^ id) & mask) == 0; }
+};
+
+// Acceptance filters of the processes, evaluated by the bus before it sends a broadcast frame.
+// A process without filters accepts everything, as it did before filters existed.
+// Like the routing table, readers work on an immutable snapshot and never wait for writers.
+class FilterTable
+{
+public:
+    // The filters of one process and their result for the standard IDs
+    struct Acceptance
+    {
+        std::vector<AcceptanceFilter> filters;
+        std::bitset<FILTER_BITSET_IDS> standardIDs;
+    };
+
+    // One published version of the table, by socket
+    typedef std::unordered_map<int, std::shared_ptr<const Acceptance>> Snapshot;
+
+private:
+    std::shared_ptr<const Snapshot> current;
+    std::mutex writeMutex;
+
+    // Publishes a new version, must be called under writeMutex
+    void publish(std::shared_ptr<const Snapshot> snapshot);
+
+public:
+    // Constructor
+    FilterTable();
+
+    // Adds a filter of the socket, the socket then accepts only what one of its filters lets pass
+    void add(int socket, const AcceptanceFilter &filter);
+
+    // Removes the filters of the socket, it accepts everything again
+    void remove(int socket);
+
+    // Removes all filters
+    void clear();
+
+    // Checks if the socket accepts the ID
+    bool accepts(int socket, uint32_t id) const;
+
+    // Checks if the socket accepts the ID in a snapshot
+    static bool accepts(const Snapshot &table, int socket, uint32_t id);
+
+    // Number of sockets with filters
+    size_t size() const;
+
+    // The current version, stays valid and unchanged while held
+    std::shared_ptr<const Snapshot> snapshot() const;
+
+    // Control frame that registers the filter at the bus, the mask travels in the payload
+    static Packet encodeFilter(uint32_t srcID, const AcceptanceFilter &filter);
+
+    // Reads the filter of a FILTER control frame
+    static AcceptanceFilter decodeFilter(const Packet &packet);
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "packet.h"
+
+// Every power of two is split into this many sub-buckets, so a recorded value is kept with an error below 1/64
+#define LATENCY_SUB_BUCKET_BITS 7
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BUCKET_BITS + 1) * (LATENCY_SUB_BUCKETS / 2))
+
+// Nanoseconds of the monotonic clock, comparable between processes on the same host
+inline int64_t monotonicNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Log-linear histogram of nanosecond latencies in the style of HdrHistogram.
+// Recording is a few relaxed atomic increments, so any thread can record without a lock.
+class LatencyHistogram
+{
+private:
+    std::atomic<uint64_t> counts[LATENCY_BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<int64_t> sum;
+    std::atomic<int64_t> minimum;
+    std::atomic<int64_t> maximum;
+
+public:
+    // Constructor
+    LatencyHistogram();
+
+    // Adds one sample, negative samples count as 0
+    void record(int64_t nanoseconds);
+
+    // Number of samples
+    uint64_t count() const;
+
+    // Smallest sample, 0 if there are none
+    int64_t min() const;
+
+    // Largest sample
+    int64_t max() const;
+
+    // Average of the samples
+    double mean() const;
+
+    // Value that percent of the samples do not exceed, rounded up to the end of its bucket
+    int64_t percentile(double percent) const;
+
+    // Removes all samples
+    void reset();
+
+    // Writes the percentile distribution in the text format of HdrHistogram, values in microseconds
+    void exportPercentiles(std::ostream &out) const;
+
+    // Bucket that holds the value
+    static size_t bucketIndex(int64_t value);
+
+    // Largest value that falls in the bucket
+    static int64_t bucketUpperBound(size_t index);
+};
+
+// Stages a packet passes from the sending process to the receiving one
+enum class LatencyHop
+{
+    SEND_TO_BUS,     // From the creation of the packet until the bus read it
+    BUS_ARBITRATION, // From the bus reading the packet until it was routed
+    BUS_TO_RECEIVER, // From the routing until the receiver got it
+    END_TO_END,      // From the creation of the packet until the receiver got it
+    COUNT
+};
+
+// Per hop latency of the packets a process receives
+class LatencyTracer
+{
+private:
+    LatencyHistogram histograms[(int)LatencyHop::COUNT];
+
+public:
+    // Records the hops of a packet delivered at deliverTime, hops the bus did not stamp are skipped
+    void recordDelivery(const Packet &packet, int64_t deliverTime);
+
+    // Histogram of one hop
+    LatencyHistogram &getHistogram(LatencyHop hop);
+
+    // Removes all samples
+    void reset();
+
+    // One line per hop with the count and the percentiles in microseconds
+    std::string report() const;
+
+    // Name of the hop in reports
+    static const char *hopName(LatencyHop hop);
+};
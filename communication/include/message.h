@@ -7,6 +7,11 @@
 #include <unordered_map>
 #include <iostream>
 #include "packet.h"
+#include "crc.h"
+
+// A message of more than one packet ends in the little-endian CRC-32C of its data. The CRC-15 of every packet
+// covers only that packet, the CRC-32C also catches a packet of another message that completed this one
+#define MESSAGE_CRC_SIZE 4
 
 class Message
 {
@@ -35,4 +40,7 @@ public:
 
     // Get the packets of the message
     std::vector<Packet> &getPackets();
+
+    // Checks the CRC-32C at the end of the reassembled data of a message of several packets
+    static bool validMessageCRC(const uint8_t *data, size_t length);
 };
\ No newline at end of file
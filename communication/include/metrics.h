@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "latency_tracer.h"
+
+// Distinct label values a labeled counter keeps apart, further values are counted together
+#define METRICS_LABEL_SLOTS 1024
+
+// How often the file export rewrites the file
+#define METRICS_EXPORT_INTERVAL_MS 1000
+
+// Monotonic counter, an increment is a single relaxed atomic add
+class Counter
+{
+private:
+    std::atomic<uint64_t> count;
+
+public:
+    // Constructor
+    Counter();
+
+    // Adds to the counter
+    void add(uint64_t amount = 1);
+
+    // Current value
+    uint64_t value() const;
+};
+
+// Counters told apart by a numeric label such as the message ID.
+// The labels live in a lock-free open addressing table, so the first packet of an ID does not take a lock either.
+class LabeledCounter
+{
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> key; // The label plus one, 0 marks a free slot
+        std::atomic<uint64_t> count;
+    };
+
+    Slot slots[METRICS_LABEL_SLOTS];
+    std::atomic<uint64_t> overflow;
+
+public:
+    // Constructor
+    LabeledCounter();
+
+    // Adds to the counter of the label
+    void add(uint32_t label, uint64_t amount = 1);
+
+    // Current value of the label
+    uint64_t value(uint32_t label) const;
+
+    // Every label seen so far with its value
+    std::vector<std::pair<uint32_t, uint64_t>> values() const;
+
+    // Sum of the labels that did not find a free slot
+    uint64_t overflowValue() const;
+};
+
+// Named metrics of a process, rendered in the Prometheus text format.
+// The components that update the metrics own them, the registry only reads them,
+// so they must outlive the registry or at least its file export.
+class MetricsRegistry
+{
+public:
+    // Label set and value of every sample of a gauge, the label set is empty or like client="3"
+    typedef std::vector<std::pair<std::string, double>> Samples;
+
+private:
+    struct Entry
+    {
+        std::string name;
+        std::string help;
+        std::string type;
+        std::function<void(std::string &)> write;
+    };
+
+    std::vector<Entry> entries;
+    std::mutex entriesMutex;
+    std::thread exportThread;
+    std::atomic<bool> exporting;
+    std::mutex exportMutex;
+    std::condition_variable exportWake;
+
+    // Adds a metric whose samples are appended by write
+    void add(const std::string &name, const std::string &help, const std::string &type,
+             std::function<void(std::string &)> write);
+
+    // Appends one sample line
+    static void writeSample(std::string &out, const std::string &name, const std::string &labels, double value);
+
+public:
+    // Constructor
+    MetricsRegistry();
+
+    // Registers a counter
+    void addCounter(const std::string &name, const std::string &help, const Counter &counter);
+
+    // Registers a labeled counter, labelValue formats a label and defaults to its decimal value
+    void addCounter(const std::string &name, const std::string &help, const LabeledCounter &counter,
+                    const std::string &labelName, std::function<std::string(uint32_t)> labelValue = nullptr);
+
+    // Registers a gauge sampled at every export
+    void addGauge(const std::string &name, const std::string &help, std::function<Samples()> sample);
+
+    // Registers a latency histogram, exported as a summary in seconds
+    void addSummary(const std::string &name, const std::string &help, const LatencyHistogram &histogram);
+
+    // The current value of every metric
+    std::string exportText();
+
+    // Rewrites the file with the metrics every interval. The text goes to a temporary file that is renamed over
+    // the previous one, so a reader never sees a partial file.
+    void startFileExport(const std::string &fileName, int intervalMs = METRICS_EXPORT_INTERVAL_MS);
+
+    // Stops the file export, the file keeps the last values
+    void stopFileExport();
+
+    // Destructor
+    ~MetricsRegistry();
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include "../sockets/Isocket.h"
+#include "event_loop.h"
+#include "wire_format.h"
+#include "error_code.h"
+
+// Default capacity of a connection's queue in bytes, must be a power of two
+#define OUTBOUND_QUEUE_SIZE 262144
+
+// The last 1/OUTBOUND_CONTROL_SHARE of a queue is kept for the frames of the connection itself,
+// so a credit or a heartbeat echo is neither dropped nor waited for when the data filled the rest
+#define OUTBOUND_CONTROL_SHARE 8
+
+// What the bus does with a frame for a process whose queue is full
+enum class SlowConsumerPolicy {
+    DROP,      // The frame is lost for this process only
+    BLOCK,     // The sender waits until the process takes the queued bytes
+    DISCONNECT // The process is dropped from the bus
+};
+
+// Bounded queue of encoded frames waiting to be written to one connection.
+// A frame is written directly when nothing is queued before it, the rest waits
+// for the connection's event loop to report the socket writable.
+class OutboundQueue
+{
+private:
+    ISocket* socketInterface;
+    EventLoop* loop;
+    int socket;
+    std::vector<uint8_t> buffer;
+    size_t mask;
+    size_t dataCapacity; // Bytes the data frames may fill, the rest is kept for the control frames
+    size_t readIndex;
+    size_t writeIndex;
+    bool writeInterest;
+    bool closed;
+    bool disconnectRequested;
+    size_t droppedFrames;
+    std::mutex queueMutex;
+
+    // Writes queued bytes without blocking, returns false on a connection error
+    bool writeQueued(int flags);
+
+    // Queues a whole frame within the capacity or applies the policy when it does not fit
+    ErrorCode enqueue(const uint8_t *frame, size_t length, SlowConsumerPolicy policy, size_t capacity);
+
+    // Copies the unsent tail of a frame into the queue
+    void append(const uint8_t *data, size_t length);
+
+    // Asks the event loop for writable events while bytes are queued, must be called under queueMutex
+    void updateWriteInterest();
+
+public:
+    // Constructor - throws if the capacity is not a power of two or its control space does not hold a whole frame
+    OutboundQueue(ISocket* socketInterface, EventLoop* loop, int socket, size_t capacity = OUTBOUND_QUEUE_SIZE);
+
+    // True if a queue of the capacity can be constructed
+    static bool validCapacity(size_t capacity);
+
+    // Queues a whole frame or applies the policy when it does not fit
+    ErrorCode push(const uint8_t *frame, size_t length, SlowConsumerPolicy policy);
+
+    // Queues a frame of the connection itself, which may use the space kept for them and never waits.
+    // A process that left even that space full is disconnected, a lost credit would stall it for good
+    ErrorCode pushControl(const uint8_t *frame, size_t length);
+
+    // Called by the event loop when the socket is writable, returns false if the connection should be closed
+    bool flush();
+
+    // Rejects further frames, called before the socket is closed
+    void close();
+
+    // Number of bytes waiting to be written
+    size_t size();
+
+    // Number of frames lost under the DROP policy
+    size_t getDroppedFrames();
+};
@@ -11,23 +11,37 @@
 #include <iomanip>
 #include <sstream>
 #define SIZE_PACKET 8
+
+// Frames that keep a connection to the bus alive and paced, they never reach the processes
+enum class ControlType : uint8_t {
+    NONE,         // A packet of a message
+    HELLO,        // Registers a process that takes part in heartbeats and flow control
+    HEARTBEAT,    // Sent by an idle process, the bus echoes it
+    CREDIT,       // The bus lets the process send ID more packets
+    FILTER,       // Adds an acceptance filter of the process, ID with the mask in the payload
+    FILTER_RESET  // Removes the acceptance filters, the process gets every broadcast again
+};
+
 class Packet
 {
 public:
     // Packet header containing various metadata fields
     struct Header
     {
-        uint32_t ID;      // Message ID
+        uint32_t ID;      // Message ID, the value of a control frame
         uint32_t PSN;     // Packet Sequence Number
         uint32_t TPS;     // Total Packet Sum
         uint32_t SrcID;   // Source ID
         uint32_t DestID;  // Destination ID
         uint8_t DLC;          // Data Length Code (0-8 bits)
         uint16_t CRC;     // Cyclic Redundancy Check for error detection
-        int timestamp;    // Timestamp field
+        int64_t timestamp;   // Monotonic nanoseconds when the sender created the packet
+        int64_t enqueueTime; // Monotonic nanoseconds when the bus read the packet, 0 if not traced
+        int64_t routeTime;   // Monotonic nanoseconds when the bus routed the packet, 0 if not traced
         bool isBroadcast; // True for broadcast, false for unicas
         bool passive;
         bool RTR;
+        ControlType control;
     } header;
 
     void *data[SIZE_PACKET];
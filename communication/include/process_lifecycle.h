@@ -0,0 +1,62 @@
+#pragma once
+#include <signal.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The lifecycle of a bus or ECU process: the main thread sleeps in run until SIGINT, SIGTERM or requestStop,
+// then the process shuts down in order instead of exiting from a signal handler.
+// The stop signals are blocked and read from a signalfd, which only works if no thread is left that would
+// take them, so the lifecycle must be created at the start of main before any thread is started.
+// A second signal during the shutdown ends the process at once, as the signals are unblocked again when it is destroyed
+class ProcessLifecycle
+{
+private:
+    sigset_t stopSignals;
+    sigset_t previousMask;
+    int signalFd;
+    int wakeFd; // Wakes run when the stop is requested from a thread
+    std::atomic<bool> stopping;
+    std::mutex stopMutex;
+    std::condition_variable stopRequested;
+    std::vector<std::thread> workers;
+    std::vector<std::function<void()>> interrupts; // Wake the workers that block in calls of their own
+    std::vector<std::function<void()>> shutdownSteps;
+
+    // Interrupts the workers that block and joins all of them
+    void joinWorkers();
+
+public:
+    // Constructor - blocks the stop signals of the process, throws std::runtime_error if they cannot be read
+    ProcessLifecycle();
+
+    // Starts a worker thread that is joined when the process stops. The worker returns once isStopping,
+    // waitForStop sleeps until then instead of polling
+    void addWorker(std::function<void()> worker);
+
+    // Starts a worker that blocks in a call of its own, such as a replay, interrupt is called once the process
+    // is stopping to make it return
+    void addWorker(std::function<void()> worker, std::function<void()> interrupt);
+
+    // Adds a step of the shutdown, the steps run after the workers are joined in the reverse order of their addition
+    void onShutdown(std::function<void()> step);
+
+    // Blocks until a stop signal or requestStop, then shuts down. Returns the signal that stopped the process, or 0
+    int run();
+
+    // Asks run to return, may be called from any thread
+    void requestStop();
+
+    // Checks if the process is stopping
+    bool isStopping();
+
+    // Waits for the stop up to the timeout, returns true if the process is stopping
+    bool waitForStop(std::chrono::milliseconds timeout);
+
+    // Destructor - stops and joins the workers that are still running and unblocks the signals
+    ~ProcessLifecycle();
+};
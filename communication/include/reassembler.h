@@ -0,0 +1,86 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include "packet.h"
+
+// Number of messages that can be in reassembly at the same time
+#define REASSEMBLY_SLOTS 64
+
+// Initial buffer size of a slot, a slot keeps the largest buffer it needed
+#define REASSEMBLY_SLOT_CAPACITY 1024
+
+// Larger messages are rejected instead of growing a slot without bound
+#define REASSEMBLY_MAX_MESSAGE_SIZE (16 * 1024 * 1024)
+
+// Rebuilds messages from their packets without allocating on the receive path.
+// Messages are keyed by source and ID, packets are placed by their PSN so they may arrive in any order.
+// A message of several packets is delivered only if the CRC-32C it ends in matches, without the CRC.
+// A complete message is handed to the callback as a span over the slot's buffer,
+// the span is valid only during the callback.
+class Reassembler
+{
+private:
+    // A message in reassembly
+    struct Slot
+    {
+        uint64_t key;
+        uint32_t tps;
+        uint32_t received;
+        size_t length;              // Known once the last packet arrived
+        uint64_t lastUsed;          // For evicting the least recently used slot
+        bool inUse;
+        std::vector<uint8_t> data;
+        std::vector<uint64_t> arrived; // Bitmap of the received PSNs
+    };
+
+    std::function<void(uint32_t, const uint8_t *, size_t)> onComplete;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint64_t> indexKeys; // Open addressing over the keys of the slots in use
+    std::vector<int32_t> indexSlots;
+    size_t indexMask;
+    uint64_t clock;
+    uint64_t duplicates;
+    uint64_t evictions;
+    uint64_t invalidPackets;
+    uint64_t corruptMessages;
+
+    // Position of the key in the index, or of the empty entry where it would be inserted
+    size_t indexPosition(uint64_t key) const;
+
+    // Removes the key from the index, shifting back the entries that probed past it
+    void indexErase(uint64_t key);
+
+    // Returns the slot of a message, or starts a new one
+    Slot &acquireSlot(uint64_t key, uint32_t tps);
+
+    // Prepares a slot for a new message
+    void resetSlot(Slot &slot, uint32_t tps);
+
+    // Returns a slot to the pool after its message was delivered or evicted
+    void releaseSlot(Slot &slot);
+
+public:
+    // Constructor - onComplete receives the source, the data and its size
+    Reassembler(std::function<void(uint32_t, const uint8_t *, size_t)> onComplete, size_t slotCount = REASSEMBLY_SLOTS);
+
+    // Places the packet in its message, returns false if the packet was rejected or completed a corrupt message
+    bool addPacket(const Packet &packet);
+
+    // Number of messages in reassembly
+    size_t pendingMessages() const;
+
+    // Packets whose PSN was already received
+    uint64_t getDuplicates() const;
+
+    // Incomplete messages dropped to make room for new ones
+    uint64_t getEvictions() const;
+
+    // Packets with an impossible PSN, TPS or DLC
+    uint64_t getInvalidPackets() const;
+
+    // Messages of several packets whose CRC-32C did not match
+    uint64_t getCorruptMessages() const;
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "packet.h"
+#include "wire_format.h"
+
+// Default capacity, must be a power of two
+#define RECEIVE_BUFFER_SIZE 65536
+
+// Per-connection ring buffer that cuts length-prefixed frames out of the byte stream.
+// A single large recv can hold many packets, and a packet split between segments waits for its tail.
+class ReceiveBuffer
+{
+private:
+    std::vector<uint8_t> buffer;
+    size_t mask;
+    size_t readIndex;
+    size_t writeIndex;
+    bool corrupted;
+
+    // Copies length bytes starting offset bytes after the read position
+    void peek(size_t offset, uint8_t *destination, size_t length) const;
+
+public:
+    // Constructor
+    ReceiveBuffer(size_t capacity = RECEIVE_BUFFER_SIZE);
+
+    // Start of the contiguous free region to receive into
+    uint8_t *writePointer();
+
+    // Size of the contiguous free region
+    size_t writableSize() const;
+
+    // Marks length bytes after writePointer as received
+    void commit(size_t length);
+
+    // Number of received bytes that were not consumed yet
+    size_t size() const;
+
+    // Extracts the next complete packet, returns false if more bytes are needed or the stream is corrupted
+    bool nextPacket(Packet &packet);
+
+    // True once a frame with an impossible length was seen, the connection cannot be resynchronized
+    bool isCorrupted() const;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+
+// Bidirectional map between the IDs of the processes and their sockets.
+// Readers work on an immutable snapshot and never wait for writers,
+// writers copy the current snapshot, change the copy and publish it.
+// Registrations are rare while every routed packet is a lookup, so the copy is cheap.
+class RoutingTable
+{
+public:
+    // One published version of the table
+    struct Snapshot
+    {
+        std::unordered_map<uint32_t, int> socketByID;
+        std::unordered_map<int, uint32_t> idBySocket;
+        std::vector<int> sockets; // In registration order, for broadcast
+    };
+
+private:
+    std::shared_ptr<const Snapshot> current;
+    std::mutex writeMutex;
+
+    // Publishes a new version, must be called under writeMutex
+    void publish(std::shared_ptr<const Snapshot> snapshot);
+
+public:
+    // Constructor
+    RoutingTable();
+
+    // Registers the socket under the ID, fails if either of them is already registered
+    bool add(int socket, uint32_t id);
+
+    // Unregisters the socket, returns false if it was not registered
+    bool remove(int socket);
+
+    // Unregisters everything and returns the sockets that were registered
+    std::vector<int> clear();
+
+    // Returns the socket of the ID or -1
+    int findSocket(uint32_t id) const;
+
+    // Returns true and sets the ID if the socket is registered
+    bool findID(int socket, uint32_t &id) const;
+
+    // Checks if the socket is registered
+    bool containsSocket(int socket) const;
+
+    // Checks if the ID is registered
+    bool containsID(uint32_t id) const;
+
+    // Number of registered processes
+    size_t size() const;
+
+    // The current version, stays valid and unchanged while held
+    std::shared_ptr<const Snapshot> snapshot() const;
+};
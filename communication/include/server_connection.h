@@ -3,15 +3,41 @@
 #include <thread>
 #include <future>
 #include <mutex>
+#include <shared_mutex>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <functional>
-#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
 #include <csignal>
 #include "message.h"
+#include "wire_format.h"
+#include "receive_buffer.h"
+#include "routing_table.h"
+#include "filter_table.h"
+#include "outbound_queue.h"
 #include "../sockets/Isocket.h"
 #include "../sockets/real_socket.h"
+#include "../sockets/socket_factory.h"
 #include "error_code.h"
+#include "event_loop.h"
+#include "metrics.h"
+
+// Packets a process that sent HELLO may have in flight before the bus returns credits
+#define FLOW_CONTROL_WINDOW 1024
+
+// Returned credits are collected into frames of at least this many, must not exceed the window
+#define FLOW_CONTROL_CREDIT_BATCH 128
+
+// Pause before accepting again after accept failed while the server runs
+#define SERVER_ACCEPT_RETRY_MS 10
+
+// Threading model used to serve the connected processes
+enum class ServerMode {
+    THREAD_PER_CLIENT, // A blocking thread for each accepted socket
+    REACTOR            // A fixed pool of epoll event loops multiplexing all sockets
+};
 
 class ServerConnection
 {
@@ -22,13 +48,37 @@ private:
     std::atomic<bool> running;
     std::thread mainThread;
     std::vector<std::thread> clientThreads;
-    std::vector<int> sockets;
-    std::mutex socketMutex;
+    std::unordered_set<int> threadSockets; // Sockets served by a thread of their own, which closes them
+    std::vector<std::thread::id> finishedThreads; // Threads of clientThreads that have returned and wait to be joined
     std::mutex threadMutex;
     std::function<void(Packet&)> receiveDataCallback;
-    std::map<int, uint32_t> clientIDMap;
-    std::mutex IDMapMutex;
+    RoutingTable routingTable;
+    FilterTable filterTable; // Acceptance filters of the processes, applied to broadcast frames
     ISocket* socketInterface;
+    ServerMode mode;
+    std::vector<std::unique_ptr<EventLoop>> eventLoops;
+    std::unordered_map<int, std::unique_ptr<ReceiveBuffer>> receiveBuffers;
+    std::mutex bufferMutex;
+    size_t workerCount;
+    std::unordered_map<int, std::shared_ptr<OutboundQueue>> outboundQueues;
+    std::shared_mutex queueMutex;
+    SlowConsumerPolicy slowConsumerPolicy;
+    size_t outboundQueueSize;
+    std::unordered_map<int, uint32_t> creditsOwed; // Sockets under flow control and the credits not yet returned
+    std::mutex creditMutex;
+    bool deferredCredits;
+    std::unordered_set<uint32_t> allowedIDs; // The processes that belong to the bus, empty for any process
+    uint32_t clientLimit;                    // Processes connected at once, 0 for no limit
+    std::mutex registrationMutex;
+
+    // Traffic of the server, read by registerMetrics
+    Counter packetsReceived;
+    Counter bytesReceived;
+    Counter framesSent;
+    Counter bytesSent;
+    Counter framesDropped;
+    Counter framesFiltered;
+    LabeledCounter sendErrors;
 
     // Starts listening for connection requests
     void startThread();
@@ -39,13 +89,57 @@ private:
     // Runs in a thread for each process - waits for a message and forwards it to the manager
     void handleClient(int clientSocket);
 
+    // Joins the threads of the processes that have disconnected, called with threadMutex held
+    void reapClientThreads();
+
     // Returns the sockets ID
     int getClientSocketByID(uint32_t destID);
 
+    // Registers the socket under the ID sent in the first packet of the connection
+    bool registerClient(int clientSocket, uint32_t clientID);
+
+    // Checks if the socket has already sent its ID
+    bool isRegistered(int clientSocket);
+
+    // Forwards the complete packets of the buffer, the first packet of a connection registers it
+    bool dispatchPackets(int clientSocket, ReceiveBuffer &buffer);
+
+    // Returns the receive buffer of a socket in reactor mode, creating it on first use
+    ReceiveBuffer &getReceiveBuffer(int clientSocket);
+
+    // Reads the pending packets of a socket in reactor mode, returns false if the socket should be closed
+    bool handleReadable(int clientSocket);
+
+    // Closes the socket and removes it from the routing tables
+    void removeClient(int clientSocket);
+
+    // Closes a socket dropped by an event loop, including sockets that never sent their ID
+    void closeClient(int clientSocket);
+
+    // Returns the outbound queue of a socket in reactor mode or null
+    std::shared_ptr<OutboundQueue> getOutboundQueue(int clientSocket);
+
+    // Writes the queued frames of a socket in reactor mode, returns false if the socket should be closed
+    bool handleWritable(int clientSocket);
+
+    // Sends an encoded frame to one socket, through its queue in reactor mode where a full queue applies the policy.
+    // A control frame may use the space of the queue kept for control frames instead
+    ErrorCode sendFrame(int clientSocket, const uint8_t *frame, size_t length, SlowConsumerPolicy policy, bool control = false);
+
+    // Answers a frame of the connection itself
+    void handleControl(int clientSocket, const Packet &packet);
+
+    // Sends a frame of the connection itself, never dropped since a lost credit would stall the process for good.
+    // In reactor mode it never waits for the process
+    ErrorCode sendControl(int clientSocket, ControlType type, uint32_t value = 0);
+
+    // Adds credits for the socket and returns them once a batch is collected
+    void releaseCredits(int clientSocket, uint32_t count);
+
 public:
 
     // Constructor
-    ServerConnection(int port, std::function<void(Packet&)> callback, ISocket* socketInterface = new RealSocket());
+    ServerConnection(int port, std::function<void(Packet&)> callback, ISocket* socketInterface = createSocketInterface());
     
     // Initializes the listening socket
     ErrorCode startConnection();
@@ -65,26 +159,50 @@ public:
     // Sets the socket interface, throws an exception if the socketInterface is null.
     void setSocketInterface(ISocket *socketInterface);              
 
+    // Selects the threading model, must be called before startConnection
+    void setServerMode(ServerMode mode, size_t workerCount = 1);
+
+    // Selects what happens to frames for a process that does not keep up, used in reactor mode
+    void setSlowConsumerPolicy(SlowConsumerPolicy policy, size_t queueSize = OUTBOUND_QUEUE_SIZE);
+
+    // Credits of the received packets are returned by returnCredits instead of once the callback returns,
+    // so the bus can hold the processes back until their packets actually left. Must be called before startConnection
+    void setDeferredCredits(bool deferred);
+
+    // Accepts only processes with these IDs, an empty list accepts any process. Must be called before startConnection
+    void setAllowedIDs(const std::vector<uint32_t> &ids);
+
+    // Limits the number of processes connected at once, 0 for no limit. Must be called before startConnection
+    void setClientLimit(uint32_t limit);
+
+    // Returns the credits of packets of the process that the bus is done with
+    void returnCredits(uint32_t clientID, uint32_t count = 1);
+
     // Sends the message to destination
     ErrorCode sendDestination(const Packet &packet);
+
+    // Adds the traffic counters, the connected processes and their queue depths to the registry
+    void registerMetrics(MetricsRegistry &registry);
     
     // For testing
     int getServerSocket();
 
     int isRunning();
 
-    std::vector<int>* getSockets();
-
-    std::mutex* getSocketMutex();
-
-    std::mutex* getIDMapMutex();
+    RoutingTable* getRoutingTable();
 
-    std::map<int, uint32_t>* getClientIDMap();
+    FilterTable* getFilterTable();
 
     void testHandleClient(int clientSocket);
 
     int testGetClientSocketByID(uint32_t destID);
 
+    bool testHandleReadable(int clientSocket);
+
+    bool testHandleWritable(int clientSocket);
+
+    size_t testClientThreadCount();
+
     // Destructor
      ~ServerConnection();
 };
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "packet.h"
+#include "error_code.h"
+
+// Compact, versioned encoding of a Packet on the socket.
+// All fields are little-endian and unpadded, only DLC payload bytes follow the header:
+//   version(1) flags(1) DLC(1) control(1) ID(4) PSN(4) TPS(4) SrcID(4) DestID(4) CRC(2) timestamp(8)
+//   [enqueueTime(8) routeTime(8) if WIRE_FLAG_TRACE] data(DLC)
+#define WIRE_FORMAT_VERSION 2
+#define WIRE_HEADER_SIZE 34
+#define WIRE_TRACE_SIZE 16
+#define WIRE_MAX_PACKET_SIZE (WIRE_HEADER_SIZE + WIRE_TRACE_SIZE + SIZE_PACKET)
+
+// On the stream every encoded packet is preceded by its little-endian 16 bit length,
+// so a receiver can cut frames out of arbitrary TCP segments and skip versions it does not know
+#define WIRE_FRAME_PREFIX_SIZE 2
+#define WIRE_MAX_FRAME_LENGTH 512
+#define WIRE_MAX_FRAME_SIZE (WIRE_FRAME_PREFIX_SIZE + WIRE_MAX_PACKET_SIZE)
+
+// Bits of the flags byte
+#define WIRE_FLAG_BROADCAST 0x01
+#define WIRE_FLAG_PASSIVE 0x02
+#define WIRE_FLAG_RTR 0x04
+#define WIRE_FLAG_TRACE 0x08 // The bus stamped the packet, its times follow the header
+
+// Returns the number of bytes the packet occupies on the wire
+size_t encodedSize(const Packet &packet);
+
+// Writes the packet into buffer, returns the number of bytes written or 0 if the capacity is too small
+size_t encodePacket(const Packet &packet, uint8_t *buffer, size_t capacity);
+
+// Reads the payload length from an encoded header, returns -1 if the header is not valid
+int encodedPayloadSize(const uint8_t *header);
+
+// Parses one encoded packet of exactly length bytes
+ErrorCode decodePacket(const uint8_t *buffer, size_t length, Packet &packet);
+
+
+// Writes the length prefix followed by the encoded packet, returns the frame size or 0 if the capacity is too small
+size_t encodeFrame(const Packet &packet, uint8_t *buffer, size_t capacity);
+
+// Parses the frame at the start of buffer, returns the frame size or 0 if it is incomplete or not valid
+size_t decodeFrame(const uint8_t *buffer, size_t length, Packet &packet);
@@ -2,6 +2,7 @@
 #define ISOCKET_H
 
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include "../../logger/logger.h"
 
 class ISocket {
@@ -14,7 +15,11 @@ public:
     virtual int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) = 0;
     virtual ssize_t send(int sockfd, const void *buf, size_t len, int flags) = 0;
     virtual ssize_t recv(int sockfd, void *buf, size_t len, int flags) = 0;
+    virtual int shutdown(int sockfd, int how) = 0;
     virtual int close(int fd) = 0;
+    virtual int epoll_create1(int flags) = 0;
+    virtual int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) = 0;
+    virtual int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) = 0;
     virtual ~ISocket() = default;
 };
 
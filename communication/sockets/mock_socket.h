@@ -0,0 +1,25 @@
+#ifndef MOCKSOCKET_H
+#define MOCKSOCKET_H
+
+#include <gmock/gmock.h>
+#include "Isocket.h"
+
+class MockSocket : public ISocket
+{
+public:
+    MOCK_METHOD(int, socket, (int domain, int type, int protocol), (override));
+    MOCK_METHOD(int, setsockopt, (int sockfd, int level, int optname, const void *optval, socklen_t optlen), (override));
+    MOCK_METHOD(int, bind, (int sockfd, const struct sockaddr *addr, socklen_t addrlen), (override));
+    MOCK_METHOD(int, listen, (int sockfd, int backlog), (override));
+    MOCK_METHOD(int, accept, (int sockfd, struct sockaddr *addr, socklen_t *addrlen), (override));
+    MOCK_METHOD(int, connect, (int sockfd, const struct sockaddr *addr, socklen_t addrlen), (override));
+    MOCK_METHOD(ssize_t, send, (int sockfd, const void *buf, size_t len, int flags), (override));
+    MOCK_METHOD(ssize_t, recv, (int sockfd, void *buf, size_t len, int flags), (override));
+    MOCK_METHOD(int, shutdown, (int sockfd, int how), (override));
+    MOCK_METHOD(int, close, (int fd), (override));
+    MOCK_METHOD(int, epoll_create1, (int flags), (override));
+    MOCK_METHOD(int, epoll_ctl, (int epfd, int op, int fd, struct epoll_event *event), (override));
+    MOCK_METHOD(int, epoll_wait, (int epfd, struct epoll_event *events, int maxevents, int timeout), (override));
+};
+
+#endif
@@ -49,7 +49,12 @@ int RealSocket::listen(int sockfd, int backlog)
         close(sockfd);
     }
 
-    RealSocket::log.logMessage(logger::LogLevel::INFO, "server running on port " + std::to_string(8080));
+    sockaddr_in bound{};
+    socklen_t boundLength = sizeof(bound);
+    if (::getsockname(sockfd, reinterpret_cast<sockaddr *>(&bound), &boundLength) == 0 && bound.sin_family == AF_INET)
+        RealSocket::log.logMessage(logger::LogLevel::INFO, "server running on port " + std::to_string(ntohs(bound.sin_port)));
+    else
+        RealSocket::log.logMessage(logger::LogLevel::INFO, "server running");
     return listenAns;
 }
 
@@ -80,42 +85,102 @@ int RealSocket::connect(int sockfd, const struct sockaddr *addr, socklen_t addrl
 ssize_t RealSocket::recv(int sockfd, void *buf, size_t len, int flags)
 {
     int valread = ::recv(sockfd, buf, len, flags);
-    const Packet *p = static_cast<const Packet *>(buf);
+    int recvErrno = errno;
 
-    if (valread < 0)
-        RealSocket::log.logMessage(logger::LogLevel::ERROR, std::to_string(p->header.SrcID), std::to_string(p->header.DestID), std::string(" Error occurred: in socket ") + std::to_string(sockfd) + std::string(" ") + std::string(strerror(errno)));
-    else if (valread == 0)
-        RealSocket::log.logMessage(logger::LogLevel::INFO, std::to_string(p->header.SrcID), std::to_string(p->header.DestID), std::string(" connection closed: in socket ") + std::to_string(sockfd) + std::string(" ") + std::string(strerror(errno)));
-    else {
-        if (!p->header.DLC)
-            RealSocket::log.logMessage(logger::LogLevel::INFO, std::to_string(p->header.SrcID), std::to_string(p->header.DestID), std::string("received packet number: ") + std::to_string(p->header.PSN) + std::string(", of messageId: ") + std::to_string(p->header.ID) + std::string(" ") + std::string(strerror(errno)) + " ID for connection: " + std::to_string(p->header.SrcID));
-        else
-            RealSocket::log.logMessage(logger::LogLevel::INFO, std::to_string(p->header.SrcID), std::to_string(p->header.DestID), std::string("received packet number: ") + std::to_string(p->header.PSN) + std::string(", of messageId: ") + std::to_string(p->header.ID) + std::string(" ") + std::string(strerror(errno)) + " Data: " + p->pointerToHex(p->data,p->header.DLC));
+    if (valread < 0) {
+        // An empty non-blocking socket is not an error
+        if (recvErrno != EAGAIN && recvErrno != EWOULDBLOCK)
+            LOG_ERROR(RealSocket::log, " Error occurred: in socket {} {}", sockfd, strerror(recvErrno));
     }
-        
+    else if (valread == 0)
+        LOG_INFO(RealSocket::log, " connection closed: in socket {}", sockfd);
 
+    // Logging may overwrite errno, the caller still needs the result of recv
+    errno = recvErrno;
     return valread;
 }
 
 ssize_t RealSocket::send(int sockfd, const void *buf, size_t len, int flags)
 {
     int sendAns = ::send(sockfd, buf, len, flags);
-    const Packet *p = static_cast<const Packet *>(buf);
-    if (sendAns <= 0)
-    {
-        RealSocket::log.logMessage(logger::LogLevel::ERROR, std::to_string(p->header.SrcID), std::to_string(p->header.DestID), "sending packet number: " + std::to_string(p->header.PSN) + ", of messageId: " + std::to_string(p->header.ID) + std::string(" ") + std::string(strerror(errno)));
-    }
-    if (!p->header.DLC)
-        RealSocket::log.logMessage(logger::LogLevel::INFO, std::to_string(p->header.SrcID), std::to_string(p->header.DestID), "sending packet number: " + std::to_string(p->header.PSN) + ", of messageId: " + std::to_string(p->header.ID) + std::string(" ") + std::string(strerror(errno)) + " ID for connection: " + std::to_string(p->header.SrcID));
-    else
-        RealSocket::log.logMessage(logger::LogLevel::INFO, std::to_string(p->header.SrcID), std::to_string(p->header.DestID), "sending packet number: " + std::to_string(p->header.PSN) + ", of messageId: " + std::to_string(p->header.ID) + std::string(" ") + std::string(strerror(errno)) + " Data: " + p->pointerToHex(p->data,p->header.DLC));
+    int sendErrno = errno;
+
+    // A full non-blocking socket is not an error, the caller queues the bytes
+    if (sendAns >= 0 || (sendErrno != EAGAIN && sendErrno != EWOULDBLOCK))
+        logSentFrames(sockfd, buf, len, sendAns, sendErrno);
+
+    errno = sendErrno;
     return sendAns;
 }
 
+// Logs the frames of a send buffer, a batch is summarized in a single line
+void RealSocket::logSentFrames(int sockfd, const void *buf, size_t len, ssize_t sendAns, int sendErrno)
+{
+    // Successful sends are logged at INFO, nothing has to be decoded when it is off
+    if (sendAns > 0 && !logger::isEnabled(logger::LogLevel::INFO))
+        return;
+
+    const uint8_t *frames = static_cast<const uint8_t *>(buf);
+    Packet first;
+    size_t frameSize = decodeFrame(frames, len, first);
+    if (!frameSize) {
+        if (sendAns <= 0)
+            LOG_ERROR(RealSocket::log, "sending {} bytes on socket {} {}", len, sockfd, strerror(sendErrno));
+    }
+    else if (sendAns <= 0)
+        LOG_ROUTE_ERROR(RealSocket::log, first.header.SrcID, first.header.DestID, "sending packet number: {}, of messageId: {} {}", first.header.PSN, first.header.ID, strerror(sendErrno));
+    else if (frameSize == len)
+        logPacket(LogEvent::SEND, first);
+    else {
+        // Walks the length prefixes only, the packets themselves are not decoded again
+        size_t count = 0;
+        for (size_t offset = 0; offset + WIRE_FRAME_PREFIX_SIZE <= len; offset += WIRE_FRAME_PREFIX_SIZE + (frames[offset] | (frames[offset + 1] << 8)))
+            count++;
+        LOG_ROUTE_INFO(RealSocket::log, first.header.SrcID, first.header.DestID, "sending {} packets from messageId: {} in {} bytes", count, first.header.ID, len);
+    }
+}
+
+// Writes the details of a packet that passed through a socket to the log
+void RealSocket::logPacket(LogEvent event, const Packet &p)
+{
+    LOG_PACKET(RealSocket::log, logger::LogLevel::INFO, event, p.header.SrcID, p.header.DestID, p.header.ID, p.header.PSN, p.data, p.header.DLC);
+}
+
+int RealSocket::shutdown(int sockfd, int how)
+{
+    return ::shutdown(sockfd, how);
+}
+
 int RealSocket::close(int fd)
 {
     RealSocket::log.logMessage(logger::LogLevel::INFO, "close socket number: " + std::to_string(fd));
-    RealSocket::log.cleanUp();
-    shutdown(fd, SHUT_RDWR);
+    ::shutdown(fd, SHUT_RDWR);
     return ::close(fd);
-}
\ No newline at end of file
+}
+
+int RealSocket::epoll_create1(int flags)
+{
+    int epollFd = ::epoll_create1(flags);
+    if (epollFd < 0)
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "epoll creation error: " + std::string(strerror(errno)));
+
+    return epollFd;
+}
+
+int RealSocket::epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+    int ctlAns = ::epoll_ctl(epfd, op, fd, event);
+    if (ctlAns < 0)
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "epoll_ctl failed for socket " + std::to_string(fd) + ": " + std::string(strerror(errno)));
+
+    return ctlAns;
+}
+
+int RealSocket::epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+    int ready = ::epoll_wait(epfd, events, maxevents, timeout);
+    if (ready < 0 && errno != EINTR)
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "epoll_wait failed: " + std::string(strerror(errno)));
+
+    return ready;
+}
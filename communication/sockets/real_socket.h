@@ -1,10 +1,13 @@
 #ifndef REALSOCKET_H
 #define REALSOCKET_H
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
 #include "Isocket.h"
 #include <unistd.h>
 #include <string.h>
 #include "../include/packet.h"
+#include "../include/wire_format.h"
 
 class RealSocket : public ISocket
 {
@@ -13,6 +16,12 @@ public:
 
     RealSocket();
 
+    // Writes the details of a packet that passed through a socket to the log
+    static void logPacket(LogEvent event, const Packet &p);
+
+    // Logs the frames of a send buffer, a batch is summarized in a single line
+    static void logSentFrames(int sockfd, const void *buf, size_t len, ssize_t sendAns, int sendErrno);
+
     int socket(int domain, int type, int protocol) override;
 
     int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen) override;
@@ -29,6 +38,14 @@ public:
 
     ssize_t send(int sockfd, const void *buf, size_t len, int flags) override;
     
+    int shutdown(int sockfd, int how) override;
+
     int close(int fd) override;
+
+    int epoll_create1(int flags) override;
+
+    int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) override;
+
+    int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) override;
 };
 #endif
\ No newline at end of file
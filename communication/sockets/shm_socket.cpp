@@ -0,0 +1,467 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <cstddef>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include "shm_socket.h"
+
+// Descriptors passed from the process to the bus manager when connecting
+#define SHM_HANDSHAKE_FDS 3
+
+// A process that connects and sends no descriptors in this time is dropped, the accept loop moves on
+#define SHM_HANDSHAKE_TIMEOUT_MS 1000
+
+// Builds the abstract unix address of the bus listening on the port of an inet address
+static socklen_t busAddress(const struct sockaddr *addr, sockaddr_un &unixAddress)
+{
+    int port = ntohs(reinterpret_cast<const sockaddr_in *>(addr)->sin_port);
+    std::memset(&unixAddress, 0, sizeof(unixAddress));
+    unixAddress.sun_family = AF_UNIX;
+    // A leading zero selects the abstract namespace, so a crashed bus leaves no file behind
+    int nameLength = snprintf(unixAddress.sun_path + 1, sizeof(unixAddress.sun_path) - 1, "vcs_bus_%d", port);
+    return offsetof(sockaddr_un, sun_path) + 1 + nameLength;
+}
+
+ShmSocket::ShmSocket() {}
+
+int ShmSocket::socket(int /*domain*/, int /*type*/, int /*protocol*/)
+{
+    // The rendezvous socket is a unix socket whatever family was asked for
+    int sockFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sockFd < 0)
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "shared memory socket creation error: " + std::string(strerror(errno)));
+    else
+        RealSocket::log.logMessage(logger::LogLevel::INFO, "create a shared memory socket: " + std::to_string(sockFd));
+    return sockFd;
+}
+
+int ShmSocket::setsockopt(int /*sockfd*/, int /*level*/, int /*optname*/, const void * /*optval*/, socklen_t /*optlen*/)
+{
+    // Abstract unix addresses are released with the socket, there is nothing to reuse
+    return 0;
+}
+
+int ShmSocket::bind(int sockfd, const struct sockaddr *addr, socklen_t /*addrlen*/)
+{
+    sockaddr_un unixAddress;
+    socklen_t unixLength = busAddress(addr, unixAddress);
+    return RealSocket::bind(sockfd, reinterpret_cast<sockaddr *>(&unixAddress), unixLength);
+}
+
+int ShmSocket::listen(int sockfd, int backlog)
+{
+    return RealSocket::listen(sockfd, backlog);
+}
+
+int ShmSocket::accept(int sockfd, struct sockaddr * /*addr*/, socklen_t * /*addrlen*/)
+{
+    while (true) {
+        int connFd = ::accept4(sockfd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connFd < 0) {
+            RealSocket::log.logMessage(logger::LogLevel::ERROR, "Accept failed: " + std::string(strerror(errno)));
+            return connFd;
+        }
+
+        // The process sends its segment and both eventfds right after connecting
+        timeval timeout = {SHM_HANDSHAKE_TIMEOUT_MS / 1000, (SHM_HANDSHAKE_TIMEOUT_MS % 1000) * 1000};
+        ::setsockopt(connFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        char marker;
+        iovec iov = {&marker, sizeof(marker)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * SHM_HANDSHAKE_FDS)];
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t received = ::recvmsg(connFd, &message, MSG_CMSG_CLOEXEC);
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        if (received <= 0 || !cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * SHM_HANDSHAKE_FDS)) {
+            RealSocket::log.logMessage(logger::LogLevel::ERROR, "shared memory handshake failed on socket " + std::to_string(connFd));
+            ::close(connFd);
+            continue;
+        }
+
+        int fds[SHM_HANDSHAKE_FDS];
+        std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+        struct stat segmentStat;
+        void *mapping = MAP_FAILED;
+        if (fstat(fds[0], &segmentStat) == 0 && (size_t)segmentStat.st_size >= sizeof(ShmSegment))
+            mapping = mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+        ::close(fds[0]);
+        if (mapping == MAP_FAILED) {
+            RealSocket::log.logMessage(logger::LogLevel::ERROR, "shared memory mapping failed on socket " + std::to_string(connFd));
+            ::close(fds[1]);
+            ::close(fds[2]);
+            ::close(connFd);
+            continue;
+        }
+
+        std::shared_ptr<ShmChannel> channel = std::make_shared<ShmChannel>();
+        channel->segment = static_cast<ShmSegment *>(mapping);
+        channel->rx = &channel->segment->toServer;
+        channel->tx = &channel->segment->toClient;
+        channel->rxWakeFd = fds[1];
+        channel->txWakeFd = fds[2];
+        channel->controlFd = connFd;
+
+        int channelFd = registerChannel(-1, channel);
+        if (channelFd < 0)
+            continue;
+
+        RealSocket::log.logMessage(logger::LogLevel::INFO, "shared memory connection succeed to client socket number: " + std::to_string(channelFd));
+        return channelFd;
+    }
+}
+
+int ShmSocket::connect(int sockfd, const struct sockaddr *addr, socklen_t /*addrlen*/)
+{
+    sockaddr_un unixAddress;
+    socklen_t unixLength = busAddress(addr, unixAddress);
+    if (::connect(sockfd, reinterpret_cast<sockaddr *>(&unixAddress), unixLength) < 0) {
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "process", "server", "Connection Failed: " + std::string(strerror(errno)));
+        return -1;
+    }
+
+    // The segment is unlinked at once, it lives as long as both mappings
+    char name[64];
+    snprintf(name, sizeof(name), "/vcs_bus_%d_%d", (int)getpid(), sockfd);
+    int shmFd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    if (shmFd < 0) {
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "process", "server", "shm_open failed: " + std::string(strerror(errno)));
+        return -1;
+    }
+    shm_unlink(name);
+
+    void *mapping = MAP_FAILED;
+    if (ftruncate(shmFd, sizeof(ShmSegment)) == 0)
+        mapping = mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+    // Both consumers start asleep, so the first bytes wake a reader that only polls the descriptor
+    if (mapping != MAP_FAILED) {
+        static_cast<ShmSegment *>(mapping)->toServer.waiting.store(1);
+        static_cast<ShmSegment *>(mapping)->toClient.waiting.store(1);
+    }
+    int serverWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int clientWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    int fds[SHM_HANDSHAKE_FDS] = {shmFd, serverWakeFd, clientWakeFd};
+    char marker = 0;
+    iovec iov = {&marker, sizeof(marker)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    bool handshakeSent = mapping != MAP_FAILED && serverWakeFd >= 0 && clientWakeFd >= 0 && ::sendmsg(sockfd, &message, MSG_NOSIGNAL) == (ssize_t)sizeof(marker);
+    ::close(shmFd);
+    if (!handshakeSent) {
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "process", "server", "shared memory handshake failed: " + std::string(strerror(errno)));
+        if (mapping != MAP_FAILED)
+            munmap(mapping, sizeof(ShmSegment));
+        if (serverWakeFd >= 0)
+            ::close(serverWakeFd);
+        if (clientWakeFd >= 0)
+            ::close(clientWakeFd);
+        return -1;
+    }
+
+    std::shared_ptr<ShmChannel> channel = std::make_shared<ShmChannel>();
+    channel->segment = static_cast<ShmSegment *>(mapping);
+    channel->rx = &channel->segment->toClient;
+    channel->tx = &channel->segment->toServer;
+    channel->rxWakeFd = clientWakeFd;
+    channel->txWakeFd = serverWakeFd;
+    channel->controlFd = sockfd;
+    if (registerChannel(sockfd, channel) < 0)
+        return -1;
+
+    RealSocket::log.logMessage(logger::LogLevel::INFO, "process", "server", "shared memory connection succeed");
+    return 0;
+}
+
+ssize_t ShmSocket::recv(int sockfd, void *buf, size_t len, int flags)
+{
+    std::shared_ptr<ShmChannel> channel = getChannel(sockfd);
+    if (!channel) {
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    ShmRing *ring = channel->rx;
+    while (true) {
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        uint64_t tail = ring->tail.load(std::memory_order_seq_cst);
+        if (tail != head) {
+            ring->waiting.store(0, std::memory_order_relaxed);
+            size_t chunk = std::min<size_t>(len, tail - head);
+            size_t start = head & (SHM_RING_SIZE - 1);
+            size_t firstPart = std::min(chunk, SHM_RING_SIZE - start);
+            std::memcpy(buf, ring->data + start, firstPart);
+            std::memcpy(static_cast<uint8_t *>(buf) + firstPart, ring->data, chunk - firstPart);
+            ring->head.store(head + chunk, std::memory_order_seq_cst);
+
+            // A non-blocking producer waits for space through the descriptor it reads from
+            if (ring->spaceWaiting.load(std::memory_order_seq_cst) && ring->spaceWaiting.exchange(0, std::memory_order_seq_cst)) {
+                uint64_t one = 1;
+                ssize_t written = ::write(channel->txWakeFd, &one, sizeof(one));
+                (void)written;
+            }
+            return chunk;
+        }
+
+        // Stale wakeups are consumed before announcing the sleep, then the ring is checked again
+        uint64_t counter;
+        ssize_t drained = ::read(channel->rxWakeFd, &counter, sizeof(counter));
+        (void)drained;
+        ring->waiting.store(1, std::memory_order_seq_cst);
+        if (ring->tail.load(std::memory_order_seq_cst) != head)
+            continue;
+
+        if (isPeerGone(channel.get())) {
+            RealSocket::log.logMessage(logger::LogLevel::INFO, std::string(" connection closed: in socket ") + std::to_string(sockfd));
+            return 0;
+        }
+
+        if (flags & MSG_DONTWAIT) {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        epoll_event event;
+        ::epoll_wait(channel->waitFd, &event, 1, -1);
+    }
+}
+
+ssize_t ShmSocket::send(int sockfd, const void *buf, size_t len, int flags)
+{
+    std::shared_ptr<ShmChannel> channel = getChannel(sockfd);
+    if (!channel) {
+        errno = ENOTCONN;
+        RealSocket::logSentFrames(sockfd, buf, len, -1, errno);
+        return -1;
+    }
+
+    // The ring has a single producer, local threads sending to the same process take turns
+    std::lock_guard<std::mutex> lock(channel->sendMutex);
+    const uint8_t *bytes = static_cast<const uint8_t *>(buf);
+    ShmRing *ring = channel->tx;
+    size_t written = 0;
+    while (written < len) {
+        if (channel->segment->closed.load(std::memory_order_acquire))
+            break;
+
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t freeBytes = SHM_RING_SIZE - (tail - ring->head.load(std::memory_order_acquire));
+        if (!freeBytes) {
+            if (flags & MSG_DONTWAIT) {
+                // Announces the wait before checking again, so the consumer cannot miss it
+                ring->spaceWaiting.store(1, std::memory_order_seq_cst);
+                if (ring->head.load(std::memory_order_seq_cst) != tail - SHM_RING_SIZE)
+                    continue;
+                break;
+            }
+            if (isPeerGone(channel.get()))
+                break;
+            // The consumer does not signal free space, a full ring is polled
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            continue;
+        }
+
+        size_t chunk = std::min(len - written, freeBytes);
+        size_t start = tail & (SHM_RING_SIZE - 1);
+        size_t firstPart = std::min(chunk, SHM_RING_SIZE - start);
+        std::memcpy(ring->data + start, bytes + written, firstPart);
+        std::memcpy(ring->data, bytes + written + firstPart, chunk - firstPart);
+        ring->tail.store(tail + chunk, std::memory_order_seq_cst);
+        notify(ring, channel->txWakeFd);
+        written += chunk;
+    }
+
+    ssize_t sendAns = written;
+    if (!written && len) {
+        sendAns = -1;
+        errno = (flags & MSG_DONTWAIT) && !channel->segment->closed ? EAGAIN : EPIPE;
+    }
+
+    int sendErrno = errno;
+    if (sendAns > 0 || sendErrno != EAGAIN)
+        RealSocket::logSentFrames(sockfd, buf, len, sendAns, sendErrno);
+    errno = sendErrno;
+    return sendAns;
+}
+
+int ShmSocket::close(int fd)
+{
+    std::shared_ptr<ShmChannel> channel;
+    {
+        std::unique_lock<std::shared_mutex> lock(channelsMutex);
+        auto it = channels.find(fd);
+        if (it != channels.end()) {
+            channel = it->second;
+            channels.erase(it);
+        }
+    }
+
+    if (!channel)
+        return RealSocket::close(fd);
+
+    RealSocket::log.logMessage(logger::LogLevel::INFO, "close shared memory socket number: " + std::to_string(fd));
+
+    // The mapping goes with the last user
+    markClosed(channel.get());
+    return 0;
+}
+
+int ShmSocket::shutdown(int sockfd, int how)
+{
+    std::shared_ptr<ShmChannel> channel = getChannel(sockfd);
+    if (!channel)
+        return RealSocket::shutdown(sockfd, how);
+
+    // The rings carry both directions, so any shutdown ends the channel, the descriptor stays valid until close
+    markClosed(channel.get());
+    return 0;
+}
+
+int ShmSocket::epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+    // A connecting process knows its channel by the rendezvous socket, which never becomes readable,
+    // so the channel is polled through its wait descriptor
+    std::shared_ptr<ShmChannel> channel = getChannel(fd);
+    int res = RealSocket::epoll_ctl(epfd, op, channel ? channel->waitFd : fd, event);
+    if (res < 0 || !channel || op == EPOLL_CTL_DEL)
+        return res;
+
+    channel->writeInterest = event->events & EPOLLOUT;
+
+    // Space that was freed before the interest was set would never be reported, a self wakeup reports it
+    if (channel->writeInterest) {
+        uint64_t one = 1;
+        ssize_t written = ::write(channel->rxWakeFd, &one, sizeof(one));
+        (void)written;
+    }
+    return res;
+}
+
+int ShmSocket::epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+    int ready = RealSocket::epoll_wait(epfd, events, maxevents, timeout);
+    for (int i = 0; i < ready; ++i) {
+        std::shared_ptr<ShmChannel> channel = getChannel(events[i].data.fd);
+        if (!channel || !channel->writeInterest)
+            continue;
+
+        ShmRing *ring = channel->tx;
+        if (ring->tail.load(std::memory_order_relaxed) - ring->head.load(std::memory_order_acquire) < SHM_RING_SIZE)
+            events[i].events |= EPOLLOUT;
+    }
+    return ready;
+}
+
+// Returns the channel of a descriptor or null if it is not a connection
+std::shared_ptr<ShmChannel> ShmSocket::getChannel(int fd)
+{
+    std::shared_lock<std::shared_mutex> lock(channelsMutex);
+    auto it = channels.find(fd);
+    if (it == channels.end())
+        return nullptr;
+    return it->second;
+}
+
+// Builds the waitable descriptor of a channel and registers it under the given key
+int ShmSocket::registerChannel(int key, std::shared_ptr<ShmChannel> channel)
+{
+    channel->waitFd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (channel->waitFd < 0) {
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "epoll creation error: " + std::string(strerror(errno)));
+        return -1;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = channel->rxWakeFd;
+    ::epoll_ctl(channel->waitFd, EPOLL_CTL_ADD, channel->rxWakeFd, &event);
+    event.events = EPOLLRDHUP;
+    event.data.fd = channel->controlFd;
+    ::epoll_ctl(channel->waitFd, EPOLL_CTL_ADD, channel->controlFd, &event);
+
+    // Accepted channels are known by their waitable descriptor, so event loops can poll them
+    if (key < 0)
+        key = channel->waitFd;
+
+    std::unique_lock<std::shared_mutex> lock(channelsMutex);
+    channels[key] = channel;
+    return key;
+}
+
+// Wakes the consumer of the ring if it is sleeping
+void ShmSocket::notify(ShmRing *ring, int wakeFd)
+{
+    if (ring->waiting.exchange(0, std::memory_order_seq_cst)) {
+        uint64_t one = 1;
+        ssize_t written = ::write(wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+// Checks if the peer closed the connection or died
+bool ShmSocket::isPeerGone(ShmChannel *channel)
+{
+    if (channel->segment->closed.load(std::memory_order_acquire))
+        return true;
+
+    int savedErrno = errno;
+    char byte;
+    ssize_t peeked = ::recv(channel->controlFd, &byte, sizeof(byte), MSG_PEEK | MSG_DONTWAIT);
+    bool gone = peeked == 0 || (peeked < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+    errno = savedErrno;
+    return gone;
+}
+
+// Marks the channel closed and wakes both sides
+void ShmSocket::markClosed(ShmChannel *channel)
+{
+    // Wakes the peer and a local reader blocked on this channel
+    channel->segment->closed.store(1, std::memory_order_seq_cst);
+    uint64_t one = 1;
+    ssize_t written = ::write(channel->txWakeFd, &one, sizeof(one));
+    written = ::write(channel->rxWakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+// Releases the mapping and the descriptors
+ShmChannel::~ShmChannel()
+{
+    munmap(segment, sizeof(ShmSegment));
+    ::close(rxWakeFd);
+    ::close(txWakeFd);
+    ::close(waitFd);
+    shutdown(controlFd, SHUT_RDWR);
+    ::close(controlFd);
+}
+
+ShmSocket::~ShmSocket()
+{
+    std::vector<int> fds;
+    {
+        std::shared_lock<std::shared_mutex> lock(channelsMutex);
+        for (auto &channel : channels)
+            fds.push_back(channel.first);
+    }
+    for (int fd : fds)
+        close(fd);
+}
@@ -0,0 +1,104 @@
+#ifndef SHMSOCKET_H
+#define SHMSOCKET_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include "real_socket.h"
+
+// Capacity of each direction of a connection, must be a power of two
+#define SHM_RING_SIZE (1 << 20)
+
+// Single-producer single-consumer byte ring living in shared memory
+struct ShmRing
+{
+    alignas(64) std::atomic<uint64_t> head;    // Advanced by the consumer
+    alignas(64) std::atomic<uint64_t> tail;    // Advanced by the producer
+    alignas(64) std::atomic<uint32_t> waiting; // Set by the consumer before it sleeps
+    alignas(64) std::atomic<uint32_t> spaceWaiting; // Set by a non-blocking producer that found the ring full
+    alignas(64) uint8_t data[SHM_RING_SIZE];
+};
+
+// The mapped segment shared by a process and the bus manager
+struct ShmSegment
+{
+    std::atomic<uint32_t> closed;
+    ShmRing toServer;
+    ShmRing toClient;
+};
+
+// One end of a connection
+struct ShmChannel
+{
+    ShmSegment *segment;
+    ShmRing *rx;
+    ShmRing *tx;
+    int rxWakeFd;  // Signaled by the peer after writing to rx
+    int txWakeFd;  // Signaled by us after writing to tx
+    int controlFd; // The rendezvous socket, reports the death of the peer
+    int waitFd;    // epoll over rxWakeFd and controlFd
+    std::mutex sendMutex;
+    std::atomic<bool> writeInterest{false}; // An event loop asked for writable events
+
+    // Releases the mapping and the descriptors
+    ~ShmChannel();
+};
+
+// Transport over shared memory between processes of the same host.
+// A unix socket is used only to exchange the segment and the eventfds when connecting,
+// afterwards packets move through lock-free rings and eventfds wake the sleeping side.
+// The descriptor returned by accept is pollable, so the server's event loops work unchanged.
+// It is only readable at the kernel level, writable events are derived from the free space of the ring.
+class ShmSocket : public RealSocket
+{
+private:
+    std::unordered_map<int, std::shared_ptr<ShmChannel>> channels;
+    std::shared_mutex channelsMutex;
+
+    // Returns the channel of a descriptor or null if it is not a connection
+    std::shared_ptr<ShmChannel> getChannel(int fd);
+
+    // Builds the waitable descriptor of a channel and registers it under the given key
+    int registerChannel(int key, std::shared_ptr<ShmChannel> channel);
+
+    // Wakes the consumer of the ring if it is sleeping
+    static void notify(ShmRing *ring, int wakeFd);
+
+    // Checks if the peer closed the connection or died
+    static bool isPeerGone(ShmChannel *channel);
+
+    // Marks the channel closed and wakes both sides
+    static void markClosed(ShmChannel *channel);
+
+public:
+    ShmSocket();
+
+    int socket(int domain, int type, int protocol) override;
+
+    int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen) override;
+
+    int bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen) override;
+
+    int listen(int sockfd, int backlog) override;
+
+    int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen) override;
+
+    int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) override;
+
+    ssize_t recv(int sockfd, void *buf, size_t len, int flags) override;
+
+    ssize_t send(int sockfd, const void *buf, size_t len, int flags) override;
+
+    int shutdown(int sockfd, int how) override;
+
+    int close(int fd) override;
+
+    int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) override;
+
+    int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) override;
+
+    ~ShmSocket();
+};
+#endif
@@ -0,0 +1,24 @@
+#include <cstdlib>
+#include <cstring>
+#include "socket_factory.h"
+#include "real_socket.h"
+#include "shm_socket.h"
+
+// Reads the transport selected for this process at startup
+Transport transportFromEnvironment()
+{
+    const char *transport = std::getenv(TRANSPORT_ENV);
+    if (transport && std::strcmp(transport, "shm") == 0)
+        return Transport::SHARED_MEMORY;
+
+    return Transport::TCP;
+}
+
+// Creates the socket interface of a transport, the caller owns it
+ISocket *createSocketInterface(Transport transport)
+{
+    if (transport == Transport::SHARED_MEMORY)
+        return new ShmSocket();
+
+    return new RealSocket();
+}
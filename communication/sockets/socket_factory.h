@@ -0,0 +1,20 @@
+#ifndef SOCKETFACTORY_H
+#define SOCKETFACTORY_H
+
+#include "Isocket.h"
+
+// Environment variable selecting the transport of the bus: "tcp" (default) or "shm"
+#define TRANSPORT_ENV "VCS_TRANSPORT"
+
+enum class Transport {
+    TCP,          // Loopback TCP sockets
+    SHARED_MEMORY // Shared-memory rings between processes of the same host
+};
+
+// Reads the transport selected for this process at startup
+Transport transportFromEnvironment();
+
+// Creates the socket interface of a transport, the caller owns it
+ISocket *createSocketInterface(Transport transport = transportFromEnvironment());
+
+#endif
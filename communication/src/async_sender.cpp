@@ -0,0 +1,114 @@
+#include <stdexcept>
+#include "../include/async_sender.h"
+
+// Constructor - writeBatch sends all the packets it gets with as few writes as possible
+AsyncSender::AsyncSender(std::function<ErrorCode(std::vector<Packet> &)> writeBatch)
+    : writeBatch(writeBatch), running(false)
+{
+    if (!writeBatch)
+        throw std::invalid_argument("Invalid callback function: writeBatch cannot be null.");
+}
+
+// Starts the I/O thread
+void AsyncSender::start()
+{
+    std::lock_guard<std::mutex> lock(submitMutex);
+    if (running)
+        return;
+
+    running = true;
+    ioThread = std::thread(&AsyncSender::run, this);
+}
+
+// Sends what is still queued and joins the I/O thread
+void AsyncSender::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+        if (!running)
+            return;
+        running = false;
+    }
+    submittedChanged.notify_one();
+
+    if (ioThread.joinable())
+        ioThread.join();
+}
+
+// Queues the packets of a message, the completion may be null.
+// A message rejected because the queue is full or the sender is stopped completes on the caller's thread
+void AsyncSender::submit(std::vector<Packet> &&packets, std::function<void(ErrorCode)> completion)
+{
+    enqueue({std::move(packets), std::move(completion), ErrorCode::SUCCESS});
+}
+
+// Completes a message that cannot be sent, through the queue like every other completion
+void AsyncSender::fail(ErrorCode result, std::function<void(ErrorCode)> completion)
+{
+    enqueue({std::vector<Packet>(), std::move(completion), result});
+}
+
+// Appends a submission, completing it at once if the queue is full
+void AsyncSender::enqueue(Submission &&submission)
+{
+    bool queued = false;
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+        if (running && submitted.size() < ASYNC_SEND_QUEUE_LIMIT) {
+            submitted.push_back(std::move(submission));
+            queued = true;
+            // Only the first message of a batch has to wake the I/O thread
+            wake = submitted.size() == 1;
+        }
+        else
+            submission.result = running ? ErrorCode::SEND_FAILED : ErrorCode::CONNECTION_FAILED;
+    }
+
+    // A queued submission was moved away, only a rejected one completes here
+    if (wake)
+        submittedChanged.notify_one();
+    else if (!queued && submission.completion)
+        submission.completion(submission.result);
+}
+
+// Writes the queued messages until the sender is stopped and the queue is empty
+void AsyncSender::run()
+{
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(submitMutex);
+            submittedChanged.wait(lock, [this]() { return !running || !submitted.empty(); });
+            if (submitted.empty())
+                return;
+
+            // Everything queued so far leaves together, producers continue on the emptied vector
+            std::swap(submitted, inFlight);
+        }
+
+        batch.clear();
+        for (Submission &submission : inFlight)
+            if (submission.result == ErrorCode::SUCCESS)
+                batch.insert(batch.end(), submission.packets.begin(), submission.packets.end());
+
+        ErrorCode batchResult = batch.empty() ? ErrorCode::SUCCESS : writeBatch(batch);
+
+        for (Submission &submission : inFlight)
+            if (submission.completion)
+                submission.completion(submission.result == ErrorCode::SUCCESS ? batchResult : submission.result);
+        inFlight.clear();
+    }
+}
+
+// Number of messages waiting for the I/O thread
+size_t AsyncSender::pending()
+{
+    std::lock_guard<std::mutex> lock(submitMutex);
+    return submitted.size();
+}
+
+// Destructor
+AsyncSender::~AsyncSender()
+{
+    stop();
+}
@@ -0,0 +1,132 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include "../include/bus_capture.h"
+#include "../include/wire_format.h"
+
+// Constructor - creates the file, throws std::runtime_error if it cannot be created
+CaptureWriter::CaptureWriter(const std::string &fileName) : packets(0), failed(false)
+{
+    fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Failed to create the capture " + fileName + ": " + strerror(errno));
+
+    block.reserve(CAPTURE_WRITE_BLOCK_SIZE + CAPTURE_TIME_SIZE + WIRE_MAX_FRAME_SIZE);
+    block.insert(block.end(), CAPTURE_MAGIC, CAPTURE_MAGIC + CAPTURE_MAGIC_SIZE);
+    block.push_back(CAPTURE_VERSION & 0xFF);
+    block.push_back(CAPTURE_VERSION >> 8);
+}
+
+// Adds a record, returns false if the file could not be written
+bool CaptureWriter::write(int64_t time, const Packet &packet)
+{
+    size_t offset = block.size();
+    block.resize(offset + CAPTURE_TIME_SIZE + WIRE_MAX_FRAME_SIZE);
+    for (int i = 0; i < CAPTURE_TIME_SIZE; ++i)
+        block[offset + i] = (uint8_t)((uint64_t)time >> (8 * i));
+
+    size_t length = encodeFrame(packet, block.data() + offset + CAPTURE_TIME_SIZE, WIRE_MAX_FRAME_SIZE);
+    if (!length) {
+        block.resize(offset);
+        return false;
+    }
+    block.resize(offset + CAPTURE_TIME_SIZE + length);
+    packets++;
+
+    if (block.size() >= CAPTURE_WRITE_BLOCK_SIZE)
+        return flush();
+    return !failed;
+}
+
+// Writes the collected records to the file
+bool CaptureWriter::flush()
+{
+    size_t offset = 0;
+    while (offset < block.size() && fd >= 0) {
+        ssize_t written = ::write(fd, block.data() + offset, block.size() - offset);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            failed = true;
+            break;
+        }
+        offset += written;
+    }
+
+    block.clear();
+    return !failed;
+}
+
+// Writes what is left and closes the file, returns false if any record was lost
+bool CaptureWriter::close()
+{
+    if (fd < 0)
+        return !failed;
+
+    flush();
+    if (::close(fd) < 0)
+        failed = true;
+    fd = -1;
+    return !failed;
+}
+
+// Number of records written
+uint64_t CaptureWriter::getPackets()
+{
+    return packets;
+}
+
+// Destructor
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+// Constructor - opens the file, throws std::runtime_error if it is missing or not a capture
+CaptureReader::CaptureReader(const std::string &fileName) : file(fileName, std::ios::binary), corrupted(false)
+{
+    uint8_t header[CAPTURE_HEADER_SIZE];
+    if (!file || !file.read((char *)header, sizeof(header)) || std::memcmp(header, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) != 0)
+        throw std::runtime_error("Not a bus capture: " + fileName);
+
+    int version = header[CAPTURE_MAGIC_SIZE] | (header[CAPTURE_MAGIC_SIZE + 1] << 8);
+    if (version != CAPTURE_VERSION)
+        throw std::runtime_error("Unsupported bus capture version " + std::to_string(version) + ": " + fileName);
+}
+
+// Reads the next record, returns false at the end of the capture or at a damaged record
+bool CaptureReader::next(CapturedPacket &record)
+{
+    uint8_t buffer[CAPTURE_TIME_SIZE + WIRE_MAX_FRAME_SIZE];
+    if (!file.read((char *)buffer, CAPTURE_TIME_SIZE + WIRE_FRAME_PREFIX_SIZE)) {
+        // A record cut short by a bus that was killed while writing counts as damaged
+        corrupted = file.gcount() != 0;
+        return false;
+    }
+
+    size_t frameLength = buffer[CAPTURE_TIME_SIZE] | (buffer[CAPTURE_TIME_SIZE + 1] << 8);
+    if (frameLength > WIRE_MAX_PACKET_SIZE ||
+        !file.read((char *)buffer + CAPTURE_TIME_SIZE + WIRE_FRAME_PREFIX_SIZE, frameLength)) {
+        corrupted = true;
+        return false;
+    }
+
+    uint64_t time = 0;
+    for (int i = 0; i < CAPTURE_TIME_SIZE; ++i)
+        time |= (uint64_t)buffer[i] << (8 * i);
+    record.time = (int64_t)time;
+
+    if (!decodeFrame(buffer + CAPTURE_TIME_SIZE, WIRE_FRAME_PREFIX_SIZE + frameLength, record.packet)) {
+        corrupted = true;
+        return false;
+    }
+    return true;
+}
+
+// Checks if reading stopped at a damaged record rather than at the end
+bool CaptureReader::isCorrupted()
+{
+    return corrupted;
+}
@@ -0,0 +1,94 @@
+#include "../include/bus_gateway.h"
+
+// Constructor - the gateway joins both buses under the ID
+BusGateway::BusGateway(uint32_t id, int sourcePort, int targetPort)
+    : id(id), source(std::bind(&BusGateway::forward, this, std::placeholders::_1)), target([](Packet &) {}), started(false)
+{
+    source.setPort(sourcePort);
+    target.setPort(targetPort);
+}
+
+// Adds a route, must be called before start
+void BusGateway::addRoute(const GatewayRoute &route)
+{
+    if (started)
+        throw std::logic_error("Routes cannot be added while the gateway is running.");
+
+    routes.push_back(route);
+}
+
+// Joins the target bus and then the source bus, after which frames are forwarded
+ErrorCode BusGateway::start()
+{
+    if (routes.empty())
+        throw std::logic_error("A gateway needs at least one route.");
+
+    // The gateway reads nothing from the target bus, a filter for an ID that no CAN frame has keeps its broadcasts away
+    target.addFilter({UINT32_MAX, UINT32_MAX});
+    ErrorCode res = target.connectToServer(id);
+    if (res != ErrorCode::SUCCESS)
+        return res;
+
+    // The source bus sends only the frames of the routes, registered before joining so that none is missed
+    for (const GatewayRoute &route : routes)
+        source.addFilter({route.id, route.mask});
+    started = true;
+    res = source.connectToServer(id);
+    if (res != ErrorCode::SUCCESS) {
+        target.closeConnection();
+        started = false;
+    }
+
+    return res;
+}
+
+// Translates a frame of the source bus and sends it on the target bus
+void BusGateway::forward(Packet &packet)
+{
+    // Frames addressed to the gateway itself have no destination on the target bus
+    if (!packet.header.isBroadcast)
+        return;
+
+    for (const GatewayRoute &route : routes) {
+        if (!route.matches(packet.header.ID))
+            continue;
+
+        // The gateway is the transmitter on the target bus, the bus returns its credits for the frame
+        Packet forwarded = packet;
+        forwarded.header.ID = route.translate(packet.header.ID);
+        forwarded.header.SrcID = id;
+        forwarded.header.enqueueTime = 0;
+        forwarded.header.routeTime = 0;
+        if (target.sendPacket(forwarded) == ErrorCode::SUCCESS)
+            framesForwarded.add();
+        else
+            framesDropped.add();
+        return;
+    }
+}
+
+// Leaves both buses
+void BusGateway::stop()
+{
+    source.closeConnection();
+    target.closeConnection();
+    started = false;
+}
+
+// Frames sent on the target bus
+uint64_t BusGateway::getForwarded()
+{
+    return framesForwarded.value();
+}
+
+// Frames that matched a route but could not be sent on the target bus
+uint64_t BusGateway::getDropped()
+{
+    return framesDropped.value();
+}
+
+// Destructor
+BusGateway::~BusGateway()
+{
+    stop();
+}
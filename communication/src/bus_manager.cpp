@@ -1,76 +1,206 @@
-#include "../include/bus_manager.h"
-
-BusManager* BusManager::instance = nullptr;
-std::mutex BusManager::managerMutex;
-
-//Private constructor
-BusManager::BusManager(std::vector<uint32_t> idShouldConnect, uint32_t limit) :server(8080, std::bind(&BusManager::receiveData, this, std::placeholders::_1))//,syncCommunication(idShouldConnect, limit)
-{
-    // Setup the signal handler for SIGINT
-    signal(SIGINT, BusManager::signalHandler);
-}
-
-// Static function to return a singleton instance
-BusManager* BusManager::getInstance(std::vector<uint32_t> idShouldConnect, uint32_t limit) {
-    if (instance == nullptr) {
-        // Lock the mutex to prevent multiple threads from creating instances simultaneously
-        std::lock_guard<std::mutex> lock(managerMutex);
-        if (instance == nullptr) {
-            instance = new BusManager(idShouldConnect, limit);
-        }
-    }
-    return instance;
-}
-
-// Sends to the server to listen for requests
-ErrorCode BusManager::startConnection()
-{
-    
-    ErrorCode isConnected = server.startConnection();
-    //syncCommunication.notifyProcess()
-    return isConnected;
-}
-
-// Receives the packet that arrived and checks it before sending it out
-void BusManager::receiveData(Packet &p)
-{
-    ErrorCode res = sendToClients(p);
-
-    // Checking the case of collision and priority in functions : checkCollision,packetPriority
-    // Packet* resolvedPacket = checkCollision(*p);
-    // if (resolvedPacket)
-    //     server.sendToClients(*resolvedPacket);
-}
-
-// Sending according to broadcast variable
-ErrorCode BusManager::sendToClients(const Packet &packet)
-{
-    if(packet.header.isBroadcast)
-        return server.sendBroadcast(packet);
-    return server.sendDestination(packet);
-}
-
-// Implement according to the conflict management of the CAN bus protocol
-Packet BusManager::checkCollision(Packet &currentPacket)
-{
-    return currentPacket;
-}
-
-// Implement a priority check according to the CAN bus
-Packet BusManager::packetPriority(Packet &a, Packet &b)
-{
-    return (a.header.SrcID < b.header.SrcID) ? a : b;
-}
-
-// Static method to handle SIGINT signal
-void BusManager::signalHandler(int signum)
-{
-    if (instance) {
-        instance->server.stopServer();  // Call the stopServer method
-    }
-    exit(signum);
-}
-
-BusManager::~BusManager() {
-    instance = nullptr;
-}
+#include "../include/bus_manager.h"
+
+BusManager* BusManager::instance = nullptr;
+std::mutex BusManager::managerMutex;
+
+// Constructor - a bus of its own on the port, for processes that run several buses
+BusManager::BusManager(std::vector<uint32_t> idShouldConnect, uint32_t limit, int port) :server(port, std::bind(&BusManager::receiveData, this, std::placeholders::_1)),
+    arbiter([this](const Packet &packet) { sendToClients(packet); }, BUS_BITRATE), tracing(BUS_TRACE_PACKETS), metricsFile(BUS_METRICS_FILE), capturing(false)//,syncCommunication(idShouldConnect, limit)
+{
+    // A fixed pool of event loops instead of a thread for every process
+    server.setServerMode(ServerMode::REACTOR, BUS_EVENT_LOOPS);
+    server.setSlowConsumerPolicy(BUS_SLOW_CONSUMER_POLICY);
+
+    // A process may only have as many packets waiting for the bus as its credits allow
+    server.setDeferredCredits(true);
+
+    server.setAllowedIDs(idShouldConnect);
+    server.setClientLimit(limit);
+
+    registerMetrics();
+}
+
+// Static function to return a singleton instance
+BusManager* BusManager::getInstance(std::vector<uint32_t> idShouldConnect, uint32_t limit, int port) {
+    if (instance == nullptr) {
+        // Lock the mutex to prevent multiple threads from creating instances simultaneously
+        std::lock_guard<std::mutex> lock(managerMutex);
+        if (instance == nullptr) {
+            instance = new BusManager(idShouldConnect, limit, port);
+        }
+    }
+    return instance;
+}
+
+// Sends to the server to listen for requests
+ErrorCode BusManager::startConnection()
+{
+    
+    arbiter.start();
+    ErrorCode isConnected = server.startConnection();
+    if (isConnected == ErrorCode::SUCCESS && !metricsFile.empty())
+        metrics.startFileExport(metricsFile);
+    //syncCommunication.notifyProcess()
+    return isConnected;
+}
+
+// Receives the packet that arrived and checks it before sending it out
+void BusManager::receiveData(Packet &p)
+{
+    // Kept for the routing latency, sent on only when tracing
+    p.header.enqueueTime = monotonicNanoseconds();
+
+    // Waits for the bus, collisions are resolved by the arbiter according to packetPriority
+    arbiter.submit(checkCollision(p));
+}
+
+// Sending according to broadcast variable
+ErrorCode BusManager::sendToClients(const Packet &packet)
+{
+    // The packet left the arbiter, its sender may send another one
+    server.returnCredits(packet.header.SrcID);
+
+    Packet routed = packet;
+    int64_t now = monotonicNanoseconds();
+    routingLatency.record(now - packet.header.enqueueTime);
+    if (tracing.load(std::memory_order_relaxed))
+        routed.header.routeTime = now;
+    else
+        routed.header.enqueueTime = 0;
+
+    if (capturing.load(std::memory_order_relaxed))
+        capturePacket(now, routed);
+
+    ErrorCode result = routed.header.isBroadcast ? server.sendBroadcast(routed) : server.sendDestination(routed);
+    if (result != ErrorCode::SUCCESS) {
+        routeErrors.add(-(int)result);
+        return result;
+    }
+
+    packetsRouted.add();
+    bytesRouted.add(packet.header.DLC);
+    packetsByID.add(packet.header.ID);
+    return result;
+}
+
+// Implement according to the conflict management of the CAN bus protocol
+Packet BusManager::checkCollision(Packet &currentPacket)
+{
+    // Frames that are sent together are queued by the arbiter and go out one by one in priority order
+    return currentPacket;
+}
+
+// Implement a priority check according to the CAN bus
+Packet BusManager::packetPriority(Packet &a, Packet &b)
+{
+    return CanArbiter::hasPriority(a, b) ? a : b;
+}
+
+// Sets the simulated bus speed in bits per second, 0 disables the arbitration
+void BusManager::setBitrate(uint32_t bitrate)
+{
+    arbiter.setBitrate(bitrate);
+}
+
+// Per message ID latency since the start
+std::unordered_map<uint32_t, CanIdStatistics> BusManager::getStatistics()
+{
+    return arbiter.getStatistics();
+}
+
+// Fraction of the time the simulated bus was busy
+double BusManager::getBusLoad()
+{
+    return arbiter.getBusLoad();
+}
+
+// Turns the per hop timestamps of the packets on or off
+void BusManager::setTracing(bool enabled)
+{
+    tracing.store(enabled);
+}
+
+// Sets the file the metrics are exported to once the bus starts, empty to disable
+void BusManager::setMetricsFile(const std::string &fileName)
+{
+    metricsFile = fileName;
+}
+
+// The metrics of the bus in the Prometheus text format
+std::string BusManager::getMetrics()
+{
+    return metrics.exportText();
+}
+
+// Records every packet routed from now on to the file with the time it was routed, replacing a running capture
+bool BusManager::startCapture(const std::string &fileName)
+{
+    std::unique_ptr<CaptureWriter> writer;
+    try {
+        writer.reset(new CaptureWriter(fileName));
+    } catch (const std::runtime_error &error) {
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, error.what());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(captureMutex);
+    if (capture)
+        capture->close();
+    capture = std::move(writer);
+    capturing = true;
+    return true;
+}
+
+// Ends the capture and writes what is left, returns false if any packet could not be written
+bool BusManager::stopCapture()
+{
+    std::lock_guard<std::mutex> lock(captureMutex);
+    capturing = false;
+    if (!capture)
+        return true;
+
+    bool written = capture->close();
+    capture.reset();
+    return written;
+}
+
+// Adds a routed packet to the capture
+void BusManager::capturePacket(int64_t time, const Packet &packet)
+{
+    // The arbiter thread routes alone when the bus is arbitrated, without a bitrate every event loop routes and
+    // the lock keeps their records from mixing
+    std::lock_guard<std::mutex> lock(captureMutex);
+    if (capture && capture->write(time, packet))
+        packetsCaptured.add();
+}
+
+// Adds the metrics of the bus and of its server to the registry
+void BusManager::registerMetrics()
+{
+    metrics.addCounter("vcs_bus_packets_routed_total", "Packets handed to their destinations.", packetsRouted);
+    metrics.addCounter("vcs_bus_bytes_routed_total", "Payload bytes handed to their destinations.", bytesRouted);
+    metrics.addCounter("vcs_bus_packets_by_id_total", "Packets routed, by message ID.", packetsByID, "id");
+    metrics.addCounter("vcs_bus_route_errors_total", "Packets that could not be routed, by error.", routeErrors, "error",
+                       [](uint32_t code) { return std::string(toString((ErrorCode)-(int)code)); });
+    metrics.addCounter("vcs_bus_packets_captured_total", "Packets written to the capture file.", packetsCaptured);
+    metrics.addSummary("vcs_bus_routing_latency_seconds", "Time from reading a packet until routing it, including arbitration.",
+                       routingLatency);
+    metrics.addGauge("vcs_bus_pending_frames", "Frames waiting for the simulated bus.", [this]() {
+        return MetricsRegistry::Samples{{"", (double)arbiter.pendingFrames()}};
+    });
+    metrics.addGauge("vcs_bus_load", "Fraction of the time the simulated bus was busy.", [this]() {
+        return MetricsRegistry::Samples{{"", getBusLoad()}};
+    });
+    server.registerMetrics(metrics);
+}
+
+BusManager::~BusManager() {
+    metrics.stopFileExport();
+
+    // The server stops handing packets to the arbiter before the arbiter is stopped
+    server.stopServer();
+    arbiter.stop();
+    stopCapture();
+    if (instance == this)
+        instance = nullptr;
+}
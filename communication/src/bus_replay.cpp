@@ -0,0 +1,166 @@
+#include <stdexcept>
+#include "../include/bus_replay.h"
+#include "../include/latency_tracer.h"
+
+// Constructor - replays the capture into the bus on the port, throws std::runtime_error if it is not a capture
+BusReplayer::BusReplayer(const std::string &fileName, int port)
+    : fileName(fileName), port(port), speed(1.0), stopping(false)
+{
+    if (port <= 0 || port > 65535)
+        throw std::invalid_argument("Invalid port number: Port must be between 1 and 65535.");
+
+    // Opened once here so that a wrong file is reported before anything joins the bus
+    CaptureReader check(fileName);
+}
+
+// Sets the pace: 1 replays at the recorded pace, N at N times that, REPLAY_AS_FAST_AS_POSSIBLE without waiting
+void BusReplayer::setSpeed(double speed)
+{
+    if (!(speed >= 0))
+        throw std::invalid_argument("Invalid replay speed: speed cannot be negative.");
+
+    std::lock_guard<std::mutex> lock(replayMutex);
+    if (!sources.empty())
+        throw std::logic_error("The speed cannot be changed while the replay is running.");
+    this->speed = speed;
+}
+
+// Leaves out the packets of a source, for a process that runs live next to the replay
+void BusReplayer::skipSource(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(replayMutex);
+    skippedSources.insert(id);
+}
+
+// Joins the bus as every source of the capture that is not skipped
+ErrorCode BusReplayer::joinSources()
+{
+    std::set<uint32_t> ids;
+    CaptureReader reader(fileName);
+    CapturedPacket record;
+    while (reader.next(record))
+        if (!skippedSources.count(record.packet.header.SrcID))
+            ids.insert(record.packet.header.SrcID);
+
+    std::lock_guard<std::mutex> lock(replayMutex);
+    for (uint32_t id : ids) {
+        if (stopping)
+            return ErrorCode::CONNECTION_FAILED;
+
+        // The replayed sources only send, the bus keeps its broadcasts away from them as from a gateway
+        std::unique_ptr<ClientConnection> source(new ClientConnection([](Packet &) {}));
+        source->setPort(port);
+        source->addFilter({UINT32_MAX, UINT32_MAX});
+        ErrorCode res = source->connectToServer(id);
+        if (res != ErrorCode::SUCCESS) {
+            RealSocket::log.logMessage(logger::LogLevel::ERROR, "replay could not join the bus as " + std::to_string(id));
+            return res;
+        }
+        sources[id] = std::move(source);
+    }
+
+    return ErrorCode::SUCCESS;
+}
+
+// Sleeps until the time, returns false if the replay was stopped meanwhile
+bool BusReplayer::waitUntil(std::chrono::steady_clock::time_point time)
+{
+    std::unique_lock<std::mutex> lock(replayMutex);
+    return !stopRequested.wait_until(lock, time, [this]() { return stopping; });
+}
+
+// Leaves the bus as every source
+void BusReplayer::leaveSources()
+{
+    std::lock_guard<std::mutex> lock(replayMutex);
+    for (auto &source : sources)
+        source.second->closeConnection();
+    sources.clear();
+}
+
+// Replays the capture and leaves the bus, blocks until the end of the capture or stop
+ErrorCode BusReplayer::run()
+{
+    {
+        std::lock_guard<std::mutex> lock(replayMutex);
+        if (!sources.empty())
+            throw std::logic_error("The replay is already running.");
+    }
+
+    ErrorCode res = joinSources();
+    if (res != ErrorCode::SUCCESS) {
+        leaveSources();
+        return res;
+    }
+
+    CaptureReader reader(fileName);
+    CapturedPacket record;
+    int64_t firstTime = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool first = true;
+    while (reader.next(record)) {
+        auto source = sources.find(record.packet.header.SrcID);
+        if (source == sources.end())
+            continue;
+
+        if (first) {
+            firstTime = record.time;
+            first = false;
+        }
+
+        // The gaps between the packets are kept, divided by the speed
+        std::chrono::nanoseconds offset(0);
+        if (speed > 0)
+            offset = std::chrono::nanoseconds((int64_t)((record.time - firstTime) / speed));
+        if (!waitUntil(start + offset))
+            break;
+
+        // Sent as new packets, the bus traces them from now on
+        Packet &packet = record.packet;
+        packet.header.timestamp = monotonicNanoseconds();
+        packet.header.enqueueTime = 0;
+        packet.header.routeTime = 0;
+        if (source->second->sendPacket(packet) == ErrorCode::SUCCESS)
+            packetsReplayed.add();
+        else
+            packetsFailed.add();
+    }
+
+    leaveSources();
+    if (reader.isCorrupted()) {
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "the capture " + fileName + " ends in a damaged record");
+        return ErrorCode::INVALID_DATA;
+    }
+    return ErrorCode::SUCCESS;
+}
+
+// Ends the replay, may be called from any thread
+void BusReplayer::stop()
+{
+    std::lock_guard<std::mutex> lock(replayMutex);
+    stopping = true;
+    stopRequested.notify_all();
+
+    // Wakes a send that waits for credits
+    for (auto &source : sources)
+        source.second->closeConnection();
+}
+
+// Packets sent to the bus
+uint64_t BusReplayer::getReplayed()
+{
+    return packetsReplayed.value();
+}
+
+// Packets that could not be sent to the bus
+uint64_t BusReplayer::getFailed()
+{
+    return packetsFailed.value();
+}
+
+// Destructor
+BusReplayer::~BusReplayer()
+{
+    stop();
+    leaveSources();
+}
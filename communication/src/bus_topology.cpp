@@ -0,0 +1,197 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "../include/bus_topology.h"
+
+// Reads a number in decimal or, with a 0x prefix, in hexadecimal
+static uint32_t parseNumber(const std::string &text)
+{
+    size_t used = 0;
+    unsigned long value = std::stoul(text, &used, 0);
+    if (used != text.size() || value > UINT32_MAX)
+        throw std::invalid_argument("invalid number " + text);
+
+    return (uint32_t)value;
+}
+
+// Reads a port number
+static int parsePort(const std::string &text)
+{
+    uint32_t port = parseNumber(text);
+    if (port == 0 || port > 65535)
+        throw std::invalid_argument("invalid port " + text);
+
+    return (int)port;
+}
+
+// The port of a bus named in this topology, or the number itself for a bus of another process
+int BusTopology::resolvePort(const std::string &bus) const
+{
+    for (const BusConfig &config : buses)
+        if (config.name == bus)
+            return config.port;
+
+    if (bus.empty() || bus.find_first_not_of("0123456789") != std::string::npos)
+        throw std::invalid_argument("unknown bus " + bus);
+
+    return parsePort(bus);
+}
+
+// Reads a topology, throws std::invalid_argument naming the line of an invalid entry
+BusTopology BusTopology::parse(std::istream &input)
+{
+    BusTopology topology;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(input, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string kind;
+        if (!(fields >> kind))
+            continue;
+
+        try {
+            if (kind == "bus") {
+                BusConfig bus{"", 0, BUS_BITRATE, {}, 0, ""};
+                std::string port;
+                if (!(fields >> bus.name >> port))
+                    throw std::invalid_argument("expected bus <name> <port>");
+                bus.port = parsePort(port);
+                for (const BusConfig &other : topology.buses)
+                    if (other.name == bus.name || other.port == bus.port)
+                        throw std::invalid_argument("bus " + bus.name + " repeats the name or port of bus " + other.name);
+
+                std::string option;
+                while (fields >> option) {
+                    size_t equals = option.find('=');
+                    std::string key = option.substr(0, equals);
+                    std::string value = equals == std::string::npos ? "" : option.substr(equals + 1);
+                    if (key == "bitrate")
+                        bus.bitrate = parseNumber(value);
+                    else if (key == "limit")
+                        bus.limit = parseNumber(value);
+                    else if (key == "capture") {
+                        if (value.empty())
+                            throw std::invalid_argument("capture needs a file");
+                        bus.capture = value;
+                    } else if (key == "ids") {
+                        std::istringstream ids(value);
+                        std::string id;
+                        while (std::getline(ids, id, ','))
+                            bus.ids.push_back(parseNumber(id));
+                    } else
+                        throw std::invalid_argument("unknown option " + option);
+                }
+                topology.buses.push_back(bus);
+            } else if (kind == "gateway") {
+                std::string id, from, to;
+                if (!(fields >> id >> from >> to))
+                    throw std::invalid_argument("expected gateway <id> <source bus> <target bus>");
+                GatewayConfig gateway{parseNumber(id), topology.resolvePort(from), topology.resolvePort(to), {}};
+                if (gateway.sourcePort == gateway.targetPort)
+                    throw std::invalid_argument("a gateway needs two different buses");
+                topology.gateways.push_back(gateway);
+            } else if (kind == "route") {
+                std::string id, mask, translated;
+                if (!(fields >> id >> mask >> translated))
+                    throw std::invalid_argument("expected route <id> <mask> <translated id>");
+                if (topology.gateways.empty())
+                    throw std::invalid_argument("a route must follow its gateway");
+                topology.gateways.back().routes.push_back({parseNumber(id), parseNumber(mask), parseNumber(translated)});
+            } else
+                throw std::invalid_argument("unknown entry " + kind);
+
+            std::string extra;
+            if (kind != "bus" && fields >> extra)
+                throw std::invalid_argument("unexpected " + extra);
+        } catch (const std::invalid_argument &error) {
+            throw std::invalid_argument("Invalid bus topology, line " + std::to_string(lineNumber) + ": " + error.what());
+        } catch (const std::out_of_range &) {
+            throw std::invalid_argument("Invalid bus topology, line " + std::to_string(lineNumber) + ": number out of range");
+        }
+    }
+
+    for (const GatewayConfig &gateway : topology.gateways)
+        if (gateway.routes.empty())
+            throw std::invalid_argument("Invalid bus topology: gateway " + std::to_string(gateway.id) + " has no routes");
+
+    return topology;
+}
+
+// Reads a topology from a file, throws std::invalid_argument if it cannot be read or is invalid
+BusTopology BusTopology::load(const std::string &fileName)
+{
+    std::ifstream file(fileName);
+    if (!file)
+        throw std::invalid_argument("Cannot read the bus topology " + fileName);
+
+    return parse(file);
+}
+
+// Starts the buses and then the gateways between them, stops whatever started if one fails
+ErrorCode BusTopology::start()
+{
+    for (const BusConfig &config : buses) {
+        std::unique_ptr<BusManager> manager(new BusManager(config.ids, config.limit, config.port));
+        manager->setBitrate(config.bitrate);
+
+        // Every bus of the process exports its own metrics file
+        if (buses.size() > 1 && std::string(BUS_METRICS_FILE) != "")
+            manager->setMetricsFile("bus_metrics_" + config.name + ".prom");
+
+        if (!config.capture.empty() && !manager->startCapture(config.capture)) {
+            stop();
+            return ErrorCode::INVALID_DATA;
+        }
+
+        ErrorCode res = manager->startConnection();
+        if (res != ErrorCode::SUCCESS) {
+            stop();
+            return res;
+        }
+        managers.push_back(std::move(manager));
+    }
+
+    for (const GatewayConfig &config : gateways) {
+        std::unique_ptr<BusGateway> gateway(new BusGateway(config.id, config.sourcePort, config.targetPort));
+        for (const GatewayRoute &route : config.routes)
+            gateway->addRoute(route);
+
+        ErrorCode res = gateway->start();
+        if (res != ErrorCode::SUCCESS) {
+            stop();
+            return res;
+        }
+        links.push_back(std::move(gateway));
+    }
+
+    return ErrorCode::SUCCESS;
+}
+
+// Stops the gateways and then the buses
+void BusTopology::stop()
+{
+    links.clear();
+    managers.clear();
+}
+
+const std::vector<BusConfig> &BusTopology::getBuses() const
+{
+    return buses;
+}
+
+const std::vector<GatewayConfig> &BusTopology::getGateways() const
+{
+    return gateways;
+}
+
+// The running bus with the name, or null
+BusManager *BusTopology::getBus(const std::string &name)
+{
+    for (size_t i = 0; i < managers.size(); ++i)
+        if (buses[i].name == name)
+            return managers[i].get();
+
+    return nullptr;
+}
@@ -0,0 +1,176 @@
+#include <stdexcept>
+#include <algorithm>
+#include "../include/can_arbiter.h"
+
+// Constructor
+CanArbiter::CanArbiter(std::function<void(const Packet &)> dispatch, uint32_t bitrate)
+    : dispatch(dispatch), bitrate(bitrate), nextSequence(0), running(false), busyTime(0),
+      startTime(std::chrono::steady_clock::now())
+{
+    if (!dispatch)
+        throw std::invalid_argument("Invalid callback function: dispatch cannot be null.");
+}
+
+// Starts the bus thread
+void CanArbiter::start()
+{
+    if (running)
+        return;
+
+    startTime = std::chrono::steady_clock::now();
+    running = true;
+    busThread = std::thread(&CanArbiter::run, this);
+}
+
+// Stops the bus thread, frames still pending are discarded
+void CanArbiter::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (!running)
+            return;
+        running = false;
+    }
+    frameSubmitted.notify_all();
+
+    if (busThread.joinable())
+        busThread.join();
+
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    pending = decltype(pending)();
+}
+
+// Queues a frame for the next arbitration, or forwards it at once if the simulation is disabled
+void CanArbiter::submit(const Packet &packet)
+{
+    if (!bitrate || !running) {
+        dispatch(packet);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pending.push({packet, nextSequence++, std::chrono::steady_clock::now()});
+    }
+    frameSubmitted.notify_one();
+}
+
+// Arbitrates and transmits frames until the arbiter is stopped
+void CanArbiter::run()
+{
+    std::chrono::steady_clock::time_point busFreeAt = std::chrono::steady_clock::now();
+    while (true) {
+        PendingFrame frame;
+        {
+            // Everything submitted while the previous frame held the bus competes in this slot
+            std::unique_lock<std::mutex> lock(pendingMutex);
+            frameSubmitted.wait(lock, [this]() { return !running || !pending.empty(); });
+            if (!running)
+                return;
+
+            frame = pending.top();
+            pending.pop();
+        }
+
+        std::chrono::nanoseconds duration(0);
+        uint32_t rate = bitrate;
+        if (rate) {
+            duration = frameDuration(frame.packet, rate);
+            busFreeAt = std::max(busFreeAt, std::chrono::steady_clock::now()) + duration;
+
+            // Scheduled against the bus clock, so oversleeping one frame does not lower the throughput
+            std::this_thread::sleep_until(busFreeAt);
+        }
+
+        record(frame, duration);
+        dispatch(frame.packet);
+    }
+}
+
+// Records the delivery of a frame
+void CanArbiter::record(const PendingFrame &frame, std::chrono::nanoseconds duration)
+{
+    std::chrono::nanoseconds latency = std::chrono::steady_clock::now() - frame.submitted;
+
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    CanIdStatistics &idStatistics = statistics[frame.packet.header.ID];
+    idStatistics.frames++;
+    idStatistics.totalLatency += latency;
+    idStatistics.maxLatency = std::max(idStatistics.maxLatency, latency);
+    busyTime += duration;
+}
+
+// Orders the queue so that its top is the winner of the next arbitration
+bool CanArbiter::LosesArbitration::operator()(const PendingFrame &a, const PendingFrame &b) const
+{
+    if (hasPriority(b.packet, a.packet))
+        return true;
+    if (hasPriority(a.packet, b.packet))
+        return false;
+
+    // Equal identifiers keep the order of submission
+    return a.sequence > b.sequence;
+}
+
+// True if a wins the arbitration against b
+bool CanArbiter::hasPriority(const Packet &a, const Packet &b)
+{
+    // The lowest ID has the most leading dominant bits,
+    // on a real bus two nodes sending the same ID collide, here the lower source wins
+    if (a.header.ID != b.header.ID)
+        return a.header.ID < b.header.ID;
+
+    return a.header.SrcID < b.header.SrcID;
+}
+
+// Time the frame holds the bus, with worst-case bit stuffing
+std::chrono::nanoseconds CanArbiter::frameDuration(const Packet &packet, uint32_t bitrate)
+{
+    // A stuff bit can follow every 4 bits of the 34 header bits and the payload
+    uint64_t payloadBits = 8 * packet.header.DLC;
+    uint64_t stuffBits = (34 + payloadBits - 1) / 4;
+    uint64_t bits = CAN_FRAME_OVERHEAD_BITS + payloadBits + stuffBits;
+    return std::chrono::nanoseconds(bits * 1000000000ull / bitrate);
+}
+
+// Sets the bitrate in bits per second, 0 disables the simulation
+void CanArbiter::setBitrate(uint32_t bitrate)
+{
+    this->bitrate = bitrate;
+}
+
+uint32_t CanArbiter::getBitrate()
+{
+    return bitrate;
+}
+
+// Number of frames waiting for the bus
+size_t CanArbiter::pendingFrames()
+{
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    return pending.size();
+}
+
+// Per message ID statistics since the start
+std::unordered_map<uint32_t, CanIdStatistics> CanArbiter::getStatistics()
+{
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    return statistics;
+}
+
+// Fraction of the time since the start during which the bus was busy
+double CanArbiter::getBusLoad()
+{
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - startTime;
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    if (elapsed.count() <= 0)
+        return 0;
+
+    return std::min(1.0, (double)busyTime.count() / elapsed.count());
+}
+
+// Destructor
+CanArbiter::~CanArbiter()
+{
+    stop();
+}
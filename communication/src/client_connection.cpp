@@ -1,127 +1,518 @@
-#include "../include/client_connection.h"
-
-// Constructor
-ClientConnection::ClientConnection(std::function<void(Packet &)> callback, ISocket* socketInterface): connected(false){
-        setCallback(callback);
-        setSocketInterface(socketInterface);
-}
-
-// Requesting a connection to the server
-ErrorCode ClientConnection::connectToServer(int id)
-{
-    clientSocket = socketInterface->socket(AF_INET, SOCK_STREAM, 0);
-    if (clientSocket < 0) {
-        return ErrorCode::SOCKET_FAILED;
-    }
-
-    servAddress.sin_family = AF_INET;
-    servAddress.sin_port = htons(PORT);
-    inet_pton(AF_INET, IP, &servAddress.sin_addr);
-
-    int connectRes = socketInterface->connect(clientSocket, (struct sockaddr *)&servAddress, sizeof(servAddress));
-    if (connectRes < 0) {
-        socketInterface->close(clientSocket);
-        return ErrorCode::CONNECTION_FAILED;
-    }
-
-    Packet packet(id);
-    ssize_t bytesSent = socketInterface->send(clientSocket, &packet, sizeof(Packet), 0);
-    if (bytesSent < sizeof(Packet)) {
-        socketInterface->close(clientSocket);
-        return ErrorCode::SEND_FAILED;
-    }
-    
-    connected = true;
-    receiveThread = std::thread(&ClientConnection::receivePacket, this);
-    receiveThread.detach();
-
-    return ErrorCode::SUCCESS;
-}
-
-// Sends the packet to the manager-sync
-ErrorCode ClientConnection::sendPacket(Packet &packet)
-{
-    //If send executed before start
-    if (!connected)
-        return ErrorCode::CONNECTION_FAILED;
-        
-    ssize_t bytesSent = socketInterface->send(clientSocket, &packet, sizeof(Packet), 0);
-    if (bytesSent==0) {
-        closeConnection();
-        return ErrorCode::CONNECTION_FAILED;
-    }
-        
-    if (bytesSent<0)
-        return ErrorCode::SEND_FAILED;
-        
-    return ErrorCode::SUCCESS;
-}
-
-// Waits for a message and forwards it to Communication
-void ClientConnection::receivePacket()
-{
-    while (connected) {
-        Packet packet;
-        int valread = socketInterface->recv(clientSocket, &packet, sizeof(Packet), 0);
-        if (valread==0)
-            break;
-
-        if (valread<0)
-            continue;
-
-        passPacketCom(packet);
-    }
-
-    closeConnection();
-}
-
-// Closes the connection
-ErrorCode ClientConnection::closeConnection()
-{
-    if (connected) {
-        int socketInterfaceRes = socketInterface->close(clientSocket);
-        if(socketInterfaceRes < 0)
-            return ErrorCode::CLOSE_FAILED;
-        connected = false;
-    }
-    return ErrorCode::SUCCESS;  
-}
-
-// Setter for passPacketCom
-void ClientConnection::setCallback(std::function<void(Packet&)> callback) {
-    if (!callback)
-        throw std::invalid_argument("Callback function cannot be null");
-    
-    passPacketCom = callback;
-}
-
-// Setter for socketInterface
-void ClientConnection::setSocketInterface(ISocket* socketInterface) {
-    if (!socketInterface)
-        throw std::invalid_argument("Socket interface cannot be null");
-    
-    this->socketInterface = socketInterface;
-}
-
-// For testing
-int ClientConnection::getClientSocket()
-{
-    return clientSocket;
-}
-
-int ClientConnection::isConnected()
-{
-    return connected;
-}
-
-bool ClientConnection::isReceiveThreadRunning()
-{
-    return false;
-}
-
-//Destructor
-ClientConnection::~ClientConnection()
-{
-    closeConnection();
-    delete socketInterface;
+#include <cerrno>
+#include <algorithm>
+#include <random>
+#include <sys/eventfd.h>
+#include "../include/client_connection.h"
+
+// Constructor
+ClientConnection::ClientConnection(std::function<void(Packet &)> callback, ISocket* socketInterface)
+    : clientSocket(-1), epollFd(-1), wakeFd(-1), clientID(0), connected(false), stopping(false), supervising(false), reconnects(0),
+      heardFromBus(false), credits(0)
+{
+        setCallback(callback);
+        setSocketInterface(socketInterface);
+        setPort(portFromEnvironment());
+}
+
+// Requesting a connection to the server, a connection lost afterwards is restored in the background
+ErrorCode ClientConnection::connectToServer(int id)
+{
+    clientID = id;
+    stopping = false;
+    if (wakeFd < 0)
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    else {
+        uint64_t counter;
+        ssize_t drained = read(wakeFd, &counter, sizeof(counter));
+        (void)drained;
+    }
+
+    ErrorCode res = openConnection();
+    if (res != ErrorCode::SUCCESS)
+        return res;
+
+    // The thread of a connection that was closed before has already returned
+    if (receiveThread.joinable())
+        receiveThread.join();
+    supervising = true;
+    receiveThread = std::thread(&ClientConnection::superviseConnection, this);
+
+    return ErrorCode::SUCCESS;
+}
+
+// Opens the socket and registers the ID at the bus
+ErrorCode ClientConnection::openConnection()
+{
+    int newSocket = socketInterface->socket(AF_INET, SOCK_STREAM, 0);
+    if (newSocket < 0) {
+        return ErrorCode::SOCKET_FAILED;
+    }
+
+    servAddress.sin_family = AF_INET;
+    servAddress.sin_port = htons(port);
+    inet_pton(AF_INET, IP, &servAddress.sin_addr);
+
+    int connectRes = socketInterface->connect(newSocket, (struct sockaddr *)&servAddress, sizeof(servAddress));
+    if (connectRes < 0) {
+        socketInterface->close(newSocket);
+        return ErrorCode::CONNECTION_FAILED;
+    }
+
+    // The receive thread waits for the socket and the close request together, with a timeout for the heartbeats
+    int newEpoll = socketInterface->epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = newSocket;
+    bool polled = newEpoll >= 0 && socketInterface->epoll_ctl(newEpoll, EPOLL_CTL_ADD, newSocket, &event) == 0;
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    if (!polled || (wakeFd >= 0 && socketInterface->epoll_ctl(newEpoll, EPOLL_CTL_ADD, wakeFd, &event) < 0)) {
+        if (newEpoll >= 0)
+            socketInterface->close(newEpoll);
+        socketInterface->close(newSocket);
+        return ErrorCode::SOCKET_FAILED;
+    }
+
+    // Credits are granted per connection, the sends wait for the grant of the new one.
+    // Reset before the registration, whose answer may be read as soon as it is sent
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        credits = 0;
+    }
+    receiveBuffer = ReceiveBuffer();
+    heardFromBus = false;
+
+    // The first packet registers the ID, HELLO also asks the bus for heartbeats and credits
+    Packet packet(clientID);
+    packet.header.control = ControlType::HELLO;
+    uint8_t buffer[WIRE_MAX_FRAME_SIZE];
+    size_t length = encodeFrame(packet, buffer, sizeof(buffer));
+    ssize_t bytesSent = socketInterface->send(newSocket, buffer, length, 0);
+    if (bytesSent < (ssize_t)length) {
+        socketInterface->close(newEpoll);
+        socketInterface->close(newSocket);
+        return ErrorCode::SEND_FAILED;
+    }
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+    clientSocket = newSocket;
+    epollFd = newEpoll;
+
+    // Under the send lock, a filter added meanwhile is sent either here or by addFilter
+    std::vector<AcceptanceFilter> current;
+    {
+        std::lock_guard<std::mutex> stateLock(stateMutex);
+        current = filters;
+    }
+    for (const AcceptanceFilter &filter : current)
+        if (sendControl(FilterTable::encodeFilter(clientID, filter)) != ErrorCode::SUCCESS) {
+            socketInterface->close(newEpoll);
+            socketInterface->close(newSocket);
+            clientSocket = -1;
+            epollFd = -1;
+            return ErrorCode::SEND_FAILED;
+        }
+    connected = true;
+
+    return ErrorCode::SUCCESS;
+}
+
+// Closes a lost connection, the supervisor opens a new one
+void ClientConnection::dropConnection()
+{
+    // A writer blocked on the socket fails at once, the descriptor is closed under the send lock
+    // so that no writer uses it after it was reused
+    socketInterface->shutdown(clientSocket, SHUT_RDWR);
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        if (!connected)
+            return;
+        connected = false;
+        socketInterface->close(epollFd);
+        socketInterface->close(clientSocket);
+    }
+
+    // Senders waiting for credits give up
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+    }
+    stateChanged.notify_all();
+}
+
+// Keeps the connection alive until closeConnection, reconnecting with backoff when it is lost
+void ClientConnection::superviseConnection()
+{
+    int delayMs = RECONNECT_INITIAL_DELAY_MS;
+    std::minstd_rand random(clientID + 1);
+    while (!stopping) {
+        receivePacket();
+        if (stopping)
+            break;
+
+        dropConnection();
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "process", "server", "connection of " + std::to_string(clientID) + " lost, reconnecting");
+
+        // The backoff starts over only if the bus answered on the last connection, a bus that accepts and drops does not reset it
+        if (heardFromBus)
+            delayMs = RECONNECT_INITIAL_DELAY_MS;
+
+        bool reconnected = false;
+        while (!reconnected) {
+            int jitteredMs = delayMs / 2 + random() % (delayMs / 2 + 1);
+            if (!waitBeforeReconnect(jitteredMs))
+                break;
+            delayMs = std::min(delayMs * 2, RECONNECT_MAX_DELAY_MS);
+            reconnected = openConnection() == ErrorCode::SUCCESS;
+        }
+
+        if (reconnected) {
+            reconnects++;
+            RealSocket::log.logMessage(logger::LogLevel::INFO, "process", "server", "connection of " + std::to_string(clientID) + " restored");
+        }
+    }
+
+    supervising = false;
+}
+
+// Waits for the backoff delay, returns false if the connection was closed meanwhile
+bool ClientConnection::waitBeforeReconnect(int delayMs)
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    return !stateChanged.wait_for(lock, std::chrono::milliseconds(delayMs), [this]() { return stopping.load(); });
+}
+
+// Sends the packet to the manager-sync
+ErrorCode ClientConnection::sendPacket(Packet &packet)
+{
+    return sendFrames(&packet, 1);
+}
+
+// Sends all the packets of a message with a single write, or several when the bus limits the packets in flight
+ErrorCode ClientConnection::sendPackets(std::vector<Packet> &packets)
+{
+    return sendFrames(packets.data(), packets.size());
+}
+
+// Sends the packets in as many writes as the credits allow
+ErrorCode ClientConnection::sendFrames(const Packet *packets, size_t count)
+{
+    //If send executed before start
+    if (!connected)
+        return ErrorCode::CONNECTION_FAILED;
+
+    // Checked before taking credits, which would be lost with a packet that cannot be sent
+    for (size_t i = 0; i < count; ++i)
+        if (packets[i].header.DLC > SIZE_PACKET)
+            return ErrorCode::INVALID_DATA_SIZE;
+
+    // Another message from this process to the same destination shares the reassembly key, so the batches of
+    // this one must follow each other. The receive thread borrows its credits and writes in a single batch, it
+    // does not wait here for a sender that waits for the credits only the receive thread reads
+    std::unique_lock<std::mutex> messageLock(messageMutex, std::defer_lock);
+    if (std::this_thread::get_id() != receiveThread.get_id())
+        messageLock.lock();
+
+    size_t sent = 0;
+    while (sent < count) {
+        size_t allowed = acquireCredits(count - sent);
+        if (!allowed)
+            return ErrorCode::CONNECTION_FAILED;
+
+        std::lock_guard<std::mutex> lock(sendMutex);
+        if (!connected)
+            return ErrorCode::CONNECTION_FAILED;
+
+        // The frames are serialized back to back into one reused buffer
+        sendBuffer.resize(allowed * WIRE_MAX_FRAME_SIZE);
+        size_t length = 0;
+        for (size_t i = sent; i < sent + allowed; ++i) {
+            size_t frameSize = encodeFrame(packets[i], sendBuffer.data() + length, sendBuffer.size() - length);
+            if (!frameSize)
+                return ErrorCode::INVALID_DATA_SIZE;
+            length += frameSize;
+        }
+
+        ErrorCode result = writeAll(sendBuffer.data(), length);
+        if (result != ErrorCode::SUCCESS)
+            return result;
+        sent += allowed;
+    }
+
+    return ErrorCode::SUCCESS;
+}
+
+// Waits until the bus lets the connection send, returns the number of packets that may go now or 0 if it was lost
+size_t ClientConnection::acquireCredits(size_t wanted)
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+
+    // A callback that sends from the receive thread cannot wait for credits only this thread reads, it borrows them
+    bool mayWait = std::this_thread::get_id() != receiveThread.get_id();
+    stateChanged.wait(lock, [&]() { return !connected || stopping || credits > 0 || !mayWait; });
+    if (!connected || stopping)
+        return 0;
+
+    size_t granted = mayWait ? std::min<int64_t>(wanted, credits) : wanted;
+    credits -= granted;
+    return granted;
+}
+
+// Writes the whole buffer, continuing after partial writes, must be called with sendMutex held
+ErrorCode ClientConnection::writeAll(const uint8_t *buffer, size_t length)
+{
+    size_t offset = 0;
+    while (offset < length) {
+        ssize_t bytesSent = socketInterface->send(clientSocket, buffer + offset, length - offset, 0);
+
+        // The receive thread sees the same connection end and reconnects
+        if (bytesSent == 0)
+            return ErrorCode::CONNECTION_FAILED;
+
+        if (bytesSent < 0) {
+            if (errno == EINTR)
+                continue;
+            return ErrorCode::SEND_FAILED;
+        }
+
+        offset += bytesSent;
+    }
+
+    return ErrorCode::SUCCESS;
+}
+
+// Sends a frame of the connection itself, must be called with sendMutex held
+ErrorCode ClientConnection::sendControl(const Packet &packet)
+{
+    uint8_t buffer[WIRE_MAX_FRAME_SIZE];
+    size_t length = encodeFrame(packet, buffer, sizeof(buffer));
+    return writeAll(buffer, length);
+}
+
+// Asks the bus to send only the broadcast frames one of the filters accepts, kept across reconnects
+ErrorCode ClientConnection::addFilter(const AcceptanceFilter &filter)
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+    {
+        std::lock_guard<std::mutex> stateLock(stateMutex);
+        filters.push_back(filter);
+    }
+
+    // Without a connection the filter goes out with the registration of the next one
+    return connected ? sendControl(FilterTable::encodeFilter(clientID, filter)) : ErrorCode::SUCCESS;
+}
+
+// Removes the filters, the bus sends every broadcast frame again
+ErrorCode ClientConnection::clearFilters()
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+    {
+        std::lock_guard<std::mutex> stateLock(stateMutex);
+        filters.clear();
+    }
+
+    Packet packet(clientID);
+    packet.header.control = ControlType::FILTER_RESET;
+    return connected ? sendControl(packet) : ErrorCode::SUCCESS;
+}
+
+// Tells the bus that the idle connection is alive, skipped if the socket is busy anyway
+ErrorCode ClientConnection::sendHeartbeat()
+{
+    Packet packet(clientID);
+    packet.header.control = ControlType::HEARTBEAT;
+    uint8_t buffer[WIRE_MAX_FRAME_SIZE];
+    size_t length = encodeFrame(packet, buffer, sizeof(buffer));
+
+    // Never waits behind a writer, the receive thread has to keep watching the connection
+    std::unique_lock<std::mutex> lock(sendMutex, std::try_to_lock);
+    if (!lock.owns_lock() || !connected)
+        return ErrorCode::SEND_FAILED;
+
+    ssize_t bytesSent = socketInterface->send(clientSocket, buffer, length, MSG_DONTWAIT);
+    if (bytesSent > 0 && bytesSent < (ssize_t)length)
+        return writeAll(buffer + bytesSent, length - bytesSent);
+
+    return bytesSent == (ssize_t)length ? ErrorCode::SUCCESS : ErrorCode::SEND_FAILED;
+}
+
+// Waits for messages and forwards them to Communication, returns when the connection is lost
+void ClientConnection::receivePacket()
+{
+    std::chrono::milliseconds heartbeatInterval(HEARTBEAT_INTERVAL_MS);
+    lastReceived = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point lastHeartbeat = lastReceived;
+
+    while (connected && !stopping) {
+        epoll_event events[2];
+        int ready = socketInterface->epoll_wait(epollFd, events, 2, HEARTBEAT_INTERVAL_MS);
+        if (ready < 0 && errno != EINTR)
+            break;
+
+        bool readable = false;
+        for (int i = 0; i < ready; ++i)
+            readable = readable || events[i].data.fd != wakeFd;
+        if (readable && !readAvailable())
+            break;
+
+        // A bus that sends nothing, not even the echo of a heartbeat, is stuck or gone
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - lastReceived >= std::chrono::milliseconds(HEARTBEAT_TIMEOUT_MS)) {
+            RealSocket::log.logMessage(logger::LogLevel::ERROR, "process", "server", "no frame from the bus for " + std::to_string(HEARTBEAT_TIMEOUT_MS) + " ms");
+            break;
+        }
+
+        // Any frame proves the bus alive, only an idle connection needs heartbeats
+        if (now - lastReceived >= heartbeatInterval && now - lastHeartbeat >= heartbeatInterval) {
+            sendHeartbeat();
+            lastHeartbeat = now;
+        }
+    }
+}
+
+// Reads everything the socket has, returns false if the connection is lost
+bool ClientConnection::readAvailable()
+{
+    while (true) {
+        // One recv may carry many packets or only part of one
+        int valread = socketInterface->recv(clientSocket, receiveBuffer.writePointer(), receiveBuffer.writableSize(), MSG_DONTWAIT);
+        if (valread == 0)
+            return false;
+
+        if (valread < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        lastReceived = std::chrono::steady_clock::now();
+        heardFromBus = true;
+        receiveBuffer.commit(valread);
+        Packet packet;
+        while (receiveBuffer.nextPacket(packet)) {
+            if (packet.header.control != ControlType::NONE) {
+                handleControl(packet);
+                continue;
+            }
+            RealSocket::logPacket(LogEvent::RECEIVE, packet);
+            passPacketCom(packet);
+        }
+
+        if (receiveBuffer.isCorrupted())
+            return false;
+    }
+}
+
+// Handles a frame of the connection itself
+void ClientConnection::handleControl(const Packet &packet)
+{
+    // The echo of a heartbeat only proves the bus alive, which its arrival already did
+    if (packet.header.control != ControlType::CREDIT)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        credits += packet.header.ID;
+    }
+    stateChanged.notify_all();
+}
+
+// Closes the connection and stops reconnecting
+ErrorCode ClientConnection::closeConnection()
+{
+    stopping = true;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+    }
+    stateChanged.notify_all();
+
+    // The receive thread wakes up and returns without reconnecting
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+    if (receiveThread.joinable() && receiveThread.get_id() != std::this_thread::get_id())
+        receiveThread.join();
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if (connected) {
+        int socketInterfaceRes = socketInterface->close(clientSocket);
+        if(socketInterfaceRes < 0)
+            return ErrorCode::CLOSE_FAILED;
+        socketInterface->close(epollFd);
+        connected = false;
+    }
+    return ErrorCode::SUCCESS;  
+}
+
+// Setter for passPacketCom
+void ClientConnection::setCallback(std::function<void(Packet&)> callback) {
+    if (!callback)
+        throw std::invalid_argument("Callback function cannot be null");
+    
+    passPacketCom = callback;
+}
+
+// Setter for socketInterface
+void ClientConnection::setSocketInterface(ISocket* socketInterface) {
+    if (!socketInterface)
+        throw std::invalid_argument("Socket interface cannot be null");
+    
+    this->socketInterface = socketInterface;
+}
+
+// Selects the bus to join by its port, throws if the port is invalid or the connection is open
+void ClientConnection::setPort(int port) {
+    if (port <= 0 || port > 65535)
+        throw std::invalid_argument("Invalid port number: Port must be between 1 and 65535.");
+
+    if (supervising)
+        throw std::logic_error("The bus cannot be changed while the connection is open.");
+
+    this->port = port;
+}
+
+// The port of the bus to join, PORT unless BUS_PORT_ENV names another
+int ClientConnection::portFromEnvironment()
+{
+    const char *port = std::getenv(BUS_PORT_ENV);
+    if (!port || !*port)
+        return PORT;
+
+    return std::atoi(port);
+}
+
+// Number of times a lost connection was restored
+uint64_t ClientConnection::getReconnects()
+{
+    return reconnects;
+}
+
+// For testing
+int ClientConnection::getClientSocket()
+{
+    return clientSocket;
+}
+
+int ClientConnection::isConnected()
+{
+    return connected;
+}
+
+bool ClientConnection::isReceiveThreadRunning()
+{
+    return supervising;
+}
+
+//Destructor
+ClientConnection::~ClientConnection()
+{
+    closeConnection();
+
+    // Only a connection destroyed from its own receive thread is left running
+    if (receiveThread.joinable())
+        receiveThread.detach();
+    if (wakeFd >= 0)
+        close(wakeFd);
+    delete socketInterface;
 }
\ No newline at end of file
@@ -1,20 +1,24 @@
 #include "../include/communication.h"
-#include <future>
 
-Communication* Communication::instance = nullptr;
-
-// Constructor
-Communication::Communication(uint32_t id, void (*passDataCallback)(uint32_t, void *)) : 
-    client(std::bind(&Communication::receivePacket, this, std::placeholders::_1))
+// Constructor - the callback gets a view of every message without a copy
+Communication::Communication(uint32_t id, ReceiveCallback receiveCallback) : 
+    client(std::bind(&Communication::receivePacket, this, std::placeholders::_1)),
+    reassembler(std::bind(&Communication::deliverMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)),
+    sender(std::bind(&ClientConnection::sendPackets, &client, std::placeholders::_1))
 {
     setId(id);
-    setPassDataCallback(passDataCallback);
+    setPassDataCallback(receiveCallback);
+    sender.start();
+}
 
-    instance = this;
+// Constructor - the callback gets a malloced copy of every message and frees it
+Communication::Communication(uint32_t id, void (*passDataCallback)(uint32_t, void *)) :
+    Communication(id, copyingCallback(passDataCallback)) {}
 
-    auto signalResult = signal(SIGINT, Communication::signalHandler);
-    if (signalResult == SIG_ERR)
-        throw std::runtime_error("Failed to set signal handler for SIGINT");
+// Selects the bus to join by its port, must be called before startConnection
+void Communication::setPort(int port)
+{
+    client.setPort(port);
 }
 
 // Sends the client to connect to server
@@ -31,52 +35,59 @@ ErrorCode Communication::startConnection()
 // Sends a message sync
 ErrorCode Communication::sendMessage(void *data, size_t dataSize, uint32_t destID, uint32_t srcID, bool isBroadcast)
 {
-    if (dataSize == 0)
-        return ErrorCode::INVALID_DATA_SIZE;
-
-    if (data == nullptr)
-        return ErrorCode::INVALID_DATA;
-
-    if (!client.isConnected())
-        return ErrorCode::CONNECTION_FAILED;
+    ErrorCode res = validateMessage(data, dataSize);
+    if (res != ErrorCode::SUCCESS)
+        return res;
 
     Message msg(srcID, data, dataSize, isBroadcast, destID);
     
     //Sending the message to logger
-    RealSocket::log.logMessage(logger::LogLevel::INFO,std::to_string(srcID),std::to_string(destID),"Complete message:" + msg.getPackets().at(0).pointerToHex(data, dataSize));
+    LOG_ROUTE_INFO(RealSocket::log, srcID, destID, "Complete message:{}", logger::hex(data, dataSize));
     
-    for (auto &packet : msg.getPackets()) {
-        ErrorCode res = client.sendPacket(packet);
-        if (res != ErrorCode::SUCCESS)
-            return res;
-    }
-
-    return ErrorCode::SUCCESS;  
+    // All the packets leave in one write, the receiver still handles them one by one
+    return client.sendPackets(msg.getPackets());
 }
 
 // Sends a message Async
 void Communication::sendMessageAsync(void *data, size_t dataSize, uint32_t destID, uint32_t srcID, std::function<void(ErrorCode)> sendCallback, bool isBroadcast)
 {
-    std::promise<ErrorCode> resultPromise;
-    std::future<ErrorCode> resultFuture = resultPromise.get_future();
+    ErrorCode res = validateMessage(data, dataSize);
+    if (res != ErrorCode::SUCCESS) {
+        sender.fail(res, sendCallback);
+        return;
+    }
 
-    std::thread([this, data, dataSize, destID, srcID, isBroadcast, &resultPromise]() {
-        ErrorCode res = this->sendMessage(data, dataSize, destID, srcID, isBroadcast);
-        resultPromise.set_value(res);
-    }).detach();
-    
-    ErrorCode res = resultFuture.get();
-    sendCallback(res);
+    // The packets hold a copy of the data, the caller may reuse its buffer at once
+    Message msg(srcID, data, dataSize, isBroadcast, destID);
+    LOG_ROUTE_INFO(RealSocket::log, srcID, destID, "Complete message:{}", logger::hex(data, dataSize));
+    sender.submit(std::move(msg.getPackets()), sendCallback);
+}
+
+// Checks the arguments of a message to send
+ErrorCode Communication::validateMessage(void *data, size_t dataSize)
+{
+    if (dataSize == 0)
+        return ErrorCode::INVALID_DATA_SIZE;
+
+    if (data == nullptr)
+        return ErrorCode::INVALID_DATA;
+
+    if (!client.isConnected())
+        return ErrorCode::CONNECTION_FAILED;
+
+    return ErrorCode::SUCCESS;
 }
 
 // Accepts the packet from the client and checks..
 void Communication::receivePacket(Packet &p)
 {
     if (checkDestId(p)) {
-        if (validCRC(p))
+        if (validCRC(p)) {
+            tracer.recordDelivery(p, monotonicNanoseconds());
             handlePacket(p);
+        }
         else
-            handleError();
+            handleError(p);
     }
 }
 
@@ -101,9 +112,10 @@ void Communication::handlePacket(Packet &p)
 }
 
 // Implement error handling according to CAN bus
-void Communication::handleError()
+void Communication::handleError(Packet &p)
 {
     // Handle error cases according to CAN bus
+    LOG_ROUTE_ERROR(RealSocket::log, p.header.SrcID, p.header.DestID, "CRC mismatch in packet number: {}, of messageId: {}", p.header.PSN, p.header.ID);
 }
 
 // Implement arrival confirmation according to the CAN bus
@@ -117,32 +129,16 @@ Packet Communication::hadArrived()
 // Adding the packet to the complete message
 void Communication::addPacketToMessage(Packet &p)
 {
-    std::string messageId = std::to_string(p.header.ID);
-    // If the message already exists, we will add the packet
-    if (receivedMessages.find(messageId) != receivedMessages.end()) {
-        receivedMessages[messageId].addPacket(p);
-    } else {
-        // If the message does not exist, we will create a new message
-        Message msg(p.header.TPS);
-        msg.addPacket(p);
-        receivedMessages[messageId] = msg;
-    }
-
-    // If the message is complete, we pass the data to the passData function
-    if (receivedMessages[messageId].isComplete()) {
-        void *completeData = receivedMessages[messageId].completeData();
-        passData(p.header.SrcID, completeData);
-        receivedMessages.erase(messageId); // Removing the message once completed
-    }
+    // The reassembler calls deliverMessage once the message is complete
+    if (!reassembler.addPacket(p))
+        LOG_ROUTE_ERROR(RealSocket::log, p.header.SrcID, p.header.DestID, "dropped packet number: {}, of messageId: {}", p.header.PSN, p.header.ID);
 }
 
-// Static method to handle SIGINT signal
-void Communication::signalHandler(int signum)
+// Passes a complete message to the process
+void Communication::deliverMessage(uint32_t srcID, const uint8_t *data, size_t size)
 {
-    if (instance)
-        instance->client.closeConnection();
-    
-    exit(signum);
+    // The view points into the reassembler's slot, which is reused once the callback returns
+    passData(MessageView{srcID, data, size});
 }
 
 void Communication::setId(uint32_t newId)
@@ -150,15 +146,47 @@ void Communication::setId(uint32_t newId)
     id = newId;
 }
 
-void Communication::setPassDataCallback(void (*callback)(uint32_t, void *))
+void Communication::setPassDataCallback(ReceiveCallback callback)
 {
-    if (callback == nullptr)
+    if (!callback)
         throw std::invalid_argument("Invalid callback function: passDataCallback cannot be null");
     
     passData = callback;
 }
 
+// Adapts a callback that owns and frees its data, it gets a malloced copy of every message
+ReceiveCallback Communication::copyingCallback(void (*passDataCallback)(uint32_t, void *))
+{
+    if (passDataCallback == nullptr)
+        throw std::invalid_argument("Invalid callback function: passDataCallback cannot be null");
+
+    return [passDataCallback](const MessageView &message) {
+        void *completeData = malloc(message.size);
+        std::memcpy(completeData, message.data, message.size);
+        passDataCallback(message.srcID, completeData);
+    };
+}
+
+// Per hop latency of the packets received so far
+LatencyTracer &Communication::getLatencyTracer()
+{
+    return tracer;
+}
+
+// Registers an acceptance filter at the bus
+ErrorCode Communication::addAcceptanceFilter(uint32_t id, uint32_t mask)
+{
+    return client.addFilter({id, mask});
+}
+
+// Removes the acceptance filters, every broadcast is delivered again
+ErrorCode Communication::clearAcceptanceFilters()
+{
+    return client.clearFilters();
+}
+
 //Destructor
 Communication::~Communication() {
-    instance = nullptr;
+    // The receive thread uses the reassembler, which is destroyed before the client
+    client.closeConnection();
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include <cstring>
+#include "../include/crc.h"
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+// Lookup tables built once on first use
+struct CrcTables
+{
+    uint16_t crc15[256];
+    uint32_t crc32c[8][256];
+
+    CrcTables()
+    {
+        for (uint32_t i = 0; i < 256; ++i) {
+            // The byte enters at the top of the 15 bit register
+            uint16_t crc = i << 7;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc & 0x4000) ? (crc << 1) ^ CRC15_CAN_POLYNOMIAL : crc << 1;
+            crc15[i] = crc & 0x7FFF;
+
+            uint32_t crc32 = i;
+            for (int bit = 0; bit < 8; ++bit)
+                crc32 = (crc32 & 1) ? (crc32 >> 1) ^ CRC32C_POLYNOMIAL : crc32 >> 1;
+            crc32c[0][i] = crc32;
+        }
+
+        // Table k advances a byte that is followed by k more bytes
+        for (uint32_t i = 0; i < 256; ++i)
+            for (int k = 1; k < 8; ++k)
+                crc32c[k][i] = (crc32c[k - 1][i] >> 8) ^ crc32c[0][crc32c[k - 1][i] & 0xFF];
+    }
+};
+
+static const CrcTables &tables()
+{
+    static const CrcTables instance;
+    return instance;
+}
+
+// CRC-15 of a CAN frame, table driven one byte at a time
+uint16_t crc15Can(const void *data, size_t length)
+{
+    const CrcTables &t = tables();
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; ++i)
+        crc = ((crc << 8) ^ t.crc15[((crc >> 7) ^ bytes[i]) & 0xFF]) & 0x7FFF;
+    return crc;
+}
+
+// CRC-32C with slice-by-8 tables, the fallback of crc32c
+uint32_t crc32cSoftware(const void *data, size_t length, uint32_t crc)
+{
+    const CrcTables &t = tables();
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+
+    // Eight bytes per step, the tables are indexed little-endian
+    while (length >= 8) {
+        uint32_t low = crc ^ (bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24));
+        crc = t.crc32c[7][low & 0xFF] ^ t.crc32c[6][(low >> 8) & 0xFF] ^
+              t.crc32c[5][(low >> 16) & 0xFF] ^ t.crc32c[4][low >> 24] ^
+              t.crc32c[3][bytes[4]] ^ t.crc32c[2][bytes[5]] ^
+              t.crc32c[1][bytes[6]] ^ t.crc32c[0][bytes[7]];
+        bytes += 8;
+        length -= 8;
+    }
+
+    while (length--)
+        crc = (crc >> 8) ^ t.crc32c[0][(crc ^ *bytes++) & 0xFF];
+
+    return ~crc;
+}
+
+#if defined(__x86_64__)
+// CRC-32C on the crc32 instruction, eight bytes at a time
+__attribute__((target("sse4.2"))) static uint32_t crc32cHardware(const void *data, size_t length, uint32_t crc)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t state = ~crc;
+    while (length >= 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        state = _mm_crc32_u64(state, word);
+        bytes += 8;
+        length -= 8;
+    }
+
+    uint32_t tail = state;
+    while (length--)
+        tail = _mm_crc32_u8(tail, *bytes++);
+
+    return ~tail;
+}
+#endif
+
+// True if crc32c runs on the SSE4.2 instruction
+bool crc32cHardwareAvailable()
+{
+#if defined(__x86_64__)
+    static const bool available = __builtin_cpu_supports("sse4.2");
+    return available;
+#else
+    return false;
+#endif
+}
+
+// CRC-32C for whole messages, uses the SSE4.2 crc32 instruction when the CPU has it
+uint32_t crc32c(const void *data, size_t length, uint32_t crc)
+{
+#if defined(__x86_64__)
+    if (crc32cHardwareAvailable())
+        return crc32cHardware(data, length, crc);
+#endif
+    return crc32cSoftware(data, length, crc);
+}
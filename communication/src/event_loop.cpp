@@ -0,0 +1,141 @@
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include "../include/event_loop.h"
+
+// Constructor
+EventLoop::EventLoop(ISocket* socketInterface, std::function<bool(int)> readHandler, std::function<void(int)> closeHandler, std::function<bool(int)> writeHandler)
+    : socketInterface(socketInterface), epollFd(-1), wakeFd(-1), running(false), readHandler(readHandler), closeHandler(closeHandler), writeHandler(writeHandler)
+{
+    if (!socketInterface)
+        throw std::invalid_argument("Invalid socket interface: socketInterface cannot be null.");
+
+    if (!readHandler || !closeHandler)
+        throw std::invalid_argument("Invalid callback function: handlers cannot be null.");
+}
+
+// Creates the epoll instance and starts the loop thread
+ErrorCode EventLoop::start()
+{
+    epollFd = socketInterface->epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0)
+        return ErrorCode::SOCKET_FAILED;
+
+    // The wake descriptor lets stop() interrupt a blocking epoll_wait
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        socketInterface->close(epollFd);
+        return ErrorCode::SOCKET_FAILED;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    if (socketInterface->epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) < 0) {
+        ::close(wakeFd);
+        socketInterface->close(epollFd);
+        return ErrorCode::SOCKET_FAILED;
+    }
+
+    running = true;
+    loopThread = std::thread(&EventLoop::run, this);
+
+    return ErrorCode::SUCCESS;
+}
+
+// Registers a socket for read events
+ErrorCode EventLoop::addSocket(int fd)
+{
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = fd;
+    if (socketInterface->epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+        return ErrorCode::SOCKET_FAILED;
+
+    return ErrorCode::SUCCESS;
+}
+
+// Unregisters a socket, the caller is responsible for closing it
+void EventLoop::removeSocket(int fd)
+{
+    socketInterface->epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+// Enables or disables writable events of a registered socket, may be called from any thread
+ErrorCode EventLoop::setWriteInterest(int fd, bool enabled)
+{
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP | (enabled ? (uint32_t)EPOLLOUT : 0u);
+    event.data.fd = fd;
+    if (socketInterface->epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) < 0)
+        return ErrorCode::SOCKET_FAILED;
+
+    return ErrorCode::SUCCESS;
+}
+
+// Waits for events and dispatches them until the loop is stopped
+void EventLoop::run()
+{
+    epoll_event events[EPOLL_MAX_EVENTS];
+    while (running) {
+        int ready = socketInterface->epoll_wait(epollFd, events, EPOLL_MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                uint64_t counter;
+                ssize_t drained = ::read(wakeFd, &counter, sizeof(counter));
+                (void)drained;
+                continue;
+            }
+
+            // Queued bytes go out first, hang-ups are reported through the read handler as a zero-length read
+            bool keep = true;
+            if ((events[i].events & EPOLLOUT) && writeHandler)
+                keep = writeHandler(fd);
+            if (keep && (events[i].events & ~EPOLLOUT))
+                keep = readHandler(fd);
+
+            if (!keep) {
+                removeSocket(fd);
+                closeHandler(fd);
+            }
+        }
+    }
+}
+
+// Wakes the loop thread and joins it
+void EventLoop::stop()
+{
+    if (!running)
+        return;
+
+    running = false;
+    uint64_t one = 1;
+    ssize_t written = ::write(wakeFd, &one, sizeof(one));
+    (void)written;
+
+    if (loopThread.joinable())
+        loopThread.join();
+
+    ::close(wakeFd);
+    socketInterface->close(epollFd);
+    wakeFd = -1;
+    epollFd = -1;
+}
+
+bool EventLoop::isRunning()
+{
+    return running;
+}
+
+// Destructor
+EventLoop::~EventLoop()
+{
+    stop();
+}
@@ -0,0 +1,108 @@
+#include <atomic>
+#include "../include/filter_table.h"
+
+// Constructor
+FilterTable::FilterTable() : current(std::make_shared<Snapshot>()) {}
+
+// Publishes a new version, must be called under writeMutex
+void FilterTable::publish(std::shared_ptr<const Snapshot> snapshot)
+{
+    std::atomic_store_explicit(&current, std::move(snapshot), std::memory_order_release);
+}
+
+// Adds a filter of the socket, the socket then accepts only what one of its filters lets pass
+void FilterTable::add(int socket, const AcceptanceFilter &filter)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::shared_ptr<const Snapshot> old = snapshot();
+
+    // The entries of the other sockets are shared with the old version, only this one is rebuilt
+    std::shared_ptr<Acceptance> acceptance = std::make_shared<Acceptance>();
+    auto it = old->find(socket);
+    if (it != old->end())
+        *acceptance = *it->second;
+    acceptance->filters.push_back(filter);
+    for (uint32_t id = 0; id < FILTER_BITSET_IDS; ++id)
+        if (filter.accepts(id))
+            acceptance->standardIDs.set(id);
+
+    std::shared_ptr<Snapshot> updated = std::make_shared<Snapshot>(*old);
+    (*updated)[socket] = std::move(acceptance);
+    publish(std::move(updated));
+}
+
+// Removes the filters of the socket, it accepts everything again
+void FilterTable::remove(int socket)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::shared_ptr<const Snapshot> old = snapshot();
+    if (!old->count(socket))
+        return;
+
+    std::shared_ptr<Snapshot> updated = std::make_shared<Snapshot>(*old);
+    updated->erase(socket);
+    publish(std::move(updated));
+}
+
+// Removes all filters
+void FilterTable::clear()
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    publish(std::make_shared<Snapshot>());
+}
+
+// Checks if the socket accepts the ID
+bool FilterTable::accepts(int socket, uint32_t id) const
+{
+    return accepts(*snapshot(), socket, id);
+}
+
+// Checks if the socket accepts the ID in a snapshot
+bool FilterTable::accepts(const Snapshot &table, int socket, uint32_t id)
+{
+    auto it = table.find(socket);
+    if (it == table.end())
+        return true;
+
+    // Standard IDs are a single bit test, extended IDs go through the filters
+    const Acceptance &acceptance = *it->second;
+    if (id < FILTER_BITSET_IDS)
+        return acceptance.standardIDs.test(id);
+
+    for (const AcceptanceFilter &filter : acceptance.filters)
+        if (filter.accepts(id))
+            return true;
+    return false;
+}
+
+// Number of sockets with filters
+size_t FilterTable::size() const
+{
+    return snapshot()->size();
+}
+
+// The current version, stays valid and unchanged while held
+std::shared_ptr<const FilterTable::Snapshot> FilterTable::snapshot() const
+{
+    return std::atomic_load_explicit(&current, std::memory_order_acquire);
+}
+
+// Control frame that registers the filter at the bus, the mask travels in the payload
+Packet FilterTable::encodeFilter(uint32_t srcID, const AcceptanceFilter &filter)
+{
+    uint8_t mask[4] = {(uint8_t)filter.mask, (uint8_t)(filter.mask >> 8), (uint8_t)(filter.mask >> 16),
+                       (uint8_t)(filter.mask >> 24)};
+    Packet packet(filter.id, 0, 1, srcID, 0, mask, sizeof(mask), false);
+    packet.header.control = ControlType::FILTER;
+    return packet;
+}
+
+// Reads the filter of a FILTER control frame
+AcceptanceFilter FilterTable::decodeFilter(const Packet &packet)
+{
+    const uint8_t *mask = (const uint8_t *)packet.data;
+    uint32_t value = 0;
+    if (packet.header.DLC >= 4)
+        value = mask[0] | (mask[1] << 8) | (mask[2] << 16) | ((uint32_t)mask[3] << 24);
+    return {packet.header.ID, value};
+}
@@ -0,0 +1,192 @@
+#include "../include/latency_tracer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Constructor
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+// Adds one sample, negative samples count as 0
+void LatencyHistogram::record(int64_t nanoseconds)
+{
+    if (nanoseconds < 0)
+        nanoseconds = 0;
+
+    counts[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    int64_t current = minimum.load(std::memory_order_relaxed);
+    while (nanoseconds < current && !minimum.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed))
+        ;
+    current = maximum.load(std::memory_order_relaxed);
+    while (nanoseconds > current && !maximum.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed))
+        ;
+}
+
+// Number of samples
+uint64_t LatencyHistogram::count() const
+{
+    return total.load(std::memory_order_relaxed);
+}
+
+// Smallest sample, 0 if there are none
+int64_t LatencyHistogram::min() const
+{
+    return count() ? minimum.load(std::memory_order_relaxed) : 0;
+}
+
+// Largest sample
+int64_t LatencyHistogram::max() const
+{
+    return maximum.load(std::memory_order_relaxed);
+}
+
+// Average of the samples
+double LatencyHistogram::mean() const
+{
+    uint64_t samples = count();
+    return samples ? (double)sum.load(std::memory_order_relaxed) / samples : 0;
+}
+
+// Value that percent of the samples do not exceed, rounded up to the end of its bucket
+int64_t LatencyHistogram::percentile(double percent) const
+{
+    uint64_t samples = count();
+    if (!samples)
+        return 0;
+
+    uint64_t target = std::max<uint64_t>(1, (uint64_t)std::ceil(percent / 100 * samples));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+            return std::min(bucketUpperBound(i), max());
+    }
+    return max();
+}
+
+// Removes all samples
+void LatencyHistogram::reset()
+{
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i)
+        counts[i].store(0, std::memory_order_relaxed);
+    total.store(0);
+    sum.store(0);
+    minimum.store(INT64_MAX);
+    maximum.store(0);
+}
+
+// Writes the percentile distribution in the text format of HdrHistogram, values in microseconds
+void LatencyHistogram::exportPercentiles(std::ostream &out) const
+{
+    char line[128];
+    uint64_t samples = count();
+    out << "       Value     Percentile TotalCount 1/(1-Percentile)\n\n";
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS && seen < samples; ++i) {
+        uint64_t inBucket = counts[i].load(std::memory_order_relaxed);
+        if (!inBucket)
+            continue;
+
+        seen += inBucket;
+        double value = std::min(bucketUpperBound(i), max()) / 1000.0;
+        double fraction = (double)seen / samples;
+        if (fraction < 1)
+            snprintf(line, sizeof(line), "%12.3f %14.12f %10llu %14.2f\n", value, fraction, (unsigned long long)seen, 1 / (1 - fraction));
+        else
+            snprintf(line, sizeof(line), "%12.3f %14.12f %10llu\n", value, fraction, (unsigned long long)seen);
+        out << line;
+    }
+
+    snprintf(line, sizeof(line), "#[Mean    = %12.3f, Max            = %12.3f]\n", mean() / 1000, max() / 1000.0);
+    out << line;
+    snprintf(line, sizeof(line), "#[Total count    = %12llu]\n", (unsigned long long)samples);
+    out << line;
+}
+
+// Bucket that holds the value
+size_t LatencyHistogram::bucketIndex(int64_t value)
+{
+    if (value < LATENCY_SUB_BUCKETS)
+        return value;
+
+    // The top bits of the value select the sub-bucket inside its power of two
+    int shift = 63 - __builtin_clzll(value) - (LATENCY_SUB_BUCKET_BITS - 1);
+    return shift * (LATENCY_SUB_BUCKETS / 2) + (value >> shift);
+}
+
+// Largest value that falls in the bucket
+int64_t LatencyHistogram::bucketUpperBound(size_t index)
+{
+    if (index < LATENCY_SUB_BUCKETS)
+        return index;
+
+    int shift = index / (LATENCY_SUB_BUCKETS / 2) - 1;
+    int64_t subBucket = index % (LATENCY_SUB_BUCKETS / 2) + LATENCY_SUB_BUCKETS / 2;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+// Records the hops of a packet delivered at deliverTime, hops the bus did not stamp are skipped
+void LatencyTracer::recordDelivery(const Packet &packet, int64_t deliverTime)
+{
+    const Packet::Header &header = packet.header;
+    if (header.enqueueTime) {
+        histograms[(int)LatencyHop::SEND_TO_BUS].record(header.enqueueTime - header.timestamp);
+        if (header.routeTime)
+            histograms[(int)LatencyHop::BUS_ARBITRATION].record(header.routeTime - header.enqueueTime);
+    }
+    if (header.routeTime)
+        histograms[(int)LatencyHop::BUS_TO_RECEIVER].record(deliverTime - header.routeTime);
+    histograms[(int)LatencyHop::END_TO_END].record(deliverTime - header.timestamp);
+}
+
+// Histogram of one hop
+LatencyHistogram &LatencyTracer::getHistogram(LatencyHop hop)
+{
+    return histograms[(int)hop];
+}
+
+// Removes all samples
+void LatencyTracer::reset()
+{
+    for (LatencyHistogram &histogram : histograms)
+        histogram.reset();
+}
+
+// One line per hop with the count and the percentiles in microseconds
+std::string LatencyTracer::report() const
+{
+    std::string result;
+    char line[192];
+    for (int hop = 0; hop < (int)LatencyHop::COUNT; ++hop) {
+        const LatencyHistogram &histogram = histograms[hop];
+        snprintf(line, sizeof(line), "%-16s count=%llu p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n",
+                 hopName((LatencyHop)hop), (unsigned long long)histogram.count(), histogram.percentile(50) / 1000.0,
+                 histogram.percentile(90) / 1000.0, histogram.percentile(99) / 1000.0,
+                 histogram.percentile(99.9) / 1000.0, histogram.max() / 1000.0);
+        result += line;
+    }
+    return result;
+}
+
+// Name of the hop in reports
+const char *LatencyTracer::hopName(LatencyHop hop)
+{
+    switch (hop) {
+    case LatencyHop::SEND_TO_BUS:
+        return "send_to_bus";
+    case LatencyHop::BUS_ARBITRATION:
+        return "bus_arbitration";
+    case LatencyHop::BUS_TO_RECEIVER:
+        return "bus_to_receiver";
+    case LatencyHop::END_TO_END:
+        return "end_to_end";
+    default:
+        return "unknown";
+    }
+}
@@ -4,11 +4,26 @@
 Message::Message(uint32_t srcID, void *data, int dlc, bool isBroadcast, uint32_t destID)
 {
     size_t size = dlc;
-    uint32_t tps = (size + SIZE_PACKET-1) / SIZE_PACKET; // Calculate the number of packets needed
+
+    // A single packet is covered by its own CRC, a longer message is followed by its CRC-32C
+    uint8_t trailer[MESSAGE_CRC_SIZE];
+    size_t totalSize = size;
+    if (size > SIZE_PACKET) {
+        uint32_t crc = crc32c(data, size);
+        for (int i = 0; i < MESSAGE_CRC_SIZE; ++i)
+            trailer[i] = (crc >> (8 * i)) & 0xFF;
+        totalSize += MESSAGE_CRC_SIZE;
+    }
+
+    uint32_t tps = (totalSize + SIZE_PACKET-1) / SIZE_PACKET; // Calculate the number of packets needed
     for (uint32_t i = 0; i < tps; ++i) {
         uint8_t packetData[SIZE_PACKET];
-        size_t copySize = std::min(size - i * SIZE_PACKET, (size_t)SIZE_PACKET); // Determine how much data to copy for each packet
-        std::memcpy(packetData, (uint8_t *)data + i * SIZE_PACKET, copySize);
+        size_t offset = i * SIZE_PACKET;
+        size_t copySize = std::min(totalSize - offset, (size_t)SIZE_PACKET); // Determine how much data to copy for each packet
+        size_t dataSize = offset < size ? std::min(copySize, size - offset) : 0;
+        std::memcpy(packetData, (uint8_t *)data + offset, dataSize);
+        if (dataSize < copySize)
+            std::memcpy(packetData + dataSize, trailer + (offset + dataSize - size), copySize - dataSize);
         uint32_t id = srcID + destID;
         packets.emplace_back(id, i, tps, srcID, destID, packetData, copySize, isBroadcast, false, false);
     }
@@ -56,3 +71,16 @@ std::vector<Packet> &Message::getPackets()
 {
     return packets;
 }
+
+// Checks the CRC-32C at the end of the reassembled data of a message of several packets
+bool Message::validMessageCRC(const uint8_t *data, size_t length)
+{
+    if (length < MESSAGE_CRC_SIZE)
+        return false;
+
+    size_t size = length - MESSAGE_CRC_SIZE;
+    uint32_t crc = 0;
+    for (int i = 0; i < MESSAGE_CRC_SIZE; ++i)
+        crc |= (uint32_t)data[size + i] << (8 * i);
+    return crc == crc32c(data, size);
+}
@@ -0,0 +1,206 @@
+#include "../include/metrics.h"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+// Constructor
+Counter::Counter() : count(0) {}
+
+// Adds to the counter
+void Counter::add(uint64_t amount)
+{
+    count.fetch_add(amount, std::memory_order_relaxed);
+}
+
+// Current value
+uint64_t Counter::value() const
+{
+    return count.load(std::memory_order_relaxed);
+}
+
+// Constructor
+LabeledCounter::LabeledCounter() : overflow(0)
+{
+    for (Slot &slot : slots) {
+        slot.key.store(0, std::memory_order_relaxed);
+        slot.count.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Adds to the counter of the label
+void LabeledCounter::add(uint32_t label, uint64_t amount)
+{
+    uint64_t key = (uint64_t)label + 1;
+    size_t start = (label * 2654435761u) % METRICS_LABEL_SLOTS;
+    for (size_t i = 0; i < METRICS_LABEL_SLOTS; ++i) {
+        Slot &slot = slots[(start + i) % METRICS_LABEL_SLOTS];
+        uint64_t current = slot.key.load(std::memory_order_acquire);
+
+        // A free slot is claimed with a CAS, losing it to the same label is as good as winning
+        if (current == 0 && slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel))
+            current = key;
+        if (current != key)
+            continue;
+
+        slot.count.fetch_add(amount, std::memory_order_relaxed);
+        return;
+    }
+    overflow.fetch_add(amount, std::memory_order_relaxed);
+}
+
+// Current value of the label
+uint64_t LabeledCounter::value(uint32_t label) const
+{
+    uint64_t key = (uint64_t)label + 1;
+    size_t start = (label * 2654435761u) % METRICS_LABEL_SLOTS;
+    for (size_t i = 0; i < METRICS_LABEL_SLOTS; ++i) {
+        const Slot &slot = slots[(start + i) % METRICS_LABEL_SLOTS];
+        uint64_t current = slot.key.load(std::memory_order_acquire);
+        if (current == key)
+            return slot.count.load(std::memory_order_relaxed);
+        if (current == 0)
+            return 0;
+    }
+    return 0;
+}
+
+// Every label seen so far with its value
+std::vector<std::pair<uint32_t, uint64_t>> LabeledCounter::values() const
+{
+    std::vector<std::pair<uint32_t, uint64_t>> result;
+    for (const Slot &slot : slots) {
+        uint64_t key = slot.key.load(std::memory_order_acquire);
+        if (key)
+            result.push_back(std::make_pair((uint32_t)(key - 1), slot.count.load(std::memory_order_relaxed)));
+    }
+    return result;
+}
+
+// Sum of the labels that did not find a free slot
+uint64_t LabeledCounter::overflowValue() const
+{
+    return overflow.load(std::memory_order_relaxed);
+}
+
+// Constructor
+MetricsRegistry::MetricsRegistry() : exporting(false) {}
+
+// Adds a metric whose samples are appended by write
+void MetricsRegistry::add(const std::string &name, const std::string &help, const std::string &type,
+                          std::function<void(std::string &)> write)
+{
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    entries.push_back({name, help, type, write});
+}
+
+// Appends one sample line
+void MetricsRegistry::writeSample(std::string &out, const std::string &name, const std::string &labels, double value)
+{
+    char number[32];
+    snprintf(number, sizeof(number), "%.15g", value);
+    out += name;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    out += number;
+    out += '\n';
+}
+
+// Registers a counter
+void MetricsRegistry::addCounter(const std::string &name, const std::string &help, const Counter &counter)
+{
+    add(name, help, "counter", [name, &counter](std::string &out) { writeSample(out, name, "", counter.value()); });
+}
+
+// Registers a labeled counter, labelValue formats a label and defaults to its decimal value
+void MetricsRegistry::addCounter(const std::string &name, const std::string &help, const LabeledCounter &counter,
+                                 const std::string &labelName, std::function<std::string(uint32_t)> labelValue)
+{
+    add(name, help, "counter", [name, &counter, labelName, labelValue](std::string &out) {
+        for (const std::pair<uint32_t, uint64_t> &sample : counter.values()) {
+            std::string label = labelValue ? labelValue(sample.first) : std::to_string(sample.first);
+            writeSample(out, name, labelName + "=\"" + label + "\"", sample.second);
+        }
+        if (counter.overflowValue())
+            writeSample(out, name, labelName + "=\"other\"", counter.overflowValue());
+    });
+}
+
+// Registers a gauge sampled at every export
+void MetricsRegistry::addGauge(const std::string &name, const std::string &help, std::function<Samples()> sample)
+{
+    add(name, help, "gauge", [name, sample](std::string &out) {
+        for (const std::pair<std::string, double> &value : sample())
+            writeSample(out, name, value.first, value.second);
+    });
+}
+
+// Registers a latency histogram, exported as a summary in seconds
+void MetricsRegistry::addSummary(const std::string &name, const std::string &help, const LatencyHistogram &histogram)
+{
+    add(name, help, "summary", [name, &histogram](std::string &out) {
+        for (double quantile : {0.5, 0.9, 0.99, 0.999}) {
+            char label[32];
+            snprintf(label, sizeof(label), "quantile=\"%g\"", quantile);
+            writeSample(out, name, label, histogram.percentile(quantile * 100) / 1e9);
+        }
+        writeSample(out, name + "_sum", "", histogram.mean() * histogram.count() / 1e9);
+        writeSample(out, name + "_count", "", histogram.count());
+    });
+}
+
+// The current value of every metric
+std::string MetricsRegistry::exportText()
+{
+    std::string out;
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    for (const Entry &entry : entries) {
+        out += "# HELP " + entry.name + " " + entry.help + "\n";
+        out += "# TYPE " + entry.name + " " + entry.type + "\n";
+        entry.write(out);
+    }
+    return out;
+}
+
+// Rewrites the file with the metrics every interval
+void MetricsRegistry::startFileExport(const std::string &fileName, int intervalMs)
+{
+    if (intervalMs <= 0)
+        throw std::invalid_argument("Invalid export interval: must be positive.");
+
+    stopFileExport();
+    exporting = true;
+    exportThread = std::thread([this, fileName, intervalMs]() {
+        std::string temporaryName = fileName + ".tmp";
+        std::unique_lock<std::mutex> lock(exportMutex);
+        while (exporting) {
+            {
+                std::ofstream out(temporaryName, std::ios::trunc);
+                out << exportText();
+            }
+            std::rename(temporaryName.c_str(), fileName.c_str());
+            exportWake.wait_for(lock, std::chrono::milliseconds(intervalMs), [this]() { return !exporting; });
+        }
+    });
+}
+
+// Stops the file export, the file keeps the last values
+void MetricsRegistry::stopFileExport()
+{
+    {
+        std::lock_guard<std::mutex> lock(exportMutex);
+        exporting = false;
+    }
+    exportWake.notify_all();
+    if (exportThread.joinable())
+        exportThread.join();
+}
+
+// Destructor
+MetricsRegistry::~MetricsRegistry()
+{
+    stopFileExport();
+}
@@ -0,0 +1,174 @@
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include "../include/outbound_queue.h"
+#include "../sockets/real_socket.h"
+
+// Constructor - throws if the capacity is not a power of two or its control space does not hold a whole frame
+OutboundQueue::OutboundQueue(ISocket* socketInterface, EventLoop* loop, int socket, size_t capacity)
+    : socketInterface(socketInterface), loop(loop), socket(socket), readIndex(0), writeIndex(0),
+      writeInterest(false), closed(false), disconnectRequested(false), droppedFrames(0)
+{
+    if (!socketInterface)
+        throw std::invalid_argument("Invalid socket interface: socketInterface cannot be null.");
+
+    if (!validCapacity(capacity))
+        throw std::invalid_argument("Invalid capacity: must be a power of two whose control space holds a whole frame.");
+
+    buffer.resize(capacity);
+    mask = capacity - 1;
+    dataCapacity = capacity - capacity / OUTBOUND_CONTROL_SHARE;
+}
+
+// True if a queue of the capacity can be constructed
+bool OutboundQueue::validCapacity(size_t capacity)
+{
+    return capacity / OUTBOUND_CONTROL_SHARE >= WIRE_MAX_FRAME_SIZE && !(capacity & (capacity - 1));
+}
+
+// Queues a whole frame or applies the policy when it does not fit
+ErrorCode OutboundQueue::push(const uint8_t *frame, size_t length, SlowConsumerPolicy policy)
+{
+    return enqueue(frame, length, policy, dataCapacity);
+}
+
+// Queues a frame of the connection itself, which may use the space kept for them and never waits
+ErrorCode OutboundQueue::pushControl(const uint8_t *frame, size_t length)
+{
+    return enqueue(frame, length, SlowConsumerPolicy::DISCONNECT, buffer.size());
+}
+
+// Queues a whole frame within the capacity or applies the policy when it does not fit
+ErrorCode OutboundQueue::enqueue(const uint8_t *frame, size_t length, SlowConsumerPolicy policy, size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (closed || disconnectRequested)
+        return ErrorCode::CONNECTION_FAILED;
+
+    if (length > dataCapacity)
+        return ErrorCode::INVALID_DATA_SIZE;
+
+    // Nothing is queued before the frame, so it may skip the queue
+    size_t offset = 0;
+    if (writeIndex == readIndex) {
+        ssize_t sent = socketInterface->send(socket, frame, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return ErrorCode::CONNECTION_FAILED;
+
+        offset = sent > 0 ? sent : 0;
+        if (offset == length)
+            return ErrorCode::SUCCESS;
+    }
+
+    // A partly written frame always fits, the queue was empty. Control frames may have filled the queue past the capacity of the data
+    if (writeIndex - readIndex + length - offset > capacity) {
+        switch (policy) {
+        case SlowConsumerPolicy::DROP:
+            if (droppedFrames++ == 0)
+                RealSocket::log.logMessage(logger::LogLevel::ERROR, "slow consumer on socket " + std::to_string(socket) + ", dropping frames");
+            return ErrorCode::SEND_FAILED;
+
+        case SlowConsumerPolicy::BLOCK:
+            // The sender writes the backlog itself, waiting on the event loop could wait on its own thread
+            if (!writeQueued(MSG_NOSIGNAL))
+                return ErrorCode::CONNECTION_FAILED;
+            break;
+
+        case SlowConsumerPolicy::DISCONNECT:
+            RealSocket::log.logMessage(logger::LogLevel::ERROR, "slow consumer on socket " + std::to_string(socket) + ", disconnecting");
+            disconnectRequested = true;
+            updateWriteInterest();
+            return ErrorCode::CONNECTION_FAILED;
+        }
+    }
+
+    append(frame + offset, length - offset);
+    updateWriteInterest();
+    return ErrorCode::SUCCESS;
+}
+
+// Called by the event loop when the socket is writable, returns false if the connection should be closed
+bool OutboundQueue::flush()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (closed)
+        return true;
+
+    if (disconnectRequested || !writeQueued(MSG_DONTWAIT | MSG_NOSIGNAL))
+        return false;
+
+    if (droppedFrames && writeIndex == readIndex) {
+        RealSocket::log.logMessage(logger::LogLevel::INFO, "socket " + std::to_string(socket) + " caught up after " + std::to_string(droppedFrames) + " dropped frames");
+        droppedFrames = 0;
+    }
+
+    updateWriteInterest();
+    return true;
+}
+
+// Rejects further frames, called before the socket is closed
+void OutboundQueue::close()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    closed = true;
+    readIndex = writeIndex = 0;
+}
+
+// Number of bytes waiting to be written
+size_t OutboundQueue::size()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return writeIndex - readIndex;
+}
+
+// Number of frames lost under the DROP policy
+size_t OutboundQueue::getDroppedFrames()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return droppedFrames;
+}
+
+// Writes queued bytes without blocking, returns false on a connection error
+bool OutboundQueue::writeQueued(int flags)
+{
+    while (writeIndex != readIndex) {
+        size_t start = readIndex & mask;
+        size_t chunk = std::min(writeIndex - readIndex, buffer.size() - start);
+        ssize_t sent = socketInterface->send(socket, buffer.data() + start, chunk, flags);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            return (flags & MSG_DONTWAIT) && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        if (sent == 0)
+            return false;
+
+        readIndex += sent;
+    }
+
+    readIndex = writeIndex = 0;
+    return true;
+}
+
+// Copies the unsent tail of a frame into the queue
+void OutboundQueue::append(const uint8_t *data, size_t length)
+{
+    size_t start = writeIndex & mask;
+    size_t firstPart = std::min(length, buffer.size() - start);
+    std::memcpy(buffer.data() + start, data, firstPart);
+    std::memcpy(buffer.data(), data + firstPart, length - firstPart);
+    writeIndex += length;
+}
+
+// Asks the event loop for writable events while bytes are queued, must be called under queueMutex
+void OutboundQueue::updateWriteInterest()
+{
+    // Changed under the lock, so a concurrent push and flush cannot leave a backlog without interest
+    bool wanted = disconnectRequested || writeIndex != readIndex;
+    if (wanted == writeInterest || !loop)
+        return;
+
+    if (loop->setWriteInterest(socket, wanted) == ErrorCode::SUCCESS)
+        writeInterest = wanted;
+}
@@ -1,4 +1,6 @@
 #include "../include/packet.h"
+#include "../include/crc.h"
+#include "../include/latency_tracer.h"
 // Constructor to initialize Packet for sending
 Packet::Packet(uint32_t id, uint32_t psn, uint32_t tps, uint32_t srcID, uint32_t destID, void *data, uint8_t dlc, bool isBroadcast, bool RTR, bool passive)
 {
@@ -10,10 +12,13 @@ Packet::Packet(uint32_t id, uint32_t psn, uint32_t tps, uint32_t srcID, uint32_t
     header.DLC = dlc;
     std::memcpy(this->data, data, dlc);
     header.CRC = calculateCRC(data, dlc);
-    header.timestamp = std::time(nullptr);
+    header.timestamp = monotonicNanoseconds();
+    header.enqueueTime = 0;
+    header.routeTime = 0;
     header.RTR = RTR;
     header.passive = passive;
     header.isBroadcast = isBroadcast;
+    header.control = ControlType::NONE;
 }
 
 // Constructor to initialize receiving Packet ID for init
@@ -21,15 +26,14 @@ Packet::Packet(uint32_t id)
 {
     std::memset(&header, 0, sizeof(header)); // Initialize all fields to zero
     header.SrcID = id;
-    header.timestamp = std::time(nullptr);
+    header.timestamp = monotonicNanoseconds();
 }
 
 // Implementation according to the CAN BUS
 uint16_t Packet::calculateCRC(const void *data, size_t length)
 {
-    uint16_t crc = 0xFFFF;
-    // Calculate CRC for the given data and length
-    return crc;
+    // The 15 bit CRC of the CAN frame, computed here over the data field
+    return crc15Can(data, length);
 }
 
 // A function to convert the data to hexa (logger)
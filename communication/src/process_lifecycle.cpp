@@ -0,0 +1,143 @@
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <stdexcept>
+#include "../include/process_lifecycle.h"
+
+// Constructor - blocks the stop signals of the process, throws std::runtime_error if they cannot be read
+ProcessLifecycle::ProcessLifecycle() : signalFd(-1), wakeFd(-1), stopping(false)
+{
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+
+    // Blocked here so that every thread started afterwards inherits the mask, the signals wait for the signalfd
+    if (pthread_sigmask(SIG_BLOCK, &stopSignals, &previousMask) != 0)
+        throw std::runtime_error("Failed to block the stop signals");
+
+    signalFd = signalfd(-1, &stopSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (signalFd < 0 || wakeFd < 0) {
+        if (signalFd >= 0)
+            close(signalFd);
+        if (wakeFd >= 0)
+            close(wakeFd);
+        pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+        throw std::runtime_error("Failed to create the descriptors of the process lifecycle");
+    }
+}
+
+// Starts a worker thread that is joined when the process stops
+void ProcessLifecycle::addWorker(std::function<void()> worker)
+{
+    if (!worker)
+        throw std::invalid_argument("Invalid worker: worker cannot be null.");
+
+    workers.emplace_back(std::move(worker));
+}
+
+// Starts a worker that blocks in a call of its own, interrupt is called once the process is stopping
+void ProcessLifecycle::addWorker(std::function<void()> worker, std::function<void()> interrupt)
+{
+    if (!interrupt)
+        throw std::invalid_argument("Invalid interrupt: interrupt cannot be null.");
+
+    addWorker(std::move(worker));
+    interrupts.push_back(std::move(interrupt));
+}
+
+// Adds a step of the shutdown, the steps run after the workers are joined in the reverse order of their addition
+void ProcessLifecycle::onShutdown(std::function<void()> step)
+{
+    if (!step)
+        throw std::invalid_argument("Invalid shutdown step: step cannot be null.");
+
+    shutdownSteps.push_back(std::move(step));
+}
+
+// Interrupts the workers that block and joins all of them
+void ProcessLifecycle::joinWorkers()
+{
+    for (std::function<void()> &interrupt : interrupts)
+        interrupt();
+    interrupts.clear();
+
+    for (std::thread &worker : workers)
+        if (worker.joinable())
+            worker.join();
+    workers.clear();
+}
+
+// Blocks until a stop signal or requestStop, then shuts down
+int ProcessLifecycle::run()
+{
+    int stopSignal = 0;
+    pollfd fds[2] = {{signalFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+    while (!stopping) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        signalfd_siginfo info;
+        if ((fds[0].revents & POLLIN) && read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+            stopSignal = info.ssi_signo;
+            break;
+        }
+    }
+
+    // Workers are woken before they are joined, the steps then release what the workers used
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopping = true;
+    }
+    stopRequested.notify_all();
+    joinWorkers();
+
+    for (auto step = shutdownSteps.rbegin(); step != shutdownSteps.rend(); ++step)
+        (*step)();
+    shutdownSteps.clear();
+
+    return stopSignal;
+}
+
+// Asks run to return, may be called from any thread
+void ProcessLifecycle::requestStop()
+{
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopping = true;
+    }
+    stopRequested.notify_all();
+
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+// Checks if the process is stopping
+bool ProcessLifecycle::isStopping()
+{
+    return stopping;
+}
+
+// Waits for the stop up to the timeout, returns true if the process is stopping
+bool ProcessLifecycle::waitForStop(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(stopMutex);
+    return stopRequested.wait_for(lock, timeout, [this]() { return stopping.load(); });
+}
+
+// Destructor - stops and joins the workers that are still running and unblocks the signals
+ProcessLifecycle::~ProcessLifecycle()
+{
+    requestStop();
+    joinWorkers();
+
+    close(signalFd);
+    close(wakeFd);
+    pthread_sigmask(SIG_SETMASK, &previousMask, nullptr);
+}
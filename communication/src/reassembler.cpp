@@ -0,0 +1,209 @@
+#include <stdexcept>
+#include <cstring>
+#include "../include/reassembler.h"
+#include "../include/message.h"
+
+// Spreads the source and ID bits over the whole index
+static size_t hashKey(uint64_t key)
+{
+    key ^= key >> 29;
+    key *= 0x9E3779B97F4A7C15ull;
+    return key ^ (key >> 32);
+}
+
+// Constructor - onComplete receives the source, the data and its size
+Reassembler::Reassembler(std::function<void(uint32_t, const uint8_t *, size_t)> onComplete, size_t slotCount)
+    : onComplete(onComplete), clock(0), duplicates(0), evictions(0), invalidPackets(0), corruptMessages(0)
+{
+    if (!onComplete)
+        throw std::invalid_argument("Invalid callback function: onComplete cannot be null.");
+
+    if (slotCount == 0)
+        throw std::invalid_argument("Invalid slot count: at least one slot is required.");
+
+    slots.resize(slotCount);
+    for (size_t i = 0; i < slotCount; ++i) {
+        slots[i].inUse = false;
+        slots[i].data.reserve(REASSEMBLY_SLOT_CAPACITY);
+        slots[i].arrived.reserve(REASSEMBLY_SLOT_CAPACITY / SIZE_PACKET / 64 + 1);
+        freeSlots.push_back(slotCount - 1 - i);
+    }
+
+    // Kept at most half full, so probe sequences stay short
+    size_t indexSize = 1;
+    while (indexSize < 2 * slotCount)
+        indexSize <<= 1;
+    indexKeys.resize(indexSize);
+    indexSlots.assign(indexSize, -1);
+    indexMask = indexSize - 1;
+}
+
+// Places the packet in its message, returns false if the packet was rejected or completed a corrupt message
+bool Reassembler::addPacket(const Packet &packet)
+{
+    const Packet::Header &header = packet.header;
+    const uint8_t *payload = reinterpret_cast<const uint8_t *>(packet.data);
+    bool isLast = header.PSN + 1 == header.TPS;
+    if (header.TPS == 0 || header.PSN >= header.TPS || header.DLC > SIZE_PACKET ||
+        (!isLast && header.DLC != SIZE_PACKET) || (uint64_t)header.TPS * SIZE_PACKET > REASSEMBLY_MAX_MESSAGE_SIZE) {
+        invalidPackets++;
+        return false;
+    }
+
+    // A single-packet message is delivered straight from the packet
+    if (header.TPS == 1) {
+        onComplete(header.SrcID, payload, header.DLC);
+        return true;
+    }
+
+    // Two sources may use the same message ID, the key keeps their messages apart
+    uint64_t key = ((uint64_t)header.SrcID << 32) | header.ID;
+    Slot &slot = acquireSlot(key, header.TPS);
+    slot.lastUsed = ++clock;
+
+    uint64_t bit = 1ull << (header.PSN % 64);
+    uint64_t &word = slot.arrived[header.PSN / 64];
+    if (word & bit) {
+        duplicates++;
+
+        // Senders start a message from its first packet, a repeated first packet means
+        // the previous message with this ID lost a packet and a new one begins
+        if (header.PSN != 0)
+            return false;
+        resetSlot(slot, header.TPS);
+    }
+
+    slot.arrived[header.PSN / 64] |= bit;
+    std::memcpy(slot.data.data() + (size_t)header.PSN * SIZE_PACKET, payload, header.DLC);
+    if (isLast)
+        slot.length = (size_t)header.PSN * SIZE_PACKET + header.DLC;
+
+    if (++slot.received == slot.tps) {
+        // The CRC-32C is checked and cut off, a message completed by a packet of another one is dropped
+        bool intact = Message::validMessageCRC(slot.data.data(), slot.length);
+        if (intact)
+            onComplete(header.SrcID, slot.data.data(), slot.length - MESSAGE_CRC_SIZE);
+        else
+            corruptMessages++;
+        releaseSlot(slot);
+        return intact;
+    }
+
+    return true;
+}
+
+// Returns the slot of a message, or starts a new one
+Reassembler::Slot &Reassembler::acquireSlot(uint64_t key, uint32_t tps)
+{
+    size_t position = indexPosition(key);
+    if (indexSlots[position] >= 0) {
+        Slot &slot = slots[indexSlots[position]];
+
+        // A different length means a new message replaced one that will never complete
+        if (slot.tps != tps) {
+            evictions++;
+            resetSlot(slot, tps);
+        }
+        return slot;
+    }
+
+    if (freeSlots.empty()) {
+        Slot *oldest = &slots[0];
+        for (Slot &slot : slots)
+            if (slot.lastUsed < oldest->lastUsed)
+                oldest = &slot;
+        evictions++;
+        releaseSlot(*oldest);
+        position = indexPosition(key);
+    }
+
+    uint32_t slotIndex = freeSlots.back();
+    freeSlots.pop_back();
+    Slot &slot = slots[slotIndex];
+    slot.key = key;
+    slot.inUse = true;
+    resetSlot(slot, tps);
+
+    indexKeys[position] = key;
+    indexSlots[position] = slotIndex;
+    return slot;
+}
+
+// Prepares a slot for a new message
+void Reassembler::resetSlot(Slot &slot, uint32_t tps)
+{
+    // Both buffers keep their capacity, only a larger message than any before allocates
+    slot.tps = tps;
+    slot.received = 0;
+    slot.length = 0;
+    slot.data.resize((size_t)tps * SIZE_PACKET);
+    slot.arrived.assign((tps + 63) / 64, 0);
+}
+
+// Returns a slot to the pool after its message was delivered or evicted
+void Reassembler::releaseSlot(Slot &slot)
+{
+    indexErase(slot.key);
+    slot.inUse = false;
+    freeSlots.push_back(&slot - slots.data());
+}
+
+// Position of the key in the index, or of the empty entry where it would be inserted
+size_t Reassembler::indexPosition(uint64_t key) const
+{
+    size_t position = hashKey(key) & indexMask;
+    while (indexSlots[position] >= 0 && indexKeys[position] != key)
+        position = (position + 1) & indexMask;
+    return position;
+}
+
+// Removes the key from the index, shifting back the entries that probed past it
+void Reassembler::indexErase(uint64_t key)
+{
+    size_t hole = indexPosition(key);
+    if (indexSlots[hole] < 0)
+        return;
+
+    indexSlots[hole] = -1;
+    for (size_t next = (hole + 1) & indexMask; indexSlots[next] >= 0; next = (next + 1) & indexMask) {
+        // An entry may move back only if the hole is not before its home position
+        size_t home = hashKey(indexKeys[next]) & indexMask;
+        if (((next - home) & indexMask) < ((next - hole) & indexMask))
+            continue;
+
+        indexKeys[hole] = indexKeys[next];
+        indexSlots[hole] = indexSlots[next];
+        indexSlots[next] = -1;
+        hole = next;
+    }
+}
+
+// Number of messages in reassembly
+size_t Reassembler::pendingMessages() const
+{
+    return slots.size() - freeSlots.size();
+}
+
+// Packets whose PSN was already received
+uint64_t Reassembler::getDuplicates() const
+{
+    return duplicates;
+}
+
+// Incomplete messages dropped to make room for new ones
+uint64_t Reassembler::getEvictions() const
+{
+    return evictions;
+}
+
+// Packets with an impossible PSN, TPS or DLC
+uint64_t Reassembler::getInvalidPackets() const
+{
+    return invalidPackets;
+}
+
+// Messages of several packets whose CRC-32C did not match
+uint64_t Reassembler::getCorruptMessages() const
+{
+    return corruptMessages;
+}
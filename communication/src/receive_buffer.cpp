@@ -0,0 +1,96 @@
+#include <stdexcept>
+#include <algorithm>
+#include "../include/receive_buffer.h"
+
+// Constructor
+ReceiveBuffer::ReceiveBuffer(size_t capacity) : readIndex(0), writeIndex(0), corrupted(false)
+{
+    if (capacity < WIRE_FRAME_PREFIX_SIZE + WIRE_MAX_FRAME_LENGTH || (capacity & (capacity - 1)))
+        throw std::invalid_argument("Invalid capacity: must be a power of two that holds a whole frame.");
+
+    buffer.resize(capacity);
+    mask = capacity - 1;
+}
+
+// Start of the contiguous free region to receive into
+uint8_t *ReceiveBuffer::writePointer()
+{
+    return buffer.data() + (writeIndex & mask);
+}
+
+// Size of the contiguous free region
+size_t ReceiveBuffer::writableSize() const
+{
+    size_t freeBytes = buffer.size() - size();
+    size_t untilEnd = buffer.size() - (writeIndex & mask);
+    return std::min(freeBytes, untilEnd);
+}
+
+// Marks length bytes after writePointer as received
+void ReceiveBuffer::commit(size_t length)
+{
+    writeIndex += length;
+}
+
+// Number of received bytes that were not consumed yet
+size_t ReceiveBuffer::size() const
+{
+    return writeIndex - readIndex;
+}
+
+// Copies length bytes starting offset bytes after the read position
+void ReceiveBuffer::peek(size_t offset, uint8_t *destination, size_t length) const
+{
+    size_t start = (readIndex + offset) & mask;
+    size_t firstPart = std::min(length, buffer.size() - start);
+    std::memcpy(destination, buffer.data() + start, firstPart);
+    std::memcpy(destination + firstPart, buffer.data(), length - firstPart);
+}
+
+// Extracts the next complete packet, returns false if more bytes are needed or the stream is corrupted
+bool ReceiveBuffer::nextPacket(Packet &packet)
+{
+    while (!corrupted && size() >= WIRE_FRAME_PREFIX_SIZE) {
+        uint8_t prefix[WIRE_FRAME_PREFIX_SIZE];
+        peek(0, prefix, WIRE_FRAME_PREFIX_SIZE);
+        size_t frameLength = prefix[0] | (prefix[1] << 8);
+        if (frameLength < WIRE_HEADER_SIZE || frameLength > WIRE_MAX_FRAME_LENGTH) {
+            corrupted = true;
+            return false;
+        }
+
+        if (size() < WIRE_FRAME_PREFIX_SIZE + frameLength)
+            return false;
+
+        // Decodes in place unless the frame wraps around the end of the ring
+        uint8_t frame[WIRE_MAX_FRAME_LENGTH];
+        const uint8_t *framePointer = buffer.data() + ((readIndex + WIRE_FRAME_PREFIX_SIZE) & mask);
+        if (((readIndex + WIRE_FRAME_PREFIX_SIZE) & mask) + frameLength > buffer.size()) {
+            peek(WIRE_FRAME_PREFIX_SIZE, frame, frameLength);
+            framePointer = frame;
+        }
+
+        ErrorCode res = decodePacket(framePointer, frameLength, packet);
+        readIndex += WIRE_FRAME_PREFIX_SIZE + frameLength;
+        if (size() == 0)
+            readIndex = writeIndex = 0;
+
+        if (res == ErrorCode::SUCCESS)
+            return true;
+
+        // A frame of a known version with a wrong length means the sender is broken,
+        // frames of other versions are skipped since the prefix keeps the stream aligned
+        if (encodedPayloadSize(framePointer) >= 0) {
+            corrupted = true;
+            return false;
+        }
+    }
+
+    return false;
+}
+
+// True once a frame with an impossible length was seen, the connection cannot be resynchronized
+bool ReceiveBuffer::isCorrupted() const
+{
+    return corrupted;
+}
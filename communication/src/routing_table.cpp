@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <atomic>
+#include "../include/routing_table.h"
+
+// Constructor
+RoutingTable::RoutingTable() : current(std::make_shared<Snapshot>()) {}
+
+// Publishes a new version, must be called under writeMutex
+void RoutingTable::publish(std::shared_ptr<const Snapshot> snapshot)
+{
+    std::atomic_store_explicit(&current, std::move(snapshot), std::memory_order_release);
+}
+
+// Registers the socket under the ID, fails if either of them is already registered
+bool RoutingTable::add(int socket, uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::shared_ptr<const Snapshot> old = snapshot();
+    if (old->socketByID.count(id) || old->idBySocket.count(socket))
+        return false;
+
+    std::shared_ptr<Snapshot> updated = std::make_shared<Snapshot>(*old);
+    updated->socketByID[id] = socket;
+    updated->idBySocket[socket] = id;
+    updated->sockets.push_back(socket);
+    publish(std::move(updated));
+    return true;
+}
+
+// Unregisters the socket, returns false if it was not registered
+bool RoutingTable::remove(int socket)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::shared_ptr<const Snapshot> old = snapshot();
+    auto it = old->idBySocket.find(socket);
+    if (it == old->idBySocket.end())
+        return false;
+
+    std::shared_ptr<Snapshot> updated = std::make_shared<Snapshot>(*old);
+    updated->socketByID.erase(it->second);
+    updated->idBySocket.erase(socket);
+    updated->sockets.erase(std::find(updated->sockets.begin(), updated->sockets.end(), socket));
+    publish(std::move(updated));
+    return true;
+}
+
+// Unregisters everything and returns the sockets that were registered
+std::vector<int> RoutingTable::clear()
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::vector<int> sockets = snapshot()->sockets;
+    publish(std::make_shared<Snapshot>());
+    return sockets;
+}
+
+// Returns the socket of the ID or -1
+int RoutingTable::findSocket(uint32_t id) const
+{
+    std::shared_ptr<const Snapshot> table = snapshot();
+    auto it = table->socketByID.find(id);
+    return it == table->socketByID.end() ? -1 : it->second;
+}
+
+// Returns true and sets the ID if the socket is registered
+bool RoutingTable::findID(int socket, uint32_t &id) const
+{
+    std::shared_ptr<const Snapshot> table = snapshot();
+    auto it = table->idBySocket.find(socket);
+    if (it == table->idBySocket.end())
+        return false;
+
+    id = it->second;
+    return true;
+}
+
+// Checks if the socket is registered
+bool RoutingTable::containsSocket(int socket) const
+{
+    return snapshot()->idBySocket.count(socket) != 0;
+}
+
+// Checks if the ID is registered
+bool RoutingTable::containsID(uint32_t id) const
+{
+    return snapshot()->socketByID.count(id) != 0;
+}
+
+// Number of registered processes
+size_t RoutingTable::size() const
+{
+    return snapshot()->sockets.size();
+}
+
+// The current version, stays valid and unchanged while held
+std::shared_ptr<const RoutingTable::Snapshot> RoutingTable::snapshot() const
+{
+    return std::atomic_load_explicit(&current, std::memory_order_acquire);
+}
@@ -1,267 +1,682 @@
-#include <csignal>
-#include <iostream>
-#include "../include/server_connection.h"
-
-// Constructor
-ServerConnection::ServerConnection(int port, std::function<void(Packet&)> callback, ISocket* socketInterface) {
-    setPort(port);
-    setReceiveDataCallback(callback);
-    setSocketInterface(socketInterface);
-    running = false;
-}
-
-// Initializes the listening socket
-ErrorCode ServerConnection::startConnection()
-{
-    // Create socket TCP
-    serverSocket = socketInterface->socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket < 0)
-        return ErrorCode::SOCKET_FAILED;
-
-    // Setting the socket to allow reuse of address and port
-    int opt = 1;
-    int setSockOptRes = socketInterface->setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt));
-    if (setSockOptRes) {
-        socketInterface->close(serverSocket);
-        return ErrorCode::SOCKET_FAILED;
-    }
-    
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(port);
-
-    int bindRes = socketInterface->bind(serverSocket, (struct sockaddr *)&address, sizeof(address));
-    if (bindRes < 0) {
-        socketInterface->close(serverSocket);
-        return ErrorCode::BIND_FAILED;
-    }
-
-    int lisRes = socketInterface->listen(serverSocket, 5);
-    if (lisRes < 0) {
-        socketInterface->close(serverSocket);
-        return ErrorCode::LISTEN_FAILED;
-    }
-    
-    running = true;
-    mainThread = std::thread(&ServerConnection::startThread, this);
-    mainThread.detach();
-
-    return ErrorCode::SUCCESS;
-}
-
-// Starts listening for connection requests
-void ServerConnection::startThread()
-{
-    while (running) {
-        int clientSocket = socketInterface->accept(serverSocket, nullptr, nullptr);
-        if (!clientSocket)
-            continue;
-        
-        if(clientSocket<0){
-            stopServer();
-            return;
-        }
-        // Opens a new thread for handleClient - listening to messages from the process
-        {
-            std::lock_guard<std::mutex> lock(threadMutex);
-            clientThreads.emplace_back(&ServerConnection::handleClient, this, clientSocket);
-        } 
-    }
-}
-
-// Closes the sockets and the threads
-void ServerConnection::stopServer()
-{
-    if(!running)
-        return;
-        
-    running = false;
-    socketInterface->close(serverSocket);
-    {
-        std::lock_guard<std::mutex> lock(socketMutex);
-        for (int sock : sockets)
-            socketInterface->close(sock);
-        sockets.clear();
-    }
-    {
-        std::lock_guard<std::mutex> lock(threadMutex);
-        for (auto &th : clientThreads)
-            if (th.joinable())
-                th.join();
-    }
-}
-
-// Runs in a thread for each process - waits for a message and forwards it to the manager
-void ServerConnection::handleClient(int clientSocket)
-{
-    Packet packet;
-    int valread = socketInterface->recv(clientSocket, &packet, sizeof(Packet), 0);
-
-    //implement according to CAN bus
-    if (valread <= 0)
-        return;
-    
-    uint32_t clientID = packet.header.SrcID;
-    if(!isValidId(clientID))
-        return;
-
-    {
-        std::lock_guard<std::mutex> lock(IDMapMutex);
-        clientIDMap[clientSocket] = clientID;
-    }
-
-    {
-        std::lock_guard<std::mutex> lock(socketMutex);
-        sockets.push_back(clientSocket);
-    }
-
-    while (running) {
-        int valread = socketInterface->recv(clientSocket, &packet, sizeof(Packet), 0);
-        if (valread == 0)
-            break;
-
-        if(valread < 0)
-           continue;
-     
-        receiveDataCallback(packet);
-    }
-
-    {
-    // If the process is no longer connected
-    std::lock_guard<std::mutex> lock(socketMutex);
-    auto it = std::find(sockets.begin(), sockets.end(), clientSocket);
-    socketInterface->close(*it);
-    if (it != sockets.end())
-        sockets.erase(it);
-    }
-    {
-        std::lock_guard<std::mutex> lock(IDMapMutex);
-        clientIDMap.erase(clientSocket);
-    }
-}
-
-// Implementation according to the CAN BUS
-bool ServerConnection::isValidId(uint32_t id)
-{
-    std::lock_guard<std::mutex> lock(IDMapMutex);
-    return clientIDMap.find(id) == clientIDMap.end();
-}
-
-// Returns the sockets ID
-int ServerConnection::getClientSocketByID(uint32_t destID)
-{
-    std::lock_guard<std::mutex> lock(IDMapMutex);
-    for (const auto &client : clientIDMap)
-        if (client.second == destID)
-            return client.first;
-
-    return -1;
-}
-
-// Sends the message to destination
-ErrorCode ServerConnection::sendDestination(const Packet &packet)
-{
-    int targetSocket = getClientSocketByID(packet.header.DestID);
-    if (targetSocket == -1)
-        return ErrorCode::INVALID_CLIENT_ID;
-    
-    ssize_t bytesSent = socketInterface->send(targetSocket, &packet, sizeof(Packet), 0);
-    if (!bytesSent)
-        return ErrorCode::SEND_FAILED;
-
-    if (bytesSent<0){
-        //closeConnection();
-        return ErrorCode::CONNECTION_FAILED;
-    }
-    
-    return ErrorCode::SUCCESS;
-}
-
-// Sends the message to all connected processes - broadcast
-ErrorCode ServerConnection::sendBroadcast(const Packet &packet)
-{
-    std::lock_guard<std::mutex> lock(socketMutex);
-    for (int sock : sockets) {
-        ssize_t bytesSent = socketInterface->send(sock, &packet, sizeof(Packet), 0);
-        if (bytesSent < sizeof(Packet))
-            return ErrorCode::SEND_FAILED;
-        if (bytesSent<0){
-            //closeConnection();
-            return ErrorCode::CONNECTION_FAILED;
-        }
-    }
-
-    return ErrorCode::SUCCESS;
-}
-
-// Sets the server's port number, throws an exception if the port is invalid.
-void ServerConnection::setPort(int port) {
-    if (port <= 0 || port > 65535)
-        throw std::invalid_argument("Invalid port number: Port must be between 1 and 65535.");
-
-    this->port = port;
-}
-
-// Sets the callback for receiving data, throws an exception if the callback is null.
-void ServerConnection::setReceiveDataCallback(std::function<void(Packet&)> callback) {
-    if (!callback) {
-        throw std::invalid_argument("Invalid callback function: callback cannot be null.");
-    }
-    this->receiveDataCallback = callback;
-}
-
-// Sets the socket interface, throws an exception if the socketInterface is null.
-void ServerConnection::setSocketInterface(ISocket* socketInterface) {
-    if (socketInterface == nullptr) {
-        throw std::invalid_argument("Invalid socket interface: socketInterface cannot be null.");
-    }
-    this->socketInterface = socketInterface;
-}
-
-// For testing
-int ServerConnection::getServerSocket()
-{
-    return serverSocket;
-}
-
-int ServerConnection::isRunning()
-{
-    return running;
-}
-
-std::vector<int>* ServerConnection::getSockets()
-{
-    return &sockets;
-}
-
-std::mutex* ServerConnection::getSocketMutex()
-{
-    return &socketMutex;
-}
-
-std::mutex* ServerConnection::getIDMapMutex()
-{
-    return &IDMapMutex;
-}
-
-std::map<int, uint32_t>* ServerConnection::getClientIDMap()
-{
-    return &clientIDMap;
-}
-
-void ServerConnection::testHandleClient(int clientSocket)
-{
-    handleClient(clientSocket);
-}
-
-int ServerConnection::testGetClientSocketByID(uint32_t destID)
-{
-    return getClientSocketByID(destID);
-}
-
-// Destructor
-ServerConnection::~ServerConnection()
-{
-    stopServer();
-    delete socketInterface;
+#include <csignal>
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include "../include/server_connection.h"
+
+// Constructor
+ServerConnection::ServerConnection(int port, std::function<void(Packet&)> callback, ISocket* socketInterface) {
+    setPort(port);
+    setReceiveDataCallback(callback);
+    setSocketInterface(socketInterface);
+    running = false;
+    mode = ServerMode::THREAD_PER_CLIENT;
+    workerCount = 1;
+    slowConsumerPolicy = SlowConsumerPolicy::DROP;
+    outboundQueueSize = OUTBOUND_QUEUE_SIZE;
+    deferredCredits = false;
+    clientLimit = 0;
+}
+
+// Initializes the listening socket
+ErrorCode ServerConnection::startConnection()
+{
+    // Create socket TCP
+    serverSocket = socketInterface->socket(AF_INET, SOCK_STREAM, 0);
+    if (serverSocket < 0)
+        return ErrorCode::SOCKET_FAILED;
+
+    // Setting the socket to allow reuse of address and port
+    int opt = 1;
+    int setSockOptRes = socketInterface->setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt));
+    if (setSockOptRes) {
+        socketInterface->close(serverSocket);
+        return ErrorCode::SOCKET_FAILED;
+    }
+    
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+
+    int bindRes = socketInterface->bind(serverSocket, (struct sockaddr *)&address, sizeof(address));
+    if (bindRes < 0) {
+        socketInterface->close(serverSocket);
+        return ErrorCode::BIND_FAILED;
+    }
+
+    int lisRes = socketInterface->listen(serverSocket, 5);
+    if (lisRes < 0) {
+        socketInterface->close(serverSocket);
+        return ErrorCode::LISTEN_FAILED;
+    }
+
+    if (mode == ServerMode::REACTOR) {
+        eventLoops.clear();
+        for (size_t i = 0; i < workerCount; ++i) {
+            eventLoops.emplace_back(new EventLoop(socketInterface,
+                std::bind(&ServerConnection::handleReadable, this, std::placeholders::_1),
+                std::bind(&ServerConnection::closeClient, this, std::placeholders::_1),
+                std::bind(&ServerConnection::handleWritable, this, std::placeholders::_1)));
+            if (eventLoops.back()->start() != ErrorCode::SUCCESS) {
+                eventLoops.clear();
+                socketInterface->close(serverSocket);
+                return ErrorCode::SOCKET_FAILED;
+            }
+        }
+    }
+    
+    running = true;
+    mainThread = std::thread(&ServerConnection::startThread, this);
+
+    return ErrorCode::SUCCESS;
+}
+
+// Starts listening for connection requests
+void ServerConnection::startThread()
+{
+    while (running) {
+        int clientSocket = socketInterface->accept(serverSocket, nullptr, nullptr);
+        if (!clientSocket)
+            continue;
+        
+        // stopServer wakes the accept by closing the socket. A failure while running, such as running out of
+        // descriptors, is retried after a pause
+        if (clientSocket < 0) {
+            if (running)
+                std::this_thread::sleep_for(std::chrono::milliseconds(SERVER_ACCEPT_RETRY_MS));
+            continue;
+        }
+        // Hands the socket to a fixed event loop, so all its packets are handled by one thread
+        if (mode == ServerMode::REACTOR) {
+            EventLoop* loop = eventLoops[clientSocket % eventLoops.size()].get();
+            {
+                std::unique_lock<std::shared_mutex> lock(queueMutex);
+                outboundQueues[clientSocket] = std::make_shared<OutboundQueue>(socketInterface, loop, clientSocket, outboundQueueSize);
+            }
+            if (loop->addSocket(clientSocket) != ErrorCode::SUCCESS)
+                closeClient(clientSocket);
+            continue;
+        }
+
+        // Opens a new thread for handleClient - listening to messages from the process
+        {
+            std::lock_guard<std::mutex> lock(threadMutex);
+            reapClientThreads();
+            threadSockets.insert(clientSocket);
+            clientThreads.emplace_back(&ServerConnection::handleClient, this, clientSocket);
+        } 
+    }
+}
+
+// Closes the sockets and the threads
+void ServerConnection::stopServer()
+{
+    if(!running)
+        return;
+        
+    running = false;
+    socketInterface->close(serverSocket);
+
+    // Joined, a detached accept thread could outlive the server and stop the next one that reuses its memory
+    if (mainThread.joinable())
+        mainThread.join();
+
+    // Stops dispatching before the sockets are closed under the loops
+    for (auto &loop : eventLoops)
+        loop->stop();
+
+    // Every socket of the event loops has a queue, including the sockets that never sent their ID
+    std::unordered_set<int> closedSockets;
+    {
+        std::unique_lock<std::shared_mutex> lock(queueMutex);
+        for (auto &queue : outboundQueues) {
+            queue.second->close();
+            socketInterface->close(queue.first);
+            closedSockets.insert(queue.first);
+        }
+        outboundQueues.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        receiveBuffers.clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(creditMutex);
+        creditsOwed.clear();
+    }
+    filterTable.clear();
+
+    // The threads of the processes own their sockets, they are woken and close them themselves
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(threadMutex);
+        for (int sock : threadSockets)
+            socketInterface->shutdown(sock, SHUT_RDWR);
+        threads.swap(clientThreads);
+    }
+    for (auto &th : threads)
+        if (th.joinable())
+            th.join();
+    // Cleared once joined, the ids of the threads may be reused by the next server
+    {
+        std::lock_guard<std::mutex> lock(threadMutex);
+        finishedThreads.clear();
+    }
+
+    // The sockets of the event loops are already closed
+    for (int sock : routingTable.clear())
+        if (!closedSockets.count(sock))
+            socketInterface->close(sock);
+}
+
+// Joins the threads of the processes that have disconnected, called with threadMutex held
+void ServerConnection::reapClientThreads()
+{
+    for (std::thread::id id : finishedThreads) {
+        auto it = std::find_if(clientThreads.begin(), clientThreads.end(),
+                               [id](const std::thread &th) { return th.get_id() == id; });
+        if (it == clientThreads.end())
+            continue;
+        // The thread only returns once it is listed, the join does not wait on the lock
+        it->join();
+        clientThreads.erase(it);
+    }
+    finishedThreads.clear();
+}
+
+// Runs in a thread for each process - waits for a message and forwards it to the manager
+void ServerConnection::handleClient(int clientSocket)
+{
+    ReceiveBuffer buffer;
+    do {
+        int valread = socketInterface->recv(clientSocket, buffer.writePointer(), buffer.writableSize(), 0);
+        if (valread == 0)
+            break;
+
+        // Only an interrupted read is retried, a failing socket would otherwise spin this thread
+        if (valread < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        buffer.commit(valread);
+        if (!dispatchPackets(clientSocket, buffer))
+            break;
+    } while (running);
+
+    // Removed first, stopServer must not shut down the descriptor once it may be reused
+    {
+        std::lock_guard<std::mutex> lock(threadMutex);
+        threadSockets.erase(clientSocket);
+    }
+    // If the process is no longer connected
+    closeClient(clientSocket);
+
+    // Listed last, the next accept joins the thread instead of keeping it until stopServer
+    std::lock_guard<std::mutex> lock(threadMutex);
+    finishedThreads.push_back(std::this_thread::get_id());
+}
+
+// Forwards the complete packets of the buffer, the first packet of a connection registers it
+bool ServerConnection::dispatchPackets(int clientSocket, ReceiveBuffer &buffer)
+{
+    Packet packet;
+    uint32_t dispatched = 0;
+    while (buffer.nextPacket(packet)) {
+        RealSocket::logPacket(LogEvent::RECEIVE, packet);
+        packetsReceived.add();
+        bytesReceived.add(packet.header.DLC);
+
+        // The first packet of every connection carries the ID of the process
+        if (!isRegistered(clientSocket)) {
+            if (!registerClient(clientSocket, packet.header.SrcID))
+                return false;
+            if (packet.header.control == ControlType::HELLO) {
+                {
+                    std::lock_guard<std::mutex> lock(creditMutex);
+                    creditsOwed[clientSocket] = 0;
+                }
+                sendControl(clientSocket, ControlType::CREDIT, FLOW_CONTROL_WINDOW);
+            }
+            continue;
+        }
+
+        if (packet.header.control != ControlType::NONE) {
+            handleControl(clientSocket, packet);
+            continue;
+        }
+
+        receiveDataCallback(packet);
+        dispatched++;
+    }
+
+    if (dispatched && !deferredCredits)
+        releaseCredits(clientSocket, dispatched);
+
+    return !buffer.isCorrupted();
+}
+
+// Answers a frame of the connection itself
+void ServerConnection::handleControl(int clientSocket, const Packet &packet)
+{
+    switch (packet.header.control) {
+    case ControlType::HEARTBEAT:
+        sendControl(clientSocket, ControlType::HEARTBEAT);
+        break;
+
+    case ControlType::FILTER:
+        filterTable.add(clientSocket, FilterTable::decodeFilter(packet));
+        break;
+
+    case ControlType::FILTER_RESET:
+        filterTable.remove(clientSocket);
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Sends a frame of the connection itself, never dropped since a lost credit would stall the process for good.
+// In reactor mode it goes to the space of the queue kept for control frames, it is sent from the event loops
+// and the arbiter, which must not wait for a process that stopped reading
+ErrorCode ServerConnection::sendControl(int clientSocket, ControlType type, uint32_t value)
+{
+    Packet packet(0);
+    packet.header.control = type;
+    packet.header.ID = value;
+    uint8_t buffer[WIRE_MAX_FRAME_SIZE];
+    size_t length = encodeFrame(packet, buffer, sizeof(buffer));
+    return sendFrame(clientSocket, buffer, length, SlowConsumerPolicy::BLOCK, true);
+}
+
+// Adds credits for the socket and returns them once a batch is collected
+void ServerConnection::releaseCredits(int clientSocket, uint32_t count)
+{
+    uint32_t batch;
+    {
+        std::lock_guard<std::mutex> lock(creditMutex);
+        auto it = creditsOwed.find(clientSocket);
+        if (it == creditsOwed.end())
+            return;
+
+        it->second += count;
+        if (it->second < FLOW_CONTROL_CREDIT_BATCH)
+            return;
+        batch = it->second;
+        it->second = 0;
+    }
+
+    // Sent outside the lock, a blocking send must not hold back the other processes
+    sendControl(clientSocket, ControlType::CREDIT, batch);
+}
+
+// Returns the credits of packets of the process that the bus is done with
+void ServerConnection::returnCredits(uint32_t clientID, uint32_t count)
+{
+    int clientSocket = getClientSocketByID(clientID);
+    if (clientSocket != -1)
+        releaseCredits(clientSocket, count);
+}
+
+// Returns the receive buffer of a socket in reactor mode, creating it on first use
+ReceiveBuffer &ServerConnection::getReceiveBuffer(int clientSocket)
+{
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    std::unique_ptr<ReceiveBuffer> &buffer = receiveBuffers[clientSocket];
+    if (!buffer)
+        buffer.reset(new ReceiveBuffer());
+    return *buffer;
+}
+
+// Reads the pending packets of a socket in reactor mode, returns false if the socket should be closed
+bool ServerConnection::handleReadable(int clientSocket)
+{
+    ReceiveBuffer &buffer = getReceiveBuffer(clientSocket);
+
+    // Bounded so that one busy process cannot starve the other sockets of its loop
+    for (int i = 0; i < EPOLL_MAX_EVENTS; ++i) {
+        int valread = socketInterface->recv(clientSocket, buffer.writePointer(), buffer.writableSize(), MSG_DONTWAIT);
+        if (valread == 0)
+            return false;
+
+        if (valread < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+        buffer.commit(valread);
+        if (!dispatchPackets(clientSocket, buffer))
+            return false;
+    }
+
+    return true;
+}
+
+// Registers the socket under the ID sent in the first packet of the connection
+bool ServerConnection::registerClient(int clientSocket, uint32_t clientID)
+{
+    if (!allowedIDs.empty() && !allowedIDs.count(clientID)) {
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "ID " + std::to_string(clientID) + " does not belong to this bus, rejecting socket " + std::to_string(clientSocket));
+        return false;
+    }
+
+    // Serialized so that processes registering together on different event loops cannot pass the limit
+    std::lock_guard<std::mutex> lock(registrationMutex);
+    if (clientLimit && routingTable.size() >= clientLimit) {
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "The bus is full, rejecting ID " + std::to_string(clientID));
+        return false;
+    }
+
+    // The check is repeated by the table under its lock, two processes racing for an ID cannot both win
+    if(!isValidId(clientID) || !routingTable.add(clientSocket, clientID)) {
+        RealSocket::log.logMessage(logger::LogLevel::ERROR, "ID " + std::to_string(clientID) + " is already connected, rejecting socket " + std::to_string(clientSocket));
+        return false;
+    }
+
+    return true;
+}
+
+// Checks if the socket has already sent its ID
+bool ServerConnection::isRegistered(int clientSocket)
+{
+    return routingTable.containsSocket(clientSocket);
+}
+
+// Closes the socket and removes it from the routing tables
+void ServerConnection::removeClient(int clientSocket)
+{
+    // Only the caller that unregisters the socket closes it
+    if (routingTable.remove(clientSocket))
+        socketInterface->close(clientSocket);
+}
+
+// Closes a socket dropped by an event loop, including sockets that never sent their ID
+void ServerConnection::closeClient(int clientSocket)
+{
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        receiveBuffers.erase(clientSocket);
+    }
+    {
+        std::lock_guard<std::mutex> lock(creditMutex);
+        creditsOwed.erase(clientSocket);
+    }
+    filterTable.remove(clientSocket);
+
+    // Senders holding the queue stop writing before the descriptor can be reused
+    std::shared_ptr<OutboundQueue> queue;
+    {
+        std::unique_lock<std::shared_mutex> lock(queueMutex);
+        auto it = outboundQueues.find(clientSocket);
+        if (it != outboundQueues.end()) {
+            queue = it->second;
+            outboundQueues.erase(it);
+        }
+    }
+    if (queue)
+        queue->close();
+
+    if (isRegistered(clientSocket))
+        removeClient(clientSocket);
+    else
+        socketInterface->close(clientSocket);
+}
+
+// Implementation according to the CAN BUS - an ID belongs to a single node
+bool ServerConnection::isValidId(uint32_t id)
+{
+    return !routingTable.containsID(id);
+}
+
+// Returns the sockets ID
+int ServerConnection::getClientSocketByID(uint32_t destID)
+{
+    return routingTable.findSocket(destID);
+}
+
+// Sends the message to destination
+ErrorCode ServerConnection::sendDestination(const Packet &packet)
+{
+    int targetSocket = getClientSocketByID(packet.header.DestID);
+    if (targetSocket == -1)
+        return ErrorCode::INVALID_CLIENT_ID;
+    
+    uint8_t buffer[WIRE_MAX_FRAME_SIZE];
+    size_t length = encodeFrame(packet, buffer, sizeof(buffer));
+    if (!length)
+        return ErrorCode::INVALID_DATA_SIZE;
+
+    return sendFrame(targetSocket, buffer, length, slowConsumerPolicy);
+}
+
+// Sends the message to all connected processes - broadcast
+ErrorCode ServerConnection::sendBroadcast(const Packet &packet)
+{
+    // Encoded once and written to every socket
+    uint8_t buffer[WIRE_MAX_FRAME_SIZE];
+    size_t length = encodeFrame(packet, buffer, sizeof(buffer));
+    if (!length)
+        return ErrorCode::INVALID_DATA_SIZE;
+
+    // Sent over a snapshot, registrations during a slow broadcast do not wait for it.
+    // A failing process does not stop the others from receiving, the first error is reported
+    ErrorCode result = ErrorCode::SUCCESS;
+    std::shared_ptr<const RoutingTable::Snapshot> table = routingTable.snapshot();
+    std::shared_ptr<const FilterTable::Snapshot> filters = filterTable.snapshot();
+    for (int sock : table->sockets) {
+        // A process whose filters reject the ID is skipped before the frame is queued or written
+        if (!FilterTable::accepts(*filters, sock, packet.header.ID)) {
+            framesFiltered.add();
+            continue;
+        }
+
+        ErrorCode res = sendFrame(sock, buffer, length, slowConsumerPolicy);
+        if (res != ErrorCode::SUCCESS && result == ErrorCode::SUCCESS)
+            result = res;
+    }
+
+    return result;
+}
+
+// Sends an encoded frame to one socket, through its queue in reactor mode where a full queue applies the policy
+ErrorCode ServerConnection::sendFrame(int clientSocket, const uint8_t *frame, size_t length, SlowConsumerPolicy policy, bool control)
+{
+    ErrorCode result = ErrorCode::SUCCESS;
+    if (mode == ServerMode::REACTOR) {
+        std::shared_ptr<OutboundQueue> queue = getOutboundQueue(clientSocket);
+        if (!queue)
+            result = ErrorCode::CONNECTION_FAILED;
+        else
+            result = control ? queue->pushControl(frame, length) : queue->push(frame, length, policy);
+        if (result == ErrorCode::SEND_FAILED && policy == SlowConsumerPolicy::DROP)
+            framesDropped.add();
+    } else {
+        ssize_t sent = socketInterface->send(clientSocket, frame, length, 0);
+        if (sent < 0)
+            result = ErrorCode::CONNECTION_FAILED;
+        else if (sent < (ssize_t)length)
+            result = ErrorCode::SEND_FAILED;
+    }
+
+    if (result != ErrorCode::SUCCESS) {
+        sendErrors.add(-(int)result);
+        return result;
+    }
+
+    framesSent.add();
+    bytesSent.add(length);
+    return ErrorCode::SUCCESS;
+}
+
+// Returns the outbound queue of a socket in reactor mode or null
+std::shared_ptr<OutboundQueue> ServerConnection::getOutboundQueue(int clientSocket)
+{
+    std::shared_lock<std::shared_mutex> lock(queueMutex);
+    auto it = outboundQueues.find(clientSocket);
+    if (it == outboundQueues.end())
+        return nullptr;
+    return it->second;
+}
+
+// Writes the queued frames of a socket in reactor mode, returns false if the socket should be closed
+bool ServerConnection::handleWritable(int clientSocket)
+{
+    std::shared_ptr<OutboundQueue> queue = getOutboundQueue(clientSocket);
+    return !queue || queue->flush();
+}
+
+// Adds the traffic counters, the connected processes and their queue depths to the registry
+void ServerConnection::registerMetrics(MetricsRegistry &registry)
+{
+    registry.addCounter("vcs_server_packets_received_total", "Packets read from the connected processes.", packetsReceived);
+    registry.addCounter("vcs_server_bytes_received_total", "Payload bytes read from the connected processes.", bytesReceived);
+    registry.addCounter("vcs_server_frames_sent_total", "Frames written or queued for the connected processes.", framesSent);
+    registry.addCounter("vcs_server_bytes_sent_total", "Wire bytes written or queued for the connected processes.", bytesSent);
+    registry.addCounter("vcs_server_frames_dropped_total", "Frames dropped because a process did not keep up.", framesDropped);
+    registry.addCounter("vcs_server_frames_filtered_total", "Broadcast frames not sent because the acceptance filters of a process rejected them.", framesFiltered);
+    registry.addCounter("vcs_server_send_errors_total", "Frames that could not be sent, by error.", sendErrors, "error",
+                        [](uint32_t code) { return std::string(toString((ErrorCode)-(int)code)); });
+
+    registry.addGauge("vcs_server_clients", "Registered processes.", [this]() {
+        return MetricsRegistry::Samples{{"", (double)routingTable.size()}};
+    });
+
+    // Only reactor mode queues frames, the other modes report no depths
+    registry.addGauge("vcs_server_queue_depth_bytes", "Bytes waiting in the outbound queue of a process.", [this]() {
+        MetricsRegistry::Samples samples;
+        std::shared_lock<std::shared_mutex> lock(queueMutex);
+        for (const auto &entry : outboundQueues) {
+            uint32_t id;
+            if (routingTable.findID(entry.first, id))
+                samples.push_back({"client=\"" + std::to_string(id) + "\"", (double)entry.second->size()});
+        }
+        return samples;
+    });
+}
+
+// Selects the threading model, must be called before startConnection
+void ServerConnection::setServerMode(ServerMode mode, size_t workerCount) {
+    if (running)
+        throw std::logic_error("Server mode cannot be changed while the server is running.");
+
+    if (workerCount == 0)
+        throw std::invalid_argument("Invalid worker count: at least one event loop is required.");
+
+    this->mode = mode;
+    this->workerCount = workerCount;
+}
+
+// Selects what happens to frames for a process that does not keep up, used in reactor mode
+void ServerConnection::setSlowConsumerPolicy(SlowConsumerPolicy policy, size_t queueSize) {
+    if (running)
+        throw std::logic_error("Slow consumer policy cannot be changed while the server is running.");
+
+    if (!OutboundQueue::validCapacity(queueSize))
+        throw std::invalid_argument("Invalid queue size: must be a power of two whose control space holds a whole frame.");
+
+    slowConsumerPolicy = policy;
+    outboundQueueSize = queueSize;
+}
+
+// Credits of the received packets are returned by returnCredits instead of once the callback returns
+void ServerConnection::setDeferredCredits(bool deferred) {
+    if (running)
+        throw std::logic_error("Credit return cannot be changed while the server is running.");
+
+    deferredCredits = deferred;
+}
+
+// Accepts only processes with these IDs, an empty list accepts any process
+void ServerConnection::setAllowedIDs(const std::vector<uint32_t> &ids) {
+    if (running)
+        throw std::logic_error("The processes of the bus cannot be changed while the server is running.");
+
+    allowedIDs = std::unordered_set<uint32_t>(ids.begin(), ids.end());
+}
+
+// Limits the number of processes connected at once, 0 for no limit
+void ServerConnection::setClientLimit(uint32_t limit) {
+    if (running)
+        throw std::logic_error("The process limit cannot be changed while the server is running.");
+
+    clientLimit = limit;
+}
+
+// Sets the server's port number, throws an exception if the port is invalid.
+void ServerConnection::setPort(int port) {
+    if (port <= 0 || port > 65535)
+        throw std::invalid_argument("Invalid port number: Port must be between 1 and 65535.");
+
+    this->port = port;
+}
+
+// Sets the callback for receiving data, throws an exception if the callback is null.
+void ServerConnection::setReceiveDataCallback(std::function<void(Packet&)> callback) {
+    if (!callback) {
+        throw std::invalid_argument("Invalid callback function: callback cannot be null.");
+    }
+    this->receiveDataCallback = callback;
+}
+
+// Sets the socket interface, throws an exception if the socketInterface is null.
+void ServerConnection::setSocketInterface(ISocket* socketInterface) {
+    if (socketInterface == nullptr) {
+        throw std::invalid_argument("Invalid socket interface: socketInterface cannot be null.");
+    }
+    this->socketInterface = socketInterface;
+}
+
+// For testing
+int ServerConnection::getServerSocket()
+{
+    return serverSocket;
+}
+
+int ServerConnection::isRunning()
+{
+    return running;
+}
+
+RoutingTable* ServerConnection::getRoutingTable()
+{
+    return &routingTable;
+}
+
+FilterTable* ServerConnection::getFilterTable()
+{
+    return &filterTable;
+}
+
+void ServerConnection::testHandleClient(int clientSocket)
+{
+    handleClient(clientSocket);
+}
+
+size_t ServerConnection::testClientThreadCount()
+{
+    std::lock_guard<std::mutex> lock(threadMutex);
+    return clientThreads.size();
+}
+
+int ServerConnection::testGetClientSocketByID(uint32_t destID)
+{
+    return getClientSocketByID(destID);
+}
+
+bool ServerConnection::testHandleReadable(int clientSocket)
+{
+    return handleReadable(clientSocket);
+}
+
+bool ServerConnection::testHandleWritable(int clientSocket)
+{
+    return handleWritable(clientSocket);
+}
+
+// Destructor
+ServerConnection::~ServerConnection()
+{
+    stopServer();
+    delete socketInterface;
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "../include/wire_format.h"
+
+// Field offsets inside the encoded header
+#define WIRE_OFFSET_VERSION 0
+#define WIRE_OFFSET_FLAGS 1
+#define WIRE_OFFSET_DLC 2
+#define WIRE_OFFSET_CONTROL 3
+#define WIRE_OFFSET_ID 4
+#define WIRE_OFFSET_PSN 8
+#define WIRE_OFFSET_TPS 12
+#define WIRE_OFFSET_SRC_ID 16
+#define WIRE_OFFSET_DEST_ID 20
+#define WIRE_OFFSET_CRC 24
+#define WIRE_OFFSET_TIMESTAMP 26
+
+static void writeUint16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+}
+
+static void writeUint32(uint8_t *buffer, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        buffer[i] = (value >> (8 * i)) & 0xFF;
+}
+
+static void writeUint64(uint8_t *buffer, uint64_t value)
+{
+    writeUint32(buffer, value & 0xFFFFFFFF);
+    writeUint32(buffer + 4, value >> 32);
+}
+
+static uint16_t readUint16(const uint8_t *buffer)
+{
+    return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+static uint32_t readUint32(const uint8_t *buffer)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i)
+        value |= (uint32_t)buffer[i] << (8 * i);
+    return value;
+}
+
+static uint64_t readUint64(const uint8_t *buffer)
+{
+    return readUint32(buffer) | ((uint64_t)readUint32(buffer + 4) << 32);
+}
+
+// True if the bus stamped the packet on its way
+static bool isTraced(const Packet &packet)
+{
+    return packet.header.enqueueTime || packet.header.routeTime;
+}
+
+// Returns the number of bytes the packet occupies on the wire
+size_t encodedSize(const Packet &packet)
+{
+    return WIRE_HEADER_SIZE + (isTraced(packet) ? WIRE_TRACE_SIZE : 0) + packet.header.DLC;
+}
+
+// Writes the packet into buffer, returns the number of bytes written or 0 if the capacity is too small
+size_t encodePacket(const Packet &packet, uint8_t *buffer, size_t capacity)
+{
+    if (packet.header.DLC > SIZE_PACKET || capacity < encodedSize(packet))
+        return 0;
+
+    uint8_t flags = 0;
+    if (packet.header.isBroadcast)
+        flags |= WIRE_FLAG_BROADCAST;
+    if (packet.header.passive)
+        flags |= WIRE_FLAG_PASSIVE;
+    if (packet.header.RTR)
+        flags |= WIRE_FLAG_RTR;
+    if (isTraced(packet))
+        flags |= WIRE_FLAG_TRACE;
+
+    buffer[WIRE_OFFSET_VERSION] = WIRE_FORMAT_VERSION;
+    buffer[WIRE_OFFSET_FLAGS] = flags;
+    buffer[WIRE_OFFSET_DLC] = packet.header.DLC;
+    buffer[WIRE_OFFSET_CONTROL] = (uint8_t)packet.header.control;
+    writeUint32(buffer + WIRE_OFFSET_ID, packet.header.ID);
+    writeUint32(buffer + WIRE_OFFSET_PSN, packet.header.PSN);
+    writeUint32(buffer + WIRE_OFFSET_TPS, packet.header.TPS);
+    writeUint32(buffer + WIRE_OFFSET_SRC_ID, packet.header.SrcID);
+    writeUint32(buffer + WIRE_OFFSET_DEST_ID, packet.header.DestID);
+    writeUint16(buffer + WIRE_OFFSET_CRC, packet.header.CRC);
+    writeUint64(buffer + WIRE_OFFSET_TIMESTAMP, packet.header.timestamp);
+
+    size_t dataOffset = WIRE_HEADER_SIZE;
+    if (flags & WIRE_FLAG_TRACE) {
+        writeUint64(buffer + dataOffset, packet.header.enqueueTime);
+        writeUint64(buffer + dataOffset + 8, packet.header.routeTime);
+        dataOffset += WIRE_TRACE_SIZE;
+    }
+    std::memcpy(buffer + dataOffset, packet.data, packet.header.DLC);
+
+    return encodedSize(packet);
+}
+
+// Reads the payload length from an encoded header, returns -1 if the header is not valid
+int encodedPayloadSize(const uint8_t *header)
+{
+    if (header[WIRE_OFFSET_VERSION] != WIRE_FORMAT_VERSION || header[WIRE_OFFSET_DLC] > SIZE_PACKET ||
+        header[WIRE_OFFSET_CONTROL] > (uint8_t)ControlType::FILTER_RESET)
+        return -1;
+
+    return header[WIRE_OFFSET_DLC];
+}
+
+// Parses one encoded packet of exactly length bytes
+ErrorCode decodePacket(const uint8_t *buffer, size_t length, Packet &packet)
+{
+    if (length < WIRE_HEADER_SIZE)
+        return ErrorCode::INVALID_DATA_SIZE;
+
+    int dlc = encodedPayloadSize(buffer);
+    if (dlc < 0)
+        return ErrorCode::INVALID_DATA;
+
+    uint8_t flags = buffer[WIRE_OFFSET_FLAGS];
+    size_t dataOffset = WIRE_HEADER_SIZE + ((flags & WIRE_FLAG_TRACE) ? WIRE_TRACE_SIZE : 0);
+    if (length != dataOffset + dlc)
+        return ErrorCode::INVALID_DATA_SIZE;
+
+    std::memset(&packet, 0, sizeof(Packet));
+    packet.header.isBroadcast = flags & WIRE_FLAG_BROADCAST;
+    packet.header.passive = flags & WIRE_FLAG_PASSIVE;
+    packet.header.RTR = flags & WIRE_FLAG_RTR;
+    packet.header.control = (ControlType)buffer[WIRE_OFFSET_CONTROL];
+    packet.header.DLC = dlc;
+    packet.header.ID = readUint32(buffer + WIRE_OFFSET_ID);
+    packet.header.PSN = readUint32(buffer + WIRE_OFFSET_PSN);
+    packet.header.TPS = readUint32(buffer + WIRE_OFFSET_TPS);
+    packet.header.SrcID = readUint32(buffer + WIRE_OFFSET_SRC_ID);
+    packet.header.DestID = readUint32(buffer + WIRE_OFFSET_DEST_ID);
+    packet.header.CRC = readUint16(buffer + WIRE_OFFSET_CRC);
+    packet.header.timestamp = (int64_t)readUint64(buffer + WIRE_OFFSET_TIMESTAMP);
+    if (flags & WIRE_FLAG_TRACE) {
+        packet.header.enqueueTime = (int64_t)readUint64(buffer + WIRE_HEADER_SIZE);
+        packet.header.routeTime = (int64_t)readUint64(buffer + WIRE_HEADER_SIZE + 8);
+    }
+    std::memcpy(packet.data, buffer + dataOffset, dlc);
+
+    return ErrorCode::SUCCESS;
+}
+
+
+// Writes the length prefix followed by the encoded packet, returns the frame size or 0 if the capacity is too small
+size_t encodeFrame(const Packet &packet, uint8_t *buffer, size_t capacity)
+{
+    if (capacity < WIRE_FRAME_PREFIX_SIZE)
+        return 0;
+
+    size_t length = encodePacket(packet, buffer + WIRE_FRAME_PREFIX_SIZE, capacity - WIRE_FRAME_PREFIX_SIZE);
+    if (!length)
+        return 0;
+
+    writeUint16(buffer, length);
+    return WIRE_FRAME_PREFIX_SIZE + length;
+}
+
+// Parses the frame at the start of buffer, returns the frame size or 0 if it is incomplete or not valid
+size_t decodeFrame(const uint8_t *buffer, size_t length, Packet &packet)
+{
+    if (length < WIRE_FRAME_PREFIX_SIZE)
+        return 0;
+
+    size_t frameLength = readUint16(buffer);
+    if (length < WIRE_FRAME_PREFIX_SIZE + frameLength)
+        return 0;
+
+    if (decodePacket(buffer + WIRE_FRAME_PREFIX_SIZE, frameLength, packet) != ErrorCode::SUCCESS)
+        return 0;
+
+    return WIRE_FRAME_PREFIX_SIZE + frameLength;
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include "../include/async_sender.h"
+#include "../include/message.h"
+
+class AsyncSenderTest : public ::testing::Test {
+protected:
+    std::mutex writeMutex;
+    std::vector<size_t> batchSizes;
+    std::atomic<bool> blockWrites{false};
+    std::promise<void> firstWriteStarted;
+    std::promise<void> releaseWrites;
+    std::shared_future<void> released = releaseWrites.get_future().share();
+    ErrorCode writeResult = ErrorCode::SUCCESS;
+
+    AsyncSender sender = AsyncSender([this](std::vector<Packet> &packets) {
+        if (blockWrites.exchange(false)) {
+            firstWriteStarted.set_value();
+            released.wait();
+        }
+        std::lock_guard<std::mutex> lock(writeMutex);
+        batchSizes.push_back(packets.size());
+        return writeResult;
+    });
+
+    std::vector<Packet> packetsOf(const std::string &text) {
+        return Message(1, (void *)text.data(), text.size(), false, 2).getPackets();
+    }
+};
+
+// Test that messages queued while a write is in progress leave in one batch
+TEST_F(AsyncSenderTest, CoalescesQueuedMessages) {
+    blockWrites = true;
+    sender.start();
+    sender.submit(packetsOf("first"), nullptr);
+    firstWriteStarted.get_future().wait();
+
+    for (int i = 0; i < 5; ++i)
+        sender.submit(packetsOf("queued"), nullptr);
+    EXPECT_EQ(sender.pending(), 5);
+
+    releaseWrites.set_value();
+    sender.stop();
+
+    ASSERT_EQ(batchSizes.size(), 2);
+    EXPECT_EQ(batchSizes[0], 1);
+    EXPECT_EQ(batchSizes[1], 5);
+}
+
+// Test that every completion receives the result of its write
+TEST_F(AsyncSenderTest, CompletionsReceiveResult) {
+    writeResult = ErrorCode::SEND_FAILED;
+    sender.start();
+
+    std::promise<ErrorCode> result;
+    sender.submit(packetsOf("message"), [&result](ErrorCode res) { result.set_value(res); });
+
+    EXPECT_EQ(result.get_future().get(), ErrorCode::SEND_FAILED);
+}
+
+// Test that a failed message completes with its own error and is not written
+TEST_F(AsyncSenderTest, FailCompletesWithoutWriting) {
+    sender.start();
+
+    std::promise<ErrorCode> result;
+    sender.fail(ErrorCode::INVALID_DATA, [&result](ErrorCode res) { result.set_value(res); });
+
+    EXPECT_EQ(result.get_future().get(), ErrorCode::INVALID_DATA);
+    sender.stop();
+    EXPECT_TRUE(batchSizes.empty());
+}
+
+// Test that a failed message wakes an idle I/O thread to complete it
+TEST_F(AsyncSenderTest, FailWakesIdleThread) {
+    sender.start();
+
+    // The I/O thread wrote the first message and waits for more
+    std::promise<void> sent;
+    sender.submit(packetsOf("message"), [&sent](ErrorCode) { sent.set_value(); });
+    sent.get_future().wait();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::promise<ErrorCode> result;
+    std::future<ErrorCode> completed = result.get_future();
+    sender.fail(ErrorCode::INVALID_DATA, [&result](ErrorCode res) { result.set_value(res); });
+
+    ASSERT_EQ(completed.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    EXPECT_EQ(completed.get(), ErrorCode::INVALID_DATA);
+    sender.stop();
+    EXPECT_EQ(batchSizes.size(), 1);
+}
+
+// Test that a full queue rejects new messages on the caller's thread
+TEST_F(AsyncSenderTest, FullQueueRejects) {
+    blockWrites = true;
+    sender.start();
+    sender.submit(packetsOf("first"), nullptr);
+    firstWriteStarted.get_future().wait();
+
+    for (int i = 0; i < ASYNC_SEND_QUEUE_LIMIT; ++i)
+        sender.submit(packetsOf("queued"), nullptr);
+
+    ErrorCode rejected = ErrorCode::SUCCESS;
+    sender.submit(packetsOf("rejected"), [&rejected](ErrorCode res) { rejected = res; });
+    EXPECT_EQ(rejected, ErrorCode::SEND_FAILED);
+
+    releaseWrites.set_value();
+}
+
+// Test that stop sends what is queued and later messages are rejected
+TEST_F(AsyncSenderTest, StopDrainsQueue) {
+    std::atomic<int> completed{0};
+    sender.start();
+    for (int i = 0; i < 100; ++i)
+        sender.submit(packetsOf("message"), [&completed](ErrorCode res) {
+            if (res == ErrorCode::SUCCESS)
+                completed++;
+        });
+    sender.stop();
+    EXPECT_EQ(completed, 100);
+
+    ErrorCode afterStop = ErrorCode::SUCCESS;
+    sender.submit(packetsOf("late"), [&afterStop](ErrorCode res) { afterStop = res; });
+    EXPECT_EQ(afterStop, ErrorCode::CONNECTION_FAILED);
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "../include/bus_capture.h"
+
+#define CAPTURE_TEST_FILE "bus_capture_test.vcscap"
+
+// Test that the records are read back with their times and packets, in the order they were written
+TEST(BusCaptureTest, RecordsRoundTrip) {
+    uint8_t data[3] = {1, 2, 3};
+    Packet first(0x10, 0, 1, 1, 0, data, sizeof(data), true);
+    Packet second(0x20, 1, 2, 4, 5, data, 2, false);
+    {
+        CaptureWriter writer(CAPTURE_TEST_FILE);
+        EXPECT_TRUE(writer.write(1000, first));
+        EXPECT_TRUE(writer.write(-5, second));
+        EXPECT_EQ(writer.getPackets(), 2u);
+        EXPECT_TRUE(writer.close());
+    }
+
+    CaptureReader reader(CAPTURE_TEST_FILE);
+    CapturedPacket record;
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.time, 1000);
+    EXPECT_EQ(record.packet.header.ID, 0x10u);
+    EXPECT_TRUE(record.packet.header.isBroadcast);
+    EXPECT_EQ(record.packet.header.DLC, sizeof(data));
+    EXPECT_EQ(((uint8_t *)record.packet.data)[2], 3);
+
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.time, -5);
+    EXPECT_EQ(record.packet.header.ID, 0x20u);
+    EXPECT_EQ(record.packet.header.PSN, 1u);
+    EXPECT_EQ(record.packet.header.SrcID, 4u);
+    EXPECT_EQ(record.packet.header.DestID, 5u);
+    EXPECT_FALSE(record.packet.header.isBroadcast);
+
+    EXPECT_FALSE(reader.next(record));
+    EXPECT_FALSE(reader.isCorrupted());
+    std::remove(CAPTURE_TEST_FILE);
+}
+
+// Test that a missing file or a file of another kind is refused
+TEST(BusCaptureTest, RejectsOtherFiles) {
+    std::remove(CAPTURE_TEST_FILE);
+    EXPECT_THROW(CaptureReader reader(CAPTURE_TEST_FILE), std::runtime_error);
+
+    {
+        std::ofstream other(CAPTURE_TEST_FILE, std::ios::binary);
+        other << "not a capture";
+    }
+    EXPECT_THROW(CaptureReader reader(CAPTURE_TEST_FILE), std::runtime_error);
+    std::remove(CAPTURE_TEST_FILE);
+
+    EXPECT_THROW(CaptureWriter writer("/nonexistent/capture.vcscap"), std::runtime_error);
+}
+
+// Test that a record cut short, as by a bus killed while writing, ends the capture as damaged
+TEST(BusCaptureTest, TruncatedRecordIsCorrupted) {
+    uint8_t data[4] = {9, 9, 9, 9};
+    Packet packet(0x30, 0, 1, 1, 0, data, sizeof(data), true);
+    {
+        CaptureWriter writer(CAPTURE_TEST_FILE);
+        writer.write(1, packet);
+        writer.write(2, packet);
+    }
+
+    std::ifstream in(CAPTURE_TEST_FILE, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    {
+        std::ofstream out(CAPTURE_TEST_FILE, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), content.size() - 3);
+    }
+
+    CaptureReader reader(CAPTURE_TEST_FILE);
+    CapturedPacket record;
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.time, 1);
+    EXPECT_FALSE(reader.next(record));
+    EXPECT_TRUE(reader.isCorrupted());
+    std::remove(CAPTURE_TEST_FILE);
+}
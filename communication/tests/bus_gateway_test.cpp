@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../include/bus_gateway.h"
+#include "../include/bus_manager.h"
+
+// Polls the condition until it holds or the timeout passes
+static bool waitFor(std::function<bool()> condition, int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+// Test that a route matches the masked bits and replaces only them
+TEST(BusGatewayTest, RouteTranslatesMaskedBits) {
+    GatewayRoute exact = {0x123, 0x7FF, 0x456};
+    EXPECT_TRUE(exact.matches(0x123));
+    EXPECT_FALSE(exact.matches(0x124));
+    EXPECT_EQ(exact.translate(0x123), 0x456u);
+
+    // A range keeps the bits outside the mask
+    GatewayRoute range = {0x100, 0x7F0, 0x300};
+    EXPECT_TRUE(range.matches(0x10A));
+    EXPECT_FALSE(range.matches(0x11A));
+    EXPECT_EQ(range.translate(0x10A), 0x30Au);
+}
+
+// Test that a gateway without routes does not start
+TEST(BusGatewayTest, StartNeedsARoute) {
+    BusGateway gateway(90, 8181, 8182);
+    EXPECT_THROW(gateway.start(), std::logic_error);
+}
+
+// Test that a gateway forwards the routed broadcasts of one bus to another under their translated IDs
+TEST(BusGatewayTest, ForwardsRoutedFramesBetweenBuses) {
+    BusManager powertrain({}, 0, 8181);
+    BusManager body({}, 0, 8182);
+    powertrain.setMetricsFile("");
+    body.setMetricsFile("");
+    powertrain.setBitrate(0);
+    body.setBitrate(0);
+    ASSERT_EQ(powertrain.startConnection(), ErrorCode::SUCCESS);
+    ASSERT_EQ(body.startConnection(), ErrorCode::SUCCESS);
+
+    std::mutex receivedMutex;
+    std::vector<Packet> received;
+    ClientConnection receiver([&](Packet &packet) {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        received.push_back(packet);
+    });
+    receiver.setPort(8182);
+    ASSERT_EQ(receiver.connectToServer(2), ErrorCode::SUCCESS);
+
+    BusGateway gateway(90, 8181, 8182);
+    gateway.addRoute({0x10, 0x7FF, 0x20});
+    ASSERT_EQ(gateway.start(), ErrorCode::SUCCESS);
+    EXPECT_THROW(gateway.addRoute({0x11, 0x7FF, 0x21}), std::logic_error);
+
+    ClientConnection sender([](Packet &) {});
+    sender.setPort(8181);
+    ASSERT_EQ(sender.connectToServer(1), ErrorCode::SUCCESS);
+
+    uint8_t data[2] = {7, 8};
+    Packet routed(0x10, 0, 1, 1, 0, data, sizeof(data), true);
+    Packet unrouted(0x11, 0, 1, 1, 0, data, sizeof(data), true);
+    EXPECT_EQ(sender.sendPacket(unrouted), ErrorCode::SUCCESS);
+    EXPECT_EQ(sender.sendPacket(routed), ErrorCode::SUCCESS);
+
+    ASSERT_TRUE(waitFor([&]() { return gateway.getForwarded() == 1; }, 2000));
+    ASSERT_TRUE(waitFor([&]() {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        return received.size() == 1;
+    }, 2000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::lock_guard<std::mutex> lock(receivedMutex);
+    ASSERT_EQ(received.size(), 1u);
+    EXPECT_EQ(received[0].header.ID, 0x20u);
+    EXPECT_EQ(received[0].header.SrcID, 90u);
+    EXPECT_EQ(received[0].header.DLC, sizeof(data));
+    EXPECT_EQ(((uint8_t *)received[0].data)[1], 8);
+    EXPECT_EQ(gateway.getDropped(), 0u);
+}
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/bus_manager.h"
+#include "../include/message.h"
+#include "../include/reassembler.h"
+
+// Polls the condition until it holds or the timeout passes
+static bool waitFor(std::function<bool()> condition, int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+// The value of a series of a metric, 0 if the bus has not reported it
+static double metricValue(BusManager &bus, const std::string &series)
+{
+    std::string metrics = bus.getMetrics();
+    size_t position = metrics.find("\n" + series + " ");
+    if (position == std::string::npos)
+        return 0;
+    return std::stod(metrics.substr(position + series.size() + 2));
+}
+
+// Test that a process that stops reading holds back neither the bus nor the others, even while the bus owes it credits
+TEST(BusManagerTest, StalledProcessDoesNotStallOthers) {
+    BusManager bus({}, 0, 8185);
+    bus.setMetricsFile("");
+    ASSERT_EQ(bus.startConnection(), ErrorCode::SUCCESS);
+
+    // The stalled process takes its credits and then blocks in the first packet it receives, it reads nothing more
+    std::atomic<bool> release(false);
+    ClientConnection stalled([&release](Packet &) {
+        while (!release)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+    std::atomic<int> fromStalled(0);
+    std::atomic<int> fromLate(0);
+    ClientConnection receiver([&](Packet &packet) {
+        if (packet.header.SrcID == 1)
+            fromStalled++;
+        else if (packet.header.SrcID == 4)
+            fromLate++;
+    });
+    ClientConnection sender([](Packet &) {});
+
+    // Lets the stalled process go on however the test ends, its destructor waits for its receive thread
+    struct Release {
+        std::atomic<bool> &flag;
+        ~Release() { flag = true; }
+    } releaseOnExit{release};
+
+    for (ClientConnection *client : {&stalled, &receiver, &sender})
+        client->setPort(8185);
+    ASSERT_EQ(stalled.connectToServer(1), ErrorCode::SUCCESS);
+    ASSERT_EQ(receiver.connectToServer(2), ErrorCode::SUCCESS);
+    ASSERT_EQ(sender.connectToServer(3), ErrorCode::SUCCESS);
+
+    // The sender fills the socket and then the queue of the stalled process
+    uint8_t data[8] = {};
+    std::vector<Packet> toStalled(64, Packet(0x700, 0, 1, 3, 1, data, sizeof(data), false));
+    std::string stalledQueue = "vcs_server_queue_depth_bytes{client=\"1\"}";
+    double fullQueue = OUTBOUND_QUEUE_SIZE - OUTBOUND_QUEUE_SIZE / OUTBOUND_CONTROL_SHARE - WIRE_MAX_FRAME_SIZE;
+    for (int i = 0; i < 20000 && metricValue(bus, stalledQueue) < fullQueue; ++i)
+        ASSERT_EQ(sender.sendPackets(toStalled), ErrorCode::SUCCESS);
+    ASSERT_GE(metricValue(bus, stalledQueue), fullQueue);
+
+    // From now on the arbiter thread routes the packets and returns the credits, one thread for all the processes.
+    // The sender keeps the queue full, its packets lose the arbitration against the ones the test waits for
+    bus.setBitrate(1000000000);
+    std::atomic<bool> flooding(true);
+    std::thread flood([&]() {
+        while (flooding && sender.sendPackets(toStalled) == ErrorCode::SUCCESS)
+            ;
+    });
+
+    // The bus returns credits to the stalled process for all of its window, into its full queue
+    Packet stalledToReceiver(0x100, 0, 1, 1, 2, data, sizeof(data), false);
+    for (int i = 0; i < FLOW_CONTROL_WINDOW; ++i)
+        EXPECT_EQ(stalled.sendPacket(stalledToReceiver), ErrorCode::SUCCESS);
+
+    // A process with all of its credits still gets its packets through
+    ClientConnection late([](Packet &) {});
+    late.setPort(8185);
+    EXPECT_EQ(late.connectToServer(4), ErrorCode::SUCCESS);
+    Packet lateToReceiver(0x101, 0, 1, 4, 2, data, sizeof(data), false);
+    for (int i = 0; i < 10; ++i)
+        EXPECT_EQ(late.sendPacket(lateToReceiver), ErrorCode::SUCCESS);
+    EXPECT_TRUE(waitFor([&]() { return fromStalled == FLOW_CONTROL_WINDOW && fromLate == 10; }, 5000));
+
+    // A sender waiting for credits gives up once its connection is closed
+    flooding = false;
+    sender.closeConnection();
+    flood.join();
+}
+
+// Test that two threads sending long messages to the same destination do not interleave their packets,
+// the messages share the reassembly key and are longer than the credits the bus grants at once
+TEST(BusManagerTest, ConcurrentMessagesToOneDestinationStayWhole) {
+    BusManager bus({}, 0, 8185);
+    bus.setMetricsFile("");
+    ASSERT_EQ(bus.startConnection(), ErrorCode::SUCCESS);
+
+    const int messagesPerThread = 20;
+    const int messageSize = 3000;
+    std::mutex receivedMutex;
+    std::vector<std::vector<uint8_t>> received;
+    Reassembler reassembler([&](uint32_t, const uint8_t *data, size_t size) {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        received.emplace_back(data, data + size);
+    });
+    ClientConnection receiver([&reassembler](Packet &packet) { reassembler.addPacket(packet); });
+    ClientConnection sender([](Packet &) {});
+    receiver.setPort(8185);
+    sender.setPort(8185);
+    ASSERT_EQ(receiver.connectToServer(2), ErrorCode::SUCCESS);
+    ASSERT_EQ(sender.connectToServer(1), ErrorCode::SUCCESS);
+
+    // Every thread fills its messages with its own byte
+    std::vector<std::thread> threads;
+    for (uint8_t fill : {0x11, 0x22}) {
+        threads.emplace_back([&sender, fill, messageSize]() {
+            std::vector<uint8_t> data(messageSize, fill);
+            for (int i = 0; i < messagesPerThread; ++i) {
+                Message message(1, data.data(), messageSize, false, 2);
+                EXPECT_EQ(sender.sendPackets(message.getPackets()), ErrorCode::SUCCESS);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    EXPECT_TRUE(waitFor([&]() {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        return received.size() == 2 * messagesPerThread;
+    }, 5000));
+    EXPECT_EQ(reassembler.getCorruptMessages(), 0u);
+    std::lock_guard<std::mutex> lock(receivedMutex);
+    for (const std::vector<uint8_t> &message : received) {
+        ASSERT_EQ(message.size(), (size_t)messageSize);
+        EXPECT_EQ(std::count(message.begin(), message.end(), message[0]), messageSize);
+    }
+}
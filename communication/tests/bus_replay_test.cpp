@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/bus_manager.h"
+#include "../include/bus_replay.h"
+
+#define REPLAY_TEST_FILE "bus_replay_test.vcscap"
+#define REPLAY_TEST_PACKETS 20
+
+// Polls the condition until it holds or the timeout passes
+static bool waitFor(std::function<bool()> condition, int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+// A bus of the test with the arbitration and the metrics file turned off
+static void prepareBus(BusManager &bus)
+{
+    bus.setMetricsFile("");
+    bus.setBitrate(0);
+    ASSERT_EQ(bus.startConnection(), ErrorCode::SUCCESS);
+}
+
+// Waits until the bus let go of the sources of the previous replay, the IDs are free again afterwards
+static bool waitForNoClients(BusManager &bus)
+{
+    return waitFor([&bus]() { return bus.getMetrics().find("vcs_server_clients 0\n") != std::string::npos; }, 2000);
+}
+
+// Records the traffic of process 1 on a bus, the first packets a gap apart
+static void recordTraffic(int gapMs)
+{
+    BusManager recorded({}, 0, 8183);
+    ASSERT_TRUE(recorded.startCapture(REPLAY_TEST_FILE));
+    prepareBus(recorded);
+
+    ClientConnection sender([](Packet &) {});
+    sender.setPort(8183);
+    ASSERT_EQ(sender.connectToServer(1), ErrorCode::SUCCESS);
+    for (int i = 0; i < REPLAY_TEST_PACKETS; ++i) {
+        uint8_t data[2] = {(uint8_t)i, 7};
+        Packet packet(0x40, i, REPLAY_TEST_PACKETS, 1, 0, data, sizeof(data), true);
+        ASSERT_EQ(sender.sendPacket(packet), ErrorCode::SUCCESS);
+        if (i < 2)
+            std::this_thread::sleep_for(std::chrono::milliseconds(gapMs));
+    }
+    // The capture is stopped once everything was routed
+    std::string captured = "vcs_bus_packets_captured_total " + std::to_string(REPLAY_TEST_PACKETS) + "\n";
+    ASSERT_TRUE(waitFor([&]() { return recorded.getMetrics().find(captured) != std::string::npos; }, 2000));
+    EXPECT_TRUE(recorded.stopCapture());
+}
+
+// Test that a replay as fast as possible brings the recorded packets to another bus in their order
+TEST(BusReplayTest, ReplaysCaptureIntoAnotherBus) {
+    recordTraffic(0);
+
+    BusManager replayed({}, 0, 8184);
+    prepareBus(replayed);
+    std::mutex receivedMutex;
+    std::vector<Packet> received;
+    ClientConnection receiver([&](Packet &packet) {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        received.push_back(packet);
+    });
+    receiver.setPort(8184);
+    ASSERT_EQ(receiver.connectToServer(2), ErrorCode::SUCCESS);
+
+    BusReplayer replayer(REPLAY_TEST_FILE, 8184);
+    replayer.setSpeed(REPLAY_AS_FAST_AS_POSSIBLE);
+    EXPECT_EQ(replayer.run(), ErrorCode::SUCCESS);
+    EXPECT_EQ(replayer.getReplayed(), (uint64_t)REPLAY_TEST_PACKETS);
+    EXPECT_EQ(replayer.getFailed(), 0u);
+
+    ASSERT_TRUE(waitFor([&]() {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        return received.size() == REPLAY_TEST_PACKETS;
+    }, 2000));
+    std::lock_guard<std::mutex> lock(receivedMutex);
+    for (int i = 0; i < REPLAY_TEST_PACKETS; ++i) {
+        EXPECT_EQ(received[i].header.ID, 0x40u);
+        EXPECT_EQ(received[i].header.SrcID, 1u);
+        EXPECT_EQ(received[i].header.PSN, (uint32_t)i);
+        EXPECT_EQ(((uint8_t *)received[i].data)[0], i);
+    }
+    std::remove(REPLAY_TEST_FILE);
+}
+
+// Test that the recorded gaps are kept at the original speed and shortened at a higher one
+TEST(BusReplayTest, KeepsRecordedPace) {
+    recordTraffic(100);
+
+    BusManager replayed({}, 0, 8184);
+    prepareBus(replayed);
+
+    auto start = std::chrono::steady_clock::now();
+    BusReplayer original(REPLAY_TEST_FILE, 8184);
+    EXPECT_EQ(original.run(), ErrorCode::SUCCESS);
+    auto originalTime = std::chrono::steady_clock::now() - start;
+    EXPECT_GE(originalTime, std::chrono::milliseconds(190));
+
+    ASSERT_TRUE(waitForNoClients(replayed));
+    start = std::chrono::steady_clock::now();
+    BusReplayer faster(REPLAY_TEST_FILE, 8184);
+    faster.setSpeed(4);
+    EXPECT_EQ(faster.run(), ErrorCode::SUCCESS);
+    auto fasterTime = std::chrono::steady_clock::now() - start;
+    EXPECT_GE(fasterTime, std::chrono::milliseconds(45));
+    EXPECT_LT(fasterTime, originalTime);
+    EXPECT_EQ(faster.getReplayed(), (uint64_t)REPLAY_TEST_PACKETS);
+
+    EXPECT_THROW(faster.setSpeed(-1), std::invalid_argument);
+    std::remove(REPLAY_TEST_FILE);
+}
+
+// Test that a skipped source is left to the live process and that stop ends a replay
+TEST(BusReplayTest, SkipsSourcesAndStops) {
+    recordTraffic(1000);
+
+    BusManager replayed({}, 0, 8184);
+    prepareBus(replayed);
+
+    BusReplayer skipping(REPLAY_TEST_FILE, 8184);
+    skipping.skipSource(1);
+    EXPECT_EQ(skipping.run(), ErrorCode::SUCCESS);
+    EXPECT_EQ(skipping.getReplayed(), 0u);
+
+    // The recorded gaps take two seconds, the replay is stopped during the first one
+    ASSERT_TRUE(waitForNoClients(replayed));
+    BusReplayer stopped(REPLAY_TEST_FILE, 8184);
+    std::thread stopper([&stopped]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        stopped.stop();
+    });
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(stopped.run(), ErrorCode::SUCCESS);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(900));
+    EXPECT_EQ(stopped.getReplayed(), 1u);
+    stopper.join();
+    std::remove(REPLAY_TEST_FILE);
+}
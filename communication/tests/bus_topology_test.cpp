@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include "../include/bus_topology.h"
+
+// Reads a topology from text
+static BusTopology parse(const std::string &text)
+{
+    std::istringstream input(text);
+    return BusTopology::parse(input);
+}
+
+// Test that buses, gateways and their routes are read with their options
+TEST(BusTopologyTest, ParsesBusesAndGateways) {
+    BusTopology topology = parse(
+        "# The buses of the vehicle\n"
+        "bus powertrain 8080 bitrate=250000\n"
+        "bus body 8081 ids=3,4,0x10 limit=5 capture=body.vcscap\n"
+        "\n"
+        "gateway 90 powertrain body  # Engine state for the dashboard\n"
+        "route 0x100 0x7F0 0x300\n"
+        "route 0x200 0x7FF 0x201\n"
+        "gateway 91 body 9000\n"
+        "route 3 0x7FF 3\n");
+
+    ASSERT_EQ(topology.getBuses().size(), 2u);
+    const BusConfig &powertrain = topology.getBuses()[0];
+    EXPECT_EQ(powertrain.name, "powertrain");
+    EXPECT_EQ(powertrain.port, 8080);
+    EXPECT_EQ(powertrain.bitrate, 250000u);
+    EXPECT_TRUE(powertrain.ids.empty());
+    EXPECT_TRUE(powertrain.capture.empty());
+    const BusConfig &body = topology.getBuses()[1];
+    EXPECT_EQ(body.bitrate, (uint32_t)BUS_BITRATE);
+    EXPECT_EQ(body.ids, std::vector<uint32_t>({3, 4, 16}));
+    EXPECT_EQ(body.limit, 5u);
+    EXPECT_EQ(body.capture, "body.vcscap");
+
+    ASSERT_EQ(topology.getGateways().size(), 2u);
+    const GatewayConfig &dashboard = topology.getGateways()[0];
+    EXPECT_EQ(dashboard.id, 90u);
+    EXPECT_EQ(dashboard.sourcePort, 8080);
+    EXPECT_EQ(dashboard.targetPort, 8081);
+    ASSERT_EQ(dashboard.routes.size(), 2u);
+    EXPECT_EQ(dashboard.routes[0].mask, 0x7F0u);
+    EXPECT_EQ(dashboard.routes[1].translatedID, 0x201u);
+
+    // A bus of another process is given by its port
+    EXPECT_EQ(topology.getGateways()[1].targetPort, 9000);
+}
+
+// Test that invalid entries are rejected
+TEST(BusTopologyTest, RejectsInvalidEntries) {
+    EXPECT_THROW(parse("bus powertrain\n"), std::invalid_argument);
+    EXPECT_THROW(parse("bus powertrain 70000\n"), std::invalid_argument);
+    EXPECT_THROW(parse("bus powertrain 8080 speed=1\n"), std::invalid_argument);
+    EXPECT_THROW(parse("bus powertrain 8080 capture=\n"), std::invalid_argument);
+    EXPECT_THROW(parse("bus a 8080\nbus b 8080\n"), std::invalid_argument);
+    EXPECT_THROW(parse("bus a 8080\ngateway 90 a chassis\nroute 1 1 1\n"), std::invalid_argument);
+    EXPECT_THROW(parse("bus a 8080\ngateway 90 a a\nroute 1 1 1\n"), std::invalid_argument);
+    EXPECT_THROW(parse("route 1 1 1\n"), std::invalid_argument);
+    EXPECT_THROW(parse("bus a 8080\nbus b 8081\ngateway 90 a b\n"), std::invalid_argument);
+    EXPECT_THROW(parse("bus a 8080\nbus b 8081\ngateway 90 a b\nroute 1 1 1 1\n"), std::invalid_argument);
+    EXPECT_THROW(parse("wire a b\n"), std::invalid_argument);
+}
+
+// Test that the error names the line of the invalid entry
+TEST(BusTopologyTest, ErrorNamesTheLine) {
+    try {
+        parse("bus a 8080\n\nbus b x\n");
+        FAIL();
+    } catch (const std::invalid_argument &error) {
+        EXPECT_NE(std::string(error.what()).find("line 3"), std::string::npos);
+    }
+}
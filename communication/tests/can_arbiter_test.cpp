@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include "../include/can_arbiter.h"
+
+class CanArbiterTest : public ::testing::Test {
+protected:
+    std::vector<uint32_t> delivered;
+    std::mutex deliveredMutex;
+    std::condition_variable deliveredChanged;
+
+    std::function<void(const Packet &)> collect = [this](const Packet &packet) {
+        std::lock_guard<std::mutex> lock(deliveredMutex);
+        delivered.push_back(packet.header.ID);
+        deliveredChanged.notify_all();
+    };
+
+    Packet frame(uint32_t id, uint32_t srcID = 1) {
+        uint8_t data[SIZE_PACKET] = {};
+        return Packet(id, 0, 1, srcID, 0, data, SIZE_PACKET, true);
+    }
+
+    bool waitForDeliveries(size_t count) {
+        std::unique_lock<std::mutex> lock(deliveredMutex);
+        return deliveredChanged.wait_for(lock, std::chrono::seconds(5), [this, count]() { return delivered.size() >= count; });
+    }
+};
+
+// Test that frames waiting for the bus go out lowest ID first
+TEST_F(CanArbiterTest, LowestIdWinsArbitration) {
+    // A slow bus keeps the first frame on the wire while the others are submitted
+    CanArbiter arbiter(collect, 10000);
+    arbiter.start();
+    arbiter.submit(frame(50));
+    while (arbiter.pendingFrames())
+        std::this_thread::yield();
+    arbiter.submit(frame(30));
+    arbiter.submit(frame(10));
+    arbiter.submit(frame(20));
+
+    ASSERT_TRUE(waitForDeliveries(4));
+    EXPECT_EQ(delivered, std::vector<uint32_t>({50, 10, 20, 30}));
+}
+
+// Test that a disabled simulation forwards frames at once
+TEST_F(CanArbiterTest, ZeroBitrateForwardsImmediately) {
+    CanArbiter arbiter(collect, 0);
+    arbiter.start();
+    arbiter.submit(frame(30));
+    arbiter.submit(frame(10));
+
+    EXPECT_EQ(delivered, std::vector<uint32_t>({30, 10}));
+}
+
+// Test that equal identifiers are resolved by the source
+TEST_F(CanArbiterTest, PriorityTieBreak) {
+    EXPECT_TRUE(CanArbiter::hasPriority(frame(5, 9), frame(6, 1)));
+    EXPECT_TRUE(CanArbiter::hasPriority(frame(5, 1), frame(5, 2)));
+    EXPECT_FALSE(CanArbiter::hasPriority(frame(5, 2), frame(5, 1)));
+}
+
+// Test the frame time of a full frame with worst-case stuffing
+TEST_F(CanArbiterTest, FrameDuration) {
+    // 47 overhead bits, 64 payload bits and 24 stuff bits at 500 kbit/s
+    EXPECT_EQ(CanArbiter::frameDuration(frame(1), 500000), std::chrono::nanoseconds(270000));
+}
+
+// Test that the throughput is limited by the bitrate and measured per ID
+TEST_F(CanArbiterTest, BitrateLimitsThroughput) {
+    CanArbiter arbiter(collect, 100000);
+    std::chrono::nanoseconds expected = 20 * CanArbiter::frameDuration(frame(1), 100000);
+    auto begin = std::chrono::steady_clock::now();
+    arbiter.start();
+    for (int i = 0; i < 20; ++i)
+        arbiter.submit(frame(7));
+
+    ASSERT_TRUE(waitForDeliveries(20));
+    EXPECT_GE(std::chrono::steady_clock::now() - begin, expected);
+
+    std::unordered_map<uint32_t, CanIdStatistics> statistics = arbiter.getStatistics();
+    EXPECT_EQ(statistics[7].frames, 20);
+    EXPECT_GE(statistics[7].maxLatency, expected - CanArbiter::frameDuration(frame(1), 100000));
+    EXPECT_GT(arbiter.getBusLoad(), 0);
+}
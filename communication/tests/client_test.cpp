@@ -1,71 +1,133 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <cerrno>
+#include <functional>
+#include <mutex>
 #include "../include/client_connection.h"
 #include "../sockets/mock_socket.h"
 #include "../include/message.h"
 
 using ::testing::_;
+using ::testing::AnyNumber;
+using ::testing::Invoke;
+using ::testing::NiceMock;
 using ::testing::Return;
 
+#define CLIENT_TEST_SOCKET 1
+#define CLIENT_TEST_EPOLL 2
+
+// Polls the condition until it holds or the timeout passes
+static bool waitFor(std::function<bool()> condition, int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+// A recv that fails with the error
+static std::function<ssize_t(int, void *, size_t, int)> failRecv(int error)
+{
+    return [error](int, void *, size_t, int) -> ssize_t {
+        errno = error;
+        return -1;
+    };
+}
+
 class ClientTest : public ::testing::Test {
 protected:
-    MockSocket mockSocket;
+    // Owned by the client, which deletes it once its receive thread was joined
+    NiceMock<MockSocket> *mockSocket;
     ClientConnection* client;
 
+    // Bytes the mocked bus has sent and the receive thread has not read yet
+    std::mutex incomingMutex;
+    std::vector<uint8_t> incoming;
+    bool readable = false;
+
     void SetUp() override {
-        ON_CALL(mockSocket, socket(::testing::_, ::testing::_, ::testing::_))
-            .WillByDefault(::testing::Return(1));
-        ON_CALL(mockSocket, setsockopt(::testing::_, ::testing::_, ::testing::_, ::testing::NotNull(), ::testing::_))
-            .WillByDefault(::testing::Return(0));
-        ON_CALL(mockSocket, bind(::testing::_, ::testing::_, ::testing::_))
-            .WillByDefault(::testing::Return(0));
-        ON_CALL(mockSocket, listen(::testing::_, ::testing::_))
-            .WillByDefault(::testing::Return(0));
-        ON_CALL(mockSocket, connect(_, _, _))
-            .WillByDefault(::testing::Return(0));
-        ON_CALL(mockSocket, close(_))
-            .WillByDefault(::testing::Return(0));
-
-        ON_CALL(mockSocket, socket(_, _, _))
-        .WillByDefault(Return(1)); 
-    
-        ON_CALL(mockSocket, setsockopt(_, _, _, _, _))
-        .WillByDefault(Return(0));
-    
-        ON_CALL(mockSocket, connect(_, _, _))
-        .WillByDefault(Return(0));
-    
-        ON_CALL(mockSocket, send(_, _, _, _))
-        .WillByDefault(Return(44));  // ודא ששליחה מחזירה הצלחה
-    
-        ON_CALL(mockSocket, close(_))
-        .WillByDefault(Return(0));  // close מחזיר הצלחה
-
-        EXPECT_CALL(mockSocket, close(_)).Times(1);  // מצפה ש-close תוקרא פעם אחת
-
-
-        Packet packet;
-        ON_CALL(mockSocket, send(_, _, _, _))
-            .WillByDefault(::testing::Return(sizeof(Packet)));
-
-        client = new ClientConnection([](Packet &){}, &mockSocket);
+        mockSocket = new NiceMock<MockSocket>();
+        ON_CALL(*mockSocket, socket(_, _, _))
+            .WillByDefault(Return(CLIENT_TEST_SOCKET));
+        ON_CALL(*mockSocket, connect(_, _, _))
+            .WillByDefault(Return(0));
+        ON_CALL(*mockSocket, close(_))
+            .WillByDefault(Return(0));
+        ON_CALL(*mockSocket, epoll_create1(_))
+            .WillByDefault(Return(CLIENT_TEST_EPOLL));
+        ON_CALL(*mockSocket, epoll_ctl(_, _, _, _))
+            .WillByDefault(Return(0));
+
+        // Every write goes through whole
+        ON_CALL(*mockSocket, send(_, _, _, _))
+            .WillByDefault(Invoke([](int, const void *, size_t len, int) { return (ssize_t)len; }));
+
+        // The socket turns readable when the bus sent something, the receive thread waits shortly otherwise
+        ON_CALL(*mockSocket, epoll_wait(_, _, _, _))
+            .WillByDefault(Invoke([this](int, epoll_event *events, int, int) {
+                {
+                    std::lock_guard<std::mutex> lock(incomingMutex);
+                    if (readable) {
+                        readable = false;
+                        events[0].events = EPOLLIN;
+                        events[0].data.fd = CLIENT_TEST_SOCKET;
+                        return 1;
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                return 0;
+            }));
+        ON_CALL(*mockSocket, recv(_, _, _, _))
+            .WillByDefault(Invoke([this](int, void *buf, size_t len, int) -> ssize_t {
+                std::lock_guard<std::mutex> lock(incomingMutex);
+                if (incoming.empty()) {
+                    errno = EAGAIN;
+                    return -1;
+                }
+                size_t count = std::min(len, incoming.size());
+                memcpy(buf, incoming.data(), count);
+                incoming.erase(incoming.begin(), incoming.begin() + count);
+                return count;
+            }));
+
+        client = new ClientConnection([](Packet &){}, mockSocket);
     }
 
     void TearDown() override {
-        EXPECT_CALL(mockSocket, close(_)).Times(1);
-        //delete client;
+        delete client;
+    }
+
+    // Delivers the packet to the client as if the bus had sent it
+    void serveFromBus(const Packet &packet) {
+        uint8_t buffer[WIRE_MAX_FRAME_SIZE];
+        size_t length = encodeFrame(packet, buffer, sizeof(buffer));
+        std::lock_guard<std::mutex> lock(incomingMutex);
+        incoming.insert(incoming.end(), buffer, buffer + length);
+        readable = true;
+    }
+
+    // Connects and lets the bus grant credits, so that the sends do not wait for them
+    void connectWithCredits() {
+        ASSERT_EQ(client->connectToServer(1), ErrorCode::SUCCESS);
+        Packet credit(0);
+        credit.header.control = ControlType::CREDIT;
+        credit.header.ID = 16;
+        serveFromBus(credit);
     }
 };
 
 // Test Constructor
 TEST_F(ClientTest, ConstructorInitializesCorrectly) {
-    EXPECT_FALSE(client->isConnected()); 
-    EXPECT_GT(client->getClientSocket(), 0); 
+    EXPECT_FALSE(client->isConnected());
+    EXPECT_EQ(client->getClientSocket(), -1); // No socket before connecting
 }
 
 // Test connection success
 TEST_F(ClientTest, ConnectToServerSuccess) {
-    EXPECT_CALL(mockSocket, connect(_, _, _)).WillOnce(Return(0));
+    EXPECT_CALL(*mockSocket, connect(_, _, _)).WillOnce(Return(0));
     ErrorCode result = client->connectToServer(1);
     EXPECT_EQ(result, ErrorCode::SUCCESS);
     EXPECT_TRUE(client->isConnected());
@@ -73,7 +135,7 @@ TEST_F(ClientTest, ConnectToServerSuccess) {
 
 // Test connection failure (connect fails)
 TEST_F(ClientTest, ConnectToServerFailureOnConnect) {
-    EXPECT_CALL(mockSocket, connect(_, _, _)).WillOnce(Return(-1));
+    EXPECT_CALL(*mockSocket, connect(_, _, _)).WillOnce(Return(-1));
     ErrorCode result = client->connectToServer(1);
     EXPECT_EQ(result, ErrorCode::CONNECTION_FAILED);
     EXPECT_FALSE(client->isConnected());
@@ -81,7 +143,7 @@ TEST_F(ClientTest, ConnectToServerFailureOnConnect) {
 
 // Test connection failure (socket creation fails)
 TEST_F(ClientTest, ConnectToServerSocketFailure) {
-    EXPECT_CALL(mockSocket, socket(_, _, _)).WillOnce(Return(-1));
+    EXPECT_CALL(*mockSocket, socket(_, _, _)).WillOnce(Return(-1));
     ErrorCode result = client->connectToServer(1);
     EXPECT_EQ(result, ErrorCode::SOCKET_FAILED);
     EXPECT_FALSE(client->isConnected());
@@ -89,63 +151,80 @@ TEST_F(ClientTest, ConnectToServerSocketFailure) {
 
 // Test sendPacket success
 TEST_F(ClientTest, SendPacketSuccess) {
-    Packet packet;
-    client->connectToServer(1);
+    Packet packet(1);
+    connectWithCredits();
     ErrorCode result = client->sendPacket(packet);
     EXPECT_EQ(result, ErrorCode::SUCCESS);
 }
 
 // Test sendPacket failure - not connected
 TEST_F(ClientTest, SendPacketFailureNotConnected) {
-    Packet packet;
+    Packet packet(1);
     ErrorCode result = client->sendPacket(packet);
     EXPECT_EQ(result, ErrorCode::CONNECTION_FAILED);
 }
 
 // Test sendPacket failure - socket send fails
 TEST_F(ClientTest, SendPacketFailureOnSend) {
-    Packet packet;
-    client->connectToServer(1);
-    EXPECT_CALL(mockSocket, send(_, _, _, _)).WillOnce(Return(-1));
+    Packet packet(1);
+    connectWithCredits();
+    EXPECT_CALL(*mockSocket, send(_, _, _, _)).WillOnce(Invoke([](int, const void *, size_t, int) -> ssize_t {
+        errno = EPIPE;
+        return -1;
+    }));
     ErrorCode result = client->sendPacket(packet);
     EXPECT_EQ(result, ErrorCode::SEND_FAILED);
 }
 
-// Test sendPacket partial send
+// Test sendPacket completes a partial send
 TEST_F(ClientTest, SendPacketPartialSend) {
-    Packet packet;
-    client->connectToServer(1);
-    EXPECT_CALL(mockSocket, send(_, _, _, _)).WillOnce(Return(sizeof(Packet) - 1));
+    Packet packet(1);
+    connectWithCredits();
+    EXPECT_CALL(*mockSocket, send(_, _, _, _))
+        .WillOnce(Return(WIRE_HEADER_SIZE - 1))
+        .WillOnce(Invoke([](int, const void *, size_t len, int) { return (ssize_t)len; }));
     ErrorCode result = client->sendPacket(packet);
-    EXPECT_EQ(result, ErrorCode::SEND_FAILED);
+    EXPECT_EQ(result, ErrorCode::SUCCESS);
 }
 
 // Test receivePacket success
 TEST_F(ClientTest, ReceivePacketSuccess) {
-    Packet packet;
-    EXPECT_CALL(mockSocket, recv(_, _, _, _)).WillOnce(Return(sizeof(Packet)));
-    client->connectToServer(1);
-    std::thread receiveThread(&ClientConnection::receivePacket, client);
-    receiveThread.join();
-    // If passPacketCom works, this could be tested, but for now we'll assume correct handling
+    std::mutex receivedMutex;
+    std::vector<Packet> received;
+    client->setCallback([&](Packet &packet) {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        received.push_back(packet);
+    });
+    ASSERT_EQ(client->connectToServer(1), ErrorCode::SUCCESS);
+
+    uint8_t data[3] = {1, 2, 3};
+    serveFromBus(Packet(0x20, 0, 1, 2, 1, data, sizeof(data), false));
+    ASSERT_TRUE(waitFor([&]() {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        return received.size() == 1;
+    }, 2000));
+    std::lock_guard<std::mutex> lock(receivedMutex);
+    EXPECT_EQ(received[0].header.ID, 0x20u);
+    EXPECT_EQ(received[0].header.DLC, sizeof(data));
+    EXPECT_EQ(memcmp(received[0].data, data, sizeof(data)), 0);
 }
 
-// Test receivePacket failure (recv fails)
+// Test receivePacket failure (recv fails), the lost connection is restored
 TEST_F(ClientTest, ReceivePacketFailure) {
-    EXPECT_CALL(mockSocket, recv(_, _, _, _)).WillOnce(Return(-1));
-    client->connectToServer(1);
-    std::thread receiveThread(&ClientConnection::receivePacket, client);
-    receiveThread.join();
-    EXPECT_FALSE(client->isConnected());
+    EXPECT_CALL(*mockSocket, recv(_, _, _, _)).WillOnce(Invoke(failRecv(ECONNRESET))).WillRepeatedly(Invoke(failRecv(EAGAIN)));
+    ASSERT_EQ(client->connectToServer(1), ErrorCode::SUCCESS);
+    serveFromBus(Packet(1));
+    EXPECT_TRUE(waitFor([&]() { return client->getReconnects() == 1; }, 2000));
+    EXPECT_TRUE(client->isConnected());
 }
 
-// Test receivePacket no data (recv returns 0)
+// Test receivePacket no data (recv returns 0), the bus closed the connection and the client joins it again
 TEST_F(ClientTest, ReceivePacketNoData) {
-    EXPECT_CALL(mockSocket, recv(_, _, _, _)).WillOnce(Return(0));
-    client->connectToServer(1);
-    std::thread receiveThread(&ClientConnection::receivePacket, client);
-    receiveThread.join();
-    EXPECT_TRUE(client->isConnected()); // Should still be connected, no data means wait for more
+    EXPECT_CALL(*mockSocket, recv(_, _, _, _)).WillOnce(Return(0)).WillRepeatedly(Invoke(failRecv(EAGAIN)));
+    ASSERT_EQ(client->connectToServer(1), ErrorCode::SUCCESS);
+    serveFromBus(Packet(1));
+    EXPECT_TRUE(waitFor([&]() { return client->getReconnects() == 1; }, 2000));
+    EXPECT_TRUE(client->isConnected());
 }
 
 // Test closeConnection success
@@ -154,11 +233,14 @@ TEST_F(ClientTest, CloseConnectionSuccess) {
     ErrorCode result = client->closeConnection();
     EXPECT_EQ(result, ErrorCode::SUCCESS);
     EXPECT_FALSE(client->isConnected());
+    EXPECT_FALSE(client->isReceiveThreadRunning());
 }
 
 // Test closeConnection failure
 TEST_F(ClientTest, CloseConnectionFailure) {
-    EXPECT_CALL(mockSocket, close(_)).WillOnce(Return(-1));
+    client->connectToServer(1);
+    EXPECT_CALL(*mockSocket, close(_)).Times(AnyNumber());
+    EXPECT_CALL(*mockSocket, close(CLIENT_TEST_SOCKET)).WillOnce(Return(-1)).WillRepeatedly(Return(0));
     ErrorCode result = client->closeConnection();
     EXPECT_EQ(result, ErrorCode::CLOSE_FAILED);
 }
@@ -175,8 +257,12 @@ TEST_F(ClientTest, SetSocketInterfaceThrowsOnNull) {
 
 // Test valid socket interface setting
 TEST_F(ClientTest, SetSocketInterfaceSuccess) {
-    MockSocket anotherMockSocket;
-    EXPECT_NO_THROW(client->setSocketInterface(&anotherMockSocket));
+    MockSocket *anotherMockSocket = new MockSocket();
+    EXPECT_NO_THROW(client->setSocketInterface(anotherMockSocket));
+
+    // The client owns the new interface from now on
+    delete mockSocket;
+    mockSocket = nullptr;
 }
 
 // Test connection thread starts correctly
@@ -188,16 +274,19 @@ TEST_F(ClientTest, ConnectionStartsReceiveThread) {
 // Test destructor closes connection
 TEST_F(ClientTest, DestructorClosesConnection) {
     client->connectToServer(1);
-    delete client; // Should close connection in destructor
-    EXPECT_CALL(mockSocket, close(_)).Times(1); // Ensure close is called
+    EXPECT_CALL(*mockSocket, close(_)).Times(AnyNumber());
+    EXPECT_CALL(*mockSocket, close(CLIENT_TEST_SOCKET)).Times(1); // Ensure close is called
+    delete client; // Should close connection in destructor, and verifies the expectation with the mock
+    client = nullptr;
 }
 
-// Test connection failure after sending a partial packet
+// Test a send that ends in a closed connection after a partial write
 TEST_F(ClientTest, SendPacketPartialConnectionClose) {
-    Packet packet;
-    client->connectToServer(1);
-    EXPECT_CALL(mockSocket, send(_, _, _, _)).WillOnce(Return(sizeof(Packet) - 1));
+    Packet packet(1);
+    connectWithCredits();
+    EXPECT_CALL(*mockSocket, send(_, _, _, _))
+        .WillOnce(Return(WIRE_HEADER_SIZE - 1))
+        .WillOnce(Return(0));
     ErrorCode result = client->sendPacket(packet);
-    EXPECT_EQ(result, ErrorCode::SEND_FAILED);
-    EXPECT_FALSE(client->isConnected()); // Should close connection after failure
+    EXPECT_EQ(result, ErrorCode::CONNECTION_FAILED);
 }
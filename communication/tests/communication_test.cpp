@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../include/bus_manager.h"
+#include "../include/communication.h"
+
+// Registration at the bus is asynchronous
+#define REGISTRATION_WAIT_MS 200
+
+TEST(CommunicationTest, RejectsEmptyCallbacks)
+{
+    EXPECT_THROW(Communication(1, ReceiveCallback()), std::invalid_argument);
+    EXPECT_THROW(Communication(1, (void (*)(uint32_t, void *))nullptr), std::invalid_argument);
+}
+
+TEST(CommunicationTest, DeliversViewsToCapturingCallbacks)
+{
+    // A bus of the test alone, gone with the test
+    BusManager bus({}, 0, 8186);
+    bus.setMetricsFile("");
+    ASSERT_EQ(bus.startConnection(), ErrorCode::SUCCESS);
+
+    std::mutex mutex;
+    std::condition_variable arrived;
+    std::vector<std::vector<uint8_t>> messages;
+    std::vector<uint32_t> sources;
+    Communication receiver(11, [&](const MessageView &message) {
+        // The view is only valid during the callback, so the test keeps a copy
+        std::lock_guard<std::mutex> lock(mutex);
+        messages.emplace_back(message.data, message.data + message.size);
+        sources.push_back(message.srcID);
+        arrived.notify_all();
+    });
+    Communication sender(12, [](const MessageView &) {});
+    receiver.setPort(8186);
+    sender.setPort(8186);
+    ASSERT_EQ(receiver.startConnection(), ErrorCode::SUCCESS);
+    ASSERT_EQ(sender.startConnection(), ErrorCode::SUCCESS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(REGISTRATION_WAIT_MS));
+
+    // A single packet message and one that spans several packets
+    std::vector<uint8_t> small = {1, 2, 3};
+    std::vector<uint8_t> large(100);
+    for (size_t i = 0; i < large.size(); ++i)
+        large[i] = i;
+    ASSERT_EQ(sender.sendMessage(small.data(), small.size(), 11, 12, false), ErrorCode::SUCCESS);
+    ASSERT_EQ(sender.sendMessage(large.data(), large.size(), 11, 12, false), ErrorCode::SUCCESS);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(arrived.wait_for(lock, std::chrono::seconds(5), [&]() { return messages.size() == 2; }));
+    EXPECT_EQ(messages[0], small);
+    EXPECT_EQ(messages[1], large);
+    EXPECT_EQ(sources, std::vector<uint32_t>({12, 12}));
+}
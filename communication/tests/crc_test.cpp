@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include "../include/crc.h"
+#include "../include/packet.h"
+
+class CrcTest : public ::testing::Test {
+protected:
+    const char check[10] = "123456789";
+};
+
+// Test the published check value of CRC-15/CAN
+TEST_F(CrcTest, Crc15CheckValue) {
+    EXPECT_EQ(crc15Can(check, 9), 0x059E);
+}
+
+// Test the published check value of CRC-32C
+TEST_F(CrcTest, Crc32cCheckValue) {
+    EXPECT_EQ(crc32c(check, 9), 0xE3069283);
+    EXPECT_EQ(crc32cSoftware(check, 9), 0xE3069283);
+}
+
+// Test that the hardware and the slice-by-8 paths agree on every length and alignment
+TEST_F(CrcTest, Crc32cPathsAgree) {
+    std::vector<uint8_t> buffer(300);
+    for (size_t i = 0; i < buffer.size(); ++i)
+        buffer[i] = i * 151 + 3;
+
+    for (size_t offset = 0; offset < 8; ++offset)
+        for (size_t length = 0; length + offset <= buffer.size(); length += 13)
+            EXPECT_EQ(crc32c(buffer.data() + offset, length), crc32cSoftware(buffer.data() + offset, length));
+}
+
+// Test that a checksum can be continued over several buffers
+TEST_F(CrcTest, Crc32cChaining) {
+    uint32_t partial = crc32c(check, 4);
+    EXPECT_EQ(crc32c(check + 4, 5, partial), crc32c(check, 9));
+}
+
+// Test that a corrupted payload no longer matches the CRC of the packet
+TEST_F(CrcTest, PacketCrcDetectsCorruption) {
+    uint8_t data[SIZE_PACKET] = {1, 2, 3, 4, 5, 6, 7, 8};
+    Packet packet(1, 0, 1, 1, 2, data, SIZE_PACKET, false);
+    EXPECT_EQ(packet.header.CRC, packet.calculateCRC(packet.data, packet.header.DLC));
+
+    reinterpret_cast<uint8_t *>(packet.data)[3] ^= 0x10;
+    EXPECT_NE(packet.header.CRC, packet.calculateCRC(packet.data, packet.header.DLC));
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "../include/filter_table.h"
+
+class FilterTableTest : public ::testing::Test {
+protected:
+    FilterTable table;
+};
+
+// Test that a socket without filters accepts every ID
+TEST_F(FilterTableTest, NoFiltersAcceptsAll) {
+    EXPECT_TRUE(table.accepts(5, 0));
+    EXPECT_TRUE(table.accepts(5, 0x123));
+    EXPECT_TRUE(table.accepts(5, 0x1FFFFFFF));
+    EXPECT_EQ(table.size(), 0);
+}
+
+// Test that a filter passes only the IDs that match in the masked bits
+TEST_F(FilterTableTest, MaskSelectsIDs) {
+    table.add(5, {0x120, 0x7F0});
+
+    EXPECT_TRUE(table.accepts(5, 0x120));
+    EXPECT_TRUE(table.accepts(5, 0x12F));
+    EXPECT_FALSE(table.accepts(5, 0x130));
+    EXPECT_FALSE(table.accepts(5, 0x520));
+    EXPECT_TRUE(table.accepts(6, 0x130));
+}
+
+// Test that several filters of a socket are combined
+TEST_F(FilterTableTest, FiltersAreCombined) {
+    table.add(5, {0x100, 0x7FF});
+    table.add(5, {0x200, 0x7FF});
+
+    EXPECT_TRUE(table.accepts(5, 0x100));
+    EXPECT_TRUE(table.accepts(5, 0x200));
+    EXPECT_FALSE(table.accepts(5, 0x300));
+    EXPECT_EQ(table.size(), 1);
+}
+
+// Test that extended IDs above the bitset are checked against the filters
+TEST_F(FilterTableTest, ExtendedIDs) {
+    table.add(5, {0x18DA0000, 0x1FFF0000});
+
+    EXPECT_TRUE(table.accepts(5, 0x18DA00F1));
+    EXPECT_FALSE(table.accepts(5, 0x18DB00F1));
+    EXPECT_FALSE(table.accepts(5, 0x100));
+}
+
+// Test that removing the filters of a socket makes it accept everything again
+TEST_F(FilterTableTest, RemoveRestoresAcceptAll) {
+    table.add(5, {0x100, 0x7FF});
+    ASSERT_FALSE(table.accepts(5, 0x200));
+
+    table.remove(5);
+    EXPECT_TRUE(table.accepts(5, 0x200));
+    EXPECT_EQ(table.size(), 0);
+}
+
+// Test that a held snapshot is not changed by later writes
+TEST_F(FilterTableTest, SnapshotIsStable) {
+    table.add(5, {0x100, 0x7FF});
+    std::shared_ptr<const FilterTable::Snapshot> before = table.snapshot();
+
+    table.clear();
+
+    EXPECT_FALSE(FilterTable::accepts(*before, 5, 0x200));
+    EXPECT_TRUE(FilterTable::accepts(*table.snapshot(), 5, 0x200));
+}
+
+// Test that a filter survives its control frame
+TEST_F(FilterTableTest, EncodeDecodeRoundTrip) {
+    AcceptanceFilter filter = {0x18DA00F1, 0x1FFFFF00};
+    Packet packet = FilterTable::encodeFilter(7, filter);
+
+    EXPECT_EQ(packet.header.control, ControlType::FILTER);
+    EXPECT_EQ(packet.header.SrcID, 7);
+    AcceptanceFilter decoded = FilterTable::decodeFilter(packet);
+    EXPECT_EQ(decoded.id, filter.id);
+    EXPECT_EQ(decoded.mask, filter.mask);
+}
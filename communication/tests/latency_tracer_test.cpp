@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include "../include/latency_tracer.h"
+
+// Test that every value falls in a bucket whose bounds hold it within the precision
+TEST(LatencyHistogramTest, BucketsKeepPrecision) {
+    for (int64_t value : {0LL, 1LL, 127LL, 128LL, 129LL, 1000LL, 123456789LL, (long long)INT64_MAX}) {
+        size_t index = LatencyHistogram::bucketIndex(value);
+        ASSERT_LT(index, LATENCY_BUCKETS);
+        int64_t upper = LatencyHistogram::bucketUpperBound(index);
+        EXPECT_GE(upper, value);
+        EXPECT_LE(upper - value, value / (LATENCY_SUB_BUCKETS / 2));
+    }
+    EXPECT_EQ(LatencyHistogram::bucketIndex(128), LATENCY_SUB_BUCKETS);
+}
+
+// Test that percentiles are found within the bucket precision
+TEST(LatencyHistogramTest, Percentiles) {
+    LatencyHistogram histogram;
+    for (int64_t i = 1; i <= 1000; ++i)
+        histogram.record(i * 1000);
+
+    EXPECT_EQ(histogram.count(), 1000);
+    EXPECT_EQ(histogram.min(), 1000);
+    EXPECT_EQ(histogram.max(), 1000000);
+    EXPECT_DOUBLE_EQ(histogram.mean(), 500500);
+    EXPECT_NEAR(histogram.percentile(50), 500000, 500000 / 64);
+    EXPECT_NEAR(histogram.percentile(99), 990000, 990000 / 64);
+    EXPECT_EQ(histogram.percentile(100), 1000000);
+
+    histogram.reset();
+    EXPECT_EQ(histogram.count(), 0);
+    EXPECT_EQ(histogram.percentile(50), 0);
+}
+
+// Test that the export ends at the last sample
+TEST(LatencyHistogramTest, ExportPercentiles) {
+    LatencyHistogram histogram;
+    histogram.record(2000);
+    histogram.record(4000);
+
+    std::ostringstream out;
+    histogram.exportPercentiles(out);
+    EXPECT_NE(out.str().find("4.000 1.000000000000          2\n"), std::string::npos);
+    EXPECT_NE(out.str().find("#[Total count    =            2]"), std::string::npos);
+}
+
+// Test that a delivered packet is split into the hops the bus stamped
+TEST(LatencyTracerTest, RecordsHops) {
+    uint8_t data[SIZE_PACKET] = {};
+    Packet packet(1, 0, 1, 2, 3, data, 1, false);
+    packet.header.timestamp = 1000;
+    LatencyTracer tracer;
+
+    tracer.recordDelivery(packet, 6000);
+    EXPECT_EQ(tracer.getHistogram(LatencyHop::END_TO_END).max(), 5000);
+    EXPECT_EQ(tracer.getHistogram(LatencyHop::SEND_TO_BUS).count(), 0);
+
+    packet.header.enqueueTime = 2000;
+    packet.header.routeTime = 2500;
+    tracer.recordDelivery(packet, 4000);
+    EXPECT_EQ(tracer.getHistogram(LatencyHop::SEND_TO_BUS).max(), 1000);
+    EXPECT_EQ(tracer.getHistogram(LatencyHop::BUS_ARBITRATION).max(), 500);
+    EXPECT_EQ(tracer.getHistogram(LatencyHop::BUS_TO_RECEIVER).max(), 1500);
+    EXPECT_EQ(tracer.getHistogram(LatencyHop::END_TO_END).count(), 2);
+    EXPECT_NE(tracer.report().find("end_to_end       count=2"), std::string::npos);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "../include/metrics.h"
+
+// Test that concurrent increments of a labeled counter are all counted under their labels
+TEST(MetricsTest, LabeledCounterConcurrentAdds) {
+    LabeledCounter counter;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([&counter]() {
+            for (uint32_t i = 0; i < 10000; ++i)
+                counter.add(i % 100);
+        });
+    for (std::thread &thread : threads)
+        thread.join();
+
+    std::vector<std::pair<uint32_t, uint64_t>> values = counter.values();
+    EXPECT_EQ(values.size(), 100);
+    for (const std::pair<uint32_t, uint64_t> &value : values)
+        EXPECT_EQ(value.second, 400);
+    EXPECT_EQ(counter.value(42), 400);
+    EXPECT_EQ(counter.value(100), 0);
+}
+
+// Test that labels beyond the table are counted together
+TEST(MetricsTest, LabeledCounterOverflow) {
+    LabeledCounter counter;
+    for (uint32_t i = 0; i < METRICS_LABEL_SLOTS + 10; ++i)
+        counter.add(i);
+
+    EXPECT_EQ(counter.values().size(), METRICS_LABEL_SLOTS);
+    EXPECT_EQ(counter.overflowValue(), 10);
+}
+
+// Test that every metric type is rendered in the Prometheus text format
+TEST(MetricsTest, ExportText) {
+    Counter packets;
+    LabeledCounter byID;
+    LatencyHistogram latency;
+    packets.add(3);
+    byID.add(7, 2);
+    latency.record(1000);
+
+    MetricsRegistry registry;
+    registry.addCounter("test_packets_total", "Packets.", packets);
+    registry.addCounter("test_by_id_total", "Packets by ID.", byID, "id");
+    registry.addGauge("test_depth", "Depth.", []() { return MetricsRegistry::Samples{{"client=\"1\"", 5}}; });
+    registry.addSummary("test_latency_seconds", "Latency.", latency);
+
+    std::string text = registry.exportText();
+    EXPECT_NE(text.find("# HELP test_packets_total Packets.\n# TYPE test_packets_total counter\ntest_packets_total 3\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("test_by_id_total{id=\"7\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("# TYPE test_depth gauge\ntest_depth{client=\"1\"} 5\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds{quantile=\"0.99\"} 1e-06\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_count 1\n"), std::string::npos);
+}
+
+// Test that the file export writes the metrics and rewrites them on the interval
+TEST(MetricsTest, FileExport) {
+    Counter packets;
+    MetricsRegistry registry;
+    registry.addCounter("test_packets_total", "Packets.", packets);
+
+    const std::string fileName = "metrics_test.prom";
+    registry.startFileExport(fileName, 10);
+    packets.add(5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    registry.stopFileExport();
+
+    std::ifstream in(fileName);
+    std::stringstream text;
+    text << in.rdbuf();
+    EXPECT_NE(text.str().find("test_packets_total 5\n"), std::string::npos);
+    std::remove(fileName.c_str());
+}
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "../include/outbound_queue.h"
+#include "../sockets/mock_socket.h"
+
+using ::testing::_;
+using ::testing::Return;
+
+class OutboundQueueTest : public ::testing::Test {
+protected:
+    MockSocket mockSocket;
+    int clientSocket = 5;
+    // Two frames fill the part of a queue left to the data
+    size_t queueSize = 1024;
+    size_t frameSize = 448;
+    uint8_t frame[1024] = {};
+
+    // Makes every write fail as if the socket buffer of the process was full
+    void socketFull() {
+        EXPECT_CALL(mockSocket, send(clientSocket, _, _, _))
+            .WillRepeatedly([](int, const void *, size_t, int) {
+                errno = EAGAIN;
+                return (ssize_t)-1;
+            });
+    }
+};
+
+// Test that a frame is written directly when nothing is queued
+TEST_F(OutboundQueueTest, WritesDirectlyWhenEmpty) {
+    OutboundQueue queue(&mockSocket, nullptr, clientSocket, queueSize);
+    EXPECT_CALL(mockSocket, send(clientSocket, _, 100, MSG_DONTWAIT | MSG_NOSIGNAL))
+        .WillOnce(Return(100));
+
+    EXPECT_EQ(queue.push(frame, 100, SlowConsumerPolicy::DROP), ErrorCode::SUCCESS);
+    EXPECT_EQ(queue.size(), 0);
+}
+
+// Test that the unsent tail of a frame is queued and written once the socket is writable
+TEST_F(OutboundQueueTest, QueuesPartialWriteAndFlushes) {
+    OutboundQueue queue(&mockSocket, nullptr, clientSocket, queueSize);
+    EXPECT_CALL(mockSocket, send(clientSocket, _, 100, _))
+        .WillOnce(Return(40));
+    EXPECT_EQ(queue.push(frame, 100, SlowConsumerPolicy::DROP), ErrorCode::SUCCESS);
+    EXPECT_EQ(queue.size(), 60);
+
+    EXPECT_CALL(mockSocket, send(clientSocket, _, 60, _))
+        .WillOnce(Return(60));
+    EXPECT_TRUE(queue.flush());
+    EXPECT_EQ(queue.size(), 0);
+}
+
+// Test that a full queue drops frames under the DROP policy and keeps the connection
+TEST_F(OutboundQueueTest, DropPolicyDropsWhenFull) {
+    OutboundQueue queue(&mockSocket, nullptr, clientSocket, queueSize);
+    socketFull();
+
+    EXPECT_EQ(queue.push(frame, frameSize, SlowConsumerPolicy::DROP), ErrorCode::SUCCESS);
+    EXPECT_EQ(queue.push(frame, frameSize, SlowConsumerPolicy::DROP), ErrorCode::SUCCESS);
+    EXPECT_EQ(queue.push(frame, frameSize, SlowConsumerPolicy::DROP), ErrorCode::SEND_FAILED);
+    EXPECT_EQ(queue.getDroppedFrames(), 1);
+    EXPECT_TRUE(queue.flush());
+}
+
+// Test that a full queue asks the event loop to close the connection under the DISCONNECT policy
+TEST_F(OutboundQueueTest, DisconnectPolicyClosesWhenFull) {
+    OutboundQueue queue(&mockSocket, nullptr, clientSocket, queueSize);
+    socketFull();
+
+    queue.push(frame, frameSize, SlowConsumerPolicy::DISCONNECT);
+    queue.push(frame, frameSize, SlowConsumerPolicy::DISCONNECT);
+    EXPECT_EQ(queue.push(frame, frameSize, SlowConsumerPolicy::DISCONNECT), ErrorCode::CONNECTION_FAILED);
+    EXPECT_FALSE(queue.flush());
+}
+
+// Test that a full queue is written by the sender itself under the BLOCK policy
+TEST_F(OutboundQueueTest, BlockPolicyWritesBacklog) {
+    OutboundQueue queue(&mockSocket, nullptr, clientSocket, queueSize);
+    EXPECT_CALL(mockSocket, send(clientSocket, _, _, MSG_DONTWAIT | MSG_NOSIGNAL))
+        .WillRepeatedly([](int, const void *, size_t, int) {
+            errno = EAGAIN;
+            return (ssize_t)-1;
+        });
+    EXPECT_CALL(mockSocket, send(clientSocket, _, _, MSG_NOSIGNAL))
+        .WillRepeatedly([](int, const void *, size_t len, int) { return (ssize_t)len; });
+
+    queue.push(frame, frameSize, SlowConsumerPolicy::BLOCK);
+    queue.push(frame, frameSize, SlowConsumerPolicy::BLOCK);
+    EXPECT_EQ(queue.push(frame, frameSize, SlowConsumerPolicy::BLOCK), ErrorCode::SUCCESS);
+    EXPECT_EQ(queue.size(), frameSize);
+}
+
+// Test that a control frame goes to the space kept for it without waiting when the data filled the queue
+TEST_F(OutboundQueueTest, ControlFrameUsesReservedSpace) {
+    OutboundQueue queue(&mockSocket, nullptr, clientSocket, queueSize);
+    socketFull();
+
+    queue.push(frame, frameSize, SlowConsumerPolicy::BLOCK);
+    queue.push(frame, frameSize, SlowConsumerPolicy::BLOCK);
+    EXPECT_EQ(queue.pushControl(frame, WIRE_MAX_FRAME_SIZE), ErrorCode::SUCCESS);
+    EXPECT_EQ(queue.size(), 2 * frameSize + WIRE_MAX_FRAME_SIZE);
+
+    // The data frames still see a full queue
+    EXPECT_EQ(queue.push(frame, WIRE_MAX_FRAME_SIZE, SlowConsumerPolicy::DROP), ErrorCode::SEND_FAILED);
+    EXPECT_TRUE(queue.flush());
+}
+
+// Test that a process that left even the space of the control frames full is disconnected
+TEST_F(OutboundQueueTest, ControlFrameDisconnectsWhenReservedSpaceFull) {
+    OutboundQueue queue(&mockSocket, nullptr, clientSocket, queueSize);
+    socketFull();
+
+    queue.push(frame, frameSize, SlowConsumerPolicy::DROP);
+    queue.push(frame, frameSize, SlowConsumerPolicy::DROP);
+    EXPECT_EQ(queue.pushControl(frame, WIRE_MAX_FRAME_SIZE), ErrorCode::SUCCESS);
+    EXPECT_EQ(queue.pushControl(frame, WIRE_MAX_FRAME_SIZE), ErrorCode::SUCCESS);
+    EXPECT_EQ(queue.pushControl(frame, WIRE_MAX_FRAME_SIZE), ErrorCode::CONNECTION_FAILED);
+    EXPECT_FALSE(queue.flush());
+}
+
+// Test that the capacity must leave a whole frame to the control frames
+TEST_F(OutboundQueueTest, InvalidCapacityThrows) {
+    EXPECT_THROW(OutboundQueue(&mockSocket, nullptr, clientSocket, 1000), std::invalid_argument);
+    EXPECT_THROW(OutboundQueue(&mockSocket, nullptr, clientSocket, 256), std::invalid_argument);
+    EXPECT_TRUE(OutboundQueue::validCapacity(512));
+}
+
+// Test that writable events are requested only while bytes are queued
+TEST_F(OutboundQueueTest, WriteInterestFollowsBacklog) {
+    EventLoop loop(&mockSocket, [](int) { return true; }, [](int) {});
+    OutboundQueue queue(&mockSocket, &loop, clientSocket, queueSize);
+
+    EXPECT_CALL(mockSocket, epoll_ctl(_, EPOLL_CTL_MOD, clientSocket, _))
+        .WillOnce([](int, int, int, epoll_event *event) {
+            EXPECT_TRUE(event->events & EPOLLOUT);
+            return 0;
+        })
+        .WillOnce([](int, int, int, epoll_event *event) {
+            EXPECT_FALSE(event->events & EPOLLOUT);
+            return 0;
+        });
+    EXPECT_CALL(mockSocket, send(clientSocket, _, _, _))
+        .WillOnce(Return(0))
+        .WillOnce(Return(100));
+
+    queue.push(frame, 100, SlowConsumerPolicy::DROP);
+    EXPECT_TRUE(queue.flush());
+}
+
+// Test that a closed queue rejects frames
+TEST_F(OutboundQueueTest, ClosedQueueRejects) {
+    OutboundQueue queue(&mockSocket, nullptr, clientSocket);
+    queue.close();
+    EXPECT_EQ(queue.push(frame, 100, SlowConsumerPolicy::DROP), ErrorCode::CONNECTION_FAILED);
+}
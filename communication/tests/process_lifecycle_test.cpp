@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/process_lifecycle.h"
+
+// Test that a stop signal ends the run loop instead of the process
+TEST(ProcessLifecycleTest, StopSignalEndsRun) {
+    ProcessLifecycle lifecycle;
+
+    // Sent to the thread that runs, other threads of the test binary may not block the signal
+    pthread_t runner = pthread_self();
+    std::thread sender([runner]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        pthread_kill(runner, SIGTERM);
+    });
+
+    EXPECT_EQ(lifecycle.run(), SIGTERM);
+    EXPECT_TRUE(lifecycle.isStopping());
+    sender.join();
+}
+
+// Test that a stop requested by a thread ends the run loop
+TEST(ProcessLifecycleTest, RequestStopEndsRun) {
+    ProcessLifecycle lifecycle;
+    std::thread requester([&lifecycle]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        lifecycle.requestStop();
+    });
+
+    EXPECT_EQ(lifecycle.run(), 0);
+    requester.join();
+}
+
+// Test that the workers are woken and joined before the shutdown steps run in reverse order
+TEST(ProcessLifecycleTest, JoinsWorkersBeforeShutdownSteps) {
+    ProcessLifecycle lifecycle;
+    std::atomic<int> rounds(0);
+    std::atomic<bool> workerDone(false);
+    std::vector<std::string> steps;
+
+    lifecycle.addWorker([&]() {
+        while (!lifecycle.waitForStop(std::chrono::milliseconds(10)))
+            rounds++;
+        workerDone = true;
+    });
+    lifecycle.onShutdown([&]() { steps.push_back(workerDone ? "first added" : "worker running"); });
+    lifecycle.onShutdown([&]() { steps.push_back("last added"); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    lifecycle.requestStop();
+    EXPECT_EQ(lifecycle.run(), 0);
+
+    EXPECT_GT(rounds.load(), 0);
+    EXPECT_TRUE(workerDone);
+    EXPECT_EQ(steps, std::vector<std::string>({"last added", "first added"}));
+}
+
+// Test that a worker blocked in a call of its own is interrupted before it is joined
+TEST(ProcessLifecycleTest, InterruptsBlockedWorkers) {
+    ProcessLifecycle lifecycle;
+    std::mutex blockedMutex;
+    std::condition_variable released;
+    bool interrupted = false;
+
+    lifecycle.addWorker(
+        [&]() {
+            std::unique_lock<std::mutex> lock(blockedMutex);
+            released.wait(lock, [&]() { return interrupted; });
+        },
+        [&]() {
+            std::lock_guard<std::mutex> lock(blockedMutex);
+            interrupted = true;
+            released.notify_all();
+        });
+
+    lifecycle.requestStop();
+    EXPECT_EQ(lifecycle.run(), 0);
+    EXPECT_TRUE(interrupted);
+}
+
+// Test that null workers and steps are rejected
+TEST(ProcessLifecycleTest, RejectsNullCallbacks) {
+    ProcessLifecycle lifecycle;
+    EXPECT_THROW(lifecycle.addWorker(nullptr), std::invalid_argument);
+    EXPECT_THROW(lifecycle.addWorker([]() {}, nullptr), std::invalid_argument);
+    EXPECT_THROW(lifecycle.onShutdown(nullptr), std::invalid_argument);
+}
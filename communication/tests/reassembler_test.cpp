@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+#include "../include/reassembler.h"
+#include "../include/message.h"
+
+class ReassemblerTest : public ::testing::Test {
+protected:
+    std::vector<std::pair<uint32_t, std::string>> delivered;
+    const uint8_t *lastData = nullptr;
+
+    Reassembler reassembler = Reassembler([this](uint32_t srcID, const uint8_t *data, size_t size) {
+        lastData = data;
+        delivered.emplace_back(srcID, std::string(reinterpret_cast<const char *>(data), size));
+    }, 4);
+
+    std::vector<Packet> packetsOf(const std::string &text, uint32_t srcID, uint32_t destID = 2) {
+        return Message(srcID, (void *)text.data(), text.size(), false, destID).getPackets();
+    }
+};
+
+// Test that packets arriving in order rebuild the message
+TEST_F(ReassemblerTest, InOrder) {
+    std::string text = "a message longer than a single packet";
+    for (Packet &packet : packetsOf(text, 1))
+        EXPECT_TRUE(reassembler.addPacket(packet));
+
+    ASSERT_EQ(delivered.size(), 1);
+    EXPECT_EQ(delivered[0].first, 1);
+    EXPECT_EQ(delivered[0].second, text);
+    EXPECT_EQ(reassembler.pendingMessages(), 0);
+}
+
+// Test that packets are placed by their PSN
+TEST_F(ReassemblerTest, OutOfOrder) {
+    std::string text = "packets that arrive in a different order";
+    std::vector<Packet> packets = packetsOf(text, 1);
+    std::reverse(packets.begin(), packets.end());
+    for (Packet &packet : packets)
+        reassembler.addPacket(packet);
+
+    ASSERT_EQ(delivered.size(), 1);
+    EXPECT_EQ(delivered[0].second, text);
+}
+
+// Test that a repeated packet is ignored
+TEST_F(ReassemblerTest, DuplicateIgnored) {
+    std::string text = "a message with a repeated packet";
+    std::vector<Packet> packets = packetsOf(text, 1);
+    reassembler.addPacket(packets[0]);
+    reassembler.addPacket(packets[1]);
+    EXPECT_FALSE(reassembler.addPacket(packets[1]));
+    for (size_t i = 2; i < packets.size(); ++i)
+        reassembler.addPacket(packets[i]);
+
+    ASSERT_EQ(delivered.size(), 1);
+    EXPECT_EQ(delivered[0].second, text);
+    EXPECT_EQ(reassembler.getDuplicates(), 1);
+}
+
+// Test that sources with the same message ID are kept apart
+TEST_F(ReassemblerTest, InterleavedSources) {
+    // 1 + 3 and 2 + 2 give the same ID
+    std::vector<Packet> first = packetsOf("from the first source!", 1, 3);
+    std::vector<Packet> second = packetsOf("from the second source", 2, 2);
+    ASSERT_EQ(first[0].header.ID, second[0].header.ID);
+    for (size_t i = 0; i < first.size(); ++i) {
+        reassembler.addPacket(first[i]);
+        reassembler.addPacket(second[i]);
+    }
+
+    ASSERT_EQ(delivered.size(), 2);
+    EXPECT_EQ(delivered[0].second, "from the first source!");
+    EXPECT_EQ(delivered[1].second, "from the second source");
+}
+
+// Test that a single packet message is delivered without copying
+TEST_F(ReassemblerTest, SinglePacketZeroCopy) {
+    Packet packet = packetsOf("short", 1)[0];
+    reassembler.addPacket(packet);
+
+    ASSERT_EQ(delivered.size(), 1);
+    EXPECT_EQ(lastData, reinterpret_cast<const uint8_t *>(packet.data));
+    EXPECT_EQ(reassembler.pendingMessages(), 0);
+}
+
+// Test that the least recently used message is dropped when all slots are busy
+TEST_F(ReassemblerTest, EvictsOldestWhenFull) {
+    for (uint32_t src = 1; src <= 5; ++src)
+        reassembler.addPacket(packetsOf("an incomplete message", src)[0]);
+
+    EXPECT_EQ(reassembler.pendingMessages(), 4);
+    EXPECT_EQ(reassembler.getEvictions(), 1);
+
+    // The newest messages are still in reassembly
+    std::vector<Packet> packets = packetsOf("an incomplete message", 5);
+    for (size_t i = 1; i < packets.size(); ++i)
+        reassembler.addPacket(packets[i]);
+    ASSERT_EQ(delivered.size(), 1);
+    EXPECT_EQ(delivered[0].first, 5);
+}
+
+// Test that a new message replaces one that lost a packet
+TEST_F(ReassemblerTest, RestartsOnNewFirstPacket) {
+    std::string text = "a message that loses its last packet";
+    std::vector<Packet> lost = packetsOf(text, 1);
+    for (size_t i = 0; i + 1 < lost.size(); ++i)
+        reassembler.addPacket(lost[i]);
+
+    for (Packet &packet : packetsOf(text, 1))
+        reassembler.addPacket(packet);
+
+    ASSERT_EQ(delivered.size(), 1);
+    EXPECT_EQ(delivered[0].second, text);
+}
+
+// Test that packets with impossible headers are rejected
+TEST_F(ReassemblerTest, RejectsInvalidPackets) {
+    Packet packet = packetsOf("short", 1)[0];
+    packet.header.PSN = 3;
+    EXPECT_FALSE(reassembler.addPacket(packet));
+
+    packet.header.PSN = 0;
+    packet.header.TPS = 0;
+    EXPECT_FALSE(reassembler.addPacket(packet));
+    EXPECT_EQ(reassembler.getInvalidPackets(), 2);
+    EXPECT_TRUE(delivered.empty());
+}
+
+// Test that only messages of several packets carry the CRC-32C, which is not delivered
+TEST_F(ReassemblerTest, MessageCrcOnlyOnLongMessages) {
+    std::vector<Packet> single = packetsOf("8 bytes!", 1);
+    ASSERT_EQ(single.size(), 1);
+    EXPECT_EQ(single[0].header.DLC, 8);
+
+    std::vector<Packet> packets = packetsOf("nine byte", 1);
+    ASSERT_EQ(packets.size(), 2);
+    EXPECT_EQ(packets[1].header.DLC, 1 + MESSAGE_CRC_SIZE);
+    for (Packet &packet : packets)
+        EXPECT_TRUE(reassembler.addPacket(packet));
+
+    ASSERT_EQ(delivered.size(), 1);
+    EXPECT_EQ(delivered[0].second, "nine byte");
+    EXPECT_EQ(reassembler.getCorruptMessages(), 0);
+}
+
+// Test that a message whose data changed on the way is dropped
+TEST_F(ReassemblerTest, DropsMessageWithWrongCrc) {
+    std::vector<Packet> packets = packetsOf("a message damaged on the way", 1);
+    reinterpret_cast<uint8_t *>(packets[1].data)[2] ^= 0x10;
+    for (size_t i = 0; i + 1 < packets.size(); ++i)
+        EXPECT_TRUE(reassembler.addPacket(packets[i]));
+    EXPECT_FALSE(reassembler.addPacket(packets.back()));
+
+    EXPECT_TRUE(delivered.empty());
+    EXPECT_EQ(reassembler.getCorruptMessages(), 1);
+    EXPECT_EQ(reassembler.pendingMessages(), 0);
+}
+
+// Test that a message completed by a packet of another message with the same ID is dropped
+TEST_F(ReassemblerTest, DropsMessageMixedWithAnother) {
+    std::vector<Packet> first = packetsOf("the first message to dest", 1);
+    std::vector<Packet> second = packetsOf("the other message to dest", 1);
+    ASSERT_EQ(first.size(), second.size());
+    for (size_t i = 0; i + 1 < first.size(); ++i)
+        reassembler.addPacket(first[i]);
+    reassembler.addPacket(second.back());
+
+    EXPECT_TRUE(delivered.empty());
+    EXPECT_EQ(reassembler.getCorruptMessages(), 1);
+}
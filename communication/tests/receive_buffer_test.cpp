@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include "../include/receive_buffer.h"
+
+class ReceiveBufferTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> stream;
+
+    // Appends the frame of a packet with the given sequence number to the stream
+    void appendFrame(uint32_t psn, uint8_t dlc = SIZE_PACKET) {
+        uint8_t data[SIZE_PACKET] = {1, 2, 3, 4, 5, 6, 7, 8};
+        Packet packet(1, psn, 100, 2, 3, data, dlc, false);
+        uint8_t frame[WIRE_MAX_FRAME_SIZE];
+        size_t length = encodeFrame(packet, frame, sizeof(frame));
+        stream.insert(stream.end(), frame, frame + length);
+    }
+
+    // Copies up to length bytes of the stream into the buffer, returns the number copied
+    size_t feed(ReceiveBuffer &buffer, size_t &offset, size_t length) {
+        size_t copied = std::min({length, buffer.writableSize(), stream.size() - offset});
+        std::memcpy(buffer.writePointer(), stream.data() + offset, copied);
+        buffer.commit(copied);
+        offset += copied;
+        return copied;
+    }
+};
+
+// Test that a single read holding many frames yields all of them in order
+TEST_F(ReceiveBufferTest, ManyPacketsInOneRead) {
+    for (uint32_t i = 0; i < 10; ++i)
+        appendFrame(i);
+
+    ReceiveBuffer buffer;
+    size_t offset = 0;
+    feed(buffer, offset, stream.size());
+
+    Packet packet;
+    for (uint32_t i = 0; i < 10; ++i) {
+        ASSERT_TRUE(buffer.nextPacket(packet));
+        EXPECT_EQ(packet.header.PSN, i);
+    }
+    EXPECT_FALSE(buffer.nextPacket(packet));
+    EXPECT_FALSE(buffer.isCorrupted());
+    EXPECT_EQ(buffer.size(), 0);
+}
+
+// Test that frames split into single bytes are reassembled
+TEST_F(ReceiveBufferTest, PacketSplitAcrossReads) {
+    appendFrame(0);
+    appendFrame(1, 3);
+
+    ReceiveBuffer buffer;
+    size_t offset = 0;
+    std::vector<uint32_t> received;
+    Packet packet;
+    while (offset < stream.size()) {
+        feed(buffer, offset, 1);
+        while (buffer.nextPacket(packet))
+            received.push_back(packet.header.PSN);
+    }
+
+    ASSERT_EQ(received.size(), 2);
+    EXPECT_EQ(received[0], 0);
+    EXPECT_EQ(received[1], 1);
+    EXPECT_EQ(packet.header.DLC, 3);
+}
+
+// Test that frames wrapping around the end of the ring are decoded
+TEST_F(ReceiveBufferTest, WrapAround) {
+    for (uint32_t i = 0; i < 200; ++i)
+        appendFrame(i, i % (SIZE_PACKET + 1));
+
+    ReceiveBuffer buffer(1024);
+    size_t offset = 0;
+    uint32_t expected = 0;
+    Packet packet;
+    while (offset < stream.size()) {
+        feed(buffer, offset, 100);
+        while (buffer.nextPacket(packet))
+            EXPECT_EQ(packet.header.PSN, expected++);
+    }
+
+    EXPECT_EQ(expected, 200);
+    EXPECT_FALSE(buffer.isCorrupted());
+}
+
+// Test that a frame of an unknown version is skipped without losing alignment
+TEST_F(ReceiveBufferTest, SkipsUnknownVersion) {
+    appendFrame(0);
+    stream[WIRE_FRAME_PREFIX_SIZE] = WIRE_FORMAT_VERSION + 1;
+    appendFrame(1);
+
+    ReceiveBuffer buffer;
+    size_t offset = 0;
+    feed(buffer, offset, stream.size());
+
+    Packet packet;
+    ASSERT_TRUE(buffer.nextPacket(packet));
+    EXPECT_EQ(packet.header.PSN, 1);
+    EXPECT_FALSE(buffer.isCorrupted());
+}
+
+// Test that an impossible frame length marks the stream as corrupted
+TEST_F(ReceiveBufferTest, DetectsCorruptedLength) {
+    appendFrame(0);
+    stream[0] = 0xFF;
+    stream[1] = 0xFF;
+
+    ReceiveBuffer buffer;
+    size_t offset = 0;
+    feed(buffer, offset, stream.size());
+
+    Packet packet;
+    EXPECT_FALSE(buffer.nextPacket(packet));
+    EXPECT_TRUE(buffer.isCorrupted());
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include "../include/client_connection.h"
+#include "../include/server_connection.h"
+#include "../sockets/real_socket.h"
+
+// A port of this test alone, the default bus port is bound by other suites
+#define RECONNECT_TEST_PORT 8187
+
+// Polls the condition until it holds or the timeout passes
+static bool waitFor(std::function<bool()> condition, int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+// Test that a process rejoins a bus that was restarted and sends through it again
+TEST(ReconnectTest, RejoinsRestartedBus)
+{
+    std::atomic<int> received(0);
+    auto count = [&received](Packet &) { received++; };
+    std::unique_ptr<ServerConnection> server(new ServerConnection(RECONNECT_TEST_PORT, count, new RealSocket()));
+    ASSERT_EQ(server->startConnection(), ErrorCode::SUCCESS);
+
+    ClientConnection client([](Packet &) {}, new RealSocket());
+    client.setPort(RECONNECT_TEST_PORT);
+    ASSERT_EQ(client.connectToServer(21), ErrorCode::SUCCESS);
+
+    uint8_t data[3] = {1, 2, 3};
+    Packet packet(1, 0, 1, 21, 22, data, sizeof(data), false);
+    EXPECT_EQ(client.sendPacket(packet), ErrorCode::SUCCESS);
+    ASSERT_TRUE(waitFor([&]() { return received == 1; }, 2000));
+
+    // The old bus is gone before the new one listens on the same port
+    server.reset();
+    server.reset(new ServerConnection(RECONNECT_TEST_PORT, count, new RealSocket()));
+    ASSERT_EQ(server->startConnection(), ErrorCode::SUCCESS);
+
+    ASSERT_TRUE(waitFor([&]() { return client.getReconnects() == 1; }, 5000));
+    EXPECT_TRUE(client.isConnected());
+    EXPECT_EQ(client.sendPacket(packet), ErrorCode::SUCCESS);
+    EXPECT_TRUE(waitFor([&]() { return received == 2; }, 2000));
+
+    EXPECT_EQ(client.closeConnection(), ErrorCode::SUCCESS);
+    EXPECT_FALSE(client.isReceiveThreadRunning());
+}
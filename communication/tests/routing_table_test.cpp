@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "../include/routing_table.h"
+
+class RoutingTableTest : public ::testing::Test {
+protected:
+    RoutingTable table;
+};
+
+// Test that a registration is found in both directions
+TEST_F(RoutingTableTest, AddAndFind) {
+    ASSERT_TRUE(table.add(5, 17));
+    uint32_t id = 0;
+
+    EXPECT_EQ(table.findSocket(17), 5);
+    EXPECT_TRUE(table.findID(5, id));
+    EXPECT_EQ(id, 17);
+    EXPECT_TRUE(table.containsSocket(5));
+    EXPECT_TRUE(table.containsID(17));
+    EXPECT_EQ(table.findSocket(18), -1);
+    EXPECT_FALSE(table.findID(6, id));
+}
+
+// Test that an ID and a socket can each be registered only once
+TEST_F(RoutingTableTest, RejectsDuplicates) {
+    ASSERT_TRUE(table.add(5, 17));
+
+    EXPECT_FALSE(table.add(6, 17));
+    EXPECT_FALSE(table.add(5, 18));
+    EXPECT_EQ(table.size(), 1);
+}
+
+// Test that removing a socket releases its ID
+TEST_F(RoutingTableTest, RemoveReleasesID) {
+    table.add(5, 17);
+    table.add(6, 18);
+
+    EXPECT_TRUE(table.remove(5));
+    EXPECT_FALSE(table.remove(5));
+    EXPECT_EQ(table.findSocket(17), -1);
+    EXPECT_EQ(table.findSocket(18), 6);
+    EXPECT_TRUE(table.add(7, 17));
+}
+
+// Test that a held snapshot is not changed by later writes
+TEST_F(RoutingTableTest, SnapshotIsStable) {
+    table.add(5, 17);
+    std::shared_ptr<const RoutingTable::Snapshot> before = table.snapshot();
+
+    table.add(6, 18);
+    table.remove(5);
+
+    EXPECT_EQ(before->sockets, std::vector<int>({5}));
+    EXPECT_EQ(table.snapshot()->sockets, std::vector<int>({6}));
+}
+
+// Test that clear returns every registered socket
+TEST_F(RoutingTableTest, ClearReturnsSockets) {
+    table.add(5, 17);
+    table.add(6, 18);
+
+    EXPECT_EQ(table.clear(), std::vector<int>({5, 6}));
+    EXPECT_EQ(table.size(), 0);
+}
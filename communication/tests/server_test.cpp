@@ -17,6 +17,7 @@ protected:
     void SetUp() override {
         mockSocket = new MockSocket();
         server = new ServerConnection(testPort, [](Packet& packet) {}, mockSocket);
+        testPacket = Packet(0);
     }
 
     void TearDown() override {
@@ -95,13 +96,10 @@ TEST_F(ServerTest, SendDestination_Success) {
     testPacket.header.DestID = 1;
 
     // Simulate successful send operation
-    EXPECT_CALL(*mockSocket, send(clientSocket, &testPacket, sizeof(Packet), 0))
-        .WillOnce(Return(sizeof(Packet)));
+    EXPECT_CALL(*mockSocket, send(clientSocket, _, WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket), 0))
+        .WillOnce(Return(WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket)));
 
-    {
-        std::lock_guard<std::mutex> lock(*server->getIDMapMutex());
-        (*server->getClientIDMap())[clientSocket] = testPacket.header.DestID;
-    }
+    server->getRoutingTable()->add(clientSocket, testPacket.header.DestID);
 
     ErrorCode result = server->sendDestination(testPacket);
     EXPECT_EQ(result, ErrorCode::SUCCESS);
@@ -113,13 +111,10 @@ TEST_F(ServerTest, SendDestination_Failed) {
     testPacket.header.DestID = 1;
 
     // Simulate send failure
-    EXPECT_CALL(*mockSocket, send(clientSocket, &testPacket, sizeof(Packet), 0))
+    EXPECT_CALL(*mockSocket, send(clientSocket, _, WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket), 0))
         .WillOnce(Return(0));
 
-    {
-        std::lock_guard<std::mutex> lock(*server->getIDMapMutex());
-        (*server->getClientIDMap())[clientSocket] = testPacket.header.DestID;
-    }
+    server->getRoutingTable()->add(clientSocket, testPacket.header.DestID);
 
     ErrorCode result = server->sendDestination(testPacket);
     EXPECT_EQ(result, ErrorCode::SEND_FAILED);
@@ -131,13 +126,10 @@ TEST_F(ServerTest, SendDestination_Connection_Failed) {
     testPacket.header.DestID = 1;
 
     // Simulate send failure
-    EXPECT_CALL(*mockSocket, send(clientSocket, &testPacket, sizeof(Packet), 0))
+    EXPECT_CALL(*mockSocket, send(clientSocket, _, WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket), 0))
         .WillOnce(Return(-1));
 
-    {
-        std::lock_guard<std::mutex> lock(*server->getIDMapMutex());
-        (*server->getClientIDMap())[clientSocket] = testPacket.header.DestID;
-    }
+    server->getRoutingTable()->add(clientSocket, testPacket.header.DestID);
 
     ErrorCode result = server->sendDestination(testPacket);
     EXPECT_EQ(result, ErrorCode::CONNECTION_FAILED);
@@ -154,15 +146,12 @@ TEST_F(ServerTest, SendDestination_InvalidClientID) {
 TEST_F(ServerTest, SendDestination_SendFailed) {
     testPacket.header.DestID = 1;  // Valid client ID
     int clientSocket = 3;
-    EXPECT_CALL(*mockSocket, send(clientSocket, _, sizeof(Packet), 0))
+    EXPECT_CALL(*mockSocket, send(clientSocket, _, WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket), 0))
         .WillOnce(Return(0));  // Simulate send failure
 
     // EXPECT_CALL(*mockSocket, close(clientSocket));  // Close socket on failure
 
-    {
-        std::lock_guard<std::mutex> lock(*server->getIDMapMutex());
-        (*server->getClientIDMap())[clientSocket] = testPacket.header.DestID;  // Map client to ID
-    }
+    server->getRoutingTable()->add(clientSocket, testPacket.header.DestID);  // Map client to ID
 
     ErrorCode result = server->sendDestination(testPacket);
     EXPECT_EQ(result, ErrorCode::SEND_FAILED);  // Ensure correct error code on send failure
@@ -185,17 +174,14 @@ TEST_F(ServerTest, SendBroadcast_Success) {
     int clientSocket2 = 4;
 
     // Simulate successful broadcast to two clients
-    EXPECT_CALL(*mockSocket, send(clientSocket1, _, sizeof(Packet), 0))
-        .WillOnce(Return(sizeof(Packet)));  // Success for client 1
+    EXPECT_CALL(*mockSocket, send(clientSocket1, _, WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket), 0))
+        .WillOnce(Return(WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket)));  // Success for client 1
 
-    EXPECT_CALL(*mockSocket, send(clientSocket2, _, sizeof(Packet), 0))
-        .WillOnce(Return(sizeof(Packet)));  // Success for client 2
+    EXPECT_CALL(*mockSocket, send(clientSocket2, _, WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket), 0))
+        .WillOnce(Return(WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket)));  // Success for client 2
 
-    {
-        std::lock_guard<std::mutex> lock(*server->getSocketMutex());
-        (*server->getSockets()).push_back(clientSocket1);  // Add client 1
-        (*server->getSockets()).push_back(clientSocket2);  // Add client 2
-    }
+    server->getRoutingTable()->add(clientSocket1, 1);  // Add client 1
+    server->getRoutingTable()->add(clientSocket2, 2);  // Add client 2
 
     ErrorCode result = server->sendBroadcast(testPacket);
     EXPECT_EQ(result, ErrorCode::SUCCESS);  // Ensure broadcast was successful
@@ -206,19 +192,16 @@ TEST_F(ServerTest, SendBroadcast_SendFailed) {
     int clientSocket1 = 3;
     int clientSocket2 = 4;
 
-    EXPECT_CALL(*mockSocket, send(clientSocket1, _, sizeof(Packet), 0))
-        .WillOnce(Return(sizeof(Packet)));  // Success for client 1
+    EXPECT_CALL(*mockSocket, send(clientSocket1, _, WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket), 0))
+        .WillOnce(Return(WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket)));  // Success for client 1
 
-    EXPECT_CALL(*mockSocket, send(clientSocket2, _, sizeof(Packet), 0))
+    EXPECT_CALL(*mockSocket, send(clientSocket2, _, WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket), 0))
         .WillOnce(Return(-1));  // Failure for client 2
 
     //EXPECT_CALL(*mockSocket, close(clientSocket2));  // Close socket on failure
 
-    {
-        std::lock_guard<std::mutex> lock(*server->getSocketMutex());
-        (*server->getSockets()).push_back(clientSocket1);  // Add client 1
-        (*server->getSockets()).push_back(clientSocket2);  // Add client 2
-    }
+    server->getRoutingTable()->add(clientSocket1, 1);  // Add client 1
+    server->getRoutingTable()->add(clientSocket2, 2);  // Add client 2
 
     ErrorCode result = server->sendBroadcast(testPacket);
     EXPECT_EQ(result, ErrorCode::CONNECTION_FAILED);  // Ensure broadcast failure is handled
@@ -228,34 +211,398 @@ TEST_F(ServerTest, SendBroadcast_SendFailed) {
 TEST_F(ServerTest, HandleClient_Disconnection) {
     int clientSocket = 5;
 
-    EXPECT_CALL(*mockSocket, recv(clientSocket, _, sizeof(Packet), 0))
+    EXPECT_CALL(*mockSocket, recv(clientSocket, _, _, 0))
         .WillOnce(Return(0));  // Simulate client disconnection
 
     //EXPECT_CALL(*mockSocket, close(clientSocket));  // Close socket for disconnected client
 
     server->testHandleClient(clientSocket);
-    std::vector<int>* sockets = server->getSockets();
-
-    {
-        std::lock_guard<std::mutex> lock(*server->getSocketMutex());
-        EXPECT_EQ(std::find(sockets->begin(), sockets->end(), clientSocket), sockets->end());
-    }
+    EXPECT_FALSE(server->getRoutingTable()->containsSocket(clientSocket));
 }
 
 // Test for receive failure from a client
 TEST_F(ServerTest, HandleClient_ReceiveFailed) {
     int clientSocket = 5;
 
-    EXPECT_CALL(*mockSocket, recv(clientSocket, _, sizeof(Packet), 0))
+    EXPECT_CALL(*mockSocket, recv(clientSocket, _, _, 0))
         .WillOnce(Return(-1));  // Simulate receive failure
 
     //EXPECT_CALL(*mockSocket, close(clientSocket));  // Close socket on failure
 
     server->testHandleClient(clientSocket);
 
-    std::vector<int>* sockets = server->getSockets();
-    {
-        std::lock_guard<std::mutex> lock(*server->getSocketMutex());
-        EXPECT_EQ(std::find(sockets->begin(), sockets->end(), clientSocket), sockets->end());
-    }
-}
\ No newline at end of file
+    EXPECT_FALSE(server->getRoutingTable()->containsSocket(clientSocket));
+}
+
+// Test that a reactor read registers the process and forwards the following packets
+TEST_F(ServerTest, HandleReadable_RegistersAndForwards) {
+    int clientSocket = 5;
+    int forwarded = 0;
+    server->setReceiveDataCallback([&forwarded](Packet& packet) { forwarded++; });
+
+    // The socket holds the ID packet followed by one data packet
+    std::vector<uint8_t> stream(2 * WIRE_MAX_FRAME_SIZE);
+    size_t streamSize = encodeFrame(Packet(7), stream.data(), stream.size());
+    uint8_t data[3] = {1, 2, 3};
+    streamSize += encodeFrame(Packet(1, 0, 1, 7, 2, data, sizeof(data), false), stream.data() + streamSize, stream.size() - streamSize);
+    stream.resize(streamSize);
+    size_t offset = 0;
+
+    EXPECT_CALL(*mockSocket, recv(clientSocket, _, _, _))
+        .WillRepeatedly([&stream, &offset](int, void *buf, size_t len, int) {
+            if (offset == stream.size()) {
+                errno = EAGAIN;
+                return (ssize_t)-1;
+            }
+            size_t copied = std::min(len, stream.size() - offset);
+            std::memcpy(buf, stream.data() + offset, copied);
+            offset += copied;
+            return (ssize_t)copied;
+        });
+
+    EXPECT_TRUE(server->testHandleReadable(clientSocket));
+    EXPECT_EQ(forwarded, 1);
+    EXPECT_EQ(server->testGetClientSocketByID(7), clientSocket);
+}
+
+// Test that a reactor read reports a closed connection
+TEST_F(ServerTest, HandleReadable_Disconnection) {
+    int clientSocket = 5;
+
+    EXPECT_CALL(*mockSocket, recv(clientSocket, _, _, MSG_DONTWAIT))
+        .WillOnce(Return(0));
+
+    EXPECT_FALSE(server->testHandleReadable(clientSocket));
+}
+
+// Test that a process that says HELLO gets its window of credits and the echo of its heartbeats
+TEST_F(ServerTest, HandleReadable_HelloGrantsCreditsAndEchoesHeartbeats) {
+    int clientSocket = 5;
+    Packet hello(7);
+    hello.header.control = ControlType::HELLO;
+    Packet heartbeat(7);
+    heartbeat.header.control = ControlType::HEARTBEAT;
+
+    std::vector<uint8_t> stream(2 * WIRE_MAX_FRAME_SIZE);
+    size_t streamSize = encodeFrame(hello, stream.data(), stream.size());
+    streamSize += encodeFrame(heartbeat, stream.data() + streamSize, stream.size() - streamSize);
+    stream.resize(streamSize);
+
+    EXPECT_CALL(*mockSocket, recv(clientSocket, _, _, MSG_DONTWAIT))
+        .WillOnce([&stream](int, void *buf, size_t len, int) {
+            std::memcpy(buf, stream.data(), stream.size());
+            return (ssize_t)stream.size();
+        })
+        .WillOnce([](int, void *, size_t, int) {
+            errno = EAGAIN;
+            return (ssize_t)-1;
+        });
+
+    std::vector<Packet> answers;
+    EXPECT_CALL(*mockSocket, send(clientSocket, _, _, 0))
+        .Times(2)
+        .WillRepeatedly([&answers](int, const void *buf, size_t len, int) {
+            Packet packet;
+            decodeFrame((const uint8_t *)buf, len, packet);
+            answers.push_back(packet);
+            return (ssize_t)len;
+        });
+
+    EXPECT_TRUE(server->testHandleReadable(clientSocket));
+    ASSERT_EQ(answers.size(), 2u);
+    EXPECT_EQ(answers[0].header.control, ControlType::CREDIT);
+    EXPECT_EQ(answers[0].header.ID, (uint32_t)FLOW_CONTROL_WINDOW);
+    EXPECT_EQ(answers[1].header.control, ControlType::HEARTBEAT);
+}
+
+// Test that deferred credits go back to the process in batches once the bus is done with its packets
+TEST_F(ServerTest, ReturnCredits_SentInBatches) {
+    int clientSocket = 5;
+    int forwarded = 0;
+    server->setReceiveDataCallback([&forwarded](Packet& packet) { forwarded++; });
+    server->setDeferredCredits(true);
+
+    Packet hello(7);
+    hello.header.control = ControlType::HELLO;
+    uint8_t data[3] = {1, 2, 3};
+    std::vector<uint8_t> stream(2 * WIRE_MAX_FRAME_SIZE);
+    size_t streamSize = encodeFrame(hello, stream.data(), stream.size());
+    streamSize += encodeFrame(Packet(1, 0, 1, 7, 2, data, sizeof(data), false), stream.data() + streamSize, stream.size() - streamSize);
+    stream.resize(streamSize);
+
+    EXPECT_CALL(*mockSocket, recv(clientSocket, _, _, MSG_DONTWAIT))
+        .WillOnce([&stream](int, void *buf, size_t len, int) {
+            std::memcpy(buf, stream.data(), stream.size());
+            return (ssize_t)stream.size();
+        })
+        .WillOnce([](int, void *, size_t, int) {
+            errno = EAGAIN;
+            return (ssize_t)-1;
+        });
+
+    std::vector<uint32_t> granted;
+    EXPECT_CALL(*mockSocket, send(clientSocket, _, _, 0))
+        .WillRepeatedly([&granted](int, const void *buf, size_t len, int) {
+            Packet packet;
+            decodeFrame((const uint8_t *)buf, len, packet);
+            granted.push_back(packet.header.ID);
+            return (ssize_t)len;
+        });
+
+    // Only the initial window, forwarding the packet does not return its credit yet
+    EXPECT_TRUE(server->testHandleReadable(clientSocket));
+    EXPECT_EQ(forwarded, 1);
+    EXPECT_EQ(granted, std::vector<uint32_t>({FLOW_CONTROL_WINDOW}));
+
+    server->returnCredits(7, FLOW_CONTROL_CREDIT_BATCH - 1);
+    EXPECT_EQ(granted.size(), 1u);
+    server->returnCredits(7);
+    EXPECT_EQ(granted, std::vector<uint32_t>({FLOW_CONTROL_WINDOW, FLOW_CONTROL_CREDIT_BATCH}));
+}
+
+// Test that the server mode cannot use an empty pool
+TEST_F(ServerTest, SetServerMode_ZeroWorkersThrows) {
+    EXPECT_THROW(server->setServerMode(ServerMode::REACTOR, 0), std::invalid_argument);
+}
+
+// Test that a second process cannot connect with an ID that is already in use
+TEST_F(ServerTest, HandleReadable_DuplicateIDRejected) {
+    int clientSocket = 6;
+    server->getRoutingTable()->add(5, 7);
+
+    std::vector<uint8_t> stream(WIRE_MAX_FRAME_SIZE);
+    stream.resize(encodeFrame(Packet(7), stream.data(), stream.size()));
+
+    EXPECT_CALL(*mockSocket, recv(clientSocket, _, _, MSG_DONTWAIT))
+        .WillOnce([&stream](int, void *buf, size_t len, int) {
+            std::memcpy(buf, stream.data(), stream.size());
+            return (ssize_t)stream.size();
+        });
+
+    EXPECT_FALSE(server->testHandleReadable(clientSocket));
+    EXPECT_EQ(server->testGetClientSocketByID(7), 5);
+}
+
+// Test that a process that fails to receive a broadcast does not stop the others from receiving it
+TEST_F(ServerTest, SendBroadcast_ContinuesAfterFailure) {
+    EXPECT_CALL(*mockSocket, send(3, _, _, 0))
+        .WillOnce(Return(-1));
+    EXPECT_CALL(*mockSocket, send(4, _, _, 0))
+        .WillOnce(Return(WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket)));
+
+    server->getRoutingTable()->add(3, 1);
+    server->getRoutingTable()->add(4, 2);
+
+    EXPECT_EQ(server->sendBroadcast(testPacket), ErrorCode::CONNECTION_FAILED);
+}
+
+// Test that FILTER control frames register acceptance filters and FILTER_RESET removes them
+TEST_F(ServerTest, HandleReadable_FilterControlFrames) {
+    int clientSocket = 5;
+    Packet hello(7);
+    hello.header.control = ControlType::HELLO;
+    Packet filter = FilterTable::encodeFilter(7, {0x100, 0x7FF});
+    Packet reset(7);
+    reset.header.control = ControlType::FILTER_RESET;
+
+    // The filters follow the registration, as the process sends them
+    std::vector<uint8_t> first(2 * WIRE_MAX_FRAME_SIZE);
+    size_t firstSize = encodeFrame(hello, first.data(), first.size());
+    firstSize += encodeFrame(filter, first.data() + firstSize, first.size() - firstSize);
+    first.resize(firstSize);
+    std::vector<uint8_t> second(WIRE_MAX_FRAME_SIZE);
+    second.resize(encodeFrame(reset, second.data(), second.size()));
+
+    EXPECT_CALL(*mockSocket, recv(clientSocket, _, _, MSG_DONTWAIT))
+        .WillOnce([&first](int, void *buf, size_t len, int) {
+            std::memcpy(buf, first.data(), first.size());
+            return (ssize_t)first.size();
+        })
+        .WillOnce([](int, void *, size_t, int) {
+            errno = EAGAIN;
+            return (ssize_t)-1;
+        })
+        .WillOnce([&second](int, void *buf, size_t len, int) {
+            std::memcpy(buf, second.data(), second.size());
+            return (ssize_t)second.size();
+        })
+        .WillOnce([](int, void *, size_t, int) {
+            errno = EAGAIN;
+            return (ssize_t)-1;
+        });
+    EXPECT_CALL(*mockSocket, send(clientSocket, _, _, 0))
+        .WillOnce([](int, const void *, size_t len, int) { return (ssize_t)len; });
+
+    EXPECT_TRUE(server->testHandleReadable(clientSocket));
+    EXPECT_TRUE(server->getFilterTable()->accepts(clientSocket, 0x100));
+    EXPECT_FALSE(server->getFilterTable()->accepts(clientSocket, 0x101));
+
+    EXPECT_TRUE(server->testHandleReadable(clientSocket));
+    EXPECT_TRUE(server->getFilterTable()->accepts(clientSocket, 0x101));
+}
+
+// Test that a broadcast is not sent to a process whose filters reject its ID
+TEST_F(ServerTest, SendBroadcast_SkipsFilteredProcess) {
+    EXPECT_CALL(*mockSocket, send(3, _, _, 0))
+        .Times(0);
+    EXPECT_CALL(*mockSocket, send(4, _, _, 0))
+        .WillOnce(Return(WIRE_FRAME_PREFIX_SIZE + encodedSize(testPacket)));
+
+    server->getRoutingTable()->add(3, 1);
+    server->getRoutingTable()->add(4, 2);
+    server->getFilterTable()->add(3, {0x100, 0x7FF});
+
+    EXPECT_EQ(server->sendBroadcast(testPacket), ErrorCode::SUCCESS);
+}
+
+// Test that only the processes of the bus may join it
+TEST_F(ServerTest, HandleReadable_RejectsProcessOfAnotherBus) {
+    server->setAllowedIDs({3, 4});
+    Packet hello(7);
+    hello.header.control = ControlType::HELLO;
+    std::vector<uint8_t> stream(WIRE_MAX_FRAME_SIZE);
+    stream.resize(encodeFrame(hello, stream.data(), stream.size()));
+
+    EXPECT_CALL(*mockSocket, recv(5, _, _, MSG_DONTWAIT))
+        .WillOnce([&stream](int, void *buf, size_t len, int) {
+            std::memcpy(buf, stream.data(), stream.size());
+            return (ssize_t)stream.size();
+        });
+
+    EXPECT_FALSE(server->testHandleReadable(5));
+    EXPECT_FALSE(server->getRoutingTable()->containsID(7));
+}
+
+// Test that a full bus rejects another process
+TEST_F(ServerTest, HandleReadable_RejectsProcessBeyondLimit) {
+    server->setClientLimit(1);
+    server->getRoutingTable()->add(3, 1);
+    Packet hello(7);
+    hello.header.control = ControlType::HELLO;
+    std::vector<uint8_t> stream(WIRE_MAX_FRAME_SIZE);
+    stream.resize(encodeFrame(hello, stream.data(), stream.size()));
+
+    EXPECT_CALL(*mockSocket, recv(5, _, _, MSG_DONTWAIT))
+        .WillOnce([&stream](int, void *buf, size_t len, int) {
+            std::memcpy(buf, stream.data(), stream.size());
+            return (ssize_t)stream.size();
+        });
+
+    EXPECT_FALSE(server->testHandleReadable(5));
+    EXPECT_FALSE(server->getRoutingTable()->containsID(7));
+}
+
+// Test that the slow consumer queue must hold a whole frame
+TEST_F(ServerTest, SetSlowConsumerPolicy_InvalidQueueSizeThrows) {
+    EXPECT_THROW(server->setSlowConsumerPolicy(SlowConsumerPolicy::DROP, 100), std::invalid_argument);
+}
+
+// Test that stopping the server closes the socket of a thread per client process once, by its thread
+TEST_F(ServerTest, StopServer_ClosesThreadSocketOnce) {
+    EXPECT_CALL(*mockSocket, socket(AF_INET, SOCK_STREAM, 0)).WillOnce(Return(3));
+    EXPECT_CALL(*mockSocket, setsockopt(3, _, _, _, _)).WillOnce(Return(0));
+    EXPECT_CALL(*mockSocket, bind(3, _, _)).WillOnce(Return(0));
+    EXPECT_CALL(*mockSocket, listen(3, 5)).WillOnce(Return(0));
+    EXPECT_CALL(*mockSocket, accept(3, _, _)).WillOnce(Return(5)).WillRepeatedly(Return(-1));
+
+    // The thread of the process blocks in recv until the socket is shut down
+    std::atomic<bool> reading(false);
+    std::atomic<bool> shut(false);
+    EXPECT_CALL(*mockSocket, recv(5, _, _, _)).WillRepeatedly([&](int, void *, size_t, int) {
+        reading = true;
+        while (!shut)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return (ssize_t)0;
+    });
+    EXPECT_CALL(*mockSocket, shutdown(5, SHUT_RDWR)).WillOnce([&](int, int) {
+        shut = true;
+        return 0;
+    });
+    EXPECT_CALL(*mockSocket, close(3)).Times(1);
+    EXPECT_CALL(*mockSocket, close(5)).Times(1);
+
+    ASSERT_EQ(server->startConnection(), ErrorCode::SUCCESS);
+    while (!reading)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    server->getRoutingTable()->add(5, 1);
+
+    server->stopServer();
+    EXPECT_FALSE(server->getRoutingTable()->containsID(1));
+}
+
+// Test that stopping a reactor server closes the sockets that never sent their ID
+TEST_F(ServerTest, StopServer_ClosesUnregisteredReactorSocket) {
+    server->setServerMode(ServerMode::REACTOR, 1);
+    EXPECT_CALL(*mockSocket, epoll_create1(_)).WillOnce(Return(7));
+    EXPECT_CALL(*mockSocket, epoll_wait(7, _, _, _)).WillRepeatedly([](int, epoll_event *, int, int) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return 0;
+    });
+    std::atomic<bool> added(false);
+    EXPECT_CALL(*mockSocket, epoll_ctl(7, _, _, _)).WillRepeatedly([&](int, int, int fd, epoll_event *) {
+        if (fd == 5)
+            added = true;
+        return 0;
+    });
+    EXPECT_CALL(*mockSocket, socket(AF_INET, SOCK_STREAM, 0)).WillOnce(Return(3));
+    EXPECT_CALL(*mockSocket, setsockopt(3, _, _, _, _)).WillOnce(Return(0));
+    EXPECT_CALL(*mockSocket, bind(3, _, _)).WillOnce(Return(0));
+    EXPECT_CALL(*mockSocket, listen(3, 5)).WillOnce(Return(0));
+    EXPECT_CALL(*mockSocket, accept(3, _, _)).WillOnce(Return(5)).WillRepeatedly(Return(-1));
+    EXPECT_CALL(*mockSocket, close(3)).Times(1);
+    EXPECT_CALL(*mockSocket, close(7)).Times(1);
+    EXPECT_CALL(*mockSocket, close(5)).Times(1);
+
+    ASSERT_EQ(server->startConnection(), ErrorCode::SUCCESS);
+    while (!added)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    server->stopServer();
+}
+
+// Test that the thread of a disconnected process is joined by the next accept
+TEST_F(ServerTest, AcceptJoinsFinishedClientThreads) {
+    EXPECT_CALL(*mockSocket, socket(AF_INET, SOCK_STREAM, 0)).WillOnce(Return(3));
+    EXPECT_CALL(*mockSocket, setsockopt(3, _, _, _, _)).WillOnce(Return(0));
+    EXPECT_CALL(*mockSocket, bind(3, _, _)).WillOnce(Return(0));
+    EXPECT_CALL(*mockSocket, listen(3, 5)).WillOnce(Return(0));
+
+    // The first process disconnects at once, the second connects once its thread has closed the socket
+    std::atomic<bool> firstClosed(false);
+    EXPECT_CALL(*mockSocket, recv(5, _, _, _)).WillOnce(Return(0));
+    EXPECT_CALL(*mockSocket, close(5)).WillOnce([&](int) {
+        firstClosed = true;
+        return 0;
+    });
+    EXPECT_CALL(*mockSocket, accept(3, _, _))
+        .WillOnce(Return(5))
+        .WillOnce([&](int, sockaddr *, socklen_t *) {
+            while (!firstClosed)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            return 6;
+        })
+        .WillRepeatedly(Return(-1));
+
+    std::atomic<bool> reading(false);
+    std::atomic<bool> shut(false);
+    EXPECT_CALL(*mockSocket, recv(6, _, _, _)).WillRepeatedly([&](int, void *, size_t, int) {
+        reading = true;
+        while (!shut)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return (ssize_t)0;
+    });
+    EXPECT_CALL(*mockSocket, shutdown(6, SHUT_RDWR)).WillOnce([&](int, int) {
+        shut = true;
+        return 0;
+    });
+    EXPECT_CALL(*mockSocket, close(3)).Times(1);
+    EXPECT_CALL(*mockSocket, close(6)).Times(1);
+
+    ASSERT_EQ(server->startConnection(), ErrorCode::SUCCESS);
+    while (!reading)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_EQ(server->testClientThreadCount(), 1u);
+
+    server->stopServer();
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <future>
+#include <netinet/in.h>
+#include <sys/un.h>
+#include "../sockets/shm_socket.h"
+
+class ShmSocketTest : public ::testing::Test {
+protected:
+    ShmSocket serverSocket;
+    ShmSocket clientSocket;
+    int listenFd;
+    int serverFd;
+    int clientFd;
+
+    void SetUp() override {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(18080);
+
+        listenFd = serverSocket.socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_GE(listenFd, 0);
+        ASSERT_EQ(serverSocket.bind(listenFd, (sockaddr *)&address, sizeof(address)), 0);
+        ASSERT_EQ(serverSocket.listen(listenFd, 5), 0);
+
+        std::future<int> accepted = std::async(std::launch::async, [this]() {
+            return serverSocket.accept(listenFd, nullptr, nullptr);
+        });
+        clientFd = clientSocket.socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(clientSocket.connect(clientFd, (sockaddr *)&address, sizeof(address)), 0);
+        serverFd = accepted.get();
+        ASSERT_GE(serverFd, 0);
+    }
+
+    void TearDown() override {
+        serverSocket.close(listenFd);
+    }
+};
+
+// Test that bytes written by the process reach the bus and the other way around
+TEST_F(ShmSocketTest, SendAndReceiveBothDirections) {
+    const char request[] = "ping";
+    const char response[] = "pong";
+    char buffer[16] = {};
+
+    EXPECT_EQ(clientSocket.send(clientFd, request, sizeof(request), 0), sizeof(request));
+    EXPECT_EQ(serverSocket.recv(serverFd, buffer, sizeof(buffer), 0), sizeof(request));
+    EXPECT_STREQ(buffer, request);
+
+    EXPECT_EQ(serverSocket.send(serverFd, response, sizeof(response), 0), sizeof(response));
+    EXPECT_EQ(clientSocket.recv(clientFd, buffer, sizeof(buffer), 0), sizeof(response));
+    EXPECT_STREQ(buffer, response);
+}
+
+// Test that an empty channel reports EAGAIN to non-blocking readers
+TEST_F(ShmSocketTest, NonBlockingReceiveOnEmptyChannel) {
+    char buffer[16];
+    EXPECT_EQ(serverSocket.recv(serverFd, buffer, sizeof(buffer), MSG_DONTWAIT), -1);
+    EXPECT_EQ(errno, EAGAIN);
+}
+
+// Test that the accepted descriptor becomes readable for epoll when data arrives
+TEST_F(ShmSocketTest, AcceptedDescriptorIsPollable) {
+    int epollFd = epoll_create1(0);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = serverFd;
+    ASSERT_EQ(epoll_ctl(epollFd, EPOLL_CTL_ADD, serverFd, &event), 0);
+
+    clientSocket.send(clientFd, "x", 1, 0);
+    EXPECT_EQ(epoll_wait(epollFd, &event, 1, 1000), 1);
+    ::close(epollFd);
+}
+
+// Test that a blocked reader sees the end of the stream when the peer closes
+TEST_F(ShmSocketTest, CloseWakesBlockedReader) {
+    std::future<ssize_t> reader = std::async(std::launch::async, [this]() {
+        char buffer[16];
+        return serverSocket.recv(serverFd, buffer, sizeof(buffer), 0);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    clientSocket.close(clientFd);
+    EXPECT_EQ(reader.get(), 0);
+}
+
+// Test that a message larger than the ring is streamed through completely
+TEST_F(ShmSocketTest, StreamsMoreThanTheRingCapacity) {
+    std::vector<uint8_t> message(3 * SHM_RING_SIZE);
+    for (size_t i = 0; i < message.size(); ++i)
+        message[i] = i & 0xFF;
+
+    std::future<ssize_t> writer = std::async(std::launch::async, [this, &message]() {
+        return clientSocket.send(clientFd, message.data(), message.size(), 0);
+    });
+
+    std::vector<uint8_t> received;
+    std::vector<uint8_t> buffer(65536);
+    while (received.size() < message.size()) {
+        ssize_t valread = serverSocket.recv(serverFd, buffer.data(), buffer.size(), 0);
+        ASSERT_GT(valread, 0);
+        received.insert(received.end(), buffer.begin(), buffer.begin() + valread);
+    }
+
+    EXPECT_EQ(writer.get(), (ssize_t)message.size());
+    EXPECT_EQ(received, message);
+}
+
+// Test that a process that connects without the handshake does not hold back the next one
+TEST_F(ShmSocketTest, SilentConnectionDoesNotStallAccept) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    int nameLength = snprintf(address.sun_path + 1, sizeof(address.sun_path) - 1, "vcs_bus_18080");
+    int silentFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(::connect(silentFd, (sockaddr *)&address, offsetof(sockaddr_un, sun_path) + 1 + nameLength), 0);
+
+    std::future<int> accepted = std::async(std::launch::async, [this]() {
+        return serverSocket.accept(listenFd, nullptr, nullptr);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    sockaddr_in busAddress{};
+    busAddress.sin_family = AF_INET;
+    busAddress.sin_port = htons(18080);
+    int nextFd = clientSocket.socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(clientSocket.connect(nextFd, (sockaddr *)&busAddress, sizeof(busAddress)), 0);
+
+    // Closing the silent connection would end its handshake as well, so it stays open until the accept is checked
+    std::future_status status = accepted.wait_for(std::chrono::seconds(5));
+    ::close(silentFd);
+    ASSERT_EQ(status, std::future_status::ready);
+    EXPECT_GE(accepted.get(), 0);
+    clientSocket.close(nextFd);
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "../include/wire_format.h"
+
+class WireFormatTest : public ::testing::Test {
+protected:
+    uint8_t data[SIZE_PACKET] = {0xDE, 0xAD, 0xBE, 0xEF, 0x01};
+    Packet packet = Packet(0x1234, 3, 7, 11, 22, data, 5, true, true, false);
+    uint8_t buffer[WIRE_MAX_PACKET_SIZE];
+};
+
+// Test that the encoded size holds the header and only DLC payload bytes
+TEST_F(WireFormatTest, EncodedSizeIsCompact) {
+    EXPECT_EQ(encodedSize(packet), WIRE_HEADER_SIZE + 5);
+    EXPECT_EQ(encodePacket(packet, buffer, sizeof(buffer)), WIRE_HEADER_SIZE + 5);
+    EXPECT_LT(encodedSize(packet), sizeof(Packet));
+}
+
+// Test that every header field survives an encode/decode round trip
+TEST_F(WireFormatTest, RoundTrip) {
+    size_t length = encodePacket(packet, buffer, sizeof(buffer));
+    Packet decoded;
+    ASSERT_EQ(decodePacket(buffer, length, decoded), ErrorCode::SUCCESS);
+
+    EXPECT_EQ(decoded.header.ID, packet.header.ID);
+    EXPECT_EQ(decoded.header.PSN, packet.header.PSN);
+    EXPECT_EQ(decoded.header.TPS, packet.header.TPS);
+    EXPECT_EQ(decoded.header.SrcID, packet.header.SrcID);
+    EXPECT_EQ(decoded.header.DestID, packet.header.DestID);
+    EXPECT_EQ(decoded.header.DLC, packet.header.DLC);
+    EXPECT_EQ(decoded.header.CRC, packet.header.CRC);
+    EXPECT_EQ(decoded.header.timestamp, packet.header.timestamp);
+    EXPECT_EQ(decoded.header.isBroadcast, packet.header.isBroadcast);
+    EXPECT_EQ(decoded.header.RTR, packet.header.RTR);
+    EXPECT_EQ(decoded.header.passive, packet.header.passive);
+    EXPECT_EQ(decoded.header.control, ControlType::NONE);
+    EXPECT_EQ(std::memcmp(decoded.data, data, 5), 0);
+}
+
+// Test that multi-byte fields are written little-endian regardless of the host
+TEST_F(WireFormatTest, LittleEndianLayout) {
+    encodePacket(packet, buffer, sizeof(buffer));
+    EXPECT_EQ(buffer[0], WIRE_FORMAT_VERSION);
+    EXPECT_EQ(buffer[2], 5);
+    EXPECT_EQ(buffer[4], 0x34);
+    EXPECT_EQ(buffer[5], 0x12);
+}
+
+// Test that a too small buffer is rejected
+TEST_F(WireFormatTest, EncodeBufferTooSmall) {
+    EXPECT_EQ(encodePacket(packet, buffer, WIRE_HEADER_SIZE), 0);
+}
+
+// Test that truncated and foreign-version packets are rejected
+TEST_F(WireFormatTest, DecodeRejectsInvalidInput) {
+    size_t length = encodePacket(packet, buffer, sizeof(buffer));
+    Packet decoded;
+    EXPECT_EQ(decodePacket(buffer, length - 1, decoded), ErrorCode::INVALID_DATA_SIZE);
+    EXPECT_EQ(decodePacket(buffer, WIRE_HEADER_SIZE - 1, decoded), ErrorCode::INVALID_DATA_SIZE);
+
+    buffer[0] = WIRE_FORMAT_VERSION + 1;
+    EXPECT_EQ(decodePacket(buffer, length, decoded), ErrorCode::INVALID_DATA);
+}
+
+// Test that a frame carries the encoded length in front of the packet
+TEST_F(WireFormatTest, FrameRoundTrip) {
+    uint8_t frame[WIRE_MAX_FRAME_SIZE];
+    size_t frameSize = encodeFrame(packet, frame, sizeof(frame));
+    ASSERT_EQ(frameSize, WIRE_FRAME_PREFIX_SIZE + encodedSize(packet));
+    EXPECT_EQ(frame[0] | (frame[1] << 8), encodedSize(packet));
+
+    Packet decoded;
+    EXPECT_EQ(decodeFrame(frame, frameSize, decoded), frameSize);
+    EXPECT_EQ(decoded.header.PSN, packet.header.PSN);
+    EXPECT_EQ(decodeFrame(frame, frameSize - 1, decoded), 0);
+}
+
+// Test that the times stamped by the bus travel in the trace extension
+TEST_F(WireFormatTest, TraceRoundTrip) {
+    packet.header.enqueueTime = packet.header.timestamp + 1000;
+    packet.header.routeTime = packet.header.timestamp + 0x123456789;
+    EXPECT_EQ(encodedSize(packet), WIRE_HEADER_SIZE + WIRE_TRACE_SIZE + 5);
+
+    size_t length = encodePacket(packet, buffer, sizeof(buffer));
+    EXPECT_TRUE(buffer[1] & WIRE_FLAG_TRACE);
+
+    Packet decoded;
+    ASSERT_EQ(decodePacket(buffer, length, decoded), ErrorCode::SUCCESS);
+    EXPECT_EQ(decoded.header.timestamp, packet.header.timestamp);
+    EXPECT_EQ(decoded.header.enqueueTime, packet.header.enqueueTime);
+    EXPECT_EQ(decoded.header.routeTime, packet.header.routeTime);
+    EXPECT_EQ(std::memcmp(decoded.data, data, 5), 0);
+}
+
+// Test that a frame of the connection itself keeps its type and value, and that unknown types are rejected
+TEST_F(WireFormatTest, ControlRoundTrip) {
+    Packet credit(0);
+    credit.header.control = ControlType::CREDIT;
+    credit.header.ID = 256;
+    size_t length = encodePacket(credit, buffer, sizeof(buffer));
+
+    Packet decoded;
+    ASSERT_EQ(decodePacket(buffer, length, decoded), ErrorCode::SUCCESS);
+    EXPECT_EQ(decoded.header.control, ControlType::CREDIT);
+    EXPECT_EQ(decoded.header.ID, 256u);
+
+    buffer[3] = (uint8_t)ControlType::FILTER_RESET + 1;
+    EXPECT_EQ(decodePacket(buffer, length, decoded), ErrorCode::INVALID_DATA);
+}
@@ -30,7 +30,7 @@ public:
     // Updates the condition status according to the received field and returns the  list of the full conditions whose root is true
     void updateTrueRoots(std::string field, FieldValue value, FieldType type);
 
-    void handleMessage(void *msg);
+    void handleMessage(const void *msg);
 
 private:
     template <typename T>
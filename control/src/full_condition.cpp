@@ -188,7 +188,14 @@ void FullCondition::activateActions()
         const char *message = action.second.c_str();
         size_t dataSize = strlen(message) + 1;
         uint32_t destID = action.first;
-        instanceGP.comm->sendMessage((void *)message, dataSize, destID,
-                                     instanceGP.srcID, false);
+        instanceGP.comm->sendMessageAsync(
+            (void *)message, dataSize, destID, instanceGP.srcID,
+            [destID](ErrorCode res) {
+                if (res != ErrorCode::SUCCESS)
+                    GlobalProperties::controlLogger.logMessage(
+                        logger::LogLevel::ERROR,
+                        "Failed to send action to " + to_string(destID));
+            },
+            false);
     }
 }
\ No newline at end of file
@@ -1,21 +1,21 @@
 #include "global_properties.h"
 using namespace std;
 
-void handleMesseage(uint32_t senderId,void *data)
+// The message is a view of the communication's buffer, it is parsed in place and not kept after returning
+void handleMesseage(const MessageView &message)
 {
+    uint32_t senderId = message.srcID;
     GlobalProperties &instanceGP = GlobalProperties::getInstance();
 
-    GlobalProperties::controlLogger.logMessage(logger::LogLevel::INFO, "Received message from id " + senderId);
+    GlobalProperties::controlLogger.logMessage(logger::LogLevel::INFO, "Received message from id " + to_string(senderId));
 
     char * msg = "I got message";
     size_t dataSize = strlen(msg) + 1;
     instanceGP.comm->sendMessage((void*)msg, dataSize, senderId, instanceGP.srcID, false);
-    instanceGP.sensors[senderId]->handleMessage(data);
+    instanceGP.sensors[senderId]->handleMessage(message.data);
 
     for (int cId : instanceGP.trueConditions)
         instanceGP.conditions[cId]->activateActions();
-
-    free(data);
 }
 
 int readIdFromJson()
@@ -4,11 +4,15 @@
 #include "input.h"
 #include "full_condition.h"
 #include "global_properties.h"
+#include "../../communication/include/process_lifecycle.h"
 // #include "../parser_json/src/packet_parser.h"
 using namespace std;
 
 int main()
 {
+    // Created before any thread, so that SIGINT and SIGTERM reach the run loop
+    ProcessLifecycle lifecycle;
+
     GlobalProperties &instanceGP = GlobalProperties::getInstance();
     // Build the conditions from the bson file
     Input::s_buildConditions();
@@ -17,10 +21,12 @@ int main()
     // Starting communication with the server
     instanceGP.comm->startConnection();
 
-    // Running in a time loop to receive messages and handle them
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
+    // The messages are handled by the communication threads, the main thread sleeps until the process is stopped
+    lifecycle.onShutdown([&instanceGP]() {
+        delete instanceGP.comm;
+        instanceGP.comm = nullptr;
+    });
+    lifecycle.run();
 
     GlobalProperties::controlLogger.cleanUp();
 
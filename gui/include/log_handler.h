@@ -10,6 +10,8 @@
 #include <QTime>
 #include <QVector>
 
+class BinaryLogReader;
+
 class LogHandler {
 public:
     struct LogEntry {
@@ -33,6 +35,8 @@ public:
     const QMap<int, DraggableSquare *> &getProcessSquares() const;
 
 private:
+    void readBinaryLog(BinaryLogReader &reader);
+
     QVector<LogEntry> logEntries;
     QMap<int, DraggableSquare *>
         processSquares;  // Track process squares by their IDs
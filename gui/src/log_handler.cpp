@@ -14,6 +14,7 @@
 #include "draggable_square.h"
 #include "simulation_state_manager.h"
 #include "main_window.h"
+#include "../../logger/binary_log.h"
 
 QVector<LogHandler::LogEntry> LogHandler::getLogEntries()
 {
@@ -22,6 +23,13 @@ QVector<LogHandler::LogEntry> LogHandler::getLogEntries()
 
 void LogHandler::readLogFile(const QString &fileName)
 {
+    // Binary logs are read in place, only text logs are parsed line by line
+    BinaryLogReader reader;
+    if (reader.open(fileName.toStdString())) {
+        readBinaryLog(reader);
+        return;
+    }
+
     QFile file(fileName);
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
         MainWindow::guiLogger.logMessage(
@@ -75,6 +83,34 @@ void LogHandler::readLogFile(const QString &fileName)
                                      "Log file successfully read.");
 }
 
+void LogHandler::readBinaryLog(BinaryLogReader &reader)
+{
+    BinaryLogReader::Entry record;
+    while (reader.next(record)) {
+        if (record.event != LogEvent::SEND && record.event != LogEvent::RECEIVE)
+            continue;
+
+        LogEntry entry;
+        // Binary records carry monotonic times, shown as wall clock times
+        entry.timestamp = QDateTime::fromMSecsSinceEpoch(
+            reader.toWallClock(record.timestamp) / 1000000);
+        entry.srcId = record.src;
+        entry.dstId = record.dst;
+        entry.payload = QString::fromLatin1(
+            QByteArray::fromRawData(
+                reinterpret_cast<const char *>(record.payload),
+                record.payloadLength)
+                .toHex());
+        entry.status = record.event == LogEvent::SEND ? "SEND" : "RECEIVE";
+        logEntries.push_back(entry);
+    }
+
+    MainWindow::guiLogger.logMessage(
+        logger::LogLevel::INFO,
+        "Binary log file successfully read, entries: " +
+            std::to_string(logEntries.size()));
+}
+
 void LogHandler::sortLogEntries()
 {
     std::sort(logEntries.begin(), logEntries.end());
@@ -8,6 +8,7 @@
 #include "process.h"
 #include "main_window.h"
 #include "draggable_square.h"
+#include "../../logger/log_merge.h"
 #include "process_dialog.h"
 #include "frames.h"
 #include "log_handler.h"
@@ -457,6 +458,15 @@ void MainWindow::openImageDialog()
 void MainWindow::showSimulation()
 {
     QString filePath = "log_file.log";
+
+    // Every process wrote its own segment, they are read as one timeline
+    std::vector<std::string> segments =
+        findLogSegments(logger().getLogFileName());
+    if (!segments.empty() &&
+        mergeLogSegments(segments, filePath.toStdString()) < 0)
+        guiLogger.logMessage(logger::LogLevel::ERROR,
+                             "Failed to merge the log segments");
+
     logHandler.readLogFile(filePath);
     logHandler.analyzeLogEntries(this, "simulation_state.bson");
 
@@ -8,6 +8,7 @@
 #include <QString>
 #include <QFile>
 #include <QTextStream>
+#include "../../logger/binary_log.h"
 
 class LogHandlerTests : public QObject {
     Q_OBJECT
@@ -16,6 +17,7 @@ class LogHandlerTests : public QObject {
 private slots:
     void testReadLogFile();
     void testSortLogEntries();
+    void testReadBinaryLogFile();
     void testGetProcessSquares();
 };
 
@@ -40,6 +42,45 @@ void LogHandlerTests::testSortLogEntries()
     }
 }
 
+void LogHandlerTests::testReadBinaryLogFile()
+{
+    std::string data;
+    BinaryLogRecord record = {};
+    record.event = (uint8_t)LogEvent::FILE_HEADER;
+    record.payloadLength = BINARY_LOG_MAGIC_SIZE;
+    appendBinaryLogRecord(data, record, BINARY_LOG_MAGIC);
+
+    const char text[] = "not a packet";
+    record.event = (uint8_t)LogEvent::TEXT;
+    record.payloadLength = sizeof(text);
+    appendBinaryLogRecord(data, record, text);
+
+    const uint8_t payload[] = {0x64, 0x01};
+    record.event = (uint8_t)LogEvent::SEND;
+    record.timestamp = 1722340800000000000LL;
+    record.src = 2;
+    record.dst = 3;
+    record.payloadLength = sizeof(payload);
+    appendBinaryLogRecord(data, record, payload);
+
+    QFile file("binary_log_file.log");
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(data.data(), data.size());
+    file.close();
+
+    LogHandler logHandler;
+    logHandler.readLogFile("binary_log_file.log");
+    QFile::remove("binary_log_file.log");
+
+    QVector<LogHandler::LogEntry> logEntries = logHandler.getLogEntries();
+    QCOMPARE(logEntries.size(), 1);
+    QCOMPARE(logEntries[0].srcId, 2);
+    QCOMPARE(logEntries[0].dstId, 3);
+    QCOMPARE(logEntries[0].payload, QString("6401"));
+    QCOMPARE(logEntries[0].status, QString("SEND"));
+    QCOMPARE(logEntries[0].timestamp.toMSecsSinceEpoch(), 1722340800000LL);
+}
+
 void LogHandlerTests::testGetProcessSquares()
 {
     LogHandler logHandler;
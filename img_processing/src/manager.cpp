@@ -240,8 +240,9 @@ void Manager::drawOutput()
 void Manager::sendAlerts(vector<vector<uint8_t>> &alerts)
 {
     for (std::vector<uint8_t> &alertBuffer : alerts) {
-        communication.sendMessage(alertBuffer.data(), alertBuffer.size(),
-                                  destID, processID, false);
+        // The alert is copied before the call returns, the frame loop does not wait for the bus
+        communication.sendMessageAsync(alertBuffer.data(), alertBuffer.size(),
+                                       destID, processID, nullptr, false);
     }
 }
 
@@ -0,0 +1,105 @@
+#include "binary_log.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+BinaryLogReader::BinaryLogReader()
+    : data(nullptr), size(0), offset(0), wallClockOffset(0) {}
+
+BinaryLogReader::~BinaryLogReader() { close(); }
+
+bool BinaryLogReader::open(const std::string &fileName) {
+  close();
+
+  int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(BinaryLogRecord)) {
+    ::close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+
+  data = static_cast<const uint8_t *>(mapping);
+  size = info.st_size;
+  offset = 0;
+  madvise(mapping, size, MADV_SEQUENTIAL);
+
+  // The file must start with a header record holding the magic
+  BinaryLogRecord header;
+  std::memcpy(&header, data, sizeof(header));
+  if (header.event != (uint8_t)LogEvent::FILE_HEADER ||
+      header.payloadLength < BINARY_LOG_MAGIC_SIZE ||
+      sizeof(BinaryLogRecord) + header.payloadLength > size ||
+      std::memcmp(data + sizeof(BinaryLogRecord), BINARY_LOG_MAGIC,
+                  BINARY_LOG_MAGIC_SIZE) != 0) {
+    close();
+    return false;
+  }
+
+  // Older logs carry wall clock timestamps already
+  if (header.payloadLength >= BINARY_LOG_HEADER_SIZE) {
+    int64_t wallClock;
+    std::memcpy(&wallClock,
+                data + sizeof(BinaryLogRecord) + BINARY_LOG_MAGIC_SIZE,
+                sizeof(wallClock));
+    wallClockOffset = wallClock - header.timestamp;
+  }
+  return true;
+}
+
+void BinaryLogReader::close() {
+  if (data)
+    munmap(const_cast<uint8_t *>(data), size);
+  data = nullptr;
+  size = 0;
+  offset = 0;
+  wallClockOffset = 0;
+}
+
+bool BinaryLogReader::isBinaryLog(const std::string &fileName) {
+  BinaryLogReader reader;
+  return reader.open(fileName);
+}
+
+bool BinaryLogReader::next(Entry &entry) {
+  while (offset + sizeof(BinaryLogRecord) <= size) {
+    BinaryLogRecord record;
+    std::memcpy(&record, data + offset, sizeof(record));
+    if (record.payloadLength > size - offset - sizeof(record))
+      return false;
+
+    const uint8_t *payload = data + offset + sizeof(record);
+    offset += sizeof(record) + record.payloadLength;
+
+    // Every process that opens the file writes a header, they can be anywhere
+    if (record.event == (uint8_t)LogEvent::FILE_HEADER)
+      continue;
+
+    entry.timestamp = record.timestamp;
+    entry.src = record.src;
+    entry.dst = record.dst;
+    entry.messageId = record.messageId;
+    entry.psn = record.psn;
+    entry.level = record.level;
+    entry.event = static_cast<LogEvent>(record.event);
+    entry.payload = payload;
+    entry.payloadLength = record.payloadLength;
+    return true;
+  }
+  return false;
+}
+
+void BinaryLogReader::rewind() { offset = 0; }
+
+int64_t BinaryLogReader::toWallClock(int64_t timestamp) const {
+  return timestamp + wallClockOffset;
+}
@@ -0,0 +1,117 @@
+#ifndef BINARY_LOG_H
+#define BINARY_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Written at the start of every binary log segment
+#define BINARY_LOG_MAGIC "VCSBLOG1"
+#define BINARY_LOG_MAGIC_SIZE 8
+
+// The header payload is the magic followed by the wall clock, in nanoseconds
+// since the epoch, at the monotonic timestamp of the header. Logs written
+// before it have only the magic and wall clock timestamps.
+#define BINARY_LOG_HEADER_SIZE (BINARY_LOG_MAGIC_SIZE + 8)
+
+// Longest payload of a record, longer text is cut
+#define BINARY_LOG_MAX_PAYLOAD 65535
+
+// What a binary log record describes
+enum class LogEvent : uint8_t {
+  TEXT = 0,
+  SEND = 1,
+  RECEIVE = 2,
+  FILE_HEADER = 0xFF,
+};
+
+// Fixed part of a record, followed by payloadLength bytes. TEXT records
+// carry the formatted message, SEND and RECEIVE carry the packet data.
+// Records are packed, readers copy the fixed part out before using it.
+#pragma pack(push, 1)
+struct BinaryLogRecord {
+  int64_t timestamp; // Nanoseconds on the monotonic clock
+  uint32_t src;
+  uint32_t dst;
+  uint32_t messageId;
+  uint32_t psn;
+  uint16_t payloadLength;
+  uint8_t level;
+  uint8_t event;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(BinaryLogRecord) == 28,
+              "BinaryLogRecord is part of the file format");
+
+// Appends a record and its payload to a block that is about to be written
+inline void appendBinaryLogRecord(std::string &out,
+                                  const BinaryLogRecord &record,
+                                  const void *payload) {
+  out.append(reinterpret_cast<const char *>(&record), sizeof(record));
+  out.append(static_cast<const char *>(payload), record.payloadLength);
+}
+
+// Appends the header of a segment, which ties the monotonic timestamps of
+// its records to the wall clock
+inline void appendBinaryLogHeader(std::string &out, int64_t monotonic,
+                                  int64_t wallClock) {
+  char payload[BINARY_LOG_HEADER_SIZE];
+  std::memcpy(payload, BINARY_LOG_MAGIC, BINARY_LOG_MAGIC_SIZE);
+  std::memcpy(payload + BINARY_LOG_MAGIC_SIZE, &wallClock, sizeof(wallClock));
+  BinaryLogRecord record = {};
+  record.event = (uint8_t)LogEvent::FILE_HEADER;
+  record.timestamp = monotonic;
+  record.payloadLength = BINARY_LOG_HEADER_SIZE;
+  appendBinaryLogRecord(out, record, payload);
+}
+
+// Maps a binary log and walks its records without copying them
+class BinaryLogReader {
+public:
+  // A record as it is in the file, payload points into the mapping
+  struct Entry {
+    int64_t timestamp;
+    uint32_t src;
+    uint32_t dst;
+    uint32_t messageId;
+    uint32_t psn;
+    uint8_t level;
+    LogEvent event;
+    const uint8_t *payload;
+    uint32_t payloadLength;
+  };
+
+  BinaryLogReader();
+  ~BinaryLogReader();
+
+  // Returns false if the file cannot be mapped or is not a binary log
+  bool open(const std::string &fileName);
+  void close();
+
+  // True if the file starts with a binary log header
+  static bool isBinaryLog(const std::string &fileName);
+
+  // Moves to the next record, file headers are skipped. Returns false at the
+  // end of the file or at a record that was cut short.
+  bool next(Entry &entry);
+
+  // Starts again from the first record
+  void rewind();
+
+  // Nanoseconds since the epoch of a record timestamp, for display. The
+  // first header of the file gives the wall clock.
+  int64_t toWallClock(int64_t timestamp) const;
+
+private:
+  const uint8_t *data;
+  size_t size;
+  size_t offset;
+  int64_t wallClockOffset;
+
+  BinaryLogReader(const BinaryLogReader &) = delete;
+  BinaryLogReader &operator=(const BinaryLogReader &) = delete;
+};
+
+#endif // BINARY_LOG_H
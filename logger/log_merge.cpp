@@ -0,0 +1,220 @@
+#include "log_merge.h"
+#include "binary_log.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+
+// Entries are written out in blocks of this size
+#define LOG_MERGE_BLOCK_SIZE 65536
+
+// The next entry of every segment, ordered by timestamp then by segment
+typedef std::pair<int64_t, size_t> MergeHead;
+typedef std::priority_queue<MergeHead, std::vector<MergeHead>,
+                            std::greater<MergeHead>>
+    MergeQueue;
+
+std::vector<std::string> findLogSegments(const std::string &logFileName) {
+  // Two names that differ only in the pid give the text around it
+  std::string first = logger::segmentFileName(logFileName, 1);
+  std::string second = logger::segmentFileName(logFileName, 2);
+  size_t prefixLength = std::mismatch(first.begin(), first.end(),
+                                      second.begin())
+                            .first -
+                        first.begin();
+  size_t suffixLength = first.size() - prefixLength - 1;
+
+  std::string directory = ".";
+  std::string prefix = first.substr(0, prefixLength);
+  std::string suffix = first.substr(prefixLength + 1);
+  size_t slash = prefix.rfind('/');
+  if (slash != std::string::npos) {
+    directory = prefix.substr(0, slash);
+    prefix = prefix.substr(slash + 1);
+  }
+
+  std::vector<std::string> segments;
+  DIR *dir = opendir(directory.c_str());
+  if (!dir)
+    return segments;
+
+  while (struct dirent *entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name.size() <= prefix.size() + suffixLength ||
+        name.compare(0, prefix.size(), prefix) != 0 ||
+        name.compare(name.size() - suffixLength, suffixLength, suffix) != 0)
+      continue;
+
+    std::string pid = name.substr(prefix.size(),
+                                  name.size() - prefix.size() - suffixLength);
+    if (pid.find_first_not_of("0123456789") != std::string::npos)
+      continue;
+
+    segments.push_back(slash == std::string::npos ? name
+                                                  : directory + "/" + name);
+  }
+  closedir(dir);
+
+  std::sort(segments.begin(), segments.end());
+  return segments;
+}
+
+// A text segment read one line at a time
+struct TextSegment {
+  std::ifstream in;
+  int64_t origin;
+  int64_t timestamp;
+  std::string line;
+  size_t textStart;
+
+  // Reads the next line, lines without a time keep the previous one
+  bool advance() {
+    do {
+      if (!std::getline(in, line))
+        return false;
+    } while (line.empty());
+
+    textStart = 0;
+    size_t end = line.find("ns]");
+    if (line[0] == '[' && end != std::string::npos && end > 1 &&
+        line.find_first_not_of("0123456789", 1) == end) {
+      timestamp = origin + std::stoll(line.substr(1, end - 1));
+      textStart = end + 3;
+    }
+    return true;
+  }
+};
+
+static long mergeTextSegments(const std::vector<std::string> &segments,
+                              std::ofstream &out) {
+  std::vector<std::unique_ptr<TextSegment>> inputs;
+  int64_t start = INT64_MAX;
+  for (const std::string &name : segments) {
+    std::unique_ptr<TextSegment> segment(new TextSegment());
+    segment->in.open(name);
+    if (!segment->in)
+      return -1;
+
+    // Logs written before segments existed start at 0
+    segment->origin = 0;
+    segment->timestamp = 0;
+    std::streampos begin = segment->in.tellg();
+    std::string header;
+    if (std::getline(segment->in, header) &&
+        header.compare(0, strlen(LOG_SEGMENT_HEADER), LOG_SEGMENT_HEADER) == 0)
+      segment->origin = std::stoll(header.substr(strlen(LOG_SEGMENT_HEADER)));
+    else {
+      segment->in.clear();
+      segment->in.seekg(begin);
+    }
+    start = std::min(start, segment->origin);
+    inputs.push_back(std::move(segment));
+  }
+  if (inputs.empty())
+    start = 0;
+
+  MergeQueue queue;
+  for (size_t i = 0; i < inputs.size(); ++i)
+    if (inputs[i]->advance())
+      queue.push(MergeHead(inputs[i]->timestamp, i));
+
+  std::string block = LOG_SEGMENT_HEADER + std::to_string(start) + "\n";
+  long entries = 0;
+  while (!queue.empty()) {
+    TextSegment &segment = *inputs[queue.top().second];
+    size_t index = queue.top().second;
+    queue.pop();
+
+    if (segment.textStart) {
+      block += '[';
+      block += std::to_string(segment.timestamp - start);
+      block += "ns]";
+    }
+    block.append(segment.line, segment.textStart, std::string::npos);
+    block += '\n';
+    entries++;
+
+    if (block.size() >= LOG_MERGE_BLOCK_SIZE) {
+      out.write(block.data(), block.size());
+      block.clear();
+    }
+    if (segment.advance())
+      queue.push(MergeHead(segment.timestamp, index));
+  }
+  out.write(block.data(), block.size());
+  return entries;
+}
+
+static long mergeBinarySegments(const std::vector<std::string> &segments,
+                                std::ofstream &out) {
+  std::vector<std::unique_ptr<BinaryLogReader>> readers;
+  std::vector<BinaryLogReader::Entry> current(segments.size());
+  MergeQueue queue;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    readers.push_back(std::unique_ptr<BinaryLogReader>(new BinaryLogReader()));
+    if (!readers[i]->open(segments[i]))
+      return -1;
+    if (readers[i]->next(current[i]))
+      queue.push(MergeHead(current[i].timestamp, i));
+  }
+
+  // The merged log takes the wall clock of the segment of its first record
+  std::string block;
+  if (queue.empty())
+    appendBinaryLogHeader(block, 0, 0);
+  else
+    appendBinaryLogHeader(block, queue.top().first,
+                          readers[queue.top().second]->toWallClock(
+                              queue.top().first));
+
+  long entries = 0;
+  while (!queue.empty()) {
+    size_t index = queue.top().second;
+    queue.pop();
+
+    const BinaryLogReader::Entry &entry = current[index];
+    BinaryLogRecord record = {};
+    record.timestamp = entry.timestamp;
+    record.src = entry.src;
+    record.dst = entry.dst;
+    record.messageId = entry.messageId;
+    record.psn = entry.psn;
+    record.level = entry.level;
+    record.event = (uint8_t)entry.event;
+    record.payloadLength = entry.payloadLength;
+    appendBinaryLogRecord(block, record, entry.payload);
+    entries++;
+
+    if (block.size() >= LOG_MERGE_BLOCK_SIZE) {
+      out.write(block.data(), block.size());
+      block.clear();
+    }
+    if (readers[index]->next(current[index]))
+      queue.push(MergeHead(current[index].timestamp, index));
+  }
+  out.write(block.data(), block.size());
+  return entries;
+}
+
+long mergeLogSegments(const std::vector<std::string> &segments,
+                      const std::string &outputFileName) {
+  size_t binary = 0;
+  for (const std::string &name : segments)
+    if (BinaryLogReader::isBinaryLog(name))
+      binary++;
+  if (binary != 0 && binary != segments.size())
+    return -1;
+
+  std::ofstream out(outputFileName, std::ios::binary | std::ios::trunc);
+  if (!out)
+    return -1;
+
+  long entries = binary ? mergeBinarySegments(segments, out)
+                        : mergeTextSegments(segments, out);
+  out.close();
+  return out ? entries : -1;
+}
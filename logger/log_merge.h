@@ -0,0 +1,18 @@
+#ifndef LOG_MERGE_H
+#define LOG_MERGE_H
+
+#include <string>
+#include <vector>
+
+// Segments written by the processes that shared the log file name, in the
+// order of their names
+std::vector<std::string> findLogSegments(const std::string &logFileName);
+
+// Merges text or binary segments into one file ordered by their monotonic
+// timestamps. Text lines get elapsed times from the earliest segment start.
+// Returns the number of entries written, or -1 if a file cannot be opened
+// or the segments do not share one format.
+long mergeLogSegments(const std::vector<std::string> &segments,
+                      const std::string &outputFileName);
+
+#endif // LOG_MERGE_H
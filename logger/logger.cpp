@@ -1,10 +1,693 @@
 #include "logger.h"
+#include "binary_log.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <memory>
+#include <pthread.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 std::string logger::logFileName;
 std::mutex logger::logMutex;
 std::chrono::system_clock::time_point logger::initTime =
     std::chrono::system_clock::now();
+std::chrono::steady_clock::time_point logger::monotonicInitTime =
+    std::chrono::steady_clock::now();
 std::string logger::componentName = "out";
+std::atomic<logger::OverflowPolicy> logger::overflowPolicy(LOG_OVERFLOW_POLICY);
+std::atomic<logger::LogLevel> logger::runtimeLevel(LOG_LEVEL);
+std::atomic<logger::LogFormat> logger::fileFormat(LOG_FORMAT);
+
+// One record of the ring. A message that does not fit continues in the
+// following records, the first one starts with a LogRecordHeader.
+struct LogSlot {
+  std::atomic<uint64_t> sequence;
+  char bytes[LOG_RECORD_SIZE - sizeof(std::atomic<uint64_t>)];
+};
+
+// A record is either text (src, dst and message), a format from the LOG_*
+// macros followed by its encoded arguments in the message bytes, or a packet
+// event whose data is the message bytes
+struct LogRecordHeader {
+  int64_t elapsed;
+  const char *format;
+  uint32_t srcLength;
+  uint32_t dstLength;
+  uint32_t messageLength;
+  uint32_t srcID;
+  uint32_t dstID;
+  uint32_t messageId;
+  uint32_t psn;
+  uint16_t slotCount;
+  uint8_t level;
+  uint8_t hasEndpoints;
+  uint8_t event;
+};
+
+// Longest message kept whole, longer ones are cut
+#define LOG_MAX_RECORD_SLOTS (LOG_RING_RECORDS / 8)
+
+static std::atomic<uint64_t> rotateBytes(LOG_ROTATE_BYTES);
+static std::atomic<uint32_t> rotateSeconds(LOG_ROTATE_SECONDS);
+static std::atomic<unsigned> rotateKeep(LOG_ROTATE_KEEP);
+static std::atomic<size_t> flightRecorderBytes(LOG_FLIGHT_RECORDER_BYTES);
+static std::atomic<bool> flightRecorderDumpRequested(false);
+
+// The last formatted records within a fixed number of bytes, the oldest
+// whole records make room for new ones
+class FlightRecorder {
+public:
+  FlightRecorder() : start(0), used(0) {}
+
+  void setCapacity(size_t bytes) {
+    buffer.assign(bytes, 0);
+    start = used = 0;
+    lengths.clear();
+  }
+
+  bool enabled() const { return !buffer.empty(); }
+
+  void push(const char *data, size_t length) {
+    if (length > buffer.size())
+      return;
+    while (buffer.size() - used < length) {
+      start = (start + lengths.front()) % buffer.size();
+      used -= lengths.front();
+      lengths.pop_front();
+    }
+
+    size_t end = (start + used) % buffer.size();
+    size_t first = std::min(length, buffer.size() - end);
+    std::memcpy(buffer.data() + end, data, first);
+    std::memcpy(buffer.data(), data + first, length - first);
+    used += length;
+    lengths.push_back(length);
+  }
+
+  // Moves the records to out, oldest first
+  void drainTo(std::string &out) {
+    size_t first = std::min(used, buffer.size() - start);
+    out.append(buffer.data() + start, first);
+    out.append(buffer.data(), used - first);
+    start = used = 0;
+    lengths.clear();
+  }
+
+private:
+  std::vector<char> buffer;
+  size_t start;
+  size_t used;
+  std::deque<uint32_t> lengths;
+};
+
+// Many producers reserve records with a CAS on the head and publish them
+// through the sequence of their first record. A single thread formats them
+// and writes whole blocks to a file that stays open.
+class AsyncLogWriter {
+public:
+  explicit AsyncLogWriter(const std::string &fileName);
+
+  void push(LogRecordHeader &header, const char *src, const char *dst,
+            const char *message);
+  void flush();
+  void dump();
+  void stop();
+  uint64_t getDropped() const { return dropped.load(); }
+
+private:
+  static const size_t payloadSize = sizeof(LogSlot::bytes);
+  static const uint64_t mask = LOG_RING_RECORDS - 1;
+
+  std::unique_ptr<LogSlot[]> slots;
+  std::atomic<uint64_t> head;
+  uint64_t tail;
+  std::atomic<uint64_t> written;
+  std::atomic<uint64_t> dropped;
+  uint64_t reportedDrops;
+  std::atomic<bool> running;
+  std::atomic<bool> writerSleeping;
+  std::atomic<int> blockedProducers;
+  std::atomic<int> flushWaiters;
+  std::atomic<uint64_t> dumpRequests;
+  std::atomic<uint64_t> dumpsWritten;
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  std::condition_variable spaceFreed;
+  std::condition_variable blockWritten;
+  int fd;
+  std::string fileName;
+  uint64_t bytesInFile;
+  std::chrono::steady_clock::time_point fileOpenedAt;
+  FlightRecorder recorder;
+  bool binary;
+  int64_t monotonicOrigin;
+  std::string block;
+  std::string scratch;
+  std::vector<char> text;
+  std::thread thread;
+
+  void run();
+  bool drain();
+  void writeBlock();
+  void openFile();
+  void rotate();
+  void dumpRecorder();
+  void copyIn(uint64_t position, size_t offset, const void *data,
+              size_t length);
+  void copyOut(uint64_t position, size_t offset, void *data, size_t length);
+  void appendRecord(std::string &out, const LogRecordHeader &header,
+                    const char *text);
+  static void formatRecord(std::string &out, const LogRecordHeader &header,
+                           const char *text);
+  static void formatMessage(std::string &out, const LogRecordHeader &header,
+                            const char *text);
+  static void formatArguments(std::string &out, const char *format,
+                              const char *arguments, size_t length,
+                              bool hasEndpoints);
+};
+
+const size_t AsyncLogWriter::payloadSize;
+const uint64_t AsyncLogWriter::mask;
+
+static_assert((LOG_RING_RECORDS & (LOG_RING_RECORDS - 1)) == 0,
+              "LOG_RING_RECORDS must be a power of two");
+
+// Nanoseconds on the monotonic clock since the logger started, the same
+// clock in every process so segments can be merged
+static int64_t elapsedSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Bytes as 0x followed by two hex digits per byte, like Packet::pointerToHex
+static void appendHex(std::string &out, const char *data, size_t length) {
+  static const char digits[] = "0123456789abcdef";
+  out += "0x";
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char byte = data[i];
+    out += digits[byte >> 4];
+    out += digits[byte & 0xF];
+  }
+}
+
+// The writer lives until the process exits, loggers in static objects may
+// still log while other statics are destroyed
+static std::atomic<AsyncLogWriter *> writerInstance(nullptr);
+static std::mutex writerStartMutex;
+
+static void stopWriterAtExit() {
+  AsyncLogWriter *writer = writerInstance.load();
+  if (writer)
+    writer->stop();
+}
+
+// A forked child does not have the writer thread of its parent. It leaves
+// the copied writer behind and starts its own with its own segment.
+static void lockWriterStart() { writerStartMutex.lock(); }
+
+static void unlockWriterStart() { writerStartMutex.unlock(); }
+
+static void restartWriterInChild() {
+  writerInstance.store(nullptr);
+  writerStartMutex.unlock();
+}
+
+static void requestFlightRecorderDump(int) {
+  flightRecorderDumpRequested.store(true);
+}
+
+AsyncLogWriter::AsyncLogWriter(const std::string &fileName)
+    : slots(new LogSlot[LOG_RING_RECORDS]), head(0), tail(0), written(0),
+      dropped(0), reportedDrops(0), running(true), writerSleeping(false),
+      blockedProducers(0), flushWaiters(0), dumpRequests(0), dumpsWritten(0),
+      fd(-1), fileName(fileName) {
+  for (uint64_t i = 0; i < LOG_RING_RECORDS; ++i)
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+
+  binary = logger::getFormat() == logger::LogFormat::BINARY;
+  monotonicOrigin = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        logger::monotonicInitTime.time_since_epoch())
+                        .count();
+  block.reserve(2 * LOG_WRITE_BLOCK_SIZE);
+  openFile();
+
+  // The handler only sets a flag, the writer dumps on its next pass
+  recorder.setCapacity(flightRecorderBytes.load());
+  if (recorder.enabled()) {
+    struct sigaction action = {};
+    action.sa_handler = requestFlightRecorderDump;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(LOG_FLIGHT_RECORDER_SIGNAL, &action, nullptr);
+  }
+  thread = std::thread(&AsyncLogWriter::run, this);
+}
+
+// Opens the segment and writes its header, which lets a merge place it on
+// the shared timeline
+void AsyncLogWriter::openFile() {
+  fd = ::open(fileName.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+              0644);
+  if (fd < 0)
+    std::cerr << "[ERROR]"
+              << "Failed to open log file" << std::endl;
+  fileOpenedAt = std::chrono::steady_clock::now();
+
+  std::string header;
+  if (binary) {
+    appendBinaryLogHeader(
+        header, monotonicOrigin,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            logger::initTime.time_since_epoch())
+            .count());
+  } else {
+    header += LOG_SEGMENT_HEADER;
+    header += std::to_string(monotonicOrigin);
+    header += '\n';
+  }
+  block.insert(0, header);
+  bytesInFile = 0;
+}
+
+// Moves the segment to <segment>.1, shifting older ones up to the limit
+void AsyncLogWriter::rotate() {
+  ::close(fd);
+  unsigned keep = rotateKeep.load();
+  if (keep == 0) {
+    ::unlink(fileName.c_str());
+  } else {
+    for (unsigned i = keep - 1; i >= 1; --i)
+      ::rename((fileName + "." + std::to_string(i)).c_str(),
+               (fileName + "." + std::to_string(i + 1)).c_str());
+    ::rename(fileName.c_str(), (fileName + ".1").c_str());
+  }
+  openFile();
+}
+
+// Everything in the recorder is newer than what the block holds
+void AsyncLogWriter::dumpRecorder() { recorder.drainTo(block); }
+
+void AsyncLogWriter::copyIn(uint64_t position, size_t offset,
+                            const void *data, size_t length) {
+  const char *bytes = static_cast<const char *>(data);
+  while (length > 0) {
+    LogSlot &slot = slots[(position + offset / payloadSize) & mask];
+    size_t inSlot = offset % payloadSize;
+    size_t chunk = std::min(length, payloadSize - inSlot);
+    std::memcpy(slot.bytes + inSlot, bytes, chunk);
+    bytes += chunk;
+    offset += chunk;
+    length -= chunk;
+  }
+}
+
+void AsyncLogWriter::copyOut(uint64_t position, size_t offset, void *data,
+                             size_t length) {
+  char *bytes = static_cast<char *>(data);
+  while (length > 0) {
+    LogSlot &slot = slots[(position + offset / payloadSize) & mask];
+    size_t inSlot = offset % payloadSize;
+    size_t chunk = std::min(length, payloadSize - inSlot);
+    std::memcpy(bytes, slot.bytes + inSlot, chunk);
+    bytes += chunk;
+    offset += chunk;
+    length -= chunk;
+  }
+}
+
+// Copies a record into the ring, the caller fills everything but slotCount
+void AsyncLogWriter::push(LogRecordHeader &header, const char *src,
+                          const char *dst, const char *message) {
+  size_t maxText = LOG_MAX_RECORD_SLOTS * payloadSize - sizeof(header) -
+                   header.srcLength - header.dstLength;
+  header.messageLength = std::min<size_t>(header.messageLength, maxText);
+  size_t total = sizeof(header) + header.srcLength + header.dstLength +
+                 header.messageLength;
+  uint64_t count = (total + payloadSize - 1) / payloadSize;
+  header.slotCount = count;
+
+  if (!running.load(std::memory_order_acquire)) {
+    // After exit started there is no writer, the line goes out directly
+    std::string text(src, header.srcLength);
+    text.append(dst, header.dstLength);
+    text.append(message, header.messageLength);
+    std::string line;
+    appendRecord(line, header, text.data());
+    std::lock_guard<std::mutex> guard(logger::logMutex);
+    if (fd >= 0 && ::write(fd, line.data(), line.size()) < 0)
+      std::cerr << "[ERROR]"
+                << "Failed to write log file" << std::endl;
+    return;
+  }
+
+  uint64_t position = head.load(std::memory_order_relaxed);
+  while (true) {
+    // The writer frees records in order, so if the last one is free all are
+    uint64_t last = position + count - 1;
+    uint64_t sequence =
+        slots[last & mask].sequence.load(std::memory_order_acquire);
+    if (sequence == last) {
+      if (head.compare_exchange_weak(position, position + count,
+                                     std::memory_order_relaxed))
+        break;
+    } else if (sequence < last) {
+      if (logger::getOverflowPolicy() == logger::OverflowPolicy::DROP ||
+          !running.load(std::memory_order_acquire)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      blockedProducers.fetch_add(1);
+      {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.notify_one();
+        spaceFreed.wait_for(lock, std::chrono::milliseconds(1));
+      }
+      blockedProducers.fetch_sub(1);
+      position = head.load(std::memory_order_relaxed);
+    } else {
+      position = head.load(std::memory_order_relaxed);
+    }
+  }
+
+  size_t offset = 0;
+  copyIn(position, offset, &header, sizeof(header));
+  offset += sizeof(header);
+  copyIn(position, offset, src, header.srcLength);
+  offset += header.srcLength;
+  copyIn(position, offset, dst, header.dstLength);
+  offset += header.dstLength;
+  copyIn(position, offset, message, header.messageLength);
+
+  slots[position & mask].sequence.store(position + 1);
+  if (writerSleeping.load()) {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    wake.notify_one();
+  }
+}
+
+// Formats every published record, returns false if the ring was empty
+bool AsyncLogWriter::drain() {
+  bool any = false;
+  while (slots[tail & mask].sequence.load() == tail + 1) {
+    LogRecordHeader header;
+    copyOut(tail, 0, &header, sizeof(header));
+    size_t textLength =
+        header.srcLength + header.dstLength + header.messageLength;
+    text.resize(textLength);
+    copyOut(tail, sizeof(header), text.data(), textLength);
+    size_t recordStart = block.size();
+    appendRecord(block, header, text.data());
+
+    // The recorder keeps the record instead of the file, until an error
+    if (recorder.enabled()) {
+      recorder.push(block.data() + recordStart, block.size() - recordStart);
+      block.resize(recordStart);
+      if (header.level == (uint8_t)logger::LogLevel::ERROR)
+        dumpRecorder();
+    }
+
+    for (uint64_t i = 0; i < header.slotCount; ++i)
+      slots[(tail + i) & mask].sequence.store(tail + i + LOG_RING_RECORDS,
+                                               std::memory_order_release);
+    tail += header.slotCount;
+    any = true;
+
+    if (blockedProducers.load() > 0)
+      spaceFreed.notify_all();
+    if (block.size() >= LOG_WRITE_BLOCK_SIZE)
+      writeBlock();
+  }
+  return any;
+}
+
+void AsyncLogWriter::writeBlock() {
+  uint64_t drops = dropped.load(std::memory_order_relaxed);
+  if (drops != reportedDrops) {
+    std::string message = "Dropped " + std::to_string(drops - reportedDrops) +
+                          " log messages, the ring was full";
+    LogRecordHeader header = {};
+    header.elapsed = elapsedSince(logger::monotonicInitTime);
+    header.level = static_cast<uint8_t>(logger::LogLevel::ERROR);
+    header.messageLength = message.size();
+    appendRecord(block, header, message.data());
+    reportedDrops = drops;
+  }
+
+  uint64_t maxBytes = rotateBytes.load(std::memory_order_relaxed);
+  uint32_t maxSeconds = rotateSeconds.load(std::memory_order_relaxed);
+  if (bytesInFile > 0 && !block.empty() &&
+      ((maxBytes && bytesInFile + block.size() > maxBytes) ||
+       (maxSeconds && std::chrono::steady_clock::now() - fileOpenedAt >=
+                          std::chrono::seconds(maxSeconds))))
+    rotate();
+
+  size_t done = 0;
+  while (fd >= 0 && done < block.size()) {
+    ssize_t result = ::write(fd, block.data() + done, block.size() - done);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      break;
+    done += result;
+  }
+  bytesInFile += done;
+  block.clear();
+  written.store(tail, std::memory_order_release);
+}
+
+void AsyncLogWriter::run() {
+  while (true) {
+    if (drain())
+      continue;
+
+    uint64_t requests = dumpRequests.load();
+    if (flightRecorderDumpRequested.exchange(false) ||
+        requests != dumpsWritten.load() || !running.load())
+      dumpRecorder();
+
+    // The ring is empty, everything formatted so far goes out in one write
+    if (!block.empty() || written.load() != tail ||
+        dropped.load(std::memory_order_relaxed) != reportedDrops)
+      writeBlock();
+    dumpsWritten.store(requests);
+    if (flushWaiters.load() > 0) {
+      std::lock_guard<std::mutex> lock(wakeMutex);
+      blockWritten.notify_all();
+    }
+
+    if (!running.load()) {
+      // Records reserved before the stop are still being copied in
+      if (head.load() == tail)
+        return;
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    writerSleeping.store(true);
+    if (slots[tail & mask].sequence.load() != tail + 1 && running.load())
+      wake.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+    writerSleeping.store(false);
+  }
+}
+
+void AsyncLogWriter::flush() {
+  uint64_t target = head.load();
+  flushWaiters.fetch_add(1);
+  std::unique_lock<std::mutex> lock(wakeMutex);
+  while (running.load() && written.load(std::memory_order_acquire) < target) {
+    wake.notify_one();
+    blockWritten.wait_for(lock, std::chrono::milliseconds(1));
+  }
+  flushWaiters.fetch_sub(1);
+}
+
+// Waits until the writer wrote the recorder out, the records logged before
+// the call are in it after a flush
+void AsyncLogWriter::dump() {
+  flush();
+  uint64_t request = dumpRequests.fetch_add(1) + 1;
+  flushWaiters.fetch_add(1);
+  std::unique_lock<std::mutex> lock(wakeMutex);
+  while (running.load() && dumpsWritten.load() < request) {
+    wake.notify_one();
+    blockWritten.wait_for(lock, std::chrono::milliseconds(1));
+  }
+  flushWaiters.fetch_sub(1);
+}
+
+void AsyncLogWriter::stop() {
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    if (!running.load())
+      return;
+    running.store(false, std::memory_order_release);
+    wake.notify_one();
+  }
+  if (thread.joinable())
+    thread.join();
+}
+
+// Appends a record in the format of the file
+void AsyncLogWriter::appendRecord(std::string &out,
+                                  const LogRecordHeader &header,
+                                  const char *text) {
+  if (!binary) {
+    formatRecord(out, header, text);
+    return;
+  }
+
+  BinaryLogRecord record = {};
+  record.timestamp = monotonicOrigin + header.elapsed;
+  record.src = header.srcID;
+  record.dst = header.dstID;
+  record.messageId = header.messageId;
+  record.psn = header.psn;
+  record.level = header.level;
+  record.event = header.event;
+
+  // Packets keep their raw data, anything else is stored as its text
+  const char *payload = text + header.srcLength + header.dstLength;
+  size_t payloadLength = header.messageLength;
+  if (header.event == (uint8_t)LogEvent::TEXT) {
+    scratch.clear();
+    formatMessage(scratch, header, text);
+    payload = scratch.data();
+    payloadLength = scratch.size();
+  }
+  record.payloadLength = std::min<size_t>(payloadLength, BINARY_LOG_MAX_PAYLOAD);
+  appendBinaryLogRecord(out, record, payload);
+}
+
+// Appends a record as a text line
+void AsyncLogWriter::formatRecord(std::string &out,
+                                  const LogRecordHeader &header,
+                                  const char *text) {
+  out += '[';
+  out += std::to_string(header.elapsed);
+  out += "ns] ";
+  out += logger::logLevelToString(static_cast<logger::LogLevel>(header.level));
+  out += ' ';
+  formatMessage(out, header, text);
+  out += '\n';
+}
+
+// The message of a record, without the time and the level
+void AsyncLogWriter::formatMessage(std::string &out,
+                                   const LogRecordHeader &header,
+                                   const char *text) {
+  const char *message = text + header.srcLength + header.dstLength;
+  if (header.event != (uint8_t)LogEvent::TEXT) {
+    out += "SRC " + std::to_string(header.srcID) + " DST " +
+           std::to_string(header.dstID) + ' ';
+    out += header.event == (uint8_t)LogEvent::SEND ? "sending" : "received";
+    out += " packet number: " + std::to_string(header.psn) +
+           ", of messageId: " + std::to_string(header.messageId);
+    if (header.messageLength == 0) {
+      out += " ID for connection: " + std::to_string(header.srcID);
+    } else {
+      out += " Data: ";
+      appendHex(out, message, header.messageLength);
+    }
+  } else if (header.format) {
+    formatArguments(out, header.format, message, header.messageLength,
+                    header.hasEndpoints);
+  } else {
+    if (header.hasEndpoints) {
+      out += "SRC ";
+      out.append(text, header.srcLength);
+      out += " DST ";
+      out.append(text + header.srcLength, header.dstLength);
+      out += ' ';
+    }
+    out.append(message, header.messageLength);
+  }
+}
+
+// Appends one encoded argument, returns false if the arguments were cut
+static bool appendArgument(std::string &out, const char *&cursor,
+                           const char *end) {
+  if (cursor >= end)
+    return false;
+
+  char tag = *cursor++;
+  size_t fixed = tag == 'b' || tag == 'c' ? 1 : 8;
+  if (tag == 's' || tag == 'x') {
+    uint32_t length;
+    if (end - cursor < (ptrdiff_t)sizeof(length))
+      return false;
+    std::memcpy(&length, cursor, sizeof(length));
+    cursor += sizeof(length);
+    length = std::min<size_t>(length, end - cursor);
+    if (tag == 's') {
+      out.append(cursor, length);
+    } else {
+      appendHex(out, cursor, length);
+    }
+    cursor += length;
+    return true;
+  }
+
+  if (end - cursor < (ptrdiff_t)fixed)
+    return false;
+  if (tag == 'i') {
+    int64_t value;
+    std::memcpy(&value, cursor, sizeof(value));
+    out += std::to_string(value);
+  } else if (tag == 'u') {
+    uint64_t value;
+    std::memcpy(&value, cursor, sizeof(value));
+    out += std::to_string(value);
+  } else if (tag == 'd') {
+    double value;
+    std::memcpy(&value, cursor, sizeof(value));
+    out += std::to_string(value);
+  } else if (tag == 'b') {
+    out += *cursor ? "true" : "false";
+  } else if (tag == 'c') {
+    out += *cursor;
+  } else {
+    return false;
+  }
+  cursor += fixed;
+  return true;
+}
+
+// Replaces each {} in the format with the next argument, {{ and }} print a
+// single brace
+void AsyncLogWriter::formatArguments(std::string &out, const char *format,
+                                     const char *arguments, size_t length,
+                                     bool hasEndpoints) {
+  const char *cursor = arguments;
+  const char *end = arguments + length;
+  if (hasEndpoints) {
+    out += "SRC ";
+    appendArgument(out, cursor, end);
+    out += " DST ";
+    appendArgument(out, cursor, end);
+    out += ' ';
+  }
+
+  for (const char *c = format; *c; ++c) {
+    if (c[0] == '{' && c[1] == '}') {
+      if (!appendArgument(out, cursor, end))
+        out += "{}";
+      ++c;
+    } else if ((c[0] == '{' || c[0] == '}') && c[1] == c[0]) {
+      out += *c++;
+    } else {
+      out += *c;
+    }
+  }
+}
 
 logger::logger(std::string componentName) {
   logger::componentName = componentName;
@@ -48,6 +731,22 @@ std::string logger::getLogFileName() {
   return logFileName;
 }
 
+std::string logger::getSegmentFileName() {
+  return segmentFileName(getLogFileName(), getpid());
+}
+
+// name.log becomes name.<pid>.log
+std::string logger::segmentFileName(const std::string &logFileName, int pid) {
+  std::string stem = logFileName;
+  std::string extension;
+  size_t dot = logFileName.rfind('.');
+  if (dot != std::string::npos && logFileName.find('/', dot) == std::string::npos) {
+    stem = logFileName.substr(0, dot);
+    extension = logFileName.substr(dot);
+  }
+  return stem + "." + std::to_string(pid) + extension;
+}
+
 void logger::cleanUp() { std::remove(sharedLogFileName.c_str()); }
 
 std::string logger::logLevelToString(LogLevel level) {
@@ -63,25 +762,94 @@ std::string logger::logLevelToString(LogLevel level) {
   }
 }
 
-bool logger::shouldLog(LogLevel level) {
-  switch (LOG_LEVEL) {
-  case LogLevel::ERROR:
-    return level == LogLevel::ERROR;
-  case LogLevel::INFO:
-    return level == LogLevel::ERROR || level == LogLevel::INFO;
-  case LogLevel::DEBUG:
-    return true;
-  default:
-    return false;
+bool logger::shouldLog(LogLevel level) { return isEnabled(level); }
+
+// Started by the first message, which also fixes the file name
+static AsyncLogWriter &startWriter(logger &owner) {
+  AsyncLogWriter *writer = writerInstance.load(std::memory_order_acquire);
+  if (writer)
+    return *writer;
+
+  std::lock_guard<std::mutex> lock(writerStartMutex);
+  writer = writerInstance.load();
+  if (!writer) {
+    static bool hooksInstalled = false;
+    if (!hooksInstalled) {
+      std::atexit(stopWriterAtExit);
+      pthread_atfork(lockWriterStart, unlockWriterStart, restartWriterInChild);
+      hooksInstalled = true;
+    }
+    writer = new AsyncLogWriter(owner.getSegmentFileName());
+    writerInstance.store(writer, std::memory_order_release);
+  }
+  return *writer;
+}
+
+void logger::enqueue(LogLevel level, const std::string *src,
+                     const std::string *dst, const std::string &message) {
+  LogRecordHeader header = {};
+  header.elapsed = elapsedSince(monotonicInitTime);
+  header.level = static_cast<uint8_t>(level);
+  header.hasEndpoints = src != nullptr;
+  header.srcLength = src ? src->size() : 0;
+  header.dstLength = dst ? dst->size() : 0;
+  header.messageLength = message.size();
+  if (src) {
+    header.srcID = endpointID(*src);
+    header.dstID = endpointID(*dst);
   }
+  startWriter(*this).push(header, src ? src->data() : "",
+                          dst ? dst->data() : "", message.data());
+}
+
+void logger::enqueueFormatted(LogLevel level, const char *format,
+                              bool hasEndpoints, uint32_t srcID,
+                              uint32_t dstID, const std::string &arguments) {
+  LogRecordHeader header = {};
+  header.elapsed = elapsedSince(monotonicInitTime);
+  header.format = format;
+  header.level = static_cast<uint8_t>(level);
+  header.hasEndpoints = hasEndpoints;
+  header.srcID = srcID;
+  header.dstID = dstID;
+  header.messageLength = arguments.size();
+  startWriter(*this).push(header, "", "", arguments.data());
 }
 
-std::string logger::getElapsedTime() {
-  auto now = std::chrono::system_clock::now();
-  auto elapsed =
-      std::chrono::duration_cast<std::chrono::nanoseconds>(now - initTime)
-          .count();
-  return std::to_string(elapsed) + "ns";
+void logger::logPacket(LogLevel level, LogEvent event, uint32_t src,
+                       uint32_t dst, uint32_t messageId, uint32_t psn,
+                       const void *data, size_t size) {
+  LogRecordHeader header = {};
+  header.elapsed = elapsedSince(monotonicInitTime);
+  header.level = static_cast<uint8_t>(level);
+  header.event = static_cast<uint8_t>(event);
+  header.hasEndpoints = true;
+  header.srcID = src;
+  header.dstID = dst;
+  header.messageId = messageId;
+  header.psn = psn;
+  header.messageLength = size;
+  startWriter(*this).push(header, "", "", static_cast<const char *>(data));
+}
+
+uint32_t logger::endpointID(const std::string &value) {
+  return endpointID(value.c_str());
+}
+
+uint32_t logger::endpointID(const char *value) {
+  uint32_t id = 0;
+  for (const char *c = value; *c; ++c) {
+    if (*c < '0' || *c > '9')
+      return 0;
+    id = id * 10 + (*c - '0');
+  }
+  return id;
+}
+
+// Reused by every LOG_* call of the thread, so encoding does not allocate
+std::string &logger::argumentBuffer() {
+  static thread_local std::string buffer;
+  return buffer;
 }
 
 void logger::logMessage(LogLevel level, std::string src, std::string dst,
@@ -89,31 +857,54 @@ void logger::logMessage(LogLevel level, std::string src, std::string dst,
   if (!shouldLog(level))
     return;
 
-  std::lock_guard<std::mutex> guard(logMutex);
-  std::ofstream logFile(getLogFileName(), std::ios_base::app);
-  if (!logFile) {
-    std::cerr << logLevelToString(LogLevel::ERROR) << "Failed to open log file"
-              << std::endl;
-    return;
-  }
-  logFile << "[" << getElapsedTime() << "] " << logLevelToString(level) << " "
-          << "SRC " << src << " "
-          << "DST " << dst << " " << message << std::endl;
+  enqueue(level, &src, &dst, message);
 }
 
 void logger::logMessage(LogLevel level, const std::string &message) {
   if (!shouldLog(level))
     return;
 
-  std::lock_guard<std::mutex> guard(logMutex);
+  enqueue(level, nullptr, nullptr, message);
+}
 
-  std::ofstream logFile(getLogFileName(), std::ios_base::app);
-  if (!logFile) {
-    std::cerr << logLevelToString(LogLevel::ERROR) << "Failed to open log file"
-              << std::endl;
-    return;
-  }
+void logger::setOverflowPolicy(OverflowPolicy policy) {
+  overflowPolicy.store(policy);
+}
+
+void logger::setLevel(LogLevel level) { runtimeLevel.store(level); }
+
+void logger::setFormat(LogFormat format) { fileFormat.store(format); }
+
+void logger::setRotation(uint64_t maxBytes, uint32_t maxSeconds,
+                         unsigned keepFiles) {
+  rotateBytes.store(maxBytes);
+  rotateSeconds.store(maxSeconds);
+  rotateKeep.store(keepFiles);
+}
+
+void logger::setFlightRecorder(size_t bytes) {
+  flightRecorderBytes.store(bytes);
+}
+
+void logger::dumpFlightRecorder() {
+  AsyncLogWriter *writer = writerInstance.load();
+  if (writer)
+    writer->dump();
+}
+
+logger::LogFormat logger::getFormat() { return fileFormat.load(); }
 
-  logFile << "[" << getElapsedTime() << "] " << logLevelToString(level) << " "
-          << message << std::endl;
-}
\ No newline at end of file
+logger::OverflowPolicy logger::getOverflowPolicy() {
+  return overflowPolicy.load(std::memory_order_relaxed);
+}
+
+void logger::flush() {
+  AsyncLogWriter *writer = writerInstance.load();
+  if (writer)
+    writer->flush();
+}
+
+uint64_t logger::getDroppedMessages() {
+  AsyncLogWriter *writer = writerInstance.load();
+  return writer ? writer->getDropped() : 0;
+}
@@ -1,18 +1,108 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <type_traits>
+#include "binary_log.h"
 
+// TEXT writes readable lines, BINARY writes BinaryLogRecord entries
+#ifndef LOG_FORMAT
+#define LOG_FORMAT logger::LogFormat::TEXT
+#endif
+
+// Messages above this level are compiled out of the LOG_* macros
 #ifndef LOG_LEVEL
 #define LOG_LEVEL logger::LogLevel::INFO
 #endif
 
+// The arguments of these macros are evaluated only if the level is enabled.
+// The format is a string literal with {} for each argument and {{ or }} for
+// a brace, the arguments are copied as they are and formatted later by the
+// writer thread. A {} without an argument is printed as it is, arguments
+// without a {} are left out:
+//   LOG_DEBUG(log, "packet {} of message {}", psn, id);
+//   LOG_ROUTE_INFO(log, srcID, destID, "data {}", logger::hex(data, size));
+#define LOG_AT(log, level, ...)                                                \
+  do {                                                                         \
+    if (logger::isEnabled(level))                                              \
+      (log).logFormat(level, __VA_ARGS__);                                     \
+  } while (0)
+#define LOG_ROUTE_AT(log, level, src, dst, ...)                                \
+  do {                                                                         \
+    if (logger::isEnabled(level))                                              \
+      (log).logRoute(level, src, dst, __VA_ARGS__);                            \
+  } while (0)
+#define LOG_ERROR(log, ...) LOG_AT(log, logger::LogLevel::ERROR, __VA_ARGS__)
+#define LOG_INFO(log, ...) LOG_AT(log, logger::LogLevel::INFO, __VA_ARGS__)
+#define LOG_DEBUG(log, ...) LOG_AT(log, logger::LogLevel::DEBUG, __VA_ARGS__)
+#define LOG_ROUTE_ERROR(log, src, dst, ...)                                    \
+  LOG_ROUTE_AT(log, logger::LogLevel::ERROR, src, dst, __VA_ARGS__)
+#define LOG_ROUTE_INFO(log, src, dst, ...)                                     \
+  LOG_ROUTE_AT(log, logger::LogLevel::INFO, src, dst, __VA_ARGS__)
+#define LOG_ROUTE_DEBUG(log, src, dst, ...)                                    \
+  LOG_ROUTE_AT(log, logger::LogLevel::DEBUG, src, dst, __VA_ARGS__)
+
+// A packet that was sent or received, kept as structured fields
+#define LOG_PACKET(log, level, event, src, dst, messageId, psn, data, size)    \
+  do {                                                                         \
+    if (logger::isEnabled(level))                                              \
+      (log).logPacket(level, event, src, dst, messageId, psn, data, size);     \
+  } while (0)
+
+// Records the background writer can hold, a power of two
+#ifndef LOG_RING_RECORDS
+#define LOG_RING_RECORDS 16384
+#endif
+
+// Size of one record in the ring, longer messages take several records
+#define LOG_RECORD_SIZE 128
+
+// What logMessage does when the ring is full
+#ifndef LOG_OVERFLOW_POLICY
+#define LOG_OVERFLOW_POLICY logger::OverflowPolicy::DROP
+#endif
+
+// The writer collects formatted lines up to this size before writing them
+#define LOG_WRITE_BLOCK_SIZE 65536
+
+// Longest time the writer sleeps when the ring is empty
+#define LOG_FLUSH_INTERVAL_MS 100
+
+// A segment is rotated to <segment>.1 once it reaches this size in bytes or
+// this age in seconds, 0 turns the limit off
+#ifndef LOG_ROTATE_BYTES
+#define LOG_ROTATE_BYTES 0
+#endif
+#ifndef LOG_ROTATE_SECONDS
+#define LOG_ROTATE_SECONDS 0
+#endif
+
+// Rotated segments kept on disk, older ones are deleted
+#ifndef LOG_ROTATE_KEEP
+#define LOG_ROTATE_KEEP 4
+#endif
+
+// Bytes of the most recent output kept in memory instead of the file, 0
+// writes everything to the file
+#ifndef LOG_FLIGHT_RECORDER_BYTES
+#define LOG_FLIGHT_RECORDER_BYTES 0
+#endif
+
+// Writes the flight recorder to the file
+#define LOG_FLIGHT_RECORDER_SIGNAL SIGUSR1
+
+// First line of a text log segment, followed by the monotonic clock in
+// nanoseconds at which the elapsed times of the segment start
+#define LOG_SEGMENT_HEADER "# VCSLOG segment monotonic="
+
 class logger {
 public:
   enum class LogLevel {
@@ -20,6 +110,24 @@ public:
     INFO,
     DEBUG,
   };
+  enum class LogFormat {
+    TEXT,
+    BINARY,
+  };
+  // DROP counts the message and returns, BLOCK waits for the writer
+  enum class OverflowPolicy {
+    DROP,
+    BLOCK,
+  };
+  // Bytes printed as 0x followed by two hex digits per byte
+  struct Hex {
+    const void *data;
+    size_t size;
+  };
+  static Hex hex(const void *data, size_t size) {
+    Hex value = {data, size};
+    return value;
+  }
   logger() {}
   logger(std::string componentName);
   void logMessage(LogLevel level, const std::string &message);
@@ -27,18 +135,146 @@ public:
                   const std::string &message);
   void initializeLogFile();
   std::string getLogFileName();
+  // Each process writes its own segment next to the shared log file name
+  std::string getSegmentFileName();
+  static std::string segmentFileName(const std::string &logFileName, int pid);
   std::string sharedLogFileName = "shared_log_file_name.txt";
   void cleanUp();
+  // Messages are queued to a background thread that writes them in blocks
+  static void setOverflowPolicy(OverflowPolicy policy);
+  static OverflowPolicy getOverflowPolicy();
+  // Waits until every message logged before the call is in the file
+  static void flush();
+  static uint64_t getDroppedMessages();
+  // Takes effect if called before the first message opens the file
+  static void setFormat(LogFormat format);
+  // Limits the size and age of a segment, 0 turns a limit off
+  static void setRotation(uint64_t maxBytes, uint32_t maxSeconds,
+                          unsigned keepFiles);
+  // Keeps the last bytes of output in memory. They are written to the file
+  // on an ERROR message, on LOG_FLIGHT_RECORDER_SIGNAL, on
+  // dumpFlightRecorder and at exit. Takes effect before the first message.
+  static void setFlightRecorder(size_t bytes);
+  // Returns once the recorder is in the file
+  static void dumpFlightRecorder();
+  static LogFormat getFormat();
+  // Lowers the level at run time, it cannot go above LOG_LEVEL
+  static void setLevel(LogLevel level);
+  static bool isEnabled(LogLevel level) {
+    return level <= LOG_LEVEL &&
+           level <= runtimeLevel.load(std::memory_order_relaxed);
+  }
+  // Used by the LOG_* macros, the format must outlive the process
+  template <typename... Args>
+  void logFormat(LogLevel level, const char *format, const Args &...args) {
+    std::string &buffer = argumentBuffer();
+    buffer.clear();
+    encodeAll(buffer, args...);
+    enqueueFormatted(level, format, false, 0, 0, buffer);
+  }
+  template <typename Src, typename Dst, typename... Args>
+  void logRoute(LogLevel level, const Src &src, const Dst &dst,
+                const char *format, const Args &...args) {
+    std::string &buffer = argumentBuffer();
+    buffer.clear();
+    encodeAll(buffer, src, dst, args...);
+    enqueueFormatted(level, format, true, endpointID(src), endpointID(dst),
+                     buffer);
+  }
+  // Used by LOG_PACKET, the payload is copied
+  void logPacket(LogLevel level, LogEvent event, uint32_t src, uint32_t dst,
+                 uint32_t messageId, uint32_t psn, const void *data,
+                 size_t size);
 
 private:
   static std::string logLevelToString(LogLevel level);
   static bool shouldLog(LogLevel level);
-  static std::string getElapsedTime();
+  void enqueue(LogLevel level, const std::string *src, const std::string *dst,
+               const std::string &message);
+  void enqueueFormatted(LogLevel level, const char *format, bool hasEndpoints,
+                        uint32_t srcID, uint32_t dstID,
+                        const std::string &arguments);
+
+  // Numeric process IDs of the endpoints for binary records, 0 if unknown
+  static uint32_t endpointID(const std::string &value);
+  static uint32_t endpointID(const char *value);
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value, uint32_t>::type
+  endpointID(T value) {
+    return value;
+  }
+  template <typename T>
+  static typename std::enable_if<!std::is_integral<T>::value &&
+                                     !std::is_convertible<T, const char *>::value,
+                                 uint32_t>::type
+  endpointID(const T &) {
+    return 0;
+  }
+  static std::string &argumentBuffer();
+
+  // Each argument is a type tag followed by its bytes
+  static void encodeBytes(std::string &out, char tag, const void *data,
+                          size_t size) {
+    uint32_t length = size;
+    out += tag;
+    out.append(reinterpret_cast<const char *>(&length), sizeof(length));
+    out.append(static_cast<const char *>(data), size);
+  }
+  static void encode(std::string &out, const std::string &value) {
+    encodeBytes(out, 's', value.data(), value.size());
+  }
+  static void encode(std::string &out, const char *value) {
+    encodeBytes(out, 's', value, std::char_traits<char>::length(value));
+  }
+  static void encode(std::string &out, const Hex &value) {
+    encodeBytes(out, 'x', value.data, value.size);
+  }
+  static void encode(std::string &out, bool value) {
+    out += 'b';
+    out += static_cast<char>(value);
+  }
+  static void encode(std::string &out, char value) {
+    out += 'c';
+    out += value;
+  }
+  static void encode(std::string &out, double value) {
+    out += 'd';
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value &&
+                                 std::is_signed<T>::value>::type
+  encode(std::string &out, T value) {
+    int64_t wide = value;
+    out += 'i';
+    out.append(reinterpret_cast<const char *>(&wide), sizeof(wide));
+  }
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value &&
+                                 std::is_unsigned<T>::value>::type
+  encode(std::string &out, T value) {
+    uint64_t wide = value;
+    out += 'u';
+    out.append(reinterpret_cast<const char *>(&wide), sizeof(wide));
+  }
+  static void encodeAll(std::string &) {}
+  template <typename T, typename... Rest>
+  static void encodeAll(std::string &out, const T &first,
+                        const Rest &...rest) {
+    encode(out, first);
+    encodeAll(out, rest...);
+  }
+
   static std::string componentName;
   static std::string logFileName;
   bool isInitialized = false;
   static std::mutex logMutex;
   static std::chrono::system_clock::time_point initTime;
+  static std::chrono::steady_clock::time_point monotonicInitTime;
+  static std::atomic<OverflowPolicy> overflowPolicy;
+  static std::atomic<LogLevel> runtimeLevel;
+  static std::atomic<LogFormat> fileFormat;
+  friend class AsyncLogWriter;
 };
 
 #endif // LOGGER_H
\ No newline at end of file
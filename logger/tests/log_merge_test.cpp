@@ -0,0 +1,190 @@
+#include "../binary_log.h"
+#include "../log_merge.h"
+#include "../logger.h"
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Messages each process logs in the interleaving tests
+#define MERGE_TEST_MESSAGES 20
+
+// The writer of a process is configured before its first message, so every
+// process that logs is a forked child with a writer of its own
+static pid_t runInChild(std::function<void()> body) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    body();
+    std::exit(0);
+  }
+  return pid;
+}
+
+// Waits for the child, returns false if it did not exit with status 0 in time
+static bool waitForChild(pid_t pid, int timeoutMs = 5000) {
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(timeoutMs);
+  int status = 0;
+  while (waitpid(pid, &status, WNOHANG) == 0) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      kill(pid, SIGKILL);
+      waitpid(pid, &status, 0);
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static std::string readFile(const std::string &fileName) {
+  std::ifstream file(fileName, std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+// Two processes take turns through a pair of pipes, so their messages
+// interleave as a0 b0 a1 b1 ... Returns the segments of both processes.
+static std::vector<std::string> logInTurns(logger &log,
+                                           logger::LogFormat format) {
+  int toSecond[2], toFirst[2];
+  if (pipe(toSecond) < 0 || pipe(toFirst) < 0)
+    return {};
+
+  char token = 0;
+  pid_t first = runInChild([&]() {
+    logger::setFormat(format);
+    for (int i = 0; i < MERGE_TEST_MESSAGES; ++i) {
+      log.logMessage(logger::LogLevel::INFO, "a " + std::to_string(i));
+      if (write(toSecond[1], &token, 1) != 1 ||
+          read(toFirst[0], &token, 1) != 1)
+        std::exit(1);
+    }
+  });
+  pid_t second = runInChild([&]() {
+    logger::setFormat(format);
+    for (int i = 0; i < MERGE_TEST_MESSAGES; ++i) {
+      if (read(toSecond[0], &token, 1) != 1)
+        std::exit(1);
+      log.logMessage(logger::LogLevel::INFO, "b " + std::to_string(i));
+      if (write(toFirst[1], &token, 1) != 1)
+        std::exit(1);
+    }
+  });
+  for (int fd : {toSecond[0], toSecond[1], toFirst[0], toFirst[1]})
+    close(fd);
+
+  bool exited = waitForChild(first);
+  if (!waitForChild(second) || !exited)
+    return {};
+  return {logger::segmentFileName(log.getLogFileName(), first),
+          logger::segmentFileName(log.getLogFileName(), second)};
+}
+
+// The message every merged entry should have, in order
+static std::vector<std::string> turns() {
+  std::vector<std::string> messages;
+  for (int i = 0; i < MERGE_TEST_MESSAGES; ++i) {
+    messages.push_back("a " + std::to_string(i));
+    messages.push_back("b " + std::to_string(i));
+  }
+  return messages;
+}
+
+// Test that only the segments of the log file name with a numeric pid are
+// found, in the order of their names
+TEST(LogMergeTest, FindsSegmentsOfEveryProcess) {
+  std::vector<std::string> files = {
+      "merge_find.12.log", "merge_find.7.log",   "merge_find.log",
+      "merge_find.x1.log", "merge_find.12.log.1", "other_find.12.log"};
+  for (const std::string &name : files)
+    std::ofstream(name) << "line\n";
+
+  std::vector<std::string> segments = findLogSegments("merge_find.log");
+  ASSERT_EQ(segments.size(), 2u);
+  EXPECT_EQ(segments[0], "merge_find.12.log");
+  EXPECT_EQ(segments[1], "merge_find.7.log");
+  for (const std::string &name : files)
+    std::remove(name.c_str());
+}
+
+// Test that the text segments of two processes are merged in the order the
+// processes logged
+TEST(LogMergeTest, MergesInterleavedTextSegments) {
+  logger log("log_merge_test");
+  std::vector<std::string> segments =
+      logInTurns(log, logger::LogFormat::TEXT);
+  ASSERT_EQ(segments.size(), 2u);
+  std::vector<std::string> found = findLogSegments(log.getLogFileName());
+  for (const std::string &segment : segments)
+    EXPECT_NE(std::find(found.begin(), found.end(), segment), found.end());
+
+  EXPECT_EQ(mergeLogSegments(segments, "merge_text_test.out"),
+            2 * MERGE_TEST_MESSAGES);
+  std::istringstream merged(readFile("merge_text_test.out"));
+  std::string line;
+  ASSERT_TRUE(std::getline(merged, line));
+  EXPECT_EQ(line.compare(0, strlen(LOG_SEGMENT_HEADER), LOG_SEGMENT_HEADER), 0);
+  std::vector<std::string> messages;
+  int64_t previous = 0;
+  while (std::getline(merged, line)) {
+    int64_t elapsed = std::stoll(line.substr(1));
+    EXPECT_GE(elapsed, previous);
+    previous = elapsed;
+    messages.push_back(line.substr(line.find("[INFO] ") + 7));
+  }
+  EXPECT_EQ(messages, turns());
+
+  for (const std::string &segment : segments)
+    std::remove(segment.c_str());
+  std::remove("merge_text_test.out");
+}
+
+// Test that binary segments are merged on the monotonic clock and that the
+// reader turns their timestamps into wall clock times
+TEST(LogMergeTest, MergesInterleavedBinarySegments) {
+  logger log("log_merge_test");
+  std::vector<std::string> segments =
+      logInTurns(log, logger::LogFormat::BINARY);
+  ASSERT_EQ(segments.size(), 2u);
+
+  EXPECT_EQ(mergeLogSegments(segments, "merge_binary_test.out"),
+            2 * MERGE_TEST_MESSAGES);
+  BinaryLogReader reader;
+  ASSERT_TRUE(reader.open("merge_binary_test.out"));
+  int64_t monotonicNow = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now().time_since_epoch())
+                             .count();
+  int64_t wallClockNow = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+  const int64_t minute = 60000000000LL;
+
+  std::vector<std::string> messages;
+  BinaryLogReader::Entry entry;
+  int64_t previous = 0;
+  while (reader.next(entry)) {
+    EXPECT_GE(entry.timestamp, previous);
+    EXPECT_LT(std::llabs(entry.timestamp - monotonicNow), minute);
+    EXPECT_LT(std::llabs(reader.toWallClock(entry.timestamp) - wallClockNow),
+              minute);
+    previous = entry.timestamp;
+    messages.push_back(std::string(
+        reinterpret_cast<const char *>(entry.payload), entry.payloadLength));
+  }
+  EXPECT_EQ(messages, turns());
+
+  for (const std::string &segment : segments)
+    std::remove(segment.c_str());
+  std::remove("merge_binary_test.out");
+}
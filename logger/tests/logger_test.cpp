@@ -0,0 +1,436 @@
+#include "../logger.h"
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The writer of a process is configured before its first message, so every
+// test logs from a forked child with a writer of its own
+static pid_t runInChild(std::function<void()> body) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    body();
+    // Exits normally, the writer is flushed by its exit handler
+    std::exit(0);
+  }
+  return pid;
+}
+
+// Waits for the child, returns false if it did not exit with status 0 in time
+static bool waitForChild(pid_t pid, int timeoutMs = 5000) {
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(timeoutMs);
+  int status = 0;
+  while (waitpid(pid, &status, WNOHANG) == 0) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      kill(pid, SIGKILL);
+      waitpid(pid, &status, 0);
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static std::string readFile(const std::string &fileName) {
+  std::ifstream file(fileName, std::ios::binary);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+static std::string childSegment(logger &log, pid_t pid) {
+  return logger::segmentFileName(log.getLogFileName(), pid);
+}
+
+// Test that a child forked after the parent logged writes its own segment
+// instead of waiting for the writer thread of its parent
+TEST(LoggerTest, ForkedChildStartsItsOwnWriter) {
+  logger log("logger_test");
+  log.logMessage(logger::LogLevel::INFO, "parent before fork");
+  logger::flush();
+
+  logger::setOverflowPolicy(logger::OverflowPolicy::BLOCK);
+  pid_t pid = runInChild([&log]() {
+    log.logMessage(logger::LogLevel::INFO, "child after fork");
+    logger::flush();
+  });
+  logger::setOverflowPolicy(LOG_OVERFLOW_POLICY);
+  ASSERT_TRUE(waitForChild(pid));
+
+  std::string segment = childSegment(log, pid);
+  std::string content = readFile(segment);
+  EXPECT_NE(content.find("child after fork"), std::string::npos);
+  EXPECT_EQ(content.find("parent before fork"), std::string::npos);
+  std::remove(segment.c_str());
+}
+
+// Reads a pipe into a string until a flush from another thread returned and
+// the pipe is empty
+static std::string readPipeUntilFlushed(int pipe) {
+  std::atomic<bool> flushed(false);
+  std::thread flusher([&flushed]() {
+    logger::flush();
+    flushed = true;
+  });
+
+  std::string content;
+  char buffer[65536];
+  while (true) {
+    bool done = flushed.load();
+    ssize_t length = read(pipe, buffer, sizeof(buffer));
+    if (length > 0) {
+      content.append(buffer, length);
+    } else if (done) {
+      break;
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  flusher.join();
+  return content;
+}
+
+// Opens the segment of the process as a pipe nobody reads yet, the writer
+// blocks on it once it is full and the ring fills up behind it
+static int openStalledSegment(logger &log) {
+  std::string segment = log.getSegmentFileName();
+  if (mkfifo(segment.c_str(), 0644) < 0)
+    std::exit(2);
+  return open(segment.c_str(), O_RDONLY | O_NONBLOCK);
+}
+
+// The text of the lines of a segment after their time and level
+static std::vector<std::string> messagesOf(const std::string &segment) {
+  std::istringstream content(readFile(segment));
+  std::vector<std::string> messages;
+  std::string line;
+  while (std::getline(content, line)) {
+    size_t start = line.find("[INFO] ");
+    if (start != std::string::npos)
+      messages.push_back(line.substr(start + 7));
+  }
+  return messages;
+}
+
+// The indices of the lines "<prefix><index>" of a text, in their order
+static std::vector<int> indicesOf(const std::string &text,
+                                  const std::string &prefix) {
+  std::istringstream content(text);
+  std::vector<int> indices;
+  std::string line;
+  while (std::getline(content, line)) {
+    size_t start = line.find(prefix);
+    if (start != std::string::npos)
+      indices.push_back(std::stoi(line.substr(start + prefix.size())));
+  }
+  return indices;
+}
+
+// Test that records of concurrent producers, each longer than one slot,
+// arrive whole, in the order of their producer, and that none is lost
+TEST(LoggerTest, ConcurrentProducersLoseNoRecords) {
+  logger log("logger_test");
+  const int producers = 8;
+  const int messages = 2000;
+  const std::string padding(2 * LOG_RECORD_SIZE, 'x');
+  pid_t pid = runInChild([&]() {
+    logger::setOverflowPolicy(logger::OverflowPolicy::BLOCK);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+      threads.emplace_back([&, p]() {
+        for (int i = 0; i < messages; ++i)
+          log.logMessage(logger::LogLevel::INFO,
+                         "producer " + std::to_string(p) + " message " +
+                             std::to_string(i) + " " + padding);
+      });
+    for (std::thread &thread : threads)
+      thread.join();
+    if (logger::getDroppedMessages() != 0)
+      std::exit(1);
+  });
+  ASSERT_TRUE(waitForChild(pid, 30000));
+
+  std::string segment = childSegment(log, pid);
+  std::vector<int> next(producers, 0);
+  for (const std::string &record : messagesOf(segment)) {
+    std::istringstream fields(record);
+    std::string producerWord, messageWord, text;
+    int producer = -1, message = -1;
+    fields >> producerWord >> producer >> messageWord >> message >> text;
+    ASSERT_EQ(producerWord, "producer");
+    ASSERT_GE(producer, 0);
+    ASSERT_LT(producer, producers);
+    EXPECT_EQ(message, next[producer]++);
+    EXPECT_EQ(text, padding);
+  }
+  for (int p = 0; p < producers; ++p) {
+    EXPECT_EQ(next[p], messages);
+  }
+  std::remove(segment.c_str());
+}
+
+// Test that a full ring drops records under DROP and that the file reports
+// how many were dropped
+TEST(LoggerTest, FullRingDropsAndReportsRecords) {
+  logger log("logger_test");
+  const int messages = 4 * LOG_RING_RECORDS;
+  pid_t pid = runInChild([&]() {
+    logger::setOverflowPolicy(logger::OverflowPolicy::DROP);
+    int pipe = openStalledSegment(log);
+    for (int i = 0; i < messages; ++i)
+      log.logMessage(logger::LogLevel::INFO, "message " + std::to_string(i));
+    uint64_t dropped = logger::getDroppedMessages();
+
+    std::ofstream out(log.getSegmentFileName() + ".out");
+    out << readPipeUntilFlushed(pipe);
+    if (dropped == 0)
+      std::exit(1);
+  });
+  ASSERT_TRUE(waitForChild(pid, 20000));
+
+  std::string segment = childSegment(log, pid);
+  std::string content = readFile(segment + ".out");
+  std::vector<int> written = indicesOf(content, "[INFO] message ");
+  for (size_t i = 1; i < written.size(); ++i) {
+    EXPECT_GT(written[i], written[i - 1]);
+  }
+  long reported = 0;
+  for (int dropped : indicesOf(content, "[ERROR] Dropped ")) {
+    reported += dropped;
+  }
+  EXPECT_GT(reported, 0);
+  EXPECT_EQ(static_cast<long>(written.size()) + reported, messages);
+  std::remove(segment.c_str());
+  std::remove((segment + ".out").c_str());
+}
+
+// Test that a full ring makes producers wait under BLOCK instead of dropping
+TEST(LoggerTest, FullRingBlocksProducers) {
+  logger log("logger_test");
+  const int messages = 4 * LOG_RING_RECORDS;
+  pid_t pid = runInChild([&]() {
+    logger::setOverflowPolicy(logger::OverflowPolicy::BLOCK);
+    int pipe = openStalledSegment(log);
+    std::atomic<bool> done(false);
+    std::thread producer([&]() {
+      for (int i = 0; i < messages; ++i)
+        log.logMessage(logger::LogLevel::INFO,
+                       "message " + std::to_string(i));
+      done = true;
+    });
+
+    // The producer waits for the ring as long as the pipe is not read
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    bool blocked = !done;
+    std::string content;
+    char buffer[65536];
+    while (!done) {
+      ssize_t length = read(pipe, buffer, sizeof(buffer));
+      if (length > 0)
+        content.append(buffer, length);
+    }
+    producer.join();
+    content += readPipeUntilFlushed(pipe);
+
+    std::ofstream out(log.getSegmentFileName() + ".out");
+    out << content;
+    if (!blocked || logger::getDroppedMessages() != 0)
+      std::exit(1);
+  });
+  ASSERT_TRUE(waitForChild(pid, 20000));
+
+  std::string segment = childSegment(log, pid);
+  std::vector<int> indices =
+      indicesOf(readFile(segment + ".out"), "[INFO] message ");
+  ASSERT_EQ(indices.size(), static_cast<size_t>(messages));
+  for (int i = 0; i < messages; ++i) {
+    EXPECT_EQ(indices[i], i);
+  }
+  std::remove(segment.c_str());
+  std::remove((segment + ".out").c_str());
+}
+
+// Test that the records still in the ring when the process exits reach the
+// file without a flush
+TEST(LoggerTest, ExitWritesQueuedRecords) {
+  logger log("logger_test");
+  const int messages = LOG_RING_RECORDS / 2;
+  pid_t pid = runInChild([&]() {
+    logger::setOverflowPolicy(logger::OverflowPolicy::BLOCK);
+    for (int i = 0; i < messages; ++i)
+      log.logMessage(logger::LogLevel::INFO, "message " + std::to_string(i));
+  });
+  ASSERT_TRUE(waitForChild(pid));
+
+  std::string segment = childSegment(log, pid);
+  std::vector<int> indices = indicesOf(readFile(segment), "[INFO] message ");
+  ASSERT_EQ(indices.size(), static_cast<size_t>(messages));
+  for (int i = 0; i < messages; ++i) {
+    EXPECT_EQ(indices[i], i);
+  }
+  std::remove(segment.c_str());
+}
+
+// Test that the writer thread fills in the arguments of the LOG_* macros,
+// with more or fewer arguments than {} and with escaped braces
+TEST(LoggerTest, FormatsMacroArguments) {
+  logger log("logger_test");
+  pid_t pid = runInChild([&log]() {
+    LOG_INFO(log, "packet {} of message {}", 3, std::string("seven"));
+    LOG_INFO(log, "a {} b {} c {}", -1, 'x');
+    LOG_INFO(log, "only {}", true, 2.5);
+    LOG_INFO(log, "{{}} {{{}}} }} {", 5u);
+    LOG_ROUTE_INFO(log, 1, "2", "data {}", logger::hex("\x01\xab", 2));
+  });
+  ASSERT_TRUE(waitForChild(pid));
+
+  std::string segment = childSegment(log, pid);
+  std::vector<std::string> messages = messagesOf(segment);
+  ASSERT_EQ(messages.size(), 5u);
+  EXPECT_EQ(messages[0], "packet 3 of message seven");
+  EXPECT_EQ(messages[1], "a -1 b x c {}");
+  EXPECT_EQ(messages[2], "only true");
+  EXPECT_EQ(messages[3], "{} {5} } {");
+  EXPECT_EQ(messages[4], "SRC 1 DST 2 data 0x01ab");
+  std::remove(segment.c_str());
+}
+
+// Test that arguments longer than a slot of the ring are kept whole and that
+// an argument longer than a whole record is cut without breaking the line
+TEST(LoggerTest, FormatsArgumentsLongerThanASlot) {
+  logger log("logger_test");
+  const std::string slots(3 * LOG_RECORD_SIZE + 1, 's');
+  const std::string record(LOG_RING_RECORDS * LOG_RECORD_SIZE, 'r');
+  pid_t pid = runInChild([&]() {
+    logger::setOverflowPolicy(logger::OverflowPolicy::BLOCK);
+    LOG_INFO(log, "{} then {}", slots, 42);
+    LOG_INFO(log, "{} then {}", record, 42);
+    LOG_INFO(log, "after {}", 1);
+  });
+  ASSERT_TRUE(waitForChild(pid));
+
+  std::string segment = childSegment(log, pid);
+  std::vector<std::string> messages = messagesOf(segment);
+  ASSERT_EQ(messages.size(), 3u);
+  EXPECT_EQ(messages[0], slots + " then 42");
+
+  // The cut argument is the last one the record holds, the next {} stays
+  std::string cut = messages[1];
+  ASSERT_GT(cut.size(), slots.size());
+  EXPECT_LT(cut.size(), record.size());
+  EXPECT_EQ(cut.find_first_not_of('r'), cut.size() - 8);
+  EXPECT_EQ(cut.substr(cut.size() - 8), " then {}");
+  EXPECT_EQ(messages[2], "after 1");
+  std::remove(segment.c_str());
+}
+
+// Test that a segment past its size limit is rotated, that only the newest
+// rotated files are kept and that together they hold the latest records
+TEST(LoggerTest, RotatesSegmentsPastTheSizeLimit) {
+  logger log("logger_test");
+  const int batches = 10;
+  const int batchSize = 40;
+  const std::string padding(80, 'p');
+  pid_t pid = runInChild([&]() {
+    logger::setOverflowPolicy(logger::OverflowPolicy::BLOCK);
+    logger::setRotation(4096, 0, 2);
+    for (int i = 0; i < batches * batchSize; ++i) {
+      log.logMessage(logger::LogLevel::INFO,
+                     "message " + std::to_string(i) + " " + padding);
+      if (i % batchSize == batchSize - 1)
+        logger::flush();
+    }
+  });
+  ASSERT_TRUE(waitForChild(pid));
+
+  std::string segment = childSegment(log, pid);
+  std::vector<std::string> files = {segment + ".2", segment + ".1", segment};
+  std::vector<int> indices;
+  for (const std::string &file : files) {
+    std::string content = readFile(file);
+    EXPECT_EQ(content.compare(0, strlen(LOG_SEGMENT_HEADER),
+                              LOG_SEGMENT_HEADER),
+              0)
+        << file;
+    std::vector<int> inFile = indicesOf(content, "[INFO] message ");
+    EXPECT_FALSE(inFile.empty()) << file;
+    indices.insert(indices.end(), inFile.begin(), inFile.end());
+  }
+  EXPECT_FALSE(std::ifstream(segment + ".3").good());
+
+  // The kept files hold the last records without a gap, the first ones are
+  // gone with the deleted files
+  ASSERT_FALSE(indices.empty());
+  EXPECT_GT(indices.front(), 0);
+  EXPECT_EQ(indices.back(), batches * batchSize - 1);
+  for (size_t i = 1; i < indices.size(); ++i)
+    EXPECT_EQ(indices[i], indices[i - 1] + 1);
+
+  for (const std::string &file : files)
+    std::remove(file.c_str());
+}
+
+// Test that the flight recorder keeps the records out of the file until it
+// is dumped, and that a dump writes the last records that fit
+TEST(LoggerTest, DumpsTheLastRecordsOfTheFlightRecorder) {
+  logger log("logger_test");
+  const size_t recorderBytes = 4096;
+  const int records = 200;
+  pid_t pid = runInChild([&]() {
+    logger::setFlightRecorder(recorderBytes);
+    std::string segment = log.getSegmentFileName();
+    for (int i = 0; i < records; ++i)
+      log.logMessage(logger::LogLevel::INFO, "record " + std::to_string(i));
+    logger::flush();
+    std::ofstream(segment + ".flushed") << readFile(segment);
+
+    logger::dumpFlightRecorder();
+    std::ofstream(segment + ".dumped") << readFile(segment);
+
+    // The signal only sets a flag, the writer dumps on its next pass
+    for (int i = 0; i < 10; ++i)
+      log.logMessage(logger::LogLevel::INFO, "after " + std::to_string(i));
+    logger::flush();
+    raise(LOG_FLIGHT_RECORDER_SIGNAL);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (readFile(segment).find("after 9") == std::string::npos &&
+           std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    std::ofstream(segment + ".signaled") << readFile(segment);
+  });
+  ASSERT_TRUE(waitForChild(pid));
+
+  std::string segment = childSegment(log, pid);
+  std::string flushed = readFile(segment + ".flushed");
+  EXPECT_TRUE(indicesOf(flushed, "[INFO] record ").empty());
+
+  std::string dumped = readFile(segment + ".dumped");
+  std::vector<int> indices = indicesOf(dumped, "[INFO] record ");
+  ASSERT_FALSE(indices.empty());
+  EXPECT_GT(indices.front(), 0);
+  EXPECT_EQ(indices.back(), records - 1);
+  for (size_t i = 1; i < indices.size(); ++i)
+    EXPECT_EQ(indices[i], indices[i - 1] + 1);
+  EXPECT_LE(dumped.size() - flushed.size(), recorderBytes);
+
+  std::string signaled = readFile(segment + ".signaled");
+  EXPECT_EQ(signaled.compare(0, dumped.size(), dumped), 0);
+  EXPECT_EQ(indicesOf(signaled, "[INFO] after ").size(), 10u);
+
+  for (const char *suffix : {"", ".flushed", ".dumped", ".signaled"})
+    std::remove((segment + suffix).c_str());
+}
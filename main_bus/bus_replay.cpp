@@ -0,0 +1,46 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "../communication/include/bus_replay.h"
+#include "../communication/include/process_lifecycle.h"
+
+// Replays a capture of main_bus into a running bus:
+//   bus_replay <capture> [speed] [port]
+// speed 1 keeps the recorded pace, N is N times faster and 0 as fast as possible
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 4) {
+        std::cerr << "usage: " << argv[0] << " <capture> [speed] [port]" << std::endl;
+        return 1;
+    }
+
+    // Created before any thread, so that SIGINT and SIGTERM end the replay
+    ProcessLifecycle lifecycle;
+
+    std::unique_ptr<BusReplayer> replayer;
+    try {
+        int port = argc > 3 ? std::stoi(argv[3]) : ClientConnection::portFromEnvironment();
+        replayer.reset(new BusReplayer(argv[1], port));
+        if (argc > 2)
+            replayer->setSpeed(std::stod(argv[2]));
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    ErrorCode result = ErrorCode::SUCCESS;
+    lifecycle.addWorker(
+        [&]() {
+            result = replayer->run();
+            lifecycle.requestStop();
+        },
+        [&]() { replayer->stop(); });
+    lifecycle.run();
+
+    std::cout << "replayed " << replayer->getReplayed() << " packets, " << replayer->getFailed() << " failed" << std::endl;
+    if (result != ErrorCode::SUCCESS) {
+        std::cerr << toString(result) << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,10 +1,45 @@
+#include <cstdlib>
+#include <iostream>
 #include "../communication/include/bus_manager.h"
-int main()
+#include "../communication/include/bus_topology.h"
+#include "../communication/include/process_lifecycle.h"
+
+// Runs the bus on the default port, or the buses and gateways of the topology file given as the argument
+int main(int argc, char *argv[])
 {
+    // Created before any thread, so that SIGINT and SIGTERM reach the run loop
+    ProcessLifecycle lifecycle;
+
+    if (argc > 1) {
+        BusTopology topology;
+        try {
+            topology = BusTopology::load(argv[1]);
+        } catch (const std::invalid_argument &error) {
+            std::cerr << error.what() << std::endl;
+            return 1;
+        }
+        if (topology.start() != ErrorCode::SUCCESS)
+            return 1;
+
+        lifecycle.onShutdown([&topology]() { topology.stop(); });
+        lifecycle.run();
+        return 0;
+    }
+
     std::vector<uint32_t> ids;
-    uint32_t limit;
+    uint32_t limit = 0;
     BusManager* manager = BusManager::getInstance(ids, limit);
-    manager->startConnection();
-    while(true);
+    const char *bitrate = std::getenv(BUS_BITRATE_ENV);
+    if (bitrate && *bitrate)
+        manager->setBitrate(std::strtoul(bitrate, nullptr, 10));
+    const char *captureFile = std::getenv(BUS_CAPTURE_ENV);
+    if (captureFile && *captureFile && !manager->startCapture(captureFile))
+        return 1;
+    if (manager->startConnection() != ErrorCode::SUCCESS)
+        return 1;
+
+    // Sleeps until the bus is stopped, the bus itself runs on its event loops
+    lifecycle.onShutdown([manager]() { delete manager; });
+    lifecycle.run();
     return 0;
-}
\ No newline at end of file
+}